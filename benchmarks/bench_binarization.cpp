@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/image_processing.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+namespace {
+
+// Grayscale board photo with a lighting gradient and handwriting-like lines
+cv::Mat MakeBoard(int width, int height) {
+  cv::Mat board(height, width, CV_8UC1);
+  for (int y = 0; y < height; y++) {
+    uchar *row = board.ptr<uchar>(y);
+    for (int x = 0; x < width; x++) {
+      row[x] = static_cast<uchar>(120 + 100 * x / width + 30 * y / height);
+    }
+  }
+
+  cv::RNG rng(42);
+  for (int i = 0; i < width / 8; i++) {
+    const cv::Point from(rng.uniform(0, width), rng.uniform(0, height));
+    const cv::Point to = from + cv::Point(rng.uniform(-60, 60),
+                                          rng.uniform(-60, 60));
+    cv::line(board, from, to, cv::Scalar(rng.uniform(20, 90)), 3);
+  }
+  return board;
+}
+
+void BM_GlobalThreshold(benchmark::State &state) {
+  const cv::Mat board = MakeBoard(state.range(0), state.range(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mathboard::BinarizeImage(board));
+  }
+  state.SetItemsProcessed(state.iterations() * board.total());
+}
+
+void BM_AdaptiveThreshold(benchmark::State &state) {
+  const cv::Mat board = MakeBoard(state.range(0), state.range(1));
+  cv::Mat output;
+  for (auto _ : state) {
+    cv::adaptiveThreshold(board, output, 255, cv::ADAPTIVE_THRESH_MEAN_C,
+                          cv::THRESH_BINARY, 31, 10);
+    benchmark::DoNotOptimize(output.data);
+  }
+  state.SetItemsProcessed(state.iterations() * board.total());
+}
+
+void BM_SauvolaBinarize(benchmark::State &state) {
+  const cv::Mat board = MakeBoard(state.range(0), state.range(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mathboard::SauvolaBinarize(board));
+  }
+  state.SetItemsProcessed(state.iterations() * board.total());
+}
+
+} // namespace
+
+#define FRAME_SIZES                                                            \
+  Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160})->UseRealTime()
+
+BENCHMARK(BM_GlobalThreshold)->FRAME_SIZES;
+BENCHMARK(BM_AdaptiveThreshold)->FRAME_SIZES;
+BENCHMARK(BM_SauvolaBinarize)->FRAME_SIZES;
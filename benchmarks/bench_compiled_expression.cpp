@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/compiled_expression.hpp"
+
+#include <symengine/eval.h>
+#include <symengine/parser.h>
+#include <symengine/real_double.h>
+
+namespace {
+
+// Function recognized from a board, sanitized
+const std::string kEquation = "sin(X)/X+X**2/100";
+
+std::vector<double> MakeInputs(std::size_t count) {
+  std::vector<double> xs(count);
+  for (std::size_t i = 0; i < count; i++) {
+    xs[i] = -50.0 + 100.0 * static_cast<double>(i) / count + 1e-3;
+  }
+  return xs;
+}
+
+void BM_SubsEvalf(benchmark::State &state) {
+  const auto expr = SymEngine::parse(kEquation);
+  const auto x = SymEngine::symbol("X");
+  const std::vector<double> xs = MakeInputs(state.range(0));
+  for (auto _ : state) {
+    for (const double value : xs) {
+      const auto substituted = expr->subs({{x, SymEngine::real_double(value)}});
+      benchmark::DoNotOptimize(
+          SymEngine::evalf(*substituted, 53, SymEngine::EvalfDomain::Real));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * xs.size());
+}
+
+void BM_LambdaDoubleVisitor(benchmark::State &state) {
+  SymEngine::LambdaRealDoubleVisitor visitor;
+  visitor.init({SymEngine::symbol("X")}, *SymEngine::parse(kEquation));
+  const std::vector<double> xs = MakeInputs(state.range(0));
+  std::vector<double> ys(xs.size());
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < xs.size(); i++) {
+      visitor.call(&ys[i], &xs[i]);
+    }
+    benchmark::DoNotOptimize(ys.data());
+  }
+  state.SetItemsProcessed(state.iterations() * xs.size());
+}
+
+void BM_CompiledExpressionBatch(benchmark::State &state) {
+  const auto compiled =
+      mathboard::CompiledExpression::FromEquation(kEquation, {"X"});
+  const std::vector<double> xs = MakeInputs(state.range(0));
+  std::vector<double> ys(xs.size());
+  const double *input = xs.data();
+  for (auto _ : state) {
+    compiled.EvaluateBatch({&input, 1}, ys);
+    benchmark::DoNotOptimize(ys.data());
+  }
+  state.SetItemsProcessed(state.iterations() * xs.size());
+}
+
+void BM_CompiledExpressionParallel(benchmark::State &state) {
+  const auto compiled =
+      mathboard::CompiledExpression::FromEquation(kEquation, {"X"});
+  const std::vector<double> xs = MakeInputs(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(compiled.Evaluate(xs));
+  }
+  state.SetItemsProcessed(state.iterations() * xs.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_SubsEvalf)->Arg(1 << 12);
+BENCHMARK(BM_LambdaDoubleVisitor)->Arg(1 << 12)->Arg(1 << 20);
+BENCHMARK(BM_CompiledExpressionBatch)->Arg(1 << 12)->Arg(1 << 20);
+BENCHMARK(BM_CompiledExpressionParallel)
+    ->Arg(1 << 12)
+    ->Arg(1 << 20)
+    ->UseRealTime();
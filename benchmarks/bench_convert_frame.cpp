@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/opencv_helper.hpp"
+
+namespace {
+
+constexpr std::uint32_t kBlockCount = 64;
+
+cv::Mat MakeFrame(int width, int height) {
+  cv::Mat frame(height, width, CV_8UC3);
+  cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+  return frame;
+}
+
+// Per pixel block averaging, how ConvertFrame used to work
+void NaiveBlockAverage(const cv::Mat &frame, std::uint32_t size,
+                       cv::Mat &luminance) {
+  const float aspectRatio =
+      static_cast<float>(frame.rows) / static_cast<float>(frame.cols);
+  const std::uint32_t blockSizeX = std::max(
+      1U, frame.cols / static_cast<std::uint32_t>(size / aspectRatio));
+  const std::uint32_t blockSizeY = std::max(1U, frame.rows / size);
+  const std::uint32_t numBlocksX = frame.cols / blockSizeX;
+  const std::uint32_t numBlocksY = frame.rows / blockSizeY;
+
+  luminance.create(numBlocksY, numBlocksX, CV_8UC1);
+  for (std::uint32_t i = 0; i < numBlocksX; i++) {
+    for (std::uint32_t j = 0; j < numBlocksY; j++) {
+      std::uint32_t sum = 0;
+      for (std::uint32_t bi = 0; bi < blockSizeX; ++bi) {
+        for (std::uint32_t bj = 0; bj < blockSizeY; ++bj) {
+          const cv::Vec3b pixel =
+              frame.at<cv::Vec3b>(j * blockSizeY + bj, i * blockSizeX + bi);
+          sum += pixel[0] + pixel[1] + pixel[2];
+        }
+      }
+      luminance.at<uchar>(j, i) =
+          static_cast<uchar>(sum / (3 * blockSizeX * blockSizeY));
+    }
+  }
+}
+
+void BM_NaiveBlockAverage(benchmark::State &state) {
+  const cv::Mat frame = MakeFrame(state.range(0), state.range(1));
+  cv::Mat luminance;
+  for (auto _ : state) {
+    NaiveBlockAverage(frame, kBlockCount, luminance);
+    benchmark::DoNotOptimize(luminance.data);
+  }
+  state.SetItemsProcessed(state.iterations() * frame.total());
+}
+
+void BM_ConvertFrame(benchmark::State &state) {
+  const cv::Mat frame = MakeFrame(state.range(0), state.range(1));
+  cv::Mat luminance;
+  for (auto _ : state) {
+    mathboard::OpenCVHelper::ConvertFrame(frame, kBlockCount, luminance);
+    benchmark::DoNotOptimize(luminance.data);
+  }
+  state.SetItemsProcessed(state.iterations() * frame.total());
+}
+
+} // namespace
+
+BENCHMARK(BM_NaiveBlockAverage)
+    ->Args({1280, 720})
+    ->Args({1920, 1080})
+    ->Args({3840, 2160})
+    ->UseRealTime();
+BENCHMARK(BM_ConvertFrame)
+    ->Args({1280, 720})
+    ->Args({1920, 1080})
+    ->Args({3840, 2160})
+    ->UseRealTime();
@@ -0,0 +1,89 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/json_writer.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Contours of a board result, flat x0, y0, x1, y1, ... per stroke
+std::vector<std::vector<int>> MakeContours(std::size_t stroke_count) {
+  std::vector<std::vector<int>> contours(stroke_count);
+  for (std::size_t i = 0; i < stroke_count; i++) {
+    for (int point = 0; point < 40; point++) {
+      contours[i].push_back(static_cast<int>(i) + point);
+      contours[i].push_back(point * 3);
+    }
+  }
+  return contours;
+}
+
+// How the replies used to be built
+void BM_NlohmannReply(benchmark::State &state) {
+  const auto contours = MakeContours(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    nlohmann::json strokes = nlohmann::json::array();
+    for (std::size_t i = 0; i < contours.size(); i++) {
+      strokes.push_back({{"id", i},
+                         {"x", 10.0f},
+                         {"y", 20.0f},
+                         {"boundingBox", {0, 0, 40, 120}},
+                         {"contours", {contours[i]}}});
+    }
+    const nlohmann::json reply{
+        {"status", "ok"}, {"requestId", 1}, {"strokes", std::move(strokes)}};
+    std::string text = reply.dump();
+    benchmark::DoNotOptimize(text);
+  }
+}
+
+void BM_JsonWriterReply(benchmark::State &state) {
+  const auto contours = MakeContours(static_cast<std::size_t>(state.range(0)));
+  mathboard::JsonWriter writer{};
+  for (auto _ : state) {
+    writer.Clear();
+    writer.BeginObject()
+        .Key("status")
+        .String("ok")
+        .Key("requestId")
+        .UInt(1)
+        .Key("strokes")
+        .BeginArray();
+    for (std::size_t i = 0; i < contours.size(); i++) {
+      writer.BeginObject()
+          .Key("id")
+          .UInt(i)
+          .Key("x")
+          .Double(10.0f)
+          .Key("y")
+          .Double(20.0f)
+          .Key("boundingBox")
+          .BeginArray()
+          .Int(0)
+          .Int(0)
+          .Int(40)
+          .Int(120)
+          .EndArray()
+          .Key("contours")
+          .BeginArray()
+          .BeginArray();
+      for (const int value : contours[i]) {
+        writer.Int(value);
+      }
+      writer.EndArray().EndArray().EndObject();
+    }
+    writer.EndArray().EndObject();
+    // The copy into the connection's queue
+    std::string text(writer.View());
+    benchmark::DoNotOptimize(text);
+  }
+}
+
+} // namespace
+
+BENCHMARK(BM_NlohmannReply)->Arg(8)->Arg(512);
+BENCHMARK(BM_JsonWriterReply)->Arg(8)->Arg(512);
@@ -0,0 +1,46 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/system_solver.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Tridiagonal linear system of `count` unknowns, one equation per line
+std::vector<std::string> MakeLinearSystem(std::size_t count) {
+  std::vector<std::string> equations;
+  for (std::size_t i = 0; i < count; i++) {
+    std::string equation = "4*X" + std::to_string(i);
+    if (i > 0) {
+      equation += "-X" + std::to_string(i - 1);
+    }
+    if (i + 1 < count) {
+      equation += "-X" + std::to_string(i + 1);
+    }
+    equations.push_back(equation + "-(" + std::to_string(i) + ")");
+  }
+  return equations;
+}
+
+void BM_SolveLinearSystem(benchmark::State &state) {
+  const std::vector<std::string> equations = MakeLinearSystem(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mathboard::SolveSystems(equations));
+  }
+  state.SetItemsProcessed(state.iterations() * equations.size());
+}
+
+void BM_SolveNonLinearSystem(benchmark::State &state) {
+  // Circle intersected with a parabola
+  const std::vector<std::string> equations = {"X**2+Y**2-(4)",
+                                              "Y-(X**2-1)"};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mathboard::SolveSystems(equations));
+  }
+}
+
+} // namespace
+
+BENCHMARK(BM_SolveLinearSystem)->Arg(2)->Arg(50)->Arg(500);
+BENCHMARK(BM_SolveNonLinearSystem);
@@ -0,0 +1,174 @@
+#include <benchmark/benchmark.h>
+
+#include "../src/unix_socket_server/shared_memory_client.hpp"
+#include "../src/unix_socket_server/unix_socket_server.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr const char *kSocketPath = "/tmp/mathboard_bench_transport.sock";
+
+// Send every message back until all `clients` connected and hung up again,
+// like the daemon loop does
+std::thread StartEchoServer(mathboard::UnixSocketServer &server,
+                            std::size_t clients = 1) {
+  server.Init(kSocketPath);
+  server.Listen();
+  return std::thread([&server, clients]() {
+    std::vector<std::int32_t> connected;
+    std::size_t accepted = 0;
+    std::vector<unsigned char> buffer;
+    std::vector<std::int32_t> socketFds;
+    std::vector<std::int32_t> ready;
+    while (accepted < clients || !connected.empty()) {
+      socketFds = connected;
+      socketFds.push_back(server.GetServerSocketFd());
+      if (!server.Poll(socketFds, ready)) {
+        continue;
+      }
+      for (const std::int32_t socketFd : ready) {
+        if (socketFd == server.GetServerSocketFd()) {
+          int clientFd;
+          void *clientAddr;
+          if (server.Accept(clientFd, &clientAddr)) {
+            free(clientAddr);
+            connected.push_back(clientFd);
+            accepted++;
+          }
+          continue;
+        }
+        buffer.resize(64 * 1024);
+        if (!server.Read(socketFd, buffer) || buffer.empty()) {
+          server.Close(socketFd);
+          std::erase(connected, socketFd);
+          continue;
+        }
+        server.Write(socketFd, buffer);
+      }
+    }
+  });
+}
+
+int ConnectSocket() {
+  const int socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::string(kSocketPath).copy(address.sun_path,
+                                sizeof(address.sun_path) - 1);
+  connect(socketFd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  return socketFd;
+}
+
+// Wait for the whole echo, it can come back in pieces
+void ReceiveEcho(int socket_fd, std::vector<char> &reply) {
+  std::size_t received = 0;
+  while (received < reply.size()) {
+    const ssize_t result = recv(socket_fd, reply.data() + received,
+                                reply.size() - received, 0);
+    if (result <= 0) {
+      return;
+    }
+    received += static_cast<std::size_t>(result);
+  }
+}
+
+void BM_SocketRoundTrip(benchmark::State &state) {
+  std::unique_ptr<mathboard::UnixSocketServer> server(
+      mathboard::UnixSocketServer::Instance(mathboard::Transport::Socket));
+  std::thread echo = StartEchoServer(*server);
+
+  const int socketFd = ConnectSocket();
+
+  const std::string message(state.range(0), 'x');
+  std::vector<char> reply(message.size());
+  for (auto _ : state) {
+    send(socketFd, message.data(), message.size(), 0);
+    ReceiveEcho(socketFd, reply);
+    benchmark::DoNotOptimize(reply.data());
+  }
+  state.SetBytesProcessed(state.iterations() * message.size());
+
+  close(socketFd);
+  echo.join();
+}
+
+void BM_SharedMemoryRoundTrip(benchmark::State &state) {
+  std::unique_ptr<mathboard::UnixSocketServer> server(
+      mathboard::UnixSocketServer::Instance(
+          mathboard::Transport::SharedMemory));
+  std::thread echo = StartEchoServer(*server);
+
+  mathboard::SharedMemoryClient client{};
+  client.Connect(kSocketPath);
+
+  const std::string message(state.range(0), 'x');
+  std::vector<unsigned char> reply;
+  for (auto _ : state) {
+    client.Send(message);
+    client.Receive(reply, std::chrono::milliseconds(1000));
+    benchmark::DoNotOptimize(reply.data());
+  }
+  state.SetBytesProcessed(state.iterations() * message.size());
+
+  client.Close();
+  echo.join();
+}
+
+// Every connection has one small request in flight at a time, the server
+// handles them all in one loop
+void ManySmallRequests(benchmark::State &state,
+                       mathboard::Transport transport) {
+  const auto connections = static_cast<std::size_t>(state.range(0));
+  std::unique_ptr<mathboard::UnixSocketServer> server(
+      mathboard::UnixSocketServer::Instance(transport));
+  std::thread echo = StartEchoServer(*server, connections);
+
+  std::vector<int> socketFds;
+  for (std::size_t i = 0; i < connections; i++) {
+    socketFds.push_back(ConnectSocket());
+  }
+
+  const std::string message(64, 'x');
+  std::vector<char> reply(message.size());
+  for (auto _ : state) {
+    for (const int socketFd : socketFds) {
+      send(socketFd, message.data(), message.size(), 0);
+    }
+    for (const int socketFd : socketFds) {
+      ReceiveEcho(socketFd, reply);
+    }
+    benchmark::DoNotOptimize(reply.data());
+  }
+  state.SetItemsProcessed(state.iterations() * connections);
+
+  for (const int socketFd : socketFds) {
+    close(socketFd);
+  }
+  echo.join();
+}
+
+void BM_SocketManySmallRequests(benchmark::State &state) {
+  ManySmallRequests(state, mathboard::Transport::Socket);
+}
+
+void BM_IoUringManySmallRequests(benchmark::State &state) {
+  ManySmallRequests(state, mathboard::Transport::IoUring);
+}
+
+} // namespace
+
+BENCHMARK(BM_SocketManySmallRequests)->Arg(1)->Arg(16)->Arg(128);
+BENCHMARK(BM_IoUringManySmallRequests)->Arg(1)->Arg(16)->Arg(128);
+BENCHMARK(BM_SocketRoundTrip)->Arg(64)->Arg(1024)->Arg(16 * 1024);
+BENCHMARK(BM_SharedMemoryRoundTrip)->Arg(64)->Arg(1024)->Arg(16 * 1024);
@@ -0,0 +1,421 @@
+// header
+#include "batch.hpp"
+
+// local
+#include "json_writer.hpp"
+#include "metrics/metrics.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+// json
+#include <nlohmann/json.hpp>
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+namespace {
+
+// Set from the SIGINT handler, lock-free so it's safe to store there
+std::atomic<bool> g_Interrupted{false};
+
+void OnInterrupt(int /*signal*/) { g_Interrupted.store(true); }
+
+// Requests written to the output so far and the output size at that point.
+// Anything past `output_bytes` belongs to requests after the checkpoint and
+// is written again on resume.
+struct Checkpoint {
+  std::uint64_t completed{0};
+  std::uint64_t output_bytes{0};
+};
+
+// Empty checkpoint when there's none yet, nullopt when it's unreadable
+std::optional<Checkpoint> ReadCheckpoint(const std::filesystem::path &path) {
+  if (!std::filesystem::exists(path)) {
+    return Checkpoint{};
+  }
+
+  std::ifstream file(path);
+  const nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+  if (json.is_discarded() || !json.contains("completed") ||
+      !json.contains("outputBytes")) {
+    spdlog::error("[RunBatch]: Checkpoint {} is corrupted.\n", path.string());
+    return std::nullopt;
+  }
+  return Checkpoint{json["completed"].get<std::uint64_t>(),
+                    json["outputBytes"].get<std::uint64_t>()};
+}
+
+bool WriteCheckpoint(const std::filesystem::path &path,
+                     const Checkpoint &checkpoint) {
+  // A crash while writing leaves the previous checkpoint intact
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+
+  {
+    std::ofstream file(temporary, std::ios::trunc);
+    file << nlohmann::json{{"completed", checkpoint.completed},
+                           {"outputBytes", checkpoint.output_bytes}}
+                .dump()
+         << '\n';
+    if (!file) {
+      spdlog::error("[RunBatch]: Could not write {}.\n", temporary.string());
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    spdlog::error("[RunBatch]: Could not replace {}: {}.\n", path.string(),
+                  error.message());
+    return false;
+  }
+  return true;
+}
+
+// Requests of a directory, sorted by file name, or of a JSONL file. The order
+// is the same on every run, so a checkpoint can refer to it by count.
+class BatchInput {
+public:
+  bool Open(const std::filesystem::path &input) {
+    std::error_code error;
+    if (std::filesystem::is_directory(input, error)) {
+      for (const auto &entry :
+           std::filesystem::directory_iterator(input, error)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") {
+          m_Files.push_back(entry.path());
+        }
+      }
+      std::sort(m_Files.begin(), m_Files.end());
+      m_IsDirectory = true;
+    } else {
+      m_Lines.open(input);
+      m_Path = input;
+    }
+
+    if (error || (!m_IsDirectory && !m_Lines)) {
+      spdlog::error("[RunBatch]: Could not open the input {}.\n",
+                    input.string());
+      return false;
+    }
+    return true;
+  }
+
+  // Skip `count` requests without reading them
+  void Skip(std::uint64_t count) {
+    if (m_IsDirectory) {
+      m_NextFile = std::min<std::uint64_t>(count, m_Files.size());
+      return;
+    }
+
+    std::string line;
+    for (std::uint64_t i = 0; i < count && NextLine(line); i++) {
+    }
+  }
+
+  // Return false at the end of the input
+  bool Next(std::string &source, std::string &text) {
+    if (m_IsDirectory) {
+      if (m_NextFile == m_Files.size()) {
+        return false;
+      }
+      const std::filesystem::path &path = m_Files[m_NextFile++];
+      std::ifstream file(path, std::ios::binary);
+      std::ostringstream contents;
+      contents << file.rdbuf();
+      source = path.string();
+      text = std::move(contents).str();
+      return true;
+    }
+
+    if (!NextLine(text)) {
+      return false;
+    }
+    source = m_Path.string() + ":" + std::to_string(m_LineNumber);
+    return true;
+  }
+
+private:
+  // Next non-empty line
+  bool NextLine(std::string &line) {
+    while (std::getline(m_Lines, line)) {
+      m_LineNumber++;
+      if (line.find_first_not_of(" \t\r") != std::string::npos) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  bool m_IsDirectory{false};
+  std::vector<std::filesystem::path> m_Files{};
+  std::size_t m_NextFile{0};
+  std::filesystem::path m_Path{};
+  std::ifstream m_Lines{};
+  std::uint64_t m_LineNumber{0};
+};
+
+// Writes results in input order, whatever order the pipeline finishes them
+// in, and checkpoints the written prefix
+class ResultWriter {
+public:
+  ResultWriter(std::ofstream &output, std::filesystem::path checkpoint_path,
+               const Checkpoint &checkpoint, std::size_t interval)
+      : m_Output(output), m_CheckpointPath(std::move(checkpoint_path)),
+        m_Checkpoint(checkpoint),
+        m_Interval(std::max<std::size_t>(interval, 1)) {}
+
+  void Write(std::uint64_t index, std::string line) {
+    std::lock_guard<std::mutex> lockOutput(m_Mutex);
+    m_Pending.emplace(index, std::move(line));
+    for (auto it = m_Pending.begin();
+         it != m_Pending.end() && it->first == m_Checkpoint.completed;
+         it = m_Pending.erase(it)) {
+      m_Output << it->second << '\n';
+      m_Checkpoint.output_bytes += it->second.size() + 1;
+      m_Checkpoint.completed++;
+      if (++m_SinceCommit == m_Interval) {
+        CommitLocked();
+      }
+    }
+  }
+
+  // Flush the output and checkpoint everything written
+  bool Commit() {
+    std::lock_guard<std::mutex> lockOutput(m_Mutex);
+    return CommitLocked();
+  }
+
+  std::uint64_t GetCompleted() {
+    std::lock_guard<std::mutex> lockOutput(m_Mutex);
+    return m_Checkpoint.completed;
+  }
+
+private:
+  bool CommitLocked() {
+    m_SinceCommit = 0;
+    // The checkpoint must never get ahead of the data on disk
+    m_Output.flush();
+    if (!m_Output) {
+      spdlog::error("[RunBatch]: Could not write the output.\n");
+      return false;
+    }
+    return WriteCheckpoint(m_CheckpointPath, m_Checkpoint);
+  }
+
+private:
+  std::mutex m_Mutex{};
+  std::ofstream &m_Output;
+  const std::filesystem::path m_CheckpointPath;
+  Checkpoint m_Checkpoint;
+  const std::size_t m_Interval;
+  std::size_t m_SinceCommit{0};
+  // Results finished before the ones preceding them
+  std::map<std::uint64_t, std::string> m_Pending{};
+};
+
+// Result line of a processed request, written without a nlohmann::json
+// tree: a board can have thousands of contour points
+void WriteResultJson(JsonWriter &writer, const RequestWork &work) {
+  writer.BeginObject()
+      .Key("index")
+      .UInt(work.request_id)
+      .Key("source")
+      .String(work.source)
+      .Key("boardId")
+      .Int(work.board_id)
+      .Key("strokes")
+      .BeginArray();
+  for (const Stroke &stroke : work.strokes) {
+    WriteStrokeJson(writer, stroke, true);
+  }
+  writer.EndArray().EndObject();
+}
+
+nlohmann::json ErrorJson(std::uint64_t index, const std::string &source,
+                         const std::string &error) {
+  return {{"index", index}, {"source", source}, {"error", error}};
+}
+
+void LogSummary(const RequestPipeline &pipeline, std::uint64_t processed,
+                std::chrono::steady_clock::duration elapsed) {
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  spdlog::info("[RunBatch]: {} requests in {:.1f} s, {:.1f} requests/s.\n",
+               processed, seconds,
+               seconds > 0.0 ? static_cast<double>(processed) / seconds : 0.0);
+
+  for (const auto &stage : pipeline.GetStats()) {
+    spdlog::info("[RunBatch]: Pipeline stage {}: {} processed, {} dropped.\n",
+                 stage.name, stage.processed, stage.dropped);
+  }
+
+  for (std::size_t i = 0; i < static_cast<std::size_t>(Stage::Count); i++) {
+    const Stage stage = static_cast<Stage>(i);
+    const Metrics::Histogram histogram = Metrics::GetHistogram(stage);
+    if (histogram.count == 0) {
+      continue;
+    }
+    spdlog::info("[RunBatch]: {}: {} calls, mean {:.0f} us, p50 {:.0f} us, "
+                 "p99 {:.0f} us.\n",
+                 GetStageName(stage), histogram.count,
+                 static_cast<double>(histogram.sum_us) /
+                     static_cast<double>(histogram.count),
+                 histogram.Quantile(0.5), histogram.Quantile(0.99));
+  }
+}
+
+} // namespace
+
+bool RunBatch(const BatchOptions &options) {
+  std::filesystem::path checkpointPath = options.checkpoint;
+  if (checkpointPath.empty()) {
+    checkpointPath = options.output;
+    checkpointPath += ".checkpoint";
+  }
+
+  std::optional<Checkpoint> checkpoint = Checkpoint{};
+  std::error_code error;
+  if (options.overwrite) {
+    // A crash before the first checkpoint mustn't resume from the old one
+    std::filesystem::remove(checkpointPath, error);
+    if (error) {
+      spdlog::error("[RunBatch]: Could not remove {}: {}.\n",
+                    checkpointPath.string(), error.message());
+      return false;
+    }
+  } else {
+    // Results without a checkpoint aren't ours to resume, nor to truncate
+    if (std::filesystem::exists(options.output) &&
+        !std::filesystem::exists(checkpointPath)) {
+      spdlog::error("[RunBatch]: {} exists without a checkpoint, pass "
+                    "--overwrite to replace it.\n",
+                    options.output.string());
+      return false;
+    }
+    checkpoint = ReadCheckpoint(checkpointPath);
+    if (!checkpoint) {
+      return false;
+    }
+  }
+
+  // Drop results written after the checkpoint, they're produced again
+  if (std::filesystem::exists(options.output)) {
+    if (std::filesystem::file_size(options.output) <
+        checkpoint->output_bytes) {
+      spdlog::error("[RunBatch]: {} is shorter than its checkpoint.\n",
+                    options.output.string());
+      return false;
+    }
+    std::filesystem::resize_file(options.output, checkpoint->output_bytes,
+                                 error);
+  } else if (checkpoint->output_bytes > 0) {
+    spdlog::error("[RunBatch]: {} is missing, pass --overwrite to start "
+                  "over.\n",
+                  options.output.string());
+    return false;
+  }
+  if (error) {
+    spdlog::error("[RunBatch]: Could not truncate {}: {}.\n",
+                  options.output.string(), error.message());
+    return false;
+  }
+
+  std::ofstream output(options.output, std::ios::app | std::ios::binary);
+  if (!output) {
+    spdlog::error("[RunBatch]: Could not open the output {}.\n",
+                  options.output.string());
+    return false;
+  }
+
+  BatchInput input;
+  if (!input.Open(options.input)) {
+    return false;
+  }
+  input.Skip(checkpoint->completed);
+  if (checkpoint->completed > 0) {
+    spdlog::info("[RunBatch]: Resuming after {} requests.\n",
+                 checkpoint->completed);
+  }
+
+  ResultWriter writer(output, checkpointPath, *checkpoint,
+                      options.checkpoint_interval);
+
+  ArenaPool arenas{};
+  RequestPipeline pipeline{};
+  AddRequestStages(
+      pipeline, options.pipeline, arenas,
+      [&writer](RequestWork &work) {
+        thread_local JsonWriter result{};
+        result.Clear();
+        WriteResultJson(result, work);
+        writer.Write(work.request_id, std::string(result.View()));
+      },
+      [&writer](RequestWork &work, const std::string &stage) {
+        const std::string error =
+            work.error.empty() ? "Failed in stage " + stage : work.error;
+        writer.Write(work.request_id,
+                     ErrorJson(work.request_id, work.source, error).dump());
+      });
+  pipeline.Start();
+
+  g_Interrupted = false;
+  const auto previousHandler = std::signal(SIGINT, OnInterrupt);
+  const auto start = std::chrono::steady_clock::now();
+
+  std::uint64_t index = checkpoint->completed;
+  std::string source;
+  std::string text;
+  while (!g_Interrupted && input.Next(source, text)) {
+    nlohmann::json request = nlohmann::json::parse(text, nullptr, false);
+    if (request.is_discarded() ||
+        !(request.contains("board") || request.contains("strokes"))) {
+      writer.Write(index, ErrorJson(index, source, "Invalid request").dump());
+      index++;
+      continue;
+    }
+
+    std::unique_ptr<RequestWork> work = arenas.CreateWork();
+    work->request_id = index++;
+    work->board_id = GetRequestBoardId(request);
+    work->received = std::chrono::steady_clock::now();
+    work->source = std::move(source);
+    work->request = std::move(request);
+    // Waits while the pipeline is full
+    pipeline.Submit(std::move(work));
+  }
+
+  // Finish the requests already read
+  pipeline.Close();
+  pipeline.Wait();
+  std::signal(SIGINT, previousHandler);
+
+  const bool committed = writer.Commit();
+  LogSummary(pipeline, writer.GetCompleted() - checkpoint->completed,
+             std::chrono::steady_clock::now() - start);
+  if (g_Interrupted) {
+    spdlog::info("[RunBatch]: Interrupted after {} requests, run again to "
+                 "resume.\n",
+                 writer.GetCompleted());
+  }
+  return committed;
+}
+
+} // namespace mathboard
@@ -0,0 +1,43 @@
+#pragma once
+
+// local
+#include "request_pipeline.hpp"
+
+// std
+#include <cstddef>
+#include <filesystem>
+
+namespace mathboard {
+
+struct BatchOptions {
+  // Directory of request files or a JSONL file with a request per line, in
+  // the format described in daemon.hpp
+  std::filesystem::path input{};
+  // Results as JSONL, one line per request in input order
+  std::filesystem::path output{"results.jsonl"};
+  // Progress of the batch, an existing checkpoint is resumed from. Defaults
+  // to the output path with ".checkpoint" appended.
+  std::filesystem::path checkpoint{};
+  // Replace an existing output that has no checkpoint, and ignore the
+  // checkpoint when it has one. Without it such an output is never touched.
+  bool overwrite{false};
+  // Results written between two checkpoints
+  std::size_t checkpoint_interval{1000};
+  // Every stage runs on every core, nothing else competes for them
+  RequestPipelineOptions pipeline{{{"decode", 0},
+                                   {"preprocess", 0},
+                                   {"contour", 0},
+                                   {"simplify", 0},
+                                   {"finish", 0}},
+                                  64};
+};
+
+// Run every request of the input through the request pipeline and stream
+// the results into the output. SIGINT stops reading the input, the requests
+// in flight are finished and checkpointed, so rerunning the same command
+// continues where it stopped. Throughput and stage timings are logged at the
+// end. Return false when the input, output or checkpoint can't be used, or
+// when the output exists without a checkpoint and `overwrite` isn't set.
+bool RunBatch(const BatchOptions &options);
+
+} // namespace mathboard
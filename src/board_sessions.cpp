@@ -0,0 +1,325 @@
+// header
+#include "board_sessions.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <algorithm>
+#include <map>
+
+namespace mathboard {
+
+namespace {
+
+// Area covered by the grid of a board, strokes outside of it end up in the
+// border cells
+constexpr float kBoardExtent = 4096.0f;
+constexpr int kCellSize = 128;
+constexpr std::size_t kCellCount =
+    static_cast<std::size_t>(kBoardExtent / kCellSize) *
+    static_cast<std::size_t>(kBoardExtent / kCellSize);
+
+// Hash node and grid entries of a stroke, roughly
+constexpr std::size_t kStrokeOverhead = 64;
+
+std::size_t GetStrokeMemory(const Stroke &stroke) {
+  return stroke.GetMemoryUsage() + kStrokeOverhead;
+}
+
+// Strokes further apart than that are separate symbols
+constexpr int kSymbolMargin = 2;
+
+bool AreTouching(const cv::Rect &first, const cv::Rect &second) {
+  return first.x - kSymbolMargin < second.x + second.width &&
+         second.x - kSymbolMargin < first.x + first.width &&
+         first.y - kSymbolMargin < second.y + second.height &&
+         second.y - kSymbolMargin < first.y + first.height;
+}
+
+void AddNeighbors(const Grid<Stroke> &grid, const Stroke &stroke,
+                  std::vector<std::uint32_t> &ids) {
+  for (const Stroke *neighbor : grid.GetNeighbors(&stroke)) {
+    ids.push_back(neighbor->GetIndex());
+  }
+}
+
+} // namespace
+
+struct BoardSessions::Session {
+  Session()
+      : grid(cv::Point2f(0.0f, 0.0f), cv::Point2f(kBoardExtent, kBoardExtent),
+             cv::Size2i(kCellSize, kCellSize)) {}
+
+  // Node based, the grid keeps pointers to the strokes
+  std::unordered_map<std::uint32_t, Stroke> strokes{};
+  Grid<Stroke> grid;
+  std::size_t memory_usage{0};
+  // Next place to hand out and next one to apply
+  std::uint64_t begun{0};
+  std::uint64_t applied{0};
+  // Deltas completed before the ones begun earlier
+  std::map<std::uint64_t, std::pair<BoardDelta, BoardDeltaCallback>>
+      waiting{};
+  std::chrono::steady_clock::time_point last_used{};
+
+  // Memory of an empty session
+  static std::size_t GetOverhead();
+};
+
+std::size_t BoardSessions::Session::GetOverhead() {
+  return sizeof(Session) + kCellCount * sizeof(std::vector<Stroke *>);
+}
+
+BoardSessions::BoardSessions(BoardSessionOptions options)
+    : m_Options(options) {}
+
+BoardSessions::~BoardSessions() = default;
+
+std::uint64_t BoardSessions::Begin(std::int64_t board_id) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unique_ptr<Session> &session = m_Sessions[board_id];
+  if (!session) {
+    session = std::make_unique<Session>();
+    session->memory_usage = Session::GetOverhead();
+    m_MemoryUsage += session->memory_usage;
+  }
+  session->last_used = std::chrono::steady_clock::now();
+  return session->begun++;
+}
+
+void BoardSessions::Complete(std::int64_t board_id, std::uint64_t sequence,
+                             BoardDelta delta, BoardDeltaCallback on_applied) {
+  Applied applied;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    const auto it = m_Sessions.find(board_id);
+    if (it == m_Sessions.end()) {
+      // Sessions with deltas in flight are never evicted
+      spdlog::error("[BoardSessions::Complete]: No session for board {}.\n",
+                    board_id);
+      return;
+    }
+    Session &session = *it->second;
+    session.waiting.emplace(sequence, std::make_pair(std::move(delta),
+                                                     std::move(on_applied)));
+    ApplyReady(session, applied);
+
+    if (session.strokes.empty() && IsIdle(session)) {
+      // Closed, or nothing was ever added
+      Erase(it);
+    } else {
+      EvictOverLimit(&session);
+    }
+  }
+
+  for (auto &[callback, result] : applied) {
+    if (callback) {
+      callback(result);
+    }
+  }
+}
+
+BoardSymbol BoardSessions::GetSymbol(std::int64_t board_id,
+                                     std::uint32_t stroke_id) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  BoardSymbol symbol{};
+  const auto session = m_Sessions.find(board_id);
+  if (session == m_Sessions.end()) {
+    return symbol;
+  }
+  const Grid<Stroke> &grid = session->second->grid;
+  const auto &strokes = session->second->strokes;
+  const auto start = strokes.find(stroke_id);
+  if (start == strokes.end()) {
+    return symbol;
+  }
+
+  symbol.strokes.push_back(stroke_id);
+  symbol.bounding_box = start->second.GetBoardBoundingBox();
+  std::vector<const Stroke *> pending{&start->second};
+  while (!pending.empty()) {
+    const Stroke *stroke = pending.back();
+    pending.pop_back();
+    const cv::Rect rect = stroke->GetBoardBoundingBox();
+    for (const Stroke *neighbor : grid.GetNeighbors(stroke)) {
+      const cv::Rect neighborRect = neighbor->GetBoardBoundingBox();
+      if (!AreTouching(rect, neighborRect) ||
+          std::find(symbol.strokes.begin(), symbol.strokes.end(),
+                    neighbor->GetIndex()) != symbol.strokes.end()) {
+        continue;
+      }
+      symbol.strokes.push_back(neighbor->GetIndex());
+      symbol.bounding_box = symbol.bounding_box | neighborRect;
+      pending.push_back(neighbor);
+    }
+  }
+  std::sort(symbol.strokes.begin(), symbol.strokes.end());
+  return symbol;
+}
+
+std::size_t
+BoardSessions::EvictIdle(std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::size_t evicted = 0;
+  for (auto it = m_Sessions.begin(); it != m_Sessions.end();) {
+    if (IsIdle(*it->second) &&
+        now - it->second->last_used > m_Options.idle_timeout) {
+      it = Erase(it);
+      evicted++;
+    } else {
+      ++it;
+    }
+  }
+  m_Evictions += evicted;
+  return evicted;
+}
+
+std::size_t BoardSessions::Size() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Sessions.size();
+}
+
+std::size_t BoardSessions::GetMemoryUsage() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MemoryUsage;
+}
+
+std::uint64_t BoardSessions::GetEvictions() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Evictions;
+}
+
+void BoardSessions::ApplyReady(Session &session, Applied &applied) {
+  for (auto next = session.waiting.begin();
+       next != session.waiting.end() && next->first == session.applied;
+       next = session.waiting.begin()) {
+    auto [delta, callback] = std::move(next->second);
+    session.waiting.erase(next);
+    session.applied++;
+
+    const std::size_t memoryUsage = session.memory_usage;
+    BoardDeltaResult result = Apply(session, delta);
+    m_MemoryUsage = m_MemoryUsage - memoryUsage + session.memory_usage;
+    applied.emplace_back(std::move(callback), std::move(result));
+  }
+  session.last_used = std::chrono::steady_clock::now();
+}
+
+BoardDeltaResult BoardSessions::Apply(Session &session, BoardDelta &delta) {
+  BoardDeltaResult result{};
+  std::vector<std::uint32_t> &invalidated = result.invalidated;
+
+  switch (delta.type) {
+  case BoardDelta::Type::Add: {
+    std::size_t addedMemory = 0;
+    for (const Stroke &stroke : delta.strokes) {
+      addedMemory += GetStrokeMemory(stroke);
+    }
+    if (session.memory_usage + addedMemory > m_Options.max_memory) {
+      result.error = "Board over the session memory limit";
+      break;
+    }
+
+    std::vector<std::uint32_t> ids;
+    ids.reserve(delta.strokes.size());
+    for (Stroke &stroke : delta.strokes) {
+      ids.push_back(stroke.GetIndex());
+      const auto [it, inserted] = session.strokes.try_emplace(
+          stroke.GetIndex());
+      Stroke &stored = it->second;
+      if (!inserted) {
+        // Replaced, its old neighbors change too
+        AddNeighbors(session.grid, stored, invalidated);
+        session.grid.Remove(&stored);
+        session.memory_usage -= GetStrokeMemory(stored);
+      }
+      stored = std::move(stroke);
+      session.grid.Insert(&stored);
+      session.memory_usage += GetStrokeMemory(stored);
+    }
+    // Neighbors once all of them are in, so strokes added together see each
+    // other
+    for (const std::uint32_t id : ids) {
+      invalidated.push_back(id);
+      AddNeighbors(session.grid, session.strokes.at(id), invalidated);
+    }
+    result.applied = true;
+    break;
+  }
+  case BoardDelta::Type::Remove: {
+    const auto it = session.strokes.find(delta.stroke_id);
+    if (it == session.strokes.end()) {
+      result.error = "Unknown stroke " + std::to_string(delta.stroke_id);
+      break;
+    }
+    AddNeighbors(session.grid, it->second, invalidated);
+    session.grid.Remove(&it->second);
+    session.memory_usage -= GetStrokeMemory(it->second);
+    session.strokes.erase(it);
+    result.applied = true;
+    break;
+  }
+  case BoardDelta::Type::Move: {
+    const auto it = session.strokes.find(delta.stroke_id);
+    if (it == session.strokes.end()) {
+      result.error = "Unknown stroke " + std::to_string(delta.stroke_id);
+      break;
+    }
+    Stroke &stroke = it->second;
+    AddNeighbors(session.grid, stroke, invalidated);
+    session.grid.Remove(&stroke);
+    stroke.SetPosition(delta.position);
+    session.grid.Insert(&stroke);
+    invalidated.push_back(stroke.GetIndex());
+    AddNeighbors(session.grid, stroke, invalidated);
+    result.applied = true;
+    break;
+  }
+  case BoardDelta::Type::Close:
+    session.grid.Clear();
+    session.strokes.clear();
+    session.memory_usage = Session::GetOverhead();
+    result.applied = true;
+    break;
+  case BoardDelta::Type::Failed:
+    break;
+  }
+
+  std::sort(invalidated.begin(), invalidated.end());
+  invalidated.erase(std::unique(invalidated.begin(), invalidated.end()),
+                    invalidated.end());
+  result.stroke_count = session.strokes.size();
+  return result;
+}
+
+void BoardSessions::EvictOverLimit(const Session *keep) {
+  while (m_MemoryUsage > m_Options.max_memory) {
+    auto oldest = m_Sessions.end();
+    for (auto it = m_Sessions.begin(); it != m_Sessions.end(); ++it) {
+      if (it->second.get() != keep && IsIdle(*it->second) &&
+          (oldest == m_Sessions.end() ||
+           it->second->last_used < oldest->second->last_used)) {
+        oldest = it;
+      }
+    }
+    if (oldest == m_Sessions.end()) {
+      return;
+    }
+    Erase(oldest);
+    m_Evictions++;
+  }
+}
+
+bool BoardSessions::IsIdle(const Session &session) {
+  return session.applied == session.begun;
+}
+
+BoardSessions::SessionMap::iterator
+BoardSessions::Erase(SessionMap::iterator session) {
+  m_MemoryUsage -= session->second->memory_usage;
+  return m_Sessions.erase(session);
+}
+
+} // namespace mathboard
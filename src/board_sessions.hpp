@@ -0,0 +1,140 @@
+#pragma once
+
+// local
+#include "grid.hpp"
+#include "stroke.hpp"
+
+// libs
+// opencv
+#include <opencv2/core/types.hpp>
+
+// std
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+struct BoardSessionOptions {
+  // Memory of all the sessions together, the least recently used ones are
+  // evicted above it
+  std::size_t max_memory{256 * 1024 * 1024};
+  // Sessions left untouched that long are evicted
+  std::chrono::seconds idle_timeout{600};
+};
+
+// One change to the strokes of a board
+struct BoardDelta {
+  enum class Type {
+    // Add `strokes`, replacing the ones with the same id
+    Add,
+    // Remove the stroke `stroke_id`
+    Remove,
+    // Move the stroke `stroke_id` to `position`
+    Move,
+    // Drop the whole session
+    Close,
+    // The delta couldn't be processed, nothing changes
+    Failed
+  };
+
+  Type type{Type::Failed};
+  std::vector<Stroke> strokes{};
+  std::uint32_t stroke_id{0};
+  cv::Point2f position{};
+};
+
+struct BoardDeltaResult {
+  bool applied{false};
+  std::string error{};
+  // Strokes of the board once the delta is applied
+  std::size_t stroke_count{0};
+  // Strokes sharing a grid cell with a changed one, the changed ones
+  // included. Only their symbols can be different after the delta, the rest
+  // of the board is left as it was.
+  std::vector<std::uint32_t> invalidated{};
+};
+
+using BoardDeltaCallback = std::function<void(const BoardDeltaResult &)>;
+
+// Strokes likely forming one symbol
+struct BoardSymbol {
+  std::vector<std::uint32_t> strokes{};
+  // On the board, in pixels
+  cv::Rect bounding_box{};
+};
+
+// Strokes of the boards clients are editing, kept between messages so a
+// delta only costs the work of the strokes it touches. Every board has its
+// strokes by id and a Grid of them to find the neighbors of a changed
+// stroke.
+//
+// Deltas of a board are applied in the order they were begun, whatever order
+// the pipeline finishes them in: a stroke added and removed right after is
+// gone, not re-added by the slower add.
+class BoardSessions {
+public:
+  explicit BoardSessions(BoardSessionOptions options = {});
+  ~BoardSessions();
+
+  // Take the next place in the board's order, called by the thread reading
+  // the messages
+  std::uint64_t Begin(std::int64_t board_id);
+
+  // The delta in place `sequence` of the board is ready. It is applied after
+  // every delta begun before it, `on_applied` is called then, on the thread
+  // completing the last of them and without the lock held.
+  void Complete(std::int64_t board_id, std::uint64_t sequence,
+                BoardDelta delta, BoardDeltaCallback on_applied);
+
+  // The stroke and the strokes linked to it by overlapping bounding boxes,
+  // found through the grid: what a classifier would crop as one symbol.
+  // Empty when the stroke isn't on the board.
+  BoardSymbol GetSymbol(std::int64_t board_id, std::uint32_t stroke_id) const;
+
+  // Evict the sessions idle for longer than the timeout, returns how many
+  std::size_t EvictIdle(std::chrono::steady_clock::time_point now =
+                            std::chrono::steady_clock::now());
+
+  // Sessions, their memory and how many were evicted so far
+  std::size_t Size() const;
+  std::size_t GetMemoryUsage() const;
+  std::uint64_t GetEvictions() const;
+
+private:
+  struct Session;
+
+  using Applied = std::vector<std::pair<BoardDeltaCallback, BoardDeltaResult>>;
+
+  // Apply the deltas of the session that are next in order
+  void ApplyReady(Session &session, Applied &applied);
+  BoardDeltaResult Apply(Session &session, BoardDelta &delta);
+
+  // Evict the least recently used sessions until the memory fits, except
+  // `keep`
+  void EvictOverLimit(const Session *keep);
+
+  using SessionMap =
+      std::unordered_map<std::int64_t, std::unique_ptr<Session>>;
+
+  // Sessions with deltas in flight are never evicted
+  static bool IsIdle(const Session &session);
+  SessionMap::iterator Erase(SessionMap::iterator session);
+
+private:
+  const BoardSessionOptions m_Options;
+
+  mutable std::mutex m_Mutex;
+  SessionMap m_Sessions;
+  std::size_t m_MemoryUsage{0};
+  std::uint64_t m_Evictions{0};
+};
+
+} // namespace mathboard
@@ -0,0 +1,395 @@
+// header
+#include "compiled_expression.hpp"
+
+// local
+#include "equation_parser.hpp"
+
+// libs
+// opencv
+#include <opencv2/core/utility.hpp>
+// symengine
+#include <symengine/add.h>
+#include <symengine/constants.h>
+#include <symengine/eval_double.h>
+#include <symengine/functions.h>
+#include <symengine/mul.h>
+#include <symengine/pow.h>
+#include <symengine/rational.h>
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <algorithm>
+#include <cmath>
+
+namespace mathboard {
+
+namespace {
+
+// Integer powers up to this are computed by repeated multiplication
+constexpr std::int64_t kMaxIntegerPower = 64;
+
+// Points one parallel task evaluates
+constexpr std::size_t kParallelChunk = 16 * CompiledExpression::kBlockSize;
+
+template <typename Function>
+void Apply(double *values, std::size_t count, Function function) {
+  for (std::size_t i = 0; i < count; i++) {
+    values[i] = function(values[i]);
+  }
+}
+
+double PowInt(double base, std::int32_t exponent) {
+  double result = 1.0;
+  double factor = base;
+  for (std::uint32_t n = static_cast<std::uint32_t>(std::abs(exponent)); n > 0;
+       n >>= 1) {
+    if (n & 1) {
+      result *= factor;
+    }
+    factor *= factor;
+  }
+  return exponent < 0 ? 1.0 / result : result;
+}
+
+} // namespace
+
+CompiledExpression::CompiledExpression(
+    const SymEngine::RCP<const SymEngine::Basic> &expr,
+    const std::vector<SymEngine::RCP<const SymEngine::Symbol>> &symbols)
+    : m_SymbolCount(symbols.size()), m_Symbols(symbols) {
+  if (Compile(*expr, 0)) {
+    return;
+  }
+
+  SPDLOG_DEBUG("[CompiledExpression]: {} isn't supported by the bytecode, "
+               "using LambdaRealDoubleVisitor.\n",
+               expr->__str__());
+  m_Code.clear();
+  m_Constants.clear();
+
+  SymEngine::vec_basic inputs(symbols.begin(), symbols.end());
+  m_Fallback = std::make_shared<SymEngine::LambdaRealDoubleVisitor>();
+  m_Fallback->init(inputs, *expr);
+}
+
+CompiledExpression
+CompiledExpression::FromEquation(const std::string &equation,
+                                 const std::vector<std::string> &symbols) {
+  std::vector<SymEngine::RCP<const SymEngine::Symbol>> syms;
+  syms.reserve(symbols.size());
+  for (const auto &symbol : symbols) {
+    syms.push_back(SymEngine::symbol(symbol));
+  }
+  return CompiledExpression(ParseEquation(equation), syms);
+}
+
+bool CompiledExpression::Compile(const SymEngine::Basic &expr,
+                                 std::size_t depth) {
+  m_StackDepth = std::max(m_StackDepth, depth + 1);
+
+  if (SymEngine::is_a<SymEngine::Symbol>(expr)) {
+    for (std::size_t i = 0; i < m_Symbols.size(); i++) {
+      if (SymEngine::eq(expr, *m_Symbols[i])) {
+        Emit(OpCode::Variable, static_cast<std::int32_t>(i));
+        return true;
+      }
+    }
+    // Free symbol which isn't an input
+    return false;
+  }
+
+  if (SymEngine::is_a_Number(expr) ||
+      SymEngine::is_a<SymEngine::Constant>(expr)) {
+    try {
+      m_Constants.push_back(SymEngine::eval_double(expr));
+    } catch (const std::exception &) {
+      // Complex constant
+      return false;
+    }
+    Emit(OpCode::Constant, static_cast<std::int32_t>(m_Constants.size() - 1));
+    return true;
+  }
+
+  // N-ary sums and products become chains of binary operations
+  if (SymEngine::is_a<SymEngine::Add>(expr) ||
+      SymEngine::is_a<SymEngine::Mul>(expr)) {
+    const OpCode op =
+        SymEngine::is_a<SymEngine::Add>(expr) ? OpCode::Add : OpCode::Mul;
+    const SymEngine::vec_basic args = expr.get_args();
+    for (std::size_t i = 0; i < args.size(); i++) {
+      if (!Compile(*args[i], depth + (i == 0 ? 0 : 1))) {
+        return false;
+      }
+      if (i > 0) {
+        Emit(op);
+      }
+    }
+    return true;
+  }
+
+  if (SymEngine::is_a<SymEngine::Pow>(expr)) {
+    const auto &pow = SymEngine::down_cast<const SymEngine::Pow &>(expr);
+    const SymEngine::Basic &base = *pow.get_base();
+    const SymEngine::Basic &exponent = *pow.get_exp();
+
+    // exp(x) is E**x
+    if (SymEngine::eq(base, *SymEngine::E)) {
+      if (!Compile(exponent, depth)) {
+        return false;
+      }
+      Emit(OpCode::Exp);
+      return true;
+    }
+
+    if (SymEngine::is_a<SymEngine::Integer>(exponent)) {
+      const auto &integer =
+          SymEngine::down_cast<const SymEngine::Integer &>(exponent);
+      if (integer.is_zero() ||
+          !SymEngine::mp_fits_slong_p(integer.as_integer_class()) ||
+          std::abs(integer.as_int()) > kMaxIntegerPower) {
+        // Rare, let the generic power handle it
+      } else if (integer.as_int() == -1) {
+        // Division is Mul with a power of -1
+        m_Constants.push_back(1.0);
+        Emit(OpCode::Constant,
+             static_cast<std::int32_t>(m_Constants.size() - 1));
+        if (!Compile(base, depth + 1)) {
+          return false;
+        }
+        Emit(OpCode::Div);
+        return true;
+      } else {
+        if (!Compile(base, depth)) {
+          return false;
+        }
+        Emit(OpCode::PowInt, static_cast<std::int32_t>(integer.as_int()));
+        return true;
+      }
+    }
+
+    // sqrt(x) is x**(1/2)
+    if (SymEngine::eq(exponent, *SymEngine::rational(1, 2))) {
+      if (!Compile(base, depth)) {
+        return false;
+      }
+      Emit(OpCode::Sqrt);
+      return true;
+    }
+
+    if (!Compile(base, depth) || !Compile(exponent, depth + 1)) {
+      return false;
+    }
+    Emit(OpCode::Pow);
+    return true;
+  }
+
+  // Functions of a single argument
+  OpCode op;
+  if (SymEngine::is_a<SymEngine::Sin>(expr)) {
+    op = OpCode::Sin;
+  } else if (SymEngine::is_a<SymEngine::Cos>(expr)) {
+    op = OpCode::Cos;
+  } else if (SymEngine::is_a<SymEngine::Tan>(expr)) {
+    op = OpCode::Tan;
+  } else if (SymEngine::is_a<SymEngine::ASin>(expr)) {
+    op = OpCode::Asin;
+  } else if (SymEngine::is_a<SymEngine::ACos>(expr)) {
+    op = OpCode::Acos;
+  } else if (SymEngine::is_a<SymEngine::ATan>(expr)) {
+    op = OpCode::Atan;
+  } else if (SymEngine::is_a<SymEngine::Sinh>(expr)) {
+    op = OpCode::Sinh;
+  } else if (SymEngine::is_a<SymEngine::Cosh>(expr)) {
+    op = OpCode::Cosh;
+  } else if (SymEngine::is_a<SymEngine::Tanh>(expr)) {
+    op = OpCode::Tanh;
+  } else if (SymEngine::is_a<SymEngine::Log>(expr)) {
+    op = OpCode::Log;
+  } else if (SymEngine::is_a<SymEngine::Abs>(expr)) {
+    op = OpCode::Abs;
+  } else {
+    return false;
+  }
+
+  const SymEngine::vec_basic args = expr.get_args();
+  if (args.size() != 1 || !Compile(*args[0], depth)) {
+    return false;
+  }
+  Emit(op);
+  return true;
+}
+
+void CompiledExpression::RunBlock(std::span<const double *const> inputs,
+                                  std::size_t offset, std::size_t count,
+                                  double *output, double *stack) const {
+  // Registers of kBlockSize values, `depth` of them are in use and the last
+  // one is the top of the stack
+  std::size_t depth = 0;
+  const auto push = [stack, &depth]() { return stack + kBlockSize * depth++; };
+  const auto top = [stack, &depth]() {
+    return stack + kBlockSize * (depth - 1);
+  };
+  // Apply `function` to the two topmost registers, the result replaces them
+  const auto binary = [&](auto function) {
+    depth--;
+    const double *right = stack + kBlockSize * depth;
+    double *left = top();
+    for (std::size_t i = 0; i < count; i++) {
+      left[i] = function(left[i], right[i]);
+    }
+  };
+
+  for (const Instruction &instruction : m_Code) {
+    switch (instruction.op) {
+    case OpCode::Constant:
+      std::fill_n(push(), count, m_Constants[instruction.arg]);
+      break;
+    case OpCode::Variable:
+      std::copy_n(inputs[instruction.arg] + offset, count, push());
+      break;
+    case OpCode::Add:
+      binary([](double x, double y) { return x + y; });
+      break;
+    case OpCode::Mul:
+      binary([](double x, double y) { return x * y; });
+      break;
+    case OpCode::Div:
+      binary([](double x, double y) { return x / y; });
+      break;
+    case OpCode::Pow:
+      binary([](double x, double y) { return std::pow(x, y); });
+      break;
+    case OpCode::PowInt: {
+      const std::int32_t exponent = instruction.arg;
+      if (exponent == 2) {
+        Apply(top(), count, [](double x) { return x * x; });
+      } else {
+        Apply(top(), count,
+              [exponent](double x) { return PowInt(x, exponent); });
+      }
+      break;
+    }
+    case OpCode::Sin:
+      Apply(top(), count, [](double x) { return std::sin(x); });
+      break;
+    case OpCode::Cos:
+      Apply(top(), count, [](double x) { return std::cos(x); });
+      break;
+    case OpCode::Tan:
+      Apply(top(), count, [](double x) { return std::tan(x); });
+      break;
+    case OpCode::Asin:
+      Apply(top(), count, [](double x) { return std::asin(x); });
+      break;
+    case OpCode::Acos:
+      Apply(top(), count, [](double x) { return std::acos(x); });
+      break;
+    case OpCode::Atan:
+      Apply(top(), count, [](double x) { return std::atan(x); });
+      break;
+    case OpCode::Sinh:
+      Apply(top(), count, [](double x) { return std::sinh(x); });
+      break;
+    case OpCode::Cosh:
+      Apply(top(), count, [](double x) { return std::cosh(x); });
+      break;
+    case OpCode::Tanh:
+      Apply(top(), count, [](double x) { return std::tanh(x); });
+      break;
+    case OpCode::Exp:
+      Apply(top(), count, [](double x) { return std::exp(x); });
+      break;
+    case OpCode::Log:
+      Apply(top(), count, [](double x) { return std::log(x); });
+      break;
+    case OpCode::Sqrt:
+      Apply(top(), count, [](double x) { return std::sqrt(x); });
+      break;
+    case OpCode::Abs:
+      Apply(top(), count, [](double x) { return std::abs(x); });
+      break;
+    }
+  }
+
+  std::copy_n(top(), count, output);
+}
+
+double CompiledExpression::EvaluatePoint(std::span<const double> point) const {
+  double output = 0.0;
+
+  if (m_Fallback) {
+    m_Fallback->call(&output, point.data());
+    return output;
+  }
+
+  // One pointer per symbol, each to an array of a single point
+  std::vector<const double *> inputs(m_SymbolCount);
+  for (std::size_t i = 0; i < m_SymbolCount; i++) {
+    inputs[i] = &point[i];
+  }
+
+  thread_local std::vector<double> stack;
+  stack.resize(m_StackDepth * kBlockSize);
+  RunBlock(inputs, 0, 1, &output, stack.data());
+  return output;
+}
+
+void CompiledExpression::EvaluateBatch(std::span<const double *const> inputs,
+                                       std::span<double> outputs) const {
+  if (m_Fallback) {
+    std::vector<double> point(m_SymbolCount);
+    for (std::size_t i = 0; i < outputs.size(); i++) {
+      for (std::size_t s = 0; s < m_SymbolCount; s++) {
+        point[s] = inputs[s][i];
+      }
+      m_Fallback->call(&outputs[i], point.data());
+    }
+    return;
+  }
+
+  thread_local std::vector<double> stack;
+  stack.resize(m_StackDepth * kBlockSize);
+
+  for (std::size_t offset = 0; offset < outputs.size(); offset += kBlockSize) {
+    const std::size_t count = std::min(kBlockSize, outputs.size() - offset);
+    RunBlock(inputs, offset, count, outputs.data() + offset, stack.data());
+  }
+}
+
+std::vector<double>
+CompiledExpression::Evaluate(std::span<const double> xs) const {
+  std::vector<double> outputs(xs.size());
+  if (m_SymbolCount != 1) {
+    spdlog::error("[CompiledExpression::Evaluate]: Expression has {} symbols "
+                  "instead of 1.\n",
+                  m_SymbolCount);
+    return outputs;
+  }
+
+  const int chunks =
+      static_cast<int>((xs.size() + kParallelChunk - 1) / kParallelChunk);
+  cv::parallel_for_(cv::Range(0, chunks), [&](const cv::Range &range) {
+    for (int chunk = range.start; chunk < range.end; chunk++) {
+      const std::size_t begin = chunk * kParallelChunk;
+      const std::size_t end = std::min(begin + kParallelChunk, xs.size());
+      const double *input = xs.data() + begin;
+      EvaluateBatch(std::span<const double *const>(&input, 1),
+                    std::span<double>(outputs).subspan(begin, end - begin));
+    }
+  });
+
+  return outputs;
+}
+
+std::vector<double> CompiledExpression::Tabulate(double from, double to,
+                                                 std::size_t count) const {
+  std::vector<double> xs(count);
+  const double step = count > 1 ? (to - from) / (count - 1) : 0.0;
+  for (std::size_t i = 0; i < count; i++) {
+    xs[i] = from + step * i;
+  }
+  return Evaluate(xs);
+}
+
+} // namespace mathboard
@@ -0,0 +1,113 @@
+#pragma once
+
+// libs
+// symengine
+#include <symengine/basic.h>
+#include <symengine/lambda_double.h>
+#include <symengine/symbol.h>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace mathboard {
+
+// Real valued expression compiled once into bytecode of a small stack
+// machine. The machine runs every instruction over a whole block of inputs,
+// so the inner loops are plain array arithmetic the compiler vectorizes.
+// Large inputs are split into blocks evaluated in parallel. Expressions with
+// nodes the bytecode doesn't support are evaluated point by point with
+// SymEngine's LambdaRealDoubleVisitor instead. Compiling uses SymEngine, see
+// LockSymEngine, evaluating the bytecode doesn't.
+class CompiledExpression {
+public:
+  // Points evaluated by one pass of the machine
+  static constexpr std::size_t kBlockSize = 256;
+
+  // Compile `expr`, `symbols` are its inputs in order
+  CompiledExpression(
+      const SymEngine::RCP<const SymEngine::Basic> &expr,
+      const std::vector<SymEngine::RCP<const SymEngine::Symbol>> &symbols);
+
+  // Parse and compile sanitized equation, see EquationSolver::SanitizeEquation
+  static CompiledExpression
+  FromEquation(const std::string &equation,
+               const std::vector<std::string> &symbols);
+
+  // Evaluate at a single point, one value per symbol
+  double EvaluatePoint(std::span<const double> point) const;
+
+  // Evaluate `outputs.size()` points on the calling thread. `inputs` holds
+  // one array per symbol, each at least as long as `outputs`.
+  void EvaluateBatch(std::span<const double *const> inputs,
+                     std::span<double> outputs) const;
+
+  // Evaluate an expression of a single symbol at every x, in parallel
+  std::vector<double> Evaluate(std::span<const double> xs) const;
+
+  // Sample an expression of a single symbol at `count` evenly spaced points
+  // of [from, to]
+  std::vector<double> Tabulate(double from, double to,
+                               std::size_t count) const;
+
+  std::size_t GetSymbolCount() const { return m_SymbolCount; }
+
+  // Whether the expression runs on the bytecode machine
+  bool IsCompiled() const { return m_Fallback == nullptr; }
+
+private:
+  enum class OpCode : std::uint8_t {
+    Constant, // push m_Constants[arg]
+    Variable, // push input arg
+    Add,
+    Mul,
+    Div,
+    Pow,
+    PowInt, // raise to integer power arg
+    Sin,
+    Cos,
+    Tan,
+    Asin,
+    Acos,
+    Atan,
+    Sinh,
+    Cosh,
+    Tanh,
+    Exp,
+    Log,
+    Sqrt,
+    Abs
+  };
+
+  struct Instruction {
+    OpCode op;
+    std::int32_t arg{0};
+  };
+
+  // Append code of `expr`, return false for unsupported nodes
+  bool Compile(const SymEngine::Basic &expr, std::size_t depth);
+
+  void Emit(OpCode op, std::int32_t arg = 0) {
+    m_Code.push_back(Instruction{op, arg});
+  }
+
+  // Run the bytecode on `count` <= kBlockSize points starting at `offset`
+  void RunBlock(std::span<const double *const> inputs, std::size_t offset,
+                std::size_t count, double *output, double *stack) const;
+
+private:
+  std::size_t m_SymbolCount{0};
+  std::vector<Instruction> m_Code{};
+  std::vector<double> m_Constants{};
+  std::vector<SymEngine::RCP<const SymEngine::Symbol>> m_Symbols{};
+  // Deepest stack the bytecode needs
+  std::size_t m_StackDepth{0};
+  // Used when the bytecode couldn't be generated
+  std::shared_ptr<SymEngine::LambdaRealDoubleVisitor> m_Fallback{nullptr};
+};
+
+} // namespace mathboard
@@ -0,0 +1,222 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace mathboard {
+
+// Bounded lock-free multi-producer multi-consumer queue (Vyukov's algorithm).
+// Capacity is rounded up to a power of two. Try* never block, Push and Pop
+// spin/yield for a while and then sleep until another thread pushed, popped
+// or closed the queue, which is how backpressure propagates to the producers.
+// After Close() no more items are accepted and Pop returns false once the
+// queue is drained.
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(std::size_t capacity)
+      : m_Capacity(std::bit_ceil(std::max<std::size_t>(capacity, 2))),
+        m_Mask(m_Capacity - 1), m_Cells(std::make_unique<Cell[]>(m_Capacity)) {
+    for (std::size_t i = 0; i < m_Capacity; i++) {
+      m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  // Return false if the queue is full or closed
+  bool TryPush(T &&value) {
+    // Counted before the closed check, so Pop waits for a push which got past
+    // it before Close()
+    m_Pushing.fetch_add(1, std::memory_order_seq_cst);
+    const bool closed = m_Closed.load(std::memory_order_seq_cst);
+    const bool pushed = !closed && Enqueue(std::move(value));
+    m_Pushing.fetch_sub(1, std::memory_order_release);
+    // After Close() a Pop can be waiting for the pushes in progress
+    if (pushed || closed) {
+      WakeWaiters();
+    }
+    return pushed;
+  }
+
+  // Return false if the queue is empty
+  bool TryPop(T &value) {
+    Cell *cell;
+    std::size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &m_Cells[pos & m_Mask];
+      const std::size_t sequence =
+          cell->sequence.load(std::memory_order_acquire);
+      const std::intptr_t diff = static_cast<std::intptr_t>(sequence) -
+                                 static_cast<std::intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (m_DequeuePos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // Empty
+        return false;
+      } else {
+        pos = m_DequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    value = std::move(cell->value);
+    cell->sequence.store(pos + m_Mask + 1, std::memory_order_release);
+    WakeWaiters();
+    return true;
+  }
+
+  // Wait until there's space for the value. Return false if the queue got
+  // closed in the meantime.
+  bool Push(T value) {
+    for (std::uint32_t attempt = 0;; attempt++) {
+      const bool sleeping = attempt >= kSpinAttempts;
+      const std::uint32_t epoch = sleeping ? BeginWait() : 0;
+      const bool pushed = TryPush(std::move(value));
+      if (pushed || m_Closed.load(std::memory_order_relaxed)) {
+        if (sleeping) {
+          EndWait();
+        }
+        return pushed;
+      }
+      Backoff(attempt, epoch);
+    }
+  }
+
+  // Wait until there's a value. Return false if the queue is closed and
+  // empty.
+  bool Pop(T &value) {
+    for (std::uint32_t attempt = 0;; attempt++) {
+      const bool sleeping = attempt >= kSpinAttempts;
+      const std::uint32_t epoch = sleeping ? BeginWait() : 0;
+      bool popped = TryPop(value);
+      // Items pushed before Close() still have to be delivered, including the
+      // ones claimed but not published yet
+      const bool drained = !popped &&
+                           m_Closed.load(std::memory_order_seq_cst) &&
+                           m_Pushing.load(std::memory_order_seq_cst) == 0;
+      if (drained) {
+        popped = TryPop(value);
+      }
+      if (popped || drained) {
+        if (sleeping) {
+          EndWait();
+        }
+        return popped;
+      }
+      Backoff(attempt, epoch);
+    }
+  }
+
+  // Stop accepting new items, wakes up everyone waiting in Push/Pop
+  void Close() {
+    m_Closed.store(true, std::memory_order_seq_cst);
+    WakeWaiters();
+  }
+
+  bool IsClosed() const { return m_Closed.load(std::memory_order_acquire); }
+
+  // Number of items in the queue, only approximate while it's being used
+  std::size_t SizeApprox() const {
+    const std::size_t enqueued = m_EnqueuePos.load(std::memory_order_relaxed);
+    const std::size_t dequeued = m_DequeuePos.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+
+  std::size_t Capacity() const { return m_Capacity; }
+
+private:
+  // Push/Pop attempts spinning and yielding before they sleep
+  static constexpr std::uint32_t kSpinAttempts = 128;
+
+  struct Cell {
+    std::atomic<std::size_t> sequence{0};
+    T value{};
+  };
+
+  // Claim a cell and publish the value in it, false when full
+  bool Enqueue(T &&value) {
+    Cell *cell;
+    std::size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &m_Cells[pos & m_Mask];
+      const std::size_t sequence =
+          cell->sequence.load(std::memory_order_acquire);
+      const std::intptr_t diff = static_cast<std::intptr_t>(sequence) -
+                                 static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // Full
+        return false;
+      } else {
+        pos = m_EnqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Register as waiting before the attempt BeginWait() returns the epoch
+  // of, a change after it either is seen by the attempt or bumps the epoch
+  std::uint32_t BeginWait() {
+    m_Waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return m_Epoch.load(std::memory_order_acquire);
+  }
+
+  void EndWait() { m_Waiters.fetch_sub(1, std::memory_order_relaxed); }
+
+  // After a push, pop or Close(). Only costs a fence and a load while
+  // nobody sleeps.
+  void WakeWaiters() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_Waiters.load(std::memory_order_relaxed) != 0) {
+      m_Epoch.fetch_add(1, std::memory_order_release);
+      m_Epoch.notify_all();
+    }
+  }
+
+  // Spin first, then give the core away, then sleep until something changed
+  // since `epoch`
+  void Backoff(std::uint32_t attempt, std::uint32_t epoch) {
+    if (attempt < 64) {
+      return;
+    }
+    if (attempt < kSpinAttempts) {
+      std::this_thread::yield();
+      return;
+    }
+    m_Epoch.wait(epoch, std::memory_order_acquire);
+    EndWait();
+  }
+
+private:
+  const std::size_t m_Capacity;
+  const std::size_t m_Mask;
+  std::unique_ptr<Cell[]> m_Cells;
+  // Producers and consumers on separate cache lines
+  alignas(64) std::atomic<std::size_t> m_EnqueuePos{0};
+  alignas(64) std::atomic<std::size_t> m_DequeuePos{0};
+  alignas(64) std::atomic<bool> m_Closed{false};
+  // TryPush calls in progress
+  alignas(64) std::atomic<std::uint32_t> m_Pushing{0};
+  // Threads sleeping in Push/Pop, and what they sleep on
+  alignas(64) std::atomic<std::uint32_t> m_Waiters{0};
+  std::atomic<std::uint32_t> m_Epoch{0};
+};
+
+} // namespace mathboard
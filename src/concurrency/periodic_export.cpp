@@ -0,0 +1,82 @@
+// header
+#include "periodic_export.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+namespace mathboard {
+
+bool WriteFileAtomically(const std::filesystem::path &path,
+                         const FileWriter &write) {
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+
+  {
+    std::ofstream output(temporary, std::ios::trunc);
+    if (!output) {
+      spdlog::error("[WriteFileAtomically]: Could not open {}.\n",
+                    temporary.string());
+      return false;
+    }
+    write(output);
+    if (!output) {
+      spdlog::error("[WriteFileAtomically]: Could not write {}.\n",
+                    temporary.string());
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    spdlog::error("[WriteFileAtomically]: Could not replace {}: {}.\n",
+                  path.string(), error.message());
+    return false;
+  }
+  return true;
+}
+
+PeriodicExport::~PeriodicExport() { Stop(); }
+
+void PeriodicExport::Start(const std::filesystem::path &path,
+                           std::chrono::milliseconds interval,
+                           FileWriter write) {
+  Stop();
+
+  std::lock_guard<std::mutex> lockExport(m_Mutex);
+  m_Stopping = false;
+  m_Thread = std::thread([this, path, interval, write = std::move(write)]() {
+    std::unique_lock<std::mutex> lockStop(m_Mutex);
+    do {
+      lockStop.unlock();
+      WriteFileAtomically(path, write);
+      lockStop.lock();
+    } while (!m_Stop.wait_for(lockStop, interval,
+                              [this]() { return m_Stopping; }));
+    // Last state before stopping
+    lockStop.unlock();
+    WriteFileAtomically(path, write);
+  });
+}
+
+void PeriodicExport::Stop() {
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> lockExport(m_Mutex);
+    m_Stopping = true;
+    thread = std::move(m_Thread);
+  }
+  m_Stop.notify_all();
+
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+} // namespace mathboard
@@ -0,0 +1,47 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace mathboard {
+
+using FileWriter = std::function<void(std::ostream &)>;
+
+// Write `path` through a temporary file renamed over it, readers never see a
+// partially written file. Return false and log when it can't be written.
+bool WriteFileAtomically(const std::filesystem::path &path,
+                         const FileWriter &write);
+
+// Background thread rewriting a file every interval, e.g. the Prometheus
+// textfile or the continuous trace dump
+class PeriodicExport {
+public:
+  PeriodicExport() = default;
+
+  // Stops the export, the file is written one last time
+  ~PeriodicExport();
+
+  PeriodicExport(const PeriodicExport &) = delete;
+  PeriodicExport &operator=(const PeriodicExport &) = delete;
+
+  // Write `path` right away, then every `interval` and once more when
+  // stopped. Restarts the export when already running.
+  void Start(const std::filesystem::path &path,
+             std::chrono::milliseconds interval, FileWriter write);
+
+  void Stop();
+
+private:
+  std::mutex m_Mutex{};
+  std::condition_variable m_Stop{};
+  bool m_Stopping = false;
+  std::thread m_Thread{};
+};
+
+} // namespace mathboard
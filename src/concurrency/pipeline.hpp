@@ -0,0 +1,230 @@
+#pragma once
+
+// local
+#include "bounded_queue.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+// Work items flowing through a chain of stages. Every stage has its own
+// worker threads and reads batches of items from a bounded queue written by
+// the previous stage. A full queue stalls the stage feeding it, all the way
+// back to Submit(), so the slowest stage sets the throughput and the number
+// of items in flight stays bounded.
+template <typename T> class Pipeline {
+public:
+  // Processes one item, returning false drops it from the pipeline
+  using StageFunction = std::function<bool(T &)>;
+
+  // Receives the items a stage dropped, or threw on, with the stage's name
+  using DropHandler = std::function<void(T &, const std::string &)>;
+
+  struct StageOptions {
+    // Worker threads of the stage, 0 means one per core
+    std::size_t concurrency{1};
+    // Batches waiting for the stage
+    std::size_t queue_size{16};
+    // A worker merges batches already queued up to this many items, so a
+    // backlog is drained with fewer queue operations. Larger batches are
+    // split.
+    std::size_t max_batch{8};
+  };
+
+  // Occupancy of a stage, only approximate while the pipeline runs
+  struct StageStats {
+    std::string name{};
+    std::size_t concurrency{0};
+    // Batches waiting in the input queue
+    std::size_t queued{0};
+    // Workers currently processing a batch
+    std::size_t busy{0};
+    std::uint64_t processed{0};
+    std::uint64_t dropped{0};
+  };
+
+  Pipeline() = default;
+
+  // Finishes the submitted items, then joins the workers
+  ~Pipeline() {
+    Close();
+    Wait();
+  }
+
+  Pipeline(const Pipeline &) = delete;
+  Pipeline &operator=(const Pipeline &) = delete;
+
+  // Append a stage, only before Start()
+  void AddStage(std::string name, StageFunction function,
+                const StageOptions &options = {}) {
+    std::size_t concurrency = options.concurrency;
+    if (concurrency == 0) {
+      concurrency = std::max(1U, std::thread::hardware_concurrency());
+    }
+    m_Stages.push_back(std::make_unique<StageState>(
+        std::move(name), std::move(function), concurrency,
+        std::max<std::size_t>(options.queue_size, 1),
+        std::max<std::size_t>(options.max_batch, 1)));
+  }
+
+  // Only before Start()
+  void SetDropHandler(DropHandler handler) {
+    m_DropHandler = std::move(handler);
+  }
+
+  void Start() {
+    for (std::size_t i = 0; i < m_Stages.size(); i++) {
+      StageState &stage = *m_Stages[i];
+      stage.running.store(stage.concurrency, std::memory_order_relaxed);
+      for (std::size_t worker = 0; worker < stage.concurrency; worker++) {
+        m_Workers.emplace_back(&Pipeline::WorkerLoop, this, i);
+      }
+    }
+  }
+
+  // Queue an item for the first stage, waits while its queue is full.
+  // Return false once the pipeline is closed.
+  bool Submit(T item) {
+    std::vector<T> batch;
+    batch.push_back(std::move(item));
+    return SubmitBatch(std::move(batch));
+  }
+
+  bool SubmitBatch(std::vector<T> batch) {
+    if (m_Stages.empty()) {
+      return false;
+    }
+    return m_Stages.front()->input.Push(std::move(batch));
+  }
+
+  // Stop accepting items, the stages still finish everything submitted
+  void Close() {
+    if (!m_Stages.empty()) {
+      m_Stages.front()->input.Close();
+    }
+  }
+
+  void Wait() {
+    for (auto &thread : m_Workers) {
+      if (thread.joinable()) {
+        thread.join();
+      }
+    }
+  }
+
+  std::vector<StageStats> GetStats() const {
+    std::vector<StageStats> stats;
+    stats.reserve(m_Stages.size());
+    for (const auto &stage : m_Stages) {
+      stats.push_back(StageStats{
+          stage->name, stage->concurrency, stage->input.SizeApprox(),
+          stage->busy.load(std::memory_order_relaxed),
+          stage->processed.load(std::memory_order_relaxed),
+          stage->dropped.load(std::memory_order_relaxed)});
+    }
+    return stats;
+  }
+
+private:
+  struct StageState {
+    StageState(std::string stage_name, StageFunction stage_function,
+               std::size_t stage_concurrency, std::size_t queue_size,
+               std::size_t stage_max_batch)
+        : name(std::move(stage_name)), function(std::move(stage_function)),
+          concurrency(stage_concurrency), max_batch(stage_max_batch),
+          input(queue_size) {}
+
+    const std::string name;
+    const StageFunction function;
+    const std::size_t concurrency;
+    const std::size_t max_batch;
+    BoundedQueue<std::vector<T>> input;
+    // Workers that didn't exit yet, the last one closes the next queue
+    std::atomic<std::size_t> running{0};
+    std::atomic<std::size_t> busy{0};
+    std::atomic<std::uint64_t> processed{0};
+    std::atomic<std::uint64_t> dropped{0};
+  };
+
+  void WorkerLoop(std::size_t index) {
+    StageState &stage = *m_Stages[index];
+    StageState *next =
+        index + 1 < m_Stages.size() ? m_Stages[index + 1].get() : nullptr;
+
+    std::vector<T> batch;
+    // Items popped but not processed yet, what didn't fit into the last
+    // batch is the start of the next one
+    std::vector<T> queued;
+    while (!queued.empty() || stage.input.Pop(queued)) {
+      do {
+        MoveItems(queued, batch, stage.max_batch);
+      } while (batch.size() < stage.max_batch && stage.input.TryPop(queued));
+
+      stage.busy.fetch_add(1, std::memory_order_relaxed);
+      const std::size_t size = batch.size();
+      std::erase_if(batch, [this, &stage](T &item) {
+        if (Process(stage, item)) {
+          return false;
+        }
+        if (m_DropHandler) {
+          m_DropHandler(item, stage.name);
+        }
+        return true;
+      });
+      stage.busy.fetch_sub(1, std::memory_order_relaxed);
+      stage.processed.fetch_add(size, std::memory_order_relaxed);
+      stage.dropped.fetch_add(size - batch.size(), std::memory_order_relaxed);
+
+      if (next && !batch.empty()) {
+        next->input.Push(std::move(batch));
+      }
+      batch.clear();
+    }
+
+    // Everything before this stage is drained, let the next one finish
+    if (stage.running.fetch_sub(1, std::memory_order_acq_rel) == 1 && next) {
+      next->input.Close();
+    }
+  }
+
+  // Move items from the front of `from` until `to` holds `max_batch` items
+  static void MoveItems(std::vector<T> &from, std::vector<T> &to,
+                        std::size_t max_batch) {
+    const auto count = static_cast<std::ptrdiff_t>(
+        std::min(max_batch - to.size(), from.size()));
+    std::move(from.begin(), from.begin() + count, std::back_inserter(to));
+    from.erase(from.begin(), from.begin() + count);
+  }
+
+  static bool Process(StageState &stage, T &item) {
+    try {
+      return stage.function(item);
+    } catch (const std::exception &e) {
+      spdlog::error("[Pipeline::{}]: {}\n", stage.name, e.what());
+      return false;
+    }
+  }
+
+private:
+  std::vector<std::unique_ptr<StageState>> m_Stages{};
+  std::vector<std::thread> m_Workers{};
+  DropHandler m_DropHandler{};
+};
+
+} // namespace mathboard
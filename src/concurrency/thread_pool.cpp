@@ -0,0 +1,93 @@
+// header
+#include "thread_pool.hpp"
+
+// local
+#include "../tracing/tracer.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <algorithm>
+#include <exception>
+
+namespace mathboard {
+
+ThreadPool::ThreadPool(std::size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  m_Threads.reserve(thread_count);
+  for (std::size_t i = 0; i < thread_count; i++) {
+    m_Threads.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lockTasks(m_MutexTasks);
+    m_Stopping = true;
+  }
+  m_TaskAvailable.notify_all();
+
+  for (auto &thread : m_Threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+#ifdef MATHBOARD_ENABLE_TRACING
+  // Spans of the task belong to the request that submitted it
+  task = [context = Tracer::CurrentContext(), task = std::move(task)]() {
+    MATHBOARD_TRACE_CONTEXT(context);
+    task();
+  };
+#endif
+
+  {
+    std::lock_guard<std::mutex> lockTasks(m_MutexTasks);
+    m_Tasks.push_back(std::move(task));
+  }
+  m_TaskAvailable.notify_one();
+}
+
+std::size_t ThreadPool::GetQueueSize() const {
+  std::lock_guard<std::mutex> lockTasks(m_MutexTasks);
+  return m_Tasks.size();
+}
+
+ThreadPool &ThreadPool::Shared() {
+  static ThreadPool pool{};
+  return pool;
+}
+
+void ThreadPool::WorkerLoop() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lockTasks(m_MutexTasks);
+      m_TaskAvailable.wait(lockTasks,
+                           [this]() { return m_Stopping || !m_Tasks.empty(); });
+
+      if (m_Tasks.empty()) {
+        // Stopping and nothing left to do
+        return;
+      }
+
+      task = std::move(m_Tasks.front());
+      m_Tasks.pop_front();
+    }
+
+    try {
+      task();
+    } catch (const std::exception &e) {
+      spdlog::error("[ThreadPool::WorkerLoop]: Task threw: {}\n", e.what());
+    } catch (...) {
+      spdlog::error("[ThreadPool::WorkerLoop]: Task threw.\n");
+    }
+  }
+}
+
+} // namespace mathboard
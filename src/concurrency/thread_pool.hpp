@@ -0,0 +1,50 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mathboard {
+
+// Fixed number of worker threads running submitted tasks in FIFO order.
+// Meant for coarse tasks (a whole equation, a whole board), data parallel
+// loops over pixels use cv::parallel_for_ instead.
+class ThreadPool {
+public:
+  // 0 threads means one per core
+  explicit ThreadPool(std::size_t thread_count = 0);
+
+  // Finishes the queued tasks, then joins the workers
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Queue the task to run on one of the workers
+  void Submit(std::function<void()> task);
+
+  std::size_t GetThreadCount() const { return m_Threads.size(); }
+
+  // Number of tasks waiting for a free worker
+  std::size_t GetQueueSize() const;
+
+  // Process wide pool shared by the solver and the daemon
+  static ThreadPool &Shared();
+
+private:
+  void WorkerLoop();
+
+private:
+  std::vector<std::thread> m_Threads{};
+  std::deque<std::function<void()>> m_Tasks{};
+  mutable std::mutex m_MutexTasks{};
+  std::condition_variable m_TaskAvailable{};
+  bool m_Stopping = false;
+};
+
+} // namespace mathboard
@@ -0,0 +1,92 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+// Objects owned by the threads that use them, e.g. the tracer's event rings.
+// Each thread creates its own T on first use and is the only one writing it,
+// readers go through every registered T under the registry's lock. When a
+// thread exits, its T is handed to `retire` together with `Retired`, what the
+// exited threads left behind, and released. Merging the counts of a thread
+// into `Retired` keeps them without keeping a T per thread that ever ran.
+//
+// The calling thread's T is looked up through a thread_local of the
+// instantiation, keep a single registry per T.
+template <typename T, typename Retired = T> class ThreadRegistry {
+public:
+  using RetireFunction = std::function<void(const T &, Retired &)>;
+
+  explicit ThreadRegistry(RetireFunction retire)
+      : m_State(std::make_shared<State>()) {
+    m_State->retire = std::move(retire);
+  }
+
+  ThreadRegistry(const ThreadRegistry &) = delete;
+  ThreadRegistry &operator=(const ThreadRegistry &) = delete;
+
+  // Object of the calling thread
+  T &Local() {
+    thread_local Registration registration{};
+    if (!registration.object) {
+      registration.state = m_State;
+      registration.object = std::make_shared<T>();
+      std::lock_guard<std::mutex> lockState(m_State->mutex);
+      m_State->objects.push_back(registration.object);
+    }
+    return *registration.object;
+  }
+
+  // Call `read` with the objects of the running threads and the retired
+  // ones, under the lock so no thread is seen both alive and retired
+  template <typename Reader> decltype(auto) Read(Reader &&read) const {
+    std::lock_guard<std::mutex> lockState(m_State->mutex);
+    return std::forward<Reader>(read)(
+        static_cast<const std::vector<std::shared_ptr<T>> &>(m_State->objects),
+        static_cast<const Retired &>(m_State->retired));
+  }
+
+  // Objects of the running threads, to read without holding the lock. They
+  // stay alive as long as they're referenced, even after their threads exit.
+  std::vector<std::shared_ptr<T>> GetObjects() const {
+    std::lock_guard<std::mutex> lockState(m_State->mutex);
+    return m_State->objects;
+  }
+
+private:
+  struct State {
+    std::mutex mutex{};
+    std::vector<std::shared_ptr<T>> objects{};
+    Retired retired{};
+    RetireFunction retire{};
+  };
+
+  // Unregisters the thread's object on exit. Holds the state so threads
+  // exiting after the registry is destroyed, e.g. detached ones, are safe.
+  struct Registration {
+    ~Registration() {
+      if (!object) {
+        return;
+      }
+      std::lock_guard<std::mutex> lockState(state->mutex);
+      state->objects.erase(
+          std::find(state->objects.begin(), state->objects.end(), object));
+      if (state->retire) {
+        state->retire(*object, state->retired);
+      }
+    }
+
+    std::shared_ptr<State> state{};
+    std::shared_ptr<T> object{};
+  };
+
+  std::shared_ptr<State> m_State;
+};
+
+} // namespace mathboard
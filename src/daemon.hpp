@@ -1,9 +1,21 @@
 #pragma once
 
 // local
-#include "image_processing.hpp"
-#include "opencv_helper.hpp"
-#include "stroke.hpp"
+#include "board_sessions.hpp"
+#include "concurrency/thread_pool.hpp"
+#include "equation_solver.hpp"
+#include "json_writer.hpp"
+#include "live_strokes.hpp"
+#include "logging/async_sink.hpp"
+#include "memory/allocation_stats.hpp"
+#include "memory/pooled_mat_allocator.hpp"
+#include "metrics/metrics.hpp"
+#include "request_pipeline.hpp"
+#include "tracing/tracer.hpp"
+#include "traffic_recorder.hpp"
+#include "unix_socket_server/connection_registry.hpp"
+#include "unix_socket_server/handoff_socket_server.hpp"
+#include "unix_socket_server/message_framer.hpp"
 #include "unix_socket_server/unix_socket_server.hpp"
 
 // libs
@@ -15,14 +27,55 @@
 #include <opencv2/opencv.hpp>
 
 // std
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace mathboard {
 
+struct DaemonOptions {
+  // Metrics in Prometheus text format are written there periodically, empty
+  // disables the exporter
+  std::filesystem::path metrics_path{};
+  std::chrono::milliseconds metrics_interval{5000};
+
+  RequestPipelineOptions pipeline{};
+
+  // Every received message is captured there for tools/load_generator,
+  // empty disables the recording
+  std::filesystem::path record_path{};
+
+  Transport transport{Transport::Socket};
+
+  // Memory limit and idle timeout of the board sessions
+  BoardSessionOptions sessions{};
+
+  // Set in the workers of RunSupervisor: connections are handed over on this
+  // channel instead of accepted on socket.sock, `transport` is ignored
+  std::int32_t handoff_fd{-1};
+};
+
 /*
 FORMAT:
+Messages are JSON objects, newline-delimited or just concatenated, see
+MessageFramer. Every message may carry a `requestId?: number | string` that
+its reply echoes.
 ```
 {
+  simplifyTolerance?: number; // in pixels, 0 keeps the raw contours
+  stream?: boolean;     // send partial replies as the stages finish
   strokes: [
     {
       id: number;
@@ -37,11 +90,461 @@ FORMAT:
   ]
 }
 ```
+or, to let the daemon split a whole board raster into strokes itself:
+```
+{
+  simplifyTolerance?: number;
+  board: {
+    boardId: number;
+    path: string;       // image of the whole board
+    binarization?: "global" | "otsu" | "sauvola";
+  }
+}
+```
+or a delta of a board session, the daemon keeps the strokes of the board
+between them, see BoardSessions:
+```
+{
+  session: "add";       // the strokes are processed like above
+  boardId: number;
+  simplifyTolerance?: number;
+  strokes: [{ id: number; path: string; x: number; y: number }, ...]
+}
+```
+```
+{
+  session: "remove" | "move" | "close"; // close drops the whole session
+  boardId: number;
+  strokeId: number;     // remove and move
+  x: number;            // move, new position in pixels
+  y: number;
+}
+```
+or points of a stroke still being drawn, streamed while the pen moves:
+```
+{
+  session: "points";
+  boardId: number;
+  strokeId: number;
+  points: [[x, y], ...]; // in board pixels, appended to the stroke
+  penUp?: boolean;      // the stroke is finished and added to the session
+  simplifyTolerance?: number;
+}
+```
+or a control message:
+```
+{
+  command: "trace";
+  path: string;         // Chrome trace-event JSON written there
+  intervalMs?: number;  // rewrite the file periodically, 0 stops it
+}
+```
+```
+{
+  command: "stats";     // reply with Metrics::Snapshot()
+}
+```
+Every message gets a reply, one JSON object per line, requests once they left
+the pipeline. A client can send many requests without waiting, their replies
+arrive in the order they finish:
+```
+{
+  status: "ok" | "error";
+  requestId?: number | string; // the request's, or an id the daemon gave it
+  strokes?: number;     // strokes found in the request
+  stage?: string;       // stage that dropped the request
+  error?: string;
+}
+```
+a request with `stream` first gets a partial reply after every stage, the
+strokes are sent in chunks of kPartialReplyStrokes, without their contours
+after contour and with them (flat x0, y0, x1, y1, ...) after simplify:
+```
+{
+  status: "ok";
+  requestId?: number | string;
+  partial: true;
+  stage: "decode" | "preprocess" | "contour" | "simplify";
+  strokes?: [
+    {
+      id: number;
+      x: number;
+      y: number;
+      boundingBox: [x, y, width, height];
+      contours?: number[][];
+    },
+    ...
+  ]
+}
+```
+session deltas are answered once they're applied, in the order they were sent
+for the same board:
+```
+{
+  status: "ok" | "error";
+  requestId?: number | string;
+  boardId: number;
+  strokes: number;      // strokes of the board's session
+  invalidated?: number[]; // ids of the strokes whose neighborhood changed
+  error?: string;
+}
+```
+points are answered right away with the stroke so far, a point batch with
+penUp once the stroke is in the session, with the symbol it probably belongs
+to unless newer points on the board made that guess stale:
+```
+{
+  status: "ok" | "error";
+  requestId?: number | string;
+  boardId: number;
+  strokeId?: number;
+  boundingBox?: { x: number; y: number; width: number; height: number };
+  strokes?: number;     // penUp, like a session delta
+  invalidated?: number[];
+  symbol?: { strokes: number[]; boundingBox: { ... } };
+  error?: string;
+}
+```
 */
 
-inline void Daemon() {
-  std::unique_ptr<UnixSocketServer> server(UnixSocketServer::Instance());
-  OpenCVHelper opencvHelper{};
+// Hit rate of a cache, 0 before the first lookup
+inline double HitRate(std::uint64_t hits, std::uint64_t misses) {
+  return hits + misses == 0 ? 0.0
+                            : static_cast<double>(hits) /
+                                  static_cast<double>(hits + misses);
+}
+
+// Queue depth, cache hit rates, allocation counts and dropped log messages,
+// read by the stats command and the Prometheus export
+inline void RegisterDaemonGauges() {
+  Metrics::RegisterGauge("thread_pool_queue_depth", []() {
+    return static_cast<double>(ThreadPool::Shared().GetQueueSize());
+  });
+  Metrics::RegisterGauge("expression_cache_hit_rate", []() {
+    const EquationSolver::CacheStats stats = EquationSolver::GetCacheStats();
+    return HitRate(stats.expression_hits, stats.expression_misses);
+  });
+  Metrics::RegisterGauge("solution_cache_hit_rate", []() {
+    const EquationSolver::CacheStats stats = EquationSolver::GetCacheStats();
+    return HitRate(stats.solution_hits, stats.solution_misses);
+  });
+  Metrics::RegisterGauge("mat_pool_hit_rate", []() {
+    const AllocationStats stats = GetAllocationStats();
+    return HitRate(stats.mat_pool_hits, stats.mat_pool_misses);
+  });
+  Metrics::RegisterGauge("heap_allocations", []() {
+    return static_cast<double>(GetAllocationStats().heap_allocations);
+  });
+  Metrics::RegisterGauge("log_dropped_messages", []() {
+    return static_cast<double>(GetDroppedLogMessages());
+  });
+  Metrics::RegisterGauge("arena_upstream_allocations", []() {
+    return static_cast<double>(
+        GetAllocationStats().arena_upstream_allocations);
+  });
+}
+
+// Session count, memory and evictions, unregistered when the returned gauges
+// are destroyed. The sessions must outlive them.
+inline ScopedGauges RegisterSessionGauges(const BoardSessions &sessions) {
+  ScopedGauges gauges{};
+  gauges.Register("board_sessions", [&sessions]() {
+    return static_cast<double>(sessions.Size());
+  });
+  gauges.Register("board_session_memory_bytes", [&sessions]() {
+    return static_cast<double>(sessions.GetMemoryUsage());
+  });
+  gauges.Register("board_session_evictions", [&sessions]() {
+    return static_cast<double>(sessions.GetEvictions());
+  });
+  return gauges;
+}
+
+// requestId of the request's replies: the client's own when it sent one, so
+// it can match replies arriving out of order, the daemon's otherwise
+inline nlohmann::json GetReplyId(const nlohmann::json &request,
+                                 std::uint64_t request_id) {
+  const auto clientId = request.find("requestId");
+  if (clientId != request.end()) {
+    return *clientId;
+  }
+  return request_id;
+}
+
+// Delta of a message with a `session` field, an add gets its strokes from the
+// pipeline. Returns false with `error` set when the message is malformed.
+inline bool ParseBoardDelta(const nlohmann::json &message, BoardDelta &delta,
+                            std::string &error) {
+  const auto boardId = message.find("boardId");
+  if (boardId == message.end() || !boardId->is_number_integer()) {
+    error = "Session delta without a boardId";
+    return false;
+  }
+
+  const auto name = message.find("session");
+  const auto strokeId = message.find("strokeId");
+  const bool hasStrokeId =
+      strokeId != message.end() && strokeId->is_number_unsigned();
+  if (*name == "add") {
+    const auto strokes = message.find("strokes");
+    if (strokes == message.end() || !strokes->is_array()) {
+      error = "Add without strokes";
+      return false;
+    }
+    delta.type = BoardDelta::Type::Add;
+  } else if (*name == "remove" && hasStrokeId) {
+    delta.type = BoardDelta::Type::Remove;
+    delta.stroke_id = strokeId->get<std::uint32_t>();
+  } else if (*name == "move" && hasStrokeId &&
+             message.value("x", nlohmann::json()).is_number() &&
+             message.value("y", nlohmann::json()).is_number()) {
+    delta.type = BoardDelta::Type::Move;
+    delta.stroke_id = strokeId->get<std::uint32_t>();
+    delta.position = cv::Point2f(message["x"].get<float>(),
+                                 message["y"].get<float>());
+  } else if (*name == "close") {
+    delta.type = BoardDelta::Type::Close;
+  } else {
+    error = "Invalid session delta";
+    return false;
+  }
+  return true;
+}
+
+// Points of a `"session": "points"` message, in board pixels. Returns false
+// with `error` set when the message is malformed.
+inline bool ParseLivePoints(const nlohmann::json &message,
+                            std::vector<cv::Point> &points,
+                            std::string &error) {
+  const auto boardId = message.find("boardId");
+  const auto strokeId = message.find("strokeId");
+  const auto pointsData = message.find("points");
+  if (boardId == message.end() || !boardId->is_number_integer() ||
+      strokeId == message.end() || !strokeId->is_number_unsigned() ||
+      pointsData == message.end() || !pointsData->is_array()) {
+    error = "Points without a boardId, strokeId or points";
+    return false;
+  }
+
+  points.clear();
+  for (const auto &point : *pointsData) {
+    if (!point.is_array() || point.size() != 2 || !point[0].is_number() ||
+        !point[1].is_number()) {
+      error = "Points must be [x, y] pairs";
+      return false;
+    }
+    points.emplace_back(static_cast<int>(std::lround(point[0].get<double>())),
+                        static_cast<int>(std::lround(point[1].get<double>())));
+  }
+  return true;
+}
+
+// Writer of the calling thread's replies, cleared. Replies are written
+// into its buffer and moved into the connection's queue, no nlohmann::json
+// tree is built for them.
+inline JsonWriter &GetReplyWriter() {
+  thread_local JsonWriter writer{};
+  writer.Clear();
+  return writer;
+}
+
+inline void SendReply(ConnectionRegistry &connections, std::int32_t client_fd,
+                      std::uint64_t connection_id, JsonWriter &writer) {
+  connections.Write(client_fd, connection_id, writer.Take());
+}
+
+inline void WriteReplyId(JsonWriter &writer, const nlohmann::json &reply_id) {
+  if (reply_id.is_number_unsigned()) {
+    writer.UInt(reply_id.get<std::uint64_t>());
+  } else if (reply_id.is_number_integer()) {
+    writer.Int(reply_id.get<std::int64_t>());
+  } else if (reply_id.is_string()) {
+    writer.String(reply_id.get_ref<const std::string &>());
+  } else {
+    writer.Raw(reply_id.dump());
+  }
+}
+
+// `{"status": "ok" | "error", "requestId": ...`, the object is left open for
+// the rest of the reply. A null `reply_id` is left out.
+inline JsonWriter &BeginReply(JsonWriter &writer, bool ok,
+                              const nlohmann::json &reply_id) {
+  writer.BeginObject().Key("status").String(ok ? "ok" : "error");
+  if (!reply_id.is_null()) {
+    writer.Key("requestId");
+    WriteReplyId(writer, reply_id);
+  }
+  return writer;
+}
+
+inline void SendErrorReply(ConnectionRegistry &connections,
+                           std::int32_t client_fd, std::uint64_t connection_id,
+                           const nlohmann::json &reply_id,
+                           std::string_view error) {
+  JsonWriter &writer = GetReplyWriter();
+  BeginReply(writer, false, reply_id).Key("error").String(error).EndObject();
+  SendReply(connections, client_fd, connection_id, writer);
+}
+
+inline void WriteRect(JsonWriter &writer, const cv::Rect &rect) {
+  writer.BeginObject()
+      .Key("x")
+      .Int(rect.x)
+      .Key("y")
+      .Int(rect.y)
+      .Key("width")
+      .Int(rect.width)
+      .Key("height")
+      .Int(rect.height)
+      .EndObject();
+}
+
+// Reply to a session delta, left open like BeginReply()
+inline JsonWriter &BeginDeltaReply(JsonWriter &writer,
+                                   const BoardDeltaResult &result,
+                                   const nlohmann::json &reply_id,
+                                   std::int64_t board_id) {
+  BeginReply(writer, result.applied, reply_id)
+      .Key("boardId")
+      .Int(board_id)
+      .Key("strokes")
+      .UInt(result.stroke_count);
+  if (result.applied) {
+    writer.Key("invalidated").BeginArray();
+    for (const std::uint32_t id : result.invalidated) {
+      writer.UInt(id);
+    }
+    writer.EndArray();
+  } else {
+    writer.Key("error").String(result.error);
+  }
+  return writer;
+}
+
+// Reply to a session delta once it's applied
+inline BoardDeltaCallback ReplyToDelta(ConnectionRegistry &connections,
+                                       std::int32_t client_fd,
+                                       std::uint64_t connection_id,
+                                       nlohmann::json reply_id,
+                                       std::int64_t board_id) {
+  return [&connections, client_fd, connection_id,
+          replyId = std::move(reply_id),
+          board_id](const BoardDeltaResult &result) {
+    JsonWriter &writer = GetReplyWriter();
+    BeginDeltaReply(writer, result, replyId, board_id).EndObject();
+    SendReply(connections, client_fd, connection_id, writer);
+  };
+}
+
+// Strokes per partial reply, a large board goes out in several messages
+// instead of one huge one
+constexpr std::size_t kPartialReplyStrokes = 64;
+
+// Partial replies of a request with `stream` set, sent after each stage:
+// the found strokes after contour, and the strokes with their contours after
+// simplify
+inline void SendPartialReplies(ConnectionRegistry &connections,
+                               const RequestWork &work,
+                               const std::string &stage) {
+  const nlohmann::json replyId = GetReplyId(work.request, work.request_id);
+  const bool withStrokes = stage == "contour" || stage == "simplify";
+  const std::size_t strokeCount = withStrokes ? work.strokes.size() : 0;
+
+  std::size_t begin = 0;
+  do {
+    const std::size_t end =
+        std::min(begin + kPartialReplyStrokes, strokeCount);
+    JsonWriter &writer = GetReplyWriter();
+    BeginReply(writer, true, replyId)
+        .Key("partial")
+        .Bool(true)
+        .Key("stage")
+        .String(stage);
+    if (withStrokes) {
+      writer.Key("strokes").BeginArray();
+      for (std::size_t i = begin; i < end; i++) {
+        WriteStrokeJson(writer, work.strokes[i], stage == "simplify");
+      }
+      writer.EndArray();
+    }
+    writer.EndObject();
+    SendReply(connections, work.client_fd, work.connection_id, writer);
+    begin = end;
+  } while (begin < strokeCount);
+}
+
+// Handle a control message, its reply goes to `writer`
+inline void HandleCommand(JsonWriter &writer, const nlohmann::json &command,
+                          const nlohmann::json &reply_id) {
+  const auto fail = [&writer, &reply_id](std::string_view error) {
+    BeginReply(writer, false, reply_id).Key("error").String(error).EndObject();
+  };
+
+  const auto name = command.find("command");
+  if (name == command.end() || !name->is_string()) {
+    fail("Command must be a string");
+    return;
+  }
+  if (*name == "stats") {
+    BeginReply(writer, true, reply_id);
+    Metrics::WriteSnapshot(writer);
+    writer.EndObject();
+    return;
+  }
+  if (*name != "trace") {
+    spdlog::error("[Daemon] - Unknown command {}.\n",
+                  name->get_ref<const std::string &>());
+    fail("Unknown command");
+    return;
+  }
+
+  const auto path = command.find("path");
+  if (path == command.end() || !path->is_string()) {
+    fail("Path must be a string");
+    return;
+  }
+  const auto interval = command.find("intervalMs");
+  if (interval != command.end() && !interval->is_number_integer()) {
+    fail("intervalMs must be an integer");
+    return;
+  }
+#ifndef MATHBOARD_ENABLE_TRACING
+  spdlog::warn("[Daemon] - Built without MATHBOARD_ENABLE_TRACING, the "
+               "trace is empty.\n");
+#endif
+  const std::string &pathName = path->get_ref<const std::string &>();
+  const std::int64_t intervalMs =
+      interval == command.end() ? -1 : interval->get<std::int64_t>();
+  if (intervalMs > 0) {
+    Tracer::StartContinuousDump(pathName,
+                                std::chrono::milliseconds(intervalMs));
+  } else {
+    if (intervalMs == 0) {
+      Tracer::StopContinuousDump();
+    }
+    if (!Tracer::DumpChromeTrace(pathName)) {
+      fail("Could not write the trace");
+      return;
+    }
+  }
+  BeginReply(writer, true, reply_id).EndObject();
+}
+
+inline void Daemon(const DaemonOptions &options = {}) {
+  std::unique_ptr<UnixSocketServer> server(
+      options.handoff_fd >= 0
+          ? new HandoffSocketServer(options.handoff_fd)
+          : UnixSocketServer::Instance(options.transport));
+
+  RegisterDaemonGauges();
+  if (!options.metrics_path.empty()) {
+    Metrics::StartPrometheusExport(options.metrics_path,
+                                   options.metrics_interval);
+  }
+
+  // Every cv::Mat created from now on recycles its buffer through the
+  // per-thread pools instead of malloc/free
+  cv::Mat::setDefaultAllocator(PooledMatAllocator::Instance());
 
   bool running = true;
 
@@ -50,56 +553,370 @@ inline void Daemon() {
     return;
   }
 
+  TrafficRecorder recorder{};
+  if (!options.record_path.empty() && !recorder.Open(options.record_path)) {
+    return;
+  }
+
+  // Declared before the pipeline, whose threads write the replies
+  ConnectionRegistry connections(*server);
+
+  // Memory for per-request containers
+  ArenaPool arenas{};
+
+  // Strokes of the boards edited with session deltas, completed by the
+  // pipeline's threads
+  BoardSessions sessions(options.sessions);
+  const ScopedGauges sessionGauges = RegisterSessionGauges(sessions);
+  // Strokes being drawn, only touched by this thread
+  LiveStrokes liveStrokes(options.sessions.max_memory);
+  std::vector<cv::Point> livePoints;
+  // Adds the strokes whose pen lifted to their sessions. Its tasks use the
+  // connections and the sessions, it's drained before they're destroyed.
+  ThreadPool liveStrokePool(1);
+
+  // Requests are only read while the first stage has room, a slow stage
+  // backs up into the socket instead of piling up requests in memory
+  RequestPipeline pipeline{};
+  AddRequestStages(
+      pipeline, options.pipeline, arenas,
+      [&connections, &sessions](RequestWork &work) {
+        if (work.request.contains("session")) {
+          BoardDelta delta{};
+          delta.type = BoardDelta::Type::Add;
+          delta.strokes.assign(std::make_move_iterator(work.strokes.begin()),
+                               std::make_move_iterator(work.strokes.end()));
+          sessions.Complete(
+              work.board_id, work.session_sequence, std::move(delta),
+              ReplyToDelta(connections, work.client_fd, work.connection_id,
+                           GetReplyId(work.request, work.request_id),
+                           work.board_id));
+          return;
+        }
+
+        JsonWriter &writer = GetReplyWriter();
+        BeginReply(writer, true, GetReplyId(work.request, work.request_id))
+            .Key("strokes")
+            .UInt(work.strokes.size())
+            .EndObject();
+        SendReply(connections, work.client_fd, work.connection_id, writer);
+      },
+      [&connections, &sessions](RequestWork &work, const std::string &stage) {
+        if (work.request.contains("session")) {
+          // Later deltas of the board don't wait for this one anymore
+          sessions.Complete(work.board_id, work.session_sequence,
+                            BoardDelta{}, {});
+        }
+
+        JsonWriter &writer = GetReplyWriter();
+        BeginReply(writer, false, GetReplyId(work.request, work.request_id))
+            .Key("stage")
+            .String(stage);
+        if (!work.error.empty()) {
+          writer.Key("error").String(work.error);
+        }
+        writer.EndObject();
+        SendReply(connections, work.client_fd, work.connection_id, writer);
+      },
+      [&connections](RequestWork &work, const std::string &stage) {
+        SendPartialReplies(connections, work, stage);
+      });
+  pipeline.Start();
+  // Unregistered before the pipeline and the connections are destroyed
+  ScopedGauges gauges = RegisterPipelineGauges(pipeline);
+  gauges.Register("open_connections", [&connections]() {
+    return static_cast<double>(connections.Size());
+  });
+
   server->Listen();
 
   spdlog::info("[Daemon] - Server is listening.\n");
 
-  void *client_addr;
-  int client_fd;
+  // Reused by every read, large enough for a board of a few hundred strokes.
+  // Larger messages take several reads.
+  constexpr std::size_t kReadBufferSize = 64 * 1024;
+  std::vector<unsigned char> buffer(kReadBufferSize);
+  // A client sending more than that without finishing a message is dropped
+  constexpr std::size_t kMaxMessageSize = 16 * 1024 * 1024;
 
-  bool connected = false;
+  // Bytes of every connection's next message, see MessageFramer
+  std::unordered_map<std::int32_t, MessageFramer> framers;
 
-  // Loop to handle request
-  while (running) {
-    if (!connected) {
-      if (!server->Accept(client_fd, &client_addr)) {
-        spdlog::error("[Daemon] - Failed to accept the connection.\n");
-        continue;
+  std::uint64_t requestCount = 0;
+
+  const auto removeClient = [&](int client_fd) {
+    framers.erase(client_fd);
+    connections.Remove(client_fd);
+    spdlog::info("[Daemon] - Client disconnected, {} left.\n",
+                 connections.Size());
+  };
+
+  // Grow a stroke being drawn. Once the pen lifts, the stroke is added to the
+  // board's session on the thread pool and the symbol it belongs to is
+  // guessed right away, unless new points on the board made the guess stale
+  // in the meantime.
+  const auto handlePoints = [&](int client_fd, std::uint64_t connectionId,
+                                const nlohmann::json &message,
+                                std::uint64_t requestId) {
+    nlohmann::json replyId = GetReplyId(message, requestId);
+    std::string error;
+    if (!ParseLivePoints(message, livePoints, error)) {
+      spdlog::error("[Daemon] - Request {}: {}.\n", requestId, error);
+      SendErrorReply(connections, client_fd, connectionId, replyId, error);
+      return;
+    }
+
+    const std::int64_t boardId = message["boardId"];
+    const std::uint32_t strokeId = message["strokeId"];
+    const Stroke *stroke = liveStrokes.Append(boardId, strokeId, livePoints);
+    if (stroke == nullptr) {
+      SendErrorReply(connections, client_fd, connectionId, replyId,
+                     "Stroke without points, over " +
+                         std::to_string(LiveStrokes::kMaxPoints) +
+                         " points or over the memory limit");
+      return;
+    }
+
+    if (!message.value("penUp", false)) {
+      JsonWriter &writer = GetReplyWriter();
+      BeginReply(writer, true, replyId)
+          .Key("boardId")
+          .Int(boardId)
+          .Key("strokeId")
+          .UInt(strokeId)
+          .Key("boundingBox");
+      WriteRect(writer, stroke->GetBoardBoundingBox());
+      writer.EndObject();
+      SendReply(connections, client_fd, connectionId, writer);
+      return;
+    }
+
+    std::optional<Stroke> finished = liveStrokes.Finish(boardId, strokeId);
+    if (!finished) {
+      SendErrorReply(connections, client_fd, connectionId, replyId,
+                     "Unknown stroke " + std::to_string(strokeId));
+      return;
+    }
+    const std::shared_ptr<Speculation> speculation =
+        liveStrokes.Speculate(boardId);
+    // In the board's order like any other delta
+    const std::uint64_t sequence = sessions.Begin(boardId);
+    const double simplifyTolerance =
+        message.value("simplifyTolerance", kDefaultSimplifyTolerance);
+
+    liveStrokePool.Submit([&connections, &sessions, client_fd, connectionId,
+                           replyId, boardId, strokeId, sequence, speculation,
+                           simplifyTolerance,
+                           stroke = std::move(*finished)]() mutable {
+      BoardDelta delta{};
+      try {
+        if (simplifyTolerance > 0.0) {
+          stroke.Simplify(simplifyTolerance);
+        }
+        delta.strokes.push_back(std::move(stroke));
+      } catch (const std::exception &exception) {
+        spdlog::error("[Daemon] - Stroke {} of board {}: {}.\n", strokeId,
+                      boardId, exception.what());
+        // Later deltas of the board don't wait for this one anymore
+        sessions.Complete(boardId, sequence, BoardDelta{}, {});
+        SendErrorReply(connections, client_fd, connectionId, replyId,
+                       exception.what());
+        return;
       }
+      delta.type = BoardDelta::Type::Add;
+
+      sessions.Complete(
+          boardId, sequence, std::move(delta),
+          [&connections, &sessions, client_fd, connectionId, replyId,
+           boardId, strokeId,
+           speculation](const BoardDeltaResult &result) {
+            JsonWriter &writer = GetReplyWriter();
+            BeginDeltaReply(writer, result, replyId, boardId)
+                .Key("strokeId")
+                .UInt(strokeId);
+            if (result.applied && !speculation->IsCancelled()) {
+              const BoardSymbol symbol = sessions.GetSymbol(boardId, strokeId);
+              if (!speculation->IsCancelled()) {
+                writer.Key("symbol").BeginObject().Key("strokes").BeginArray();
+                for (const std::uint32_t id : symbol.strokes) {
+                  writer.UInt(id);
+                }
+                writer.EndArray().Key("boundingBox");
+                WriteRect(writer, symbol.bounding_box);
+                writer.EndObject();
+              }
+            }
+            writer.EndObject();
+            SendReply(connections, client_fd, connectionId, writer);
+          });
+    });
+  };
+
+  // Submit one message to the pipeline, or answer it right away
+  const auto handleMessage = [&](int client_fd, std::uint64_t connectionId,
+                                 std::string_view message,
+                                 std::chrono::steady_clock::time_point
+                                     received) {
+    const std::uint64_t requestId = ++requestCount;
+    MATHBOARD_TRACE_CONTEXT(requestId, -1);
 
-      connected = true;
-      spdlog::info("[Daemon] - Client connected.\n");
+    if (recorder.IsOpen()) {
+      recorder.Record(connectionId, message);
     }
 
-    if (connected) {
-      std::vector<unsigned char> buffer(1024);
+    // Parse straight from the read buffer, without copying it into a string
+    nlohmann::json jsonData;
+    {
+      MATHBOARD_TRACE_SCOPE("Daemon::ParseJson");
+      const StageTimer stageTimer(Stage::ParseJson);
+      jsonData = nlohmann::json::parse(message.begin(), message.end(), nullptr,
+                                       false);
+    }
+
+    if (jsonData.is_discarded()) {
+      spdlog::error("[Daemon] - Request {} is not valid JSON.\n", requestId);
+      SendErrorReply(connections, client_fd, connectionId, requestId,
+                     "Invalid JSON");
+      return;
+    }
 
-      server->Read(client_fd, buffer);
+    if (jsonData.contains("command")) {
+      JsonWriter &writer = GetReplyWriter();
+      HandleCommand(writer, jsonData, GetReplyId(jsonData, requestId));
+      SendReply(connections, client_fd, connectionId, writer);
+      return;
+    }
 
-      if (buffer.size() == 0) {
-        continue;
+    if (jsonData.contains("session") && jsonData["session"] == "points") {
+      handlePoints(client_fd, connectionId, jsonData, requestId);
+      return;
+    }
+
+    std::uint64_t sessionSequence = 0;
+    if (jsonData.contains("session")) {
+      BoardDelta delta{};
+      std::string error;
+      if (!ParseBoardDelta(jsonData, delta, error)) {
+        spdlog::error("[Daemon] - Request {}: {}.\n", requestId, error);
+        SendErrorReply(connections, client_fd, connectionId,
+                       GetReplyId(jsonData, requestId), error);
+        return;
+      }
+
+      // Deltas of a board are applied in the order they're read
+      const std::int64_t boardId = jsonData["boardId"];
+      sessionSequence = sessions.Begin(boardId);
+      if (delta.type != BoardDelta::Type::Add) {
+        sessions.Complete(boardId, sessionSequence, std::move(delta),
+                          ReplyToDelta(connections, client_fd, connectionId,
+                                       GetReplyId(jsonData, requestId),
+                                       boardId));
+        return;
       }
+    }
+
+    std::unique_ptr<RequestWork> work = arenas.CreateWork();
+    work->request_id = requestId;
+    work->received = received;
+    work->board_id = GetRequestBoardId(jsonData);
+    work->request = std::move(jsonData);
+    work->client_fd = client_fd;
+    work->connection_id = connectionId;
+    work->session_sequence = sessionSequence;
+    work->stream = work->request.contains("stream") &&
+                   work->request["stream"] == true;
 
-      std::string stringData = std::string(buffer.begin(), buffer.end());
-      nlohmann::json jsonData = nlohmann::json::parse(stringData);
-      auto &strokesData = jsonData["strokes"];
+    MATHBOARD_TRACE_SCOPE("Daemon::Submit");
+    pipeline.Submit(std::move(work));
+  };
 
-      std::vector<Stroke> strokeVector;
-      strokeVector.reserve(strokesData.size());
+  // Read what a client sent and handle every message completed by it, EOF
+  // closes the connection. Replies go out as the requests finish, so a
+  // client can keep sending without waiting for them.
+  const auto handleClient = [&](int client_fd) {
+    const auto received = std::chrono::steady_clock::now();
 
-      for (std::size_t i = 0; i != strokesData.size(); i++) {
-        auto &strokeData = strokesData[i];
-        cv::Mat processedImage;
-        opencvHelper.OpenFile(strokeData["path"]);
-        processedImage = opencvHelper.GetFrame();
-        processedImage = GrayScaleImage(processedImage);
+    buffer.resize(kReadBufferSize);
+
+    bool read = false;
+    {
+      MATHBOARD_TRACE_SCOPE("Daemon::Read");
+      const StageTimer stageTimer(Stage::Read);
+      read = server->Read(client_fd, buffer);
+    }
+
+    if (!read || buffer.empty()) {
+      removeClient(client_fd);
+      return;
+    }
 
-        strokeVector.emplace_back(strokeData["id"], strokeData["x"],
-                                  strokeData["y"], processedImage);
+    const std::uint64_t connectionId = connections.GetId(client_fd);
+    MessageFramer &framer = framers[client_fd];
+    framer.Append(buffer.data(), buffer.size());
+
+    std::string_view message;
+    while (framer.Next(message)) {
+      handleMessage(client_fd, connectionId, message, received);
+    }
+
+    if (framer.Pending() > kMaxMessageSize) {
+      spdlog::error("[Daemon] - Message over {} bytes, closing the "
+                    "connection.\n",
+                    kMaxMessageSize);
+      SendErrorReply(connections, client_fd, connectionId, nullptr,
+                     "Message too large");
+      removeClient(client_fd);
+    }
+  };
+
+  std::vector<std::int32_t> pollFds;
+  std::vector<std::int32_t> ready;
+
+  // Idle sessions are looked for at most once a second, when there's traffic
+  auto lastEviction = std::chrono::steady_clock::now();
+
+  // Loop to handle request
+  while (running) {
+    pollFds = connections.GetFds();
+    pollFds.push_back(server->GetServerSocketFd());
+
+    if (!server->Poll(pollFds, ready)) {
+      spdlog::error("[Daemon] - Failed to poll the connections.\n");
+      continue;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastEviction >= std::chrono::seconds(1)) {
+      lastEviction = now;
+      const std::size_t evicted = sessions.EvictIdle(now);
+      if (evicted > 0) {
+        spdlog::info("[Daemon] - Evicted {} idle board sessions.\n", evicted);
+      }
+      const std::size_t abandoned =
+          liveStrokes.EvictIdle(now, options.sessions.idle_timeout);
+      if (abandoned > 0) {
+        spdlog::info("[Daemon] - Dropped {} unfinished strokes.\n",
+                     abandoned);
+      }
+    }
+
+    for (const std::int32_t socketFd : ready) {
+      if (socketFd != server->GetServerSocketFd()) {
+        handleClient(socketFd);
+        continue;
+      }
+
+      void *client_addr = nullptr;
+      int client_fd;
+      if (!server->Accept(client_fd, &client_addr)) {
+        spdlog::error("[Daemon] - Failed to accept the connection.\n");
+        continue;
       }
+      std::free(client_addr);
 
-      // TODO
-      // Do something with the stroke vector
+      connections.Add(client_fd);
+      spdlog::info("[Daemon] - Client connected, {} open.\n",
+                   connections.Size());
     }
   }
 }
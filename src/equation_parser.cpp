@@ -0,0 +1,356 @@
+// header
+#include "equation_parser.hpp"
+
+// libs
+// symengine
+#include <symengine/add.h>
+#include <symengine/constants.h>
+#include <symengine/functions.h>
+#include <symengine/integer.h>
+#include <symengine/mul.h>
+#include <symengine/pow.h>
+#include <symengine/real_double.h>
+#include <symengine/symbol.h>
+
+// std
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <utility>
+
+namespace mathboard {
+
+namespace {
+
+using ExpressionRef = SymEngine::RCP<const SymEngine::Basic>;
+using UnaryFunction = ExpressionRef (*)(const ExpressionRef &);
+
+struct NamedFunction {
+  std::string_view name;
+  UnaryFunction function;
+};
+
+// Functions the sanitizer and SymEngine's parser know by name
+const NamedFunction kFunctions[] = {
+    {"sin", [](const ExpressionRef &x) { return SymEngine::sin(x); }},
+    {"cos", [](const ExpressionRef &x) { return SymEngine::cos(x); }},
+    {"tan", [](const ExpressionRef &x) { return SymEngine::tan(x); }},
+    {"asin", [](const ExpressionRef &x) { return SymEngine::asin(x); }},
+    {"acos", [](const ExpressionRef &x) { return SymEngine::acos(x); }},
+    {"atan", [](const ExpressionRef &x) { return SymEngine::atan(x); }},
+    {"sinh", [](const ExpressionRef &x) { return SymEngine::sinh(x); }},
+    {"cosh", [](const ExpressionRef &x) { return SymEngine::cosh(x); }},
+    {"tanh", [](const ExpressionRef &x) { return SymEngine::tanh(x); }},
+    {"exp", [](const ExpressionRef &x) { return SymEngine::exp(x); }},
+    {"log", [](const ExpressionRef &x) { return SymEngine::log(x); }},
+    {"sqrt", [](const ExpressionRef &x) { return SymEngine::sqrt(x); }},
+    {"abs", [](const ExpressionRef &x) { return SymEngine::abs(x); }}};
+
+// Multi-byte operators handwriting recognition produces
+const std::pair<std::string_view, TokenKind> kUnicodeOperators[] = {
+    {"\xC3\x97", TokenKind::Star},       // ×
+    {"\xC2\xB7", TokenKind::Star},       // ·
+    {"\xC3\xB7", TokenKind::Slash},      // ÷
+    {"\xE2\x88\x92", TokenKind::Minus}}; // −
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+bool IsLetter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Characters read as part of a number
+bool IsDigitLike(char c) {
+  return IsDigit(c) || c == '.' || c == 'O' || c == 'l';
+}
+
+UnaryFunction FindFunction(std::string_view name) {
+  for (const NamedFunction &function : kFunctions) {
+    if (function.name == name) {
+      return function.function;
+    }
+  }
+  return nullptr;
+}
+
+bool IsConstantName(std::string_view name) {
+  return name == "pi" || name == "E" || name == "I";
+}
+
+[[noreturn]] void Fail(const std::string &message, const Token &token) {
+  throw std::runtime_error("[ParseEquation] Error: " + message + " at \"" +
+                           std::string(token.text) + "\".");
+}
+
+// Recursive descent over the tokens, building the expression as it goes
+class Parser {
+public:
+  explicit Parser(std::string_view input) : m_Tokenizer(input) { Advance(); }
+
+  ExpressionRef ParseEquation() {
+    // `=5` reads as `0=5`, like the sanitizer's `-(5)`
+    ExpressionRef result = m_Token.kind == TokenKind::Equals
+                               ? ExpressionRef(SymEngine::zero)
+                               : ParseSum();
+    if (m_Token.kind == TokenKind::Equals) {
+      Advance();
+      result = SymEngine::sub(result, ParseSum());
+    }
+
+    if (m_Token.kind == TokenKind::RightParen) {
+      Fail("Mismatched parentheses", m_Token);
+    }
+    if (m_Token.kind != TokenKind::End) {
+      Fail("Unexpected token", m_Token);
+    }
+    return result;
+  }
+
+private:
+  void Advance() { m_Token = m_Tokenizer.Next(); }
+
+  ExpressionRef ParseSum() {
+    ExpressionRef result = ParseProduct();
+    while (m_Token.kind == TokenKind::Plus ||
+           m_Token.kind == TokenKind::Minus) {
+      const TokenKind op = m_Token.kind;
+      Advance();
+      const ExpressionRef rhs = ParseProduct();
+      result = op == TokenKind::Plus ? SymEngine::add(result, rhs)
+                                     : SymEngine::sub(result, rhs);
+    }
+    return result;
+  }
+
+  ExpressionRef ParseProduct() {
+    ExpressionRef result = ParseUnary();
+    while (true) {
+      if (m_Token.kind == TokenKind::Star) {
+        Advance();
+        result = SymEngine::mul(result, ParseUnary());
+      } else if (m_Token.kind == TokenKind::Slash) {
+        Advance();
+        result = SymEngine::div(result, ParseUnary());
+      } else if (m_Token.kind == TokenKind::Number ||
+                 m_Token.kind == TokenKind::Identifier ||
+                 m_Token.kind == TokenKind::LeftParen) {
+        // Implicit multiplication, the factor can't have a sign
+        result = SymEngine::mul(result, ParsePower());
+      } else {
+        return result;
+      }
+    }
+  }
+
+  ExpressionRef ParseUnary() {
+    if (m_Token.kind == TokenKind::Minus) {
+      Advance();
+      return SymEngine::neg(ParseUnary());
+    }
+    if (m_Token.kind == TokenKind::Plus) {
+      Advance();
+      return ParseUnary();
+    }
+    return ParsePower();
+  }
+
+  ExpressionRef ParsePower() {
+    const ExpressionRef base = ParsePrimary();
+    if (m_Token.kind != TokenKind::Power) {
+      return base;
+    }
+    Advance();
+    // Right associative, 2**3**2 is 2**9
+    return SymEngine::pow(base, ParseUnary());
+  }
+
+  ExpressionRef ParsePrimary() {
+    const Token token = m_Token;
+    switch (token.kind) {
+    case TokenKind::Number:
+      Advance();
+      return ParseNumber(token);
+    case TokenKind::Identifier:
+      Advance();
+      return ParseIdentifier(token);
+    case TokenKind::LeftParen: {
+      Advance();
+      ExpressionRef inner = ParseSum();
+      ExpectRightParen(token);
+      return inner;
+    }
+    case TokenKind::End:
+      Fail("Unexpected end of the equation", token);
+    default:
+      Fail("Unexpected token", token);
+    }
+  }
+
+  ExpressionRef ParseNumber(const Token &token) {
+    m_Scratch.clear();
+    NormalizeNumber(token.text, m_Scratch);
+
+    if (m_Scratch.find('.') == std::string::npos) {
+      return SymEngine::integer(SymEngine::integer_class(m_Scratch));
+    }
+
+    double value = 0.0;
+    const char *end = m_Scratch.data() + m_Scratch.size();
+    const auto [ptr, error] = std::from_chars(m_Scratch.data(), end, value);
+    if (error != std::errc{} || ptr != end) {
+      Fail("Malformed number", token);
+    }
+    return SymEngine::real_double(value);
+  }
+
+  ExpressionRef ParseIdentifier(const Token &token) {
+    if (const UnaryFunction function = FindFunction(token.text)) {
+      const Token paren = m_Token;
+      if (paren.kind != TokenKind::LeftParen) {
+        Fail("Missing argument of function", token);
+      }
+      Advance();
+      ExpressionRef argument = ParseSum();
+      ExpectRightParen(paren);
+      return function(argument);
+    }
+
+    if (token.text == "pi") {
+      return SymEngine::pi;
+    }
+    if (token.text == "E") {
+      return SymEngine::E;
+    }
+    if (token.text == "I") {
+      return SymEngine::I;
+    }
+
+    // Unknown names followed by a parenthesis are multiplied, see
+    // ParseProduct, there are no user defined functions on a board
+    m_Scratch.clear();
+    NormalizeIdentifier(token.text, m_Scratch);
+    return SymEngine::symbol(m_Scratch);
+  }
+
+  void ExpectRightParen(const Token &open) {
+    if (m_Token.kind != TokenKind::RightParen) {
+      Fail("Mismatched parentheses", open);
+    }
+    Advance();
+  }
+
+private:
+  EquationTokenizer m_Tokenizer;
+  Token m_Token{};
+  // Normalized text of the current number or symbol
+  std::string m_Scratch{};
+};
+
+} // namespace
+
+Token EquationTokenizer::Next() {
+  const std::size_t size = m_Input.size();
+  while (m_Position < size) {
+    const std::size_t start = m_Position;
+    const char c = m_Input[start];
+
+    if (IsDigit(c) || c == '.') {
+      // Letters continue the number only when they're all O or l, `1O` is
+      // 10 but `2log(X)` is 2 times log
+      std::size_t end = start;
+      while (end < size) {
+        if (IsDigit(m_Input[end]) || m_Input[end] == '.') {
+          end++;
+          continue;
+        }
+        std::size_t runEnd = end;
+        while (runEnd < size &&
+               (IsLetter(m_Input[runEnd]) || IsDigit(m_Input[runEnd]))) {
+          runEnd++;
+        }
+        if (runEnd == end ||
+            !std::all_of(m_Input.begin() + end, m_Input.begin() + runEnd,
+                         IsDigitLike)) {
+          break;
+        }
+        end = runEnd;
+      }
+      m_Position = end;
+      return Token{TokenKind::Number, m_Input.substr(start, end - start)};
+    }
+
+    if (IsLetter(c)) {
+      std::size_t end = start;
+      while (end < size && (IsLetter(m_Input[end]) || IsDigit(m_Input[end]))) {
+        end++;
+      }
+      m_Position = end;
+      const std::string_view text = m_Input.substr(start, end - start);
+      // `l`, `O`, `lO`, ... are misread digits
+      const bool isNumber = std::all_of(text.begin(), text.end(), IsDigitLike);
+      return Token{isNumber ? TokenKind::Number : TokenKind::Identifier, text};
+    }
+
+    m_Position++;
+    switch (c) {
+    case '+':
+      return Token{TokenKind::Plus, m_Input.substr(start, 1)};
+    case '-':
+      return Token{TokenKind::Minus, m_Input.substr(start, 1)};
+    case '*':
+      if (m_Position < size && m_Input[m_Position] == '*') {
+        m_Position++;
+        return Token{TokenKind::Power, m_Input.substr(start, 2)};
+      }
+      return Token{TokenKind::Star, m_Input.substr(start, 1)};
+    case '/':
+      return Token{TokenKind::Slash, m_Input.substr(start, 1)};
+    case '^':
+      return Token{TokenKind::Power, m_Input.substr(start, 1)};
+    case '(':
+      return Token{TokenKind::LeftParen, m_Input.substr(start, 1)};
+    case ')':
+      return Token{TokenKind::RightParen, m_Input.substr(start, 1)};
+    case '=':
+      return Token{TokenKind::Equals, m_Input.substr(start, 1)};
+    default:
+      break;
+    }
+
+    for (const auto &[text, kind] : kUnicodeOperators) {
+      if (m_Input.substr(start).starts_with(text)) {
+        m_Position = start + text.size();
+        return Token{kind, m_Input.substr(start, text.size())};
+      }
+    }
+    // Anything else is noise, skipped like whitespace
+  }
+
+  return Token{TokenKind::End, m_Input.substr(size)};
+}
+
+void NormalizeNumber(std::string_view text, std::string &output) {
+  for (const char c : text) {
+    output += c == 'O' ? '0' : c == 'l' ? '1' : c;
+  }
+}
+
+void NormalizeIdentifier(std::string_view text, std::string &output) {
+  if (IsFunctionName(text) || IsConstantName(text)) {
+    output += text;
+    return;
+  }
+  for (const char c : text) {
+    output += c == 'x' ? 'X' : c;
+  }
+}
+
+bool IsFunctionName(std::string_view name) {
+  return FindFunction(name) != nullptr;
+}
+
+SymEngine::RCP<const SymEngine::Basic> ParseEquation(std::string_view input) {
+  return Parser(input).ParseEquation();
+}
+
+} // namespace mathboard
@@ -0,0 +1,68 @@
+#pragma once
+
+// libs
+// symengine
+#include <symengine/basic.h>
+
+// std
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace mathboard {
+
+enum class TokenKind {
+  End,
+  Number,
+  Identifier,
+  Plus,
+  Minus,
+  Star,
+  Slash,
+  // `**` or `^`
+  Power,
+  LeftParen,
+  RightParen,
+  Equals
+};
+
+struct Token {
+  TokenKind kind{TokenKind::End};
+  // Characters of the token in the input, before normalization
+  std::string_view text{};
+};
+
+// Single pass tokenizer of OCR output. Tokens are views into the input, the
+// tokenizer never allocates. Characters that can't be part of an equation
+// are skipped, `×`, `·`, `÷` and `−` are read as the ASCII operators. OCR
+// confusions are resolved when the tokens are read, see NormalizeNumber and
+// NormalizeIdentifier.
+class EquationTokenizer {
+public:
+  explicit EquationTokenizer(std::string_view input) : m_Input(input) {}
+
+  // Return the next token, TokenKind::End once the input is exhausted
+  Token Next();
+
+private:
+  std::string_view m_Input;
+  std::size_t m_Position{0};
+};
+
+// Append digits of a number token to `output`, `O` read as 0 and `l` as 1
+void NormalizeNumber(std::string_view text, std::string &output);
+
+// Append an identifier token to `output`, `x` read as the X symbol. Function
+// and constant names (`exp`, `log`, `pi`, ...) are kept as they are.
+void NormalizeIdentifier(std::string_view text, std::string &output);
+
+// Whether the identifier names a function, e.g. `sin`
+bool IsFunctionName(std::string_view name);
+
+// Build the expression of raw OCR output or of a sanitized equation straight
+// from its tokens. `lhs = rhs` becomes `lhs - (rhs)`. Implicit
+// multiplication (`2X`, `2(X+1)`, `(X+1)(X-1)`) is supported. Throws
+// std::runtime_error on malformed equations.
+SymEngine::RCP<const SymEngine::Basic> ParseEquation(std::string_view input);
+
+} // namespace mathboard
@@ -1,48 +1,343 @@
 // header
 #include "equation_solver.hpp"
 
+// local
+#include "concurrency/thread_pool.hpp"
+#include "equation_parser.hpp"
+#include "metrics/metrics.hpp"
+#include "lru_cache.hpp"
+#include "numeric_solver.hpp"
+#include "symengine_lock.hpp"
+#include "tracing/tracer.hpp"
+
 // libs
 // symengine
+#include <symengine/add.h>
+#include <symengine/eval_double.h>
 #include <symengine/expression.h>
-#include <symengine/parser.h>
+#include <symengine/mul.h>
+#include <symengine/pow.h>
 #include <symengine/solve.h>
+#include <symengine/symengine_config.h>
+#include <symengine/visitor.h>
 // spdlog
 #include <spdlog/spdlog.h>
 
+// std
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <future>
+#include <optional>
+#include <thread>
+
 namespace mathboard {
 
-// Function to sanitize and validate the OCR output
-std::string EquationSolver::SanitizeEquation(const std::string &rawEquation) {
-  std::string sanitized;
-  for (const char c : rawEquation) {
-    if (std::isalnum(c) ||
-        std::string("+-*/=().").find(c) != std::string::npos) {
-      sanitized += c;
+namespace {
+
+using Solutions = std::unordered_map<std::string, std::vector<Root>>;
+
+// Highest polynomial degree handed to the symbolic solver, above it there's
+// no closed form and SymEngine can take arbitrarily long
+constexpr unsigned kMaxSymbolicDegree = 4;
+
+// Default number of cached equations
+constexpr std::size_t kDefaultCacheCapacity = 1024;
+
+// Symbolic solves running on their own threads, timed out ones included.
+// SymEngine can't be interrupted, past the limit equations go straight to
+// the numeric solver instead of piling up more threads.
+std::atomic<unsigned> symbolicSolveThreads{0};
+
+unsigned MaxSymbolicSolveThreads() {
+  static const unsigned limit =
+      std::max(2U, std::thread::hardware_concurrency());
+  return limit;
+}
+
+// Parsed equations, keyed by the equation string
+LruCache<std::string, SymEngine::Expression> &ExpressionCache() {
+  static LruCache<std::string, SymEngine::Expression> cache{
+      kDefaultCacheCapacity};
+  return cache;
+}
+
+// Solutions, keyed by the equation (or its normal form) and the symbols
+LruCache<std::string, Solutions> &SolutionCache() {
+  static LruCache<std::string, Solutions> cache{kDefaultCacheCapacity};
+  return cache;
+}
+
+// Whether to look up solutions by the normal form of the equation too
+std::atomic<bool> normalizeEquations{true};
+
+std::string SolutionKey(const std::string &equation,
+                        const std::vector<std::string> &symbols) {
+  std::string key = equation;
+  for (const auto &symbol : symbols) {
+    // Neither can appear in a sanitized equation nor in a symbol name
+    key += '|';
+    key += symbol;
+  }
+  return key;
+}
+
+// Parse the equation or take it from the cache, SymEngine has to be locked
+SymEngine::Expression ParseCached(const std::string &equation) {
+  if (std::optional<SymEngine::Expression> cached =
+          ExpressionCache().Get(equation)) {
+    return std::move(*cached);
+  }
+
+  SymEngine::Expression expr(ParseEquation(equation));
+  ExpressionCache().Put(equation, expr);
+  return expr;
+}
+
+// Canonical form of the expression, trivially equivalent equations map to
+// the same string
+std::string NormalForm(const SymEngine::Expression &expr) {
+  return SymEngine::expand(expr.get_basic())->__str__();
+}
+
+// Degree of `expr` as a polynomial in `symbol`, std::nullopt if it isn't a
+// polynomial in it (e.g. division by or a function of the symbol)
+std::optional<unsigned> PolynomialDegree(const SymEngine::Basic &expr,
+                                         const SymEngine::Symbol &symbol) {
+  if (!SymEngine::has_symbol(expr, symbol)) {
+    return 0U;
+  }
+  if (SymEngine::is_a<SymEngine::Symbol>(expr)) {
+    return 1U;
+  }
+  if (SymEngine::is_a<SymEngine::Add>(expr) ||
+      SymEngine::is_a<SymEngine::Mul>(expr)) {
+    const bool isAdd = SymEngine::is_a<SymEngine::Add>(expr);
+    unsigned degree = 0;
+    for (const auto &arg : expr.get_args()) {
+      const std::optional<unsigned> argDegree = PolynomialDegree(*arg, symbol);
+      if (!argDegree) {
+        return std::nullopt;
+      }
+      degree = isAdd ? std::max(degree, *argDegree) : degree + *argDegree;
+    }
+    return degree;
+  }
+  if (SymEngine::is_a<SymEngine::Pow>(expr)) {
+    const auto &pow = SymEngine::down_cast<const SymEngine::Pow &>(expr);
+    const auto &exponent = *pow.get_exp();
+    if (!SymEngine::is_a<SymEngine::Integer>(exponent) ||
+        SymEngine::has_symbol(exponent, symbol)) {
+      return std::nullopt;
+    }
+    const auto &integer =
+        SymEngine::down_cast<const SymEngine::Integer &>(exponent);
+    if (!integer.is_positive()) {
+      return std::nullopt;
     }
+    const std::optional<unsigned> baseDegree =
+        PolynomialDegree(*pow.get_base(), symbol);
+    if (!baseDegree) {
+      return std::nullopt;
+    }
+    return *baseDegree * static_cast<unsigned>(integer.as_int());
   }
+  return std::nullopt;
+}
 
-  // Remove any excess whitespace
-  sanitized.erase(std::remove_if(sanitized.begin(), sanitized.end(), ::isspace),
-                  sanitized.end());
+// Run SymEngine's solve, giving up at `deadline`. SymEngine can't be
+// interrupted, so a timed out solve keeps running detached, which is only
+// safe when SymEngine's reference counting is thread safe. Otherwise it runs
+// inline and relies on PolynomialDegree keeping it short.
+std::optional<SymEngine::RCP<const SymEngine::Set>>
+SolveSymbolic(const SymEngine::RCP<const SymEngine::Basic> &expr,
+              const SymEngine::RCP<const SymEngine::Symbol> &symbol,
+              std::chrono::steady_clock::time_point deadline) {
+#ifdef WITH_SYMENGINE_THREAD_SAFE
+  if (symbolicSolveThreads.fetch_add(1, std::memory_order_relaxed) >=
+      MaxSymbolicSolveThreads()) {
+    symbolicSolveThreads.fetch_sub(1, std::memory_order_relaxed);
+    spdlog::warn("[SolveSymbolic]: Too many symbolic solves still running.\n");
+    return std::nullopt;
+  }
 
-  if (sanitized.empty()) {
-    spdlog::error("[SanitizeEquation]: Sanitized equation is empty.\n");
+  auto promise =
+      std::make_shared<std::promise<SymEngine::RCP<const SymEngine::Set>>>();
+  auto future = promise->get_future();
+  std::thread([promise, expr, symbol]() {
+    try {
+      promise->set_value(SymEngine::solve(expr, symbol));
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+    symbolicSolveThreads.fetch_sub(1, std::memory_order_relaxed);
+  }).detach();
+
+  if (future.wait_until(deadline) != std::future_status::ready) {
+    spdlog::warn("[SolveSymbolic]: Symbolic solve ran out of time.\n");
+    return std::nullopt;
+  }
+#endif
+
+  try {
+#ifdef WITH_SYMENGINE_THREAD_SAFE
+    return future.get();
+#else
+    (void)deadline;
+    return SymEngine::solve(expr, symbol);
+#endif
+  } catch (const std::exception &e) {
+    spdlog::warn("[SolveSymbolic]: Symbolic solve failed: {}\n", e.what());
+    return std::nullopt;
+  }
+}
+
+// Convert symbolic solutions into real numbers. Return false if some of them
+// aren't numbers at all (other symbols, condition sets, ...), in which case
+// the numeric solver has to take over. Complex roots are dropped.
+bool ConvertSymbolicRoots(const SymEngine::Set &solutions,
+                          std::vector<Root> &roots) {
+  if (!SymEngine::is_a<SymEngine::FiniteSet>(solutions)) {
+    return false;
+  }
+
+  for (const auto &sol : solutions.get_args()) {
+    if (!SymEngine::free_symbols(*sol).empty()) {
+      return false;
+    }
+
+    try {
+      roots.push_back(
+          Root{SymEngine::eval_double(*sol), SolveMethod::Symbolic});
+    } catch (const std::exception &) {
+      try {
+        const std::complex<double> value =
+            SymEngine::eval_complex_double(*sol);
+        // Complex only due to rounding
+        if (std::abs(value.imag()) <=
+            1e-12 * std::max(1.0, std::abs(value))) {
+          roots.push_back(Root{value.real(), SolveMethod::Symbolic});
+        }
+      } catch (const std::exception &) {
+        return false;
+      }
+    }
   }
+  return true;
+}
+
+} // namespace
 
-  // Transform equation to set it equal to zero
-  size_t equalPos = sanitized.find('=');
-  if (equalPos != std::string::npos) {
-    std::string left = sanitized.substr(0, equalPos);
-    std::string right = sanitized.substr(equalPos + 1);
-    sanitized = left + "-(" + right + ")";
+// Function to sanitize and validate the OCR output
+std::string EquationSolver::SanitizeEquation(const std::string &rawEquation) {
+  std::string sanitized;
+  sanitized.reserve(rawEquation.size() + 3);
+
+  // Single pass over the tokens, emitting the normalized ones
+  EquationTokenizer tokenizer(rawEquation);
+  int openParentheses = 0;
+  bool hasEquals = false;
+  // Whether the previous token ends an operand, e.g. `2` or `)`
+  bool afterOperand = false;
+  // Whether the previous token is a function name, which needs its argument
+  // in parentheses
+  bool afterFunction = false;
+  for (Token token = tokenizer.Next(); token.kind != TokenKind::End;
+       token = tokenizer.Next()) {
+    if (afterFunction && token.kind != TokenKind::LeftParen) {
+      // `sin X` would run together into the symbol `sinX`
+      spdlog::error("[SanitizeEquation]: Missing parentheses around the "
+                    "argument of a function.\n");
+      return {};
+    }
+    const bool startsOperand = token.kind == TokenKind::Number ||
+                               token.kind == TokenKind::Identifier ||
+                               token.kind == TokenKind::LeftParen;
+    // Make implicit multiplication explicit
+    if (afterOperand && startsOperand) {
+      sanitized += '*';
+    }
+    afterOperand = false;
+    afterFunction = false;
+
+    switch (token.kind) {
+    case TokenKind::Number:
+      NormalizeNumber(token.text, sanitized);
+      afterOperand = true;
+      break;
+    case TokenKind::Identifier:
+      NormalizeIdentifier(token.text, sanitized);
+      // Function names are followed by their argument
+      afterFunction = IsFunctionName(token.text);
+      afterOperand = !afterFunction;
+      break;
+    case TokenKind::Plus:
+      sanitized += '+';
+      break;
+    case TokenKind::Minus:
+      sanitized += '-';
+      break;
+    case TokenKind::Star:
+      sanitized += '*';
+      break;
+    case TokenKind::Slash:
+      sanitized += '/';
+      break;
+    case TokenKind::Power:
+      sanitized += "**";
+      break;
+    case TokenKind::LeftParen:
+      openParentheses++;
+      sanitized += '(';
+      break;
+    case TokenKind::RightParen:
+      if (openParentheses == 0) {
+        spdlog::error(
+            "[SanitizeEquation]: Mismatched parentheses in the equation.\n");
+        return {};
+      }
+      openParentheses--;
+      sanitized += ')';
+      afterOperand = true;
+      break;
+    case TokenKind::Equals:
+      // Transform equation to set it equal to zero
+      if (hasEquals) {
+        spdlog::error("[SanitizeEquation]: More than one = in the "
+                      "equation.\n");
+        return {};
+      }
+      if (openParentheses != 0) {
+        spdlog::error(
+            "[SanitizeEquation]: Mismatched parentheses in the equation.\n");
+        return {};
+      }
+      hasEquals = true;
+      sanitized += "-(";
+      break;
+    case TokenKind::End:
+      break;
+    }
   }
 
+  if (afterFunction) {
+    spdlog::error("[SanitizeEquation]: Missing argument of a function.\n");
+    return {};
+  }
   // Validate parentheses
-  int openParentheses = std::count(sanitized.begin(), sanitized.end(), '(');
-  int closeParentheses = std::count(sanitized.begin(), sanitized.end(), ')');
-  if (openParentheses != closeParentheses) {
+  if (openParentheses != 0) {
     spdlog::error(
         "[SanitizeEquation]: Mismatched parentheses in the equation.\n");
+    return {};
+  }
+
+  if (sanitized.empty()) {
+    spdlog::error("[SanitizeEquation]: Sanitized equation is empty.\n");
+  }
+
+  if (hasEquals) {
+    sanitized += ')';
   }
 
   return sanitized;
@@ -52,24 +347,212 @@ std::string EquationSolver::SanitizeEquation(const std::string &rawEquation) {
 std::unordered_map<std::string, std::vector<double>>
 EquationSolver::SolveFor(const std::string &equation,
                          const std::vector<std::string> &symbols) {
+  std::unordered_map<std::string, std::vector<double>> results;
+  for (const auto &[symbol, roots] :
+       SolveFor(equation, symbols, kDefaultSolveBudget)) {
+    auto &values = results[symbol];
+    for (const Root &root : roots) {
+      values.push_back(root.value);
+    }
+  }
+  return results;
+}
+
+std::unordered_map<std::string, std::vector<Root>>
+EquationSolver::SolveFor(const std::string &equation,
+                         const std::vector<std::string> &symbols,
+                         std::chrono::milliseconds budget) {
+  return SolveFor(equation, symbols,
+                  SolveBudget{budget / 2, budget - budget / 2});
+}
+
+std::unordered_map<std::string, std::vector<Root>>
+EquationSolver::SolveFor(const std::string &equation,
+                         const std::vector<std::string> &symbols,
+                         SolveBudget budget) {
+  MATHBOARD_TRACE_SCOPE("EquationSolver::SolveFor");
+  const StageTimer stageTimer(Stage::Solve);
+
+  const std::string key = SolutionKey(equation, symbols);
+  if (std::optional<Solutions> cached = SolutionCache().Get(key)) {
+    return std::move(*cached);
+  }
+
+  // Cached expressions are SymEngine objects too
+  const std::unique_lock<std::mutex> lockSymEngine = LockSymEngine();
+
   // Parse the equation into a symbolic expression
-  SymEngine::Expression expr = SymEngine::parse(equation);
+  const SymEngine::Expression expr = ParseCached(equation);
+
+  // Equivalent equation may already be solved
+  std::string normalKey;
+  if (normalizeEquations.load(std::memory_order_relaxed)) {
+    normalKey = SolutionKey(NormalForm(expr), symbols);
+    if (std::optional<Solutions> cached = SolutionCache().Get(normalKey)) {
+      SolutionCache().Put(key, *cached);
+      return std::move(*cached);
+    }
+  }
 
   // Store the results in a map of symbol to solutions relation
-  std::unordered_map<std::string, std::vector<double>> results;
+  Solutions results;
+
+  // Solutions cut short by the budget aren't cached
+  bool complete = true;
+
+  const auto isCancelled = [&budget]() {
+    return budget.cancelled &&
+           budget.cancelled->load(std::memory_order_relaxed);
+  };
 
   // Solve for symbol
   for (const auto &symbol : symbols) {
-    SymEngine::RCP<const SymEngine::Set> solutions =
-        solve(expr, SymEngine::symbol(symbol));
+    if (isCancelled()) {
+      complete = false;
+      break;
+    }
+
+    const SymEngine::RCP<const SymEngine::Symbol> sym =
+        SymEngine::symbol(symbol);
+    std::vector<Root> &roots = results[symbol];
+
+    const std::optional<unsigned> degree =
+        PolynomialDegree(*expr.get_basic(), *sym);
+    if (degree && *degree <= kMaxSymbolicDegree) {
+      const auto symbolicDeadline =
+          std::chrono::steady_clock::now() + budget.symbolic;
+      const std::optional<SymEngine::RCP<const SymEngine::Set>> solutions =
+          SolveSymbolic(expr.get_basic(), sym, symbolicDeadline);
+      if (solutions && ConvertSymbolicRoots(**solutions, roots)) {
+        continue;
+      }
+      roots.clear();
+      // Timed out, an exact solution may still exist, don't cache the
+      // numeric one
+      complete = complete && solutions.has_value();
+    }
 
-    // Convert solutions to strings
-    for (const auto &sol : solutions->get_args()) {
-      results[symbol].push_back(std::stod(sol->__str__()));
+    // Deadline of its own, the symbolic solve may have used up its slice
+    const auto numericDeadline =
+        std::chrono::steady_clock::now() + budget.numeric;
+    for (const double value : FindRealRoots(expr.get_basic(), sym,
+                                            numericDeadline, 1000.0,
+                                            budget.cancelled)) {
+      roots.push_back(Root{value, SolveMethod::Numeric});
+    }
+    complete = complete && !isCancelled() &&
+               std::chrono::steady_clock::now() < numericDeadline;
+  }
+
+  if (complete) {
+    SolutionCache().Put(key, results);
+    if (!normalKey.empty() && normalKey != key) {
+      SolutionCache().Put(normalKey, results);
     }
   }
 
   return results;
 }
 
+std::vector<std::string>
+EquationSolver::FindSymbols(const std::string &equation) {
+  const std::unique_lock<std::mutex> lockSymEngine = LockSymEngine();
+
+  std::vector<std::string> symbols;
+  for (const auto &symbol :
+       SymEngine::free_symbols(*ParseCached(equation).get_basic())) {
+    symbols.push_back(symbol->__str__());
+  }
+  std::sort(symbols.begin(), symbols.end());
+  return symbols;
+}
+
+std::shared_ptr<SolveBatchHandle>
+EquationSolver::SolveBatch(const std::vector<std::string> &equations,
+                           std::function<void(BatchResult &&)> on_result,
+                           std::chrono::milliseconds budget) {
+  return SolveBatch(equations, std::move(on_result), budget,
+                    ThreadPool::Shared());
+}
+
+std::shared_ptr<SolveBatchHandle>
+EquationSolver::SolveBatch(const std::vector<std::string> &equations,
+                           std::function<void(BatchResult &&)> on_result,
+                           std::chrono::milliseconds budget,
+                           ThreadPool &pool) {
+  auto handle = std::make_shared<SolveBatchHandle>(equations.size());
+  auto callback = std::make_shared<std::function<void(BatchResult &&)>>(
+      std::move(on_result));
+
+  for (std::size_t i = 0; i < equations.size(); i++) {
+    pool.Submit([handle, callback, budget, index = i,
+                 equation = equations[i]]() {
+      if (handle->IsCancelled()) {
+        handle->FinishOne();
+        return;
+      }
+
+      BatchResult result{index, equation, {}, {}, {}};
+      try {
+        result.symbols = FindSymbols(equation);
+        result.roots =
+            SolveFor(equation, result.symbols,
+                     SolveBudget{budget / 2, budget - budget / 2,
+                                 &handle->m_Cancelled});
+      } catch (const std::exception &e) {
+        result.error = e.what();
+      }
+
+      {
+        std::lock_guard<std::mutex> lockCallback(handle->m_MutexCallback);
+        if (!handle->IsCancelled() && *callback) {
+          (*callback)(std::move(result));
+        }
+      }
+      handle->FinishOne();
+    });
+  }
+
+  return handle;
+}
+
+void SolveBatchHandle::Wait() {
+  std::unique_lock<std::mutex> lockRemaining(m_MutexRemaining);
+  m_Finished.wait(lockRemaining, [this]() { return m_Remaining == 0; });
+}
+
+bool SolveBatchHandle::IsDone() const {
+  std::lock_guard<std::mutex> lockRemaining(m_MutexRemaining);
+  return m_Remaining == 0;
+}
+
+void SolveBatchHandle::FinishOne() {
+  {
+    std::lock_guard<std::mutex> lockRemaining(m_MutexRemaining);
+    m_Remaining--;
+  }
+  m_Finished.notify_all();
+}
+
+void EquationSolver::ConfigureCache(std::size_t capacity, bool normalize) {
+  // Shrinking destroys cached expressions
+  const std::unique_lock<std::mutex> lockSymEngine = LockSymEngine();
+  ExpressionCache().SetCapacity(capacity);
+  SolutionCache().SetCapacity(capacity);
+  normalizeEquations.store(normalize, std::memory_order_relaxed);
+}
+
+void EquationSolver::ClearCache() {
+  const std::unique_lock<std::mutex> lockSymEngine = LockSymEngine();
+  ExpressionCache().Clear();
+  SolutionCache().Clear();
+}
+
+EquationSolver::CacheStats EquationSolver::GetCacheStats() {
+  const auto expressionStats = ExpressionCache().GetStats();
+  const auto solutionStats = SolutionCache().GetStats();
+  return CacheStats{expressionStats.hits, expressionStats.misses,
+                    solutionStats.hits, solutionStats.misses};
+}
+
 } // namespace mathboard
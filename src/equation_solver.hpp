@@ -1,21 +1,162 @@
 #pragma once
 
 // std
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace mathboard {
 
+class ThreadPool;
+
+// Default time budget of a single SolveFor call
+constexpr std::chrono::milliseconds kDefaultSolveBudget{250};
+
+// How SolveFor spends its time per symbol
+struct SolveBudget {
+  // Symbolic solving, abandoned when it runs out
+  std::chrono::milliseconds symbolic{kDefaultSolveBudget / 2};
+  // Numeric root finding, counted from when it starts, so a symbolic solve
+  // that timed out still leaves it the whole slice
+  std::chrono::milliseconds numeric{kDefaultSolveBudget / 2};
+  // Once set the numeric search stops and the remaining symbols are
+  // skipped, see SolveBatchHandle::Cancel
+  const std::atomic<bool> *cancelled{nullptr};
+};
+
+// How a root was found
+enum class SolveMethod {
+  // Exact solution from SymEngine
+  Symbolic,
+  // Sampling, bisection and Newton's method
+  Numeric
+};
+
+struct Root {
+  double value{0.0};
+  SolveMethod method{SolveMethod::Symbolic};
+};
+
+// Result of one equation of a batch
+struct BatchResult {
+  // Position of the equation in the batch
+  std::size_t index{0};
+  std::string equation{};
+  // Free symbols found in the equation, the equation is solved for each
+  std::vector<std::string> symbols{};
+  std::unordered_map<std::string, std::vector<Root>> roots{};
+  // Set when the equation couldn't be parsed or solved
+  std::string error{};
+};
+
+// Handle of a running SolveBatch
+class SolveBatchHandle {
+public:
+  explicit SolveBatchHandle(std::size_t equation_count)
+      : m_Remaining(equation_count) {}
+
+  // Skip equations which didn't start yet, cut the numeric search of the
+  // running ones short and drop their results. Use it when the board changed
+  // and the batch is outdated.
+  void Cancel() { m_Cancelled.store(true, std::memory_order_relaxed); }
+
+  bool IsCancelled() const {
+    return m_Cancelled.load(std::memory_order_relaxed);
+  }
+
+  // Wait until every equation is solved or skipped
+  void Wait();
+
+  bool IsDone() const;
+
+private:
+  friend class EquationSolver;
+
+  // Called by the solver once an equation is finished
+  void FinishOne();
+
+private:
+  std::atomic<bool> m_Cancelled{false};
+  std::size_t m_Remaining{0};
+  mutable std::mutex m_MutexRemaining{};
+  std::condition_variable m_Finished{};
+  // Results are delivered one at a time
+  std::mutex m_MutexCallback{};
+};
+
 class EquationSolver {
 public:
+  // Hit and miss counts of the parse and solution caches
+  struct CacheStats {
+    std::uint64_t expression_hits{0};
+    std::uint64_t expression_misses{0};
+    std::uint64_t solution_hits{0};
+    std::uint64_t solution_misses{0};
+  };
+
   // Function to sanitize and validate the OCR output
+  // Single pass over the EquationTokenizer tokens: noise is dropped, OCR
+  // confusions normalized, implicit multiplication made explicit and
+  // `lhs=rhs` turned into `lhs-(rhs)`. The result parses with ParseEquation.
+  // Equations ParseEquation rejects for their structure, with more than one
+  // `=`, mismatched parentheses or a function name without a parenthesized
+  // argument, sanitize to an empty string.
   static std::string SanitizeEquation(const std::string &rawEquation);
 
   // Function to solve the equation
+  // Parsed expressions and solutions are cached, solving an equation seen
+  // recently with the same symbols doesn't call SymEngine at all.
   static std::unordered_map<std::string, std::vector<double>>
   SolveFor(const std::string &equation,
            const std::vector<std::string> &symbols);
+
+  // Solve the equation within `budget` per symbol, half of it for the
+  // symbolic solve and half for the numeric one. Symbolic solving is only
+  // tried for polynomials of degree up to 4, everything else, and symbolic
+  // solving that times out or yields non-numeric roots, falls back to finding
+  // real roots numerically. Complex roots are dropped.
+  static std::unordered_map<std::string, std::vector<Root>>
+  SolveFor(const std::string &equation,
+           const std::vector<std::string> &symbols,
+           std::chrono::milliseconds budget);
+
+  static std::unordered_map<std::string, std::vector<Root>>
+  SolveFor(const std::string &equation,
+           const std::vector<std::string> &symbols, SolveBudget budget);
+
+  // Names of the free symbols of the sanitized equation, sorted
+  static std::vector<std::string> FindSymbols(const std::string &equation);
+
+  // Solve independent equations in parallel on `pool`, each for all of its
+  // free symbols. `on_result` receives every result as soon as it's ready,
+  // never concurrently and never after the batch was cancelled.
+  static std::shared_ptr<SolveBatchHandle>
+  SolveBatch(const std::vector<std::string> &equations,
+             std::function<void(BatchResult &&)> on_result,
+             std::chrono::milliseconds budget = kDefaultSolveBudget);
+
+  static std::shared_ptr<SolveBatchHandle>
+  SolveBatch(const std::vector<std::string> &equations,
+             std::function<void(BatchResult &&)> on_result,
+             std::chrono::milliseconds budget, ThreadPool &pool);
+
+  // Set the number of cached equations. With `normalize` enabled, equations
+  // that expand to the same expression (e.g. `2*X=4` and `X*2-4`) share one
+  // cached solution.
+  static void ConfigureCache(std::size_t capacity, bool normalize);
+
+  // Drop every cached expression and solution
+  static void ClearCache();
+
+  static CacheStats GetCacheStats();
 };
 
 } // namespace mathboard
@@ -7,6 +7,8 @@
 #include <spdlog/spdlog.h>
 
 // std
+#include <algorithm>
+#include <cmath>
 #include <list>
 #include <vector>
 
@@ -55,40 +57,54 @@ public:
 
   // Insert object to grid.
   void Insert(T *object) {
-    const Position2f pos =
-        Position2f{object->GetPosition().x, object->GetPosition().y};
-    Position2f object_min = pos;
-    const BoundingBox bounding_box =
-        BoundingBox{object->GetWidth(), object->GetHeight()};
-    Position2f object_max =
-        Position2f{pos.x + bounding_box.width, pos.y + bounding_box.height};
-
-    // calculating position of vertices in grid
-    // decrese width and height because containers are 0 index based
-    int body_min_x = static_cast<int>(
-        std::floor((object_min.x - m_TopLeftCorner.x) / m_CellSize.width));
-    body_min_x = std::clamp(body_min_x, 0, static_cast<int>(m_Columns - 1));
-
-    int body_max_x = static_cast<int>(
-        std::floor((object_max.x - m_TopLeftCorner.x) / m_CellSize.width));
-    body_max_x = std::clamp(body_max_x, 0, static_cast<int>(m_Columns - 1));
-
-    int body_min_y = static_cast<int>(
-        std::floor((object_min.y - m_TopLeftCorner.y) / m_CellSize.height));
-    body_min_y = std::clamp(body_min_y, 0, static_cast<int>(m_Rows - 1));
-
-    int body_max_y = static_cast<int>(
-        std::floor((object_max.y - m_TopLeftCorner.y)) / m_CellSize.height);
-    body_max_y = std::clamp(body_max_y, 0, static_cast<int>(m_Rows - 1));
-
-    for (std::ptrdiff_t x = body_min_x; x <= body_max_x; x++) {
-      for (std::ptrdiff_t y = body_min_y; y <= body_max_y; y++) {
+    const CellRange cells = GetCellRange(*object);
+    for (std::ptrdiff_t x = cells.min_x; x <= cells.max_x; x++) {
+      for (std::ptrdiff_t y = cells.min_y; y <= cells.max_y; y++) {
         m_Grid[x + m_Columns * y].push_back(object);
       }
     }
     m_Size++;
   }
 
+  // Remove object from grid. It has to be at the position and of the size it
+  // was inserted with, move an object by removing and inserting it again.
+  void Remove(T *object) {
+    const CellRange cells = GetCellRange(*object);
+    bool removed = false;
+    for (std::ptrdiff_t x = cells.min_x; x <= cells.max_x; x++) {
+      for (std::ptrdiff_t y = cells.min_y; y <= cells.max_y; y++) {
+        std::vector<T *> &cell = m_Grid[x + m_Columns * y];
+        const auto it = std::find(cell.begin(), cell.end(), object);
+        if (it != cell.end()) {
+          cell.erase(it);
+          removed = true;
+        }
+      }
+    }
+    if (removed) {
+      m_Size--;
+    }
+  }
+
+  // Returns objects sharing a grid cell with object, without object itself.
+  // Object doesn't have to be inside grid.
+  std::vector<T *> GetNeighbors(const T *object) const {
+    const CellRange cells = GetCellRange(*object);
+    std::vector<T *> neighbors;
+    for (std::ptrdiff_t x = cells.min_x; x <= cells.max_x; x++) {
+      for (std::ptrdiff_t y = cells.min_y; y <= cells.max_y; y++) {
+        for (T *element : m_Grid[x + m_Columns * y]) {
+          if (element != object && std::find(neighbors.begin(),
+                                             neighbors.end(),
+                                             element) == neighbors.end()) {
+            neighbors.push_back(element);
+          }
+        }
+      }
+    }
+    return neighbors;
+  }
+
   // Returns list of pairs of objects inside the same grid cell.
   std::list<std::pair<T *, T *>> GetIntersections() const {
     std::unordered_multimap<T *, T *> checked_pairs;
@@ -134,6 +150,44 @@ public:
   }
 
 private:
+  // Cells covered by an object, inclusive
+  struct CellRange {
+    int min_x;
+    int max_x;
+    int min_y;
+    int max_y;
+  };
+
+  CellRange GetCellRange(const T &object) const {
+    const Position2f pos =
+        Position2f{object.GetPosition().x, object.GetPosition().y};
+    Position2f object_min = pos;
+    const BoundingBox bounding_box =
+        BoundingBox{object.GetWidth(), object.GetHeight()};
+    Position2f object_max =
+        Position2f{pos.x + bounding_box.width, pos.y + bounding_box.height};
+
+    // calculating position of vertices in grid
+    // decrese width and height because containers are 0 index based
+    int body_min_x = static_cast<int>(
+        std::floor((object_min.x - m_TopLeftCorner.x) / m_CellSize.width));
+    body_min_x = std::clamp(body_min_x, 0, static_cast<int>(m_Columns - 1));
+
+    int body_max_x = static_cast<int>(
+        std::floor((object_max.x - m_TopLeftCorner.x) / m_CellSize.width));
+    body_max_x = std::clamp(body_max_x, 0, static_cast<int>(m_Columns - 1));
+
+    int body_min_y = static_cast<int>(
+        std::floor((object_min.y - m_TopLeftCorner.y) / m_CellSize.height));
+    body_min_y = std::clamp(body_min_y, 0, static_cast<int>(m_Rows - 1));
+
+    int body_max_y = static_cast<int>(
+        std::floor((object_max.y - m_TopLeftCorner.y) / m_CellSize.height));
+    body_max_y = std::clamp(body_max_y, 0, static_cast<int>(m_Rows - 1));
+
+    return CellRange{body_min_x, body_max_x, body_min_y, body_max_y};
+  }
+
   // Checks if a pair of objects has already been checked for intersection.
   bool HasBeenChecked(std::unordered_multimap<T *, T *> &checked_pairs,
                       std::pair<T *, T *> pair) const {
@@ -39,13 +39,12 @@ bool runUnixSocket() {
       server->Read(client_fd, buffer);
 
       if (buffer.size() > 0) {
-        std::string message = std::string(buffer.begin(), buffer.end());
-
-        spdlog::info("[runUnixSocket] - Data received from the client: {}\n",
-                     message);
+        // Only the size, the payload can be megabytes of stroke data
+        SPDLOG_DEBUG("[runUnixSocket] - Received {} bytes from the client.\n",
+                     buffer.size());
 
         if (server->WriteString(client_fd, "Data received on the CPP!")) {
-          spdlog::info("[runUnixSocket] - Response send.\n");
+          SPDLOG_DEBUG("[runUnixSocket] - Response send.\n");
 
         } else {
           spdlog::error(
@@ -4,13 +4,16 @@
 #include "../equation_solver.hpp"
 #include "../image_processing.hpp"
 #include "../opencv_helper.hpp"
+#include "../system_solver.hpp"
 
 // libs
 // spdlog
 #include <spdlog/spdlog.h>
 
 // std
+#include <sstream>
 #include <string>
+#include <vector>
 
 namespace mathboard {
 
@@ -25,19 +28,63 @@ void solveImage(const std::string &imagePath) {
 
   // Step 2: Recognize text (equation) using OCR
   std::string rawEquation = RecognizeText(processedImage);
-  spdlog::info("[solveImage]: Raw OCR Output: {}\n", rawEquation);
+  SPDLOG_DEBUG("[solveImage]: Raw OCR Output: {}\n", rawEquation);
 
   std::cout << "Raw OCR Output: " << rawEquation << std::endl;
 
+  // A board with several lines holds a system of equations
+  std::vector<std::string> lines;
+  std::istringstream rawLines(rawEquation);
+  for (std::string line; std::getline(rawLines, line);) {
+    if (line.find('=') == std::string::npos) {
+      continue;
+    }
+    if (std::string sanitized = EquationSolver::SanitizeEquation(line);
+        !sanitized.empty()) {
+      lines.push_back(std::move(sanitized));
+    }
+  }
+  if (lines.size() > 1) {
+    for (const SystemSolution &system : SolveSystems(lines)) {
+      if (system.values.empty()) {
+        spdlog::info("[solveImage]: No solution for system of {} equations "
+                     "(residual {}) in {} us\n",
+                     system.equations.size(), system.residual,
+                     system.solve_time.count());
+        continue;
+      }
+      for (std::size_t i = 0; i < system.symbols.size(); i++) {
+        spdlog::info("[solveImage]: {} = {}\n", system.symbols[i],
+                     system.values[i]);
+      }
+      if (system.kind == SystemKind::Linear && !system.unique) {
+        spdlog::info("[solveImage]: System of rank {} in {} unknowns has "
+                     "infinitely many solutions, showing the smallest\n",
+                     system.rank, system.symbols.size());
+      }
+      spdlog::info("[solveImage]: System of {} equations solved in {} us\n",
+                   system.equations.size(), system.solve_time.count());
+    }
+    return;
+  }
+
   // Step 3: Sanitize the OCR output
   std::string sanitizedEquation = EquationSolver::SanitizeEquation(rawEquation);
-  spdlog::info("[solveImage]: Sanitized equation: {}\n", sanitizedEquation);
+  SPDLOG_DEBUG("[solveImage]: Sanitized equation: {}\n", sanitizedEquation);
 
-  // Step 4: Solve the equation
-  const std::string symbol = "X";
+  // Step 4: Solve the equation for each of its symbols
+  const std::vector<std::string> symbols =
+      EquationSolver::FindSymbols(sanitizedEquation);
   std::unordered_map<std::string, std::vector<double>> solutions =
-      EquationSolver::SolveFor(sanitizedEquation, {symbol});
-  spdlog::info("Solutions: {}\n", solutions.at(symbol)[0]);
+      EquationSolver::SolveFor(sanitizedEquation, symbols);
+  for (const std::string &symbol : symbols) {
+    if (solutions[symbol].empty()) {
+      spdlog::info("[solveImage]: No solutions for {}\n", symbol);
+      continue;
+    }
+    spdlog::info("[solveImage]: Solutions for {}: {}\n", symbol,
+                 solutions[symbol][0]);
+  }
 }
 
 } // namespace mathboard
\ No newline at end of file
@@ -1,9 +1,12 @@
 // local
 #include "image_processing.hpp"
+#include "metrics/metrics.hpp"
+#include "tracing/tracer.hpp"
 
 // libs
 // opencv
 #include <opencv2/core/mat.hpp>
+#include <opencv2/core/utility.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/videoio.hpp>
 // spdlog
@@ -11,6 +14,10 @@
 // tesseract
 #include <tesseract/baseapi.h>
 
+// std
+#include <algorithm>
+#include <cmath>
+
 namespace mathboard {
 
 cv::Mat RasterizeImage(const std::filesystem::path &filename) {
@@ -49,18 +56,155 @@ cv::Mat CropImageToSymbol(const cv::Mat &input_mat) {
 }
 
 cv::Mat GrayScaleImage(const cv::Mat &input_mat) {
+  MATHBOARD_TRACE_SCOPE("GrayScaleImage");
+  const StageTimer stageTimer(Stage::GrayScale);
   cv::Mat greyImg;
   cv::cvtColor(input_mat, greyImg, cv::COLOR_BGR2GRAY);
   return greyImg;
 }
 
-cv::Mat BinarizeImage(const cv::Mat &input_mat) {
+std::optional<BinarizationMethod>
+ParseBinarizationMethod(std::string_view name) {
+  if (name == "global") {
+    return BinarizationMethod::Global;
+  }
+  if (name == "otsu") {
+    return BinarizationMethod::Otsu;
+  }
+  if (name == "sauvola") {
+    return BinarizationMethod::Sauvola;
+  }
+  return std::nullopt;
+}
+
+cv::Mat BinarizeImage(const cv::Mat &input_mat, BinarizationMethod method) {
+  MATHBOARD_TRACE_SCOPE("BinarizeImage");
+  const StageTimer stageTimer(Stage::Binarize);
   cv::Mat binarizedImg;
-  cv::threshold(input_mat, binarizedImg, 128, 255, cv::THRESH_BINARY);
+  switch (method) {
+  case BinarizationMethod::Global:
+    cv::threshold(input_mat, binarizedImg, 128, 255, cv::THRESH_BINARY);
+    break;
+  case BinarizationMethod::Otsu:
+    cv::threshold(input_mat, binarizedImg, 0, 255,
+                  cv::THRESH_BINARY | cv::THRESH_OTSU);
+    break;
+  case BinarizationMethod::Sauvola:
+    binarizedImg = SauvolaBinarize(input_mat);
+    break;
+  }
+  return binarizedImg;
+}
+
+cv::Mat BinarizeBoard(const cv::Mat &input_mat, BinarizationMethod method) {
+  cv::Mat binarizedImg = BinarizeImage(GrayScaleImage(input_mat), method);
+
+  // Boards are mostly background, invert dark-on-light images so strokes are
+  // the non-zero pixels
+  if (cv::countNonZero(binarizedImg) >
+      static_cast<int>(binarizedImg.total() / 2)) {
+    cv::bitwise_not(binarizedImg, binarizedImg);
+  }
   return binarizedImg;
 }
 
+cv::Mat SauvolaBinarize(const cv::Mat &input_mat, int window_size, double k) {
+  if (input_mat.empty() || input_mat.type() != CV_8UC1) {
+    spdlog::error("[SauvolaBinarize]: input_mat isn't 8-bit grayscale.\n");
+    return {};
+  }
+
+  // Tiles plus their halo fit into L2 cache together with their integrals
+  constexpr int kTileSize = 128;
+  // Dynamic range of the standard deviation for 8-bit images
+  constexpr double kDynamicRange = 128.0;
+
+  const int radius = std::max(1, window_size / 2);
+  const cv::Rect image_rect(0, 0, input_mat.cols, input_mat.rows);
+  const int tiles_x = (input_mat.cols + kTileSize - 1) / kTileSize;
+  const int tiles_y = (input_mat.rows + kTileSize - 1) / kTileSize;
+
+  cv::Mat output(input_mat.size(), CV_8UC1);
+
+  const auto binarize_tiles = [&](const cv::Range &range) {
+    // Integrals of the tile with its halo, reused by the following tiles.
+    // Sums of a halo'd tile fit into int, squares don't.
+    thread_local cv::Mat sum;
+    thread_local cv::Mat sqsum;
+
+    for (int t = range.start; t < range.end; t++) {
+      const cv::Rect tile = cv::Rect((t % tiles_x) * kTileSize,
+                                     (t / tiles_x) * kTileSize, kTileSize,
+                                     kTileSize) &
+                            image_rect;
+      const cv::Rect region =
+          cv::Rect(tile.x - radius, tile.y - radius, tile.width + 2 * radius,
+                   tile.height + 2 * radius) &
+          image_rect;
+
+      cv::integral(input_mat(region), sum, sqsum, CV_32S, CV_64F);
+
+      // Columns of the tile whose window doesn't cross the region border,
+      // in region coordinates
+      const int tile_begin = tile.x - region.x;
+      const int tile_end = tile_begin + tile.width;
+      const int inner_begin = std::clamp(radius, tile_begin, tile_end);
+      const int inner_end =
+          std::clamp(region.width - radius, inner_begin, tile_end);
+
+      for (int y = tile.y; y < tile.y + tile.height; y++) {
+        // Window rows, row i of an integral image sums rows [0, i)
+        const int y0 = std::max(y - radius, region.y) - region.y;
+        const int y1 =
+            std::min(y + radius + 1, region.y + region.height) - region.y;
+
+        const int *sum0 = sum.ptr<int>(y0);
+        const int *sum1 = sum.ptr<int>(y1);
+        const double *sqsum0 = sqsum.ptr<double>(y0);
+        const double *sqsum1 = sqsum.ptr<double>(y1);
+        const uchar *src = input_mat.ptr<uchar>(y) + region.x;
+        uchar *dst = output.ptr<uchar>(y) + region.x;
+
+        const auto threshold_pixel = [&](int x, int x0, int x1) {
+          const double area = static_cast<double>((y1 - y0) * (x1 - x0));
+          const double mean =
+              (sum1[x1] - sum1[x0] - sum0[x1] + sum0[x0]) / area;
+          const double variance =
+              (sqsum1[x1] - sqsum1[x0] - sqsum0[x1] + sqsum0[x0]) / area -
+              mean * mean;
+          const double deviation = std::sqrt(std::max(variance, 0.0));
+          const double threshold =
+              mean * (1.0 + k * (deviation / kDynamicRange - 1.0));
+          dst[x] = src[x] > threshold ? 255 : 0;
+        };
+
+        // Windows clipped by the image border
+        for (int x = tile_begin; x < inner_begin; x++) {
+          threshold_pixel(x, std::max(x - radius, 0),
+                          std::min(x + radius + 1, region.width));
+        }
+
+        // Full windows, fixed offsets and area so the loop vectorizes
+        for (int x = inner_begin; x < inner_end; x++) {
+          threshold_pixel(x, x - radius, x + radius + 1);
+        }
+
+        for (int x = inner_end; x < tile_end; x++) {
+          threshold_pixel(x, std::max(x - radius, 0),
+                          std::min(x + radius + 1, region.width));
+        }
+      }
+    }
+  };
+
+  cv::parallel_for_(cv::Range(0, tiles_x * tiles_y), binarize_tiles);
+
+  return output;
+}
+
 std::string RecognizeText(const cv::Mat &img) {
+  MATHBOARD_TRACE_SCOPE("RecognizeText");
+  const StageTimer stageTimer(Stage::RecognizeText);
   tesseract::TessBaseAPI ocr;
   if (ocr.Init(nullptr, "eng", tesseract::OEM_LSTM_ONLY)) {
     spdlog::error("[RecognizeText]: Could not initialize Tesseract.\n");
@@ -81,4 +225,58 @@ std::string RecognizeText(const cv::Mat &img) {
   return text;
 }
 
+std::vector<Stroke> SegmentBoard(const cv::Mat &binary_mat,
+                                 int min_pixel_count) {
+  MATHBOARD_TRACE_SCOPE("SegmentBoard");
+  const StageTimer stageTimer(Stage::Segment);
+
+  if (binary_mat.empty() || binary_mat.channels() != 1) {
+    spdlog::error("[SegmentBoard]: binary_mat is empty or isn't binary.\n");
+    return {};
+  }
+
+  // Labelling runs the parallel variant of the algorithm when OpenCV has
+  // more than one thread available
+  cv::Mat labels;
+  cv::Mat stats;
+  cv::Mat centroids;
+  const int label_count = cv::connectedComponentsWithStats(
+      binary_mat, labels, stats, centroids, 8, CV_32S, cv::CCL_DEFAULT);
+
+  // Label 0 is the background
+  std::vector<int> kept_labels;
+  std::vector<cv::Rect> bounding_boxes;
+  kept_labels.reserve(label_count);
+  bounding_boxes.reserve(label_count);
+  for (int label = 1; label < label_count; label++) {
+    if (stats.at<int>(label, cv::CC_STAT_AREA) < min_pixel_count) {
+      continue;
+    }
+
+    kept_labels.push_back(label);
+    bounding_boxes.emplace_back(stats.at<int>(label, cv::CC_STAT_LEFT),
+                                stats.at<int>(label, cv::CC_STAT_TOP),
+                                stats.at<int>(label, cv::CC_STAT_WIDTH),
+                                stats.at<int>(label, cv::CC_STAT_HEIGHT));
+  }
+
+  // Build strokes from the masks of their components in parallel
+  MATHBOARD_TRACE_CAPTURE_CONTEXT(traceContext);
+  std::vector<Stroke> strokes(kept_labels.size());
+  cv::parallel_for_(
+      cv::Range(0, static_cast<int>(kept_labels.size())),
+      [&](const cv::Range &range) {
+        MATHBOARD_TRACE_CONTEXT(traceContext);
+        for (int i = range.start; i < range.end; i++) {
+          const cv::Rect &bounding_box = bounding_boxes[i];
+          // Only the component's own pixels, neighbours overlapping its
+          // bounding box are masked out
+          const cv::Mat mask = labels(bounding_box) == kept_labels[i];
+          strokes[i] = Stroke(i, cv::Point2f(bounding_box.tl()), mask);
+        }
+      });
+
+  return strokes;
+}
+
 } // namespace mathboard
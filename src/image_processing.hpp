@@ -1,9 +1,16 @@
+#pragma once
+
 // local
 #include "grid.hpp"
+#include "metrics/metrics.hpp"
 #include "stroke.hpp"
+#include "tracing/tracer.hpp"
 
 // std
 #include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
 
 namespace mathboard {
 
@@ -18,18 +25,56 @@ cv::Mat CropImageToSymbol(const cv::Mat &input_mat);
 // Return grascaled version of input image
 cv::Mat GrayScaleImage(const cv::Mat &input_mat);
 
+// How BinarizeImage picks the threshold
+enum class BinarizationMethod {
+  // Fixed global threshold of 128
+  Global,
+  // Global threshold picked by Otsu's method
+  Otsu,
+  // Local Sauvola threshold, handles uneven lighting of photographed boards
+  Sauvola
+};
+
+// Return method with the given name ("global", "otsu", "sauvola")
+std::optional<BinarizationMethod>
+ParseBinarizationMethod(std::string_view name);
+
+// `input_mat` has to be grayscale
 // Return image binarized using threshold.
-cv::Mat BinarizeImage(const cv::Mat &input_mat);
+cv::Mat BinarizeImage(const cv::Mat &input_mat,
+                      BinarizationMethod method = BinarizationMethod::Global);
+
+// Turn color image of a board into binary image with strokes as non-zero
+// pixels, ready for SegmentBoard
+cv::Mat BinarizeBoard(const cv::Mat &input_mat,
+                      BinarizationMethod method = BinarizationMethod::Global);
+
+// `input_mat` has to be grayscale
+// Sauvola binarization with window of `window_size` pixels, threshold is
+// mean * (1 + k * (deviation / 128 - 1)) of the window. Mean and deviation come
+// from integral images computed per tile, tiles are processed in parallel.
+cv::Mat SauvolaBinarize(const cv::Mat &input_mat, int window_size = 31,
+                        double k = 0.2);
 
 // Returns image string
 std::string RecognizeText(const cv::Mat &img);
 
+// `binary_mat` has to be binarized with strokes as non-zero pixels
+// split the whole board into strokes, one per 8-connected component, placed
+// at the top left corner of their component
+// components smaller than `min_pixel_count` are dropped as noise
+std::vector<Stroke> SegmentBoard(const cv::Mat &binary_mat,
+                                 int min_pixel_count = 4);
+
 // returns instance of Grid class with all images put on
 // their positions ready to further interpreatation
 // it sets grid cell size and boundaries of it
 // automaticaly
 Grid<mathboard::Stroke> inline PlaceOnGrid(
-    std::vector<mathboard::Stroke> &strokes) {
+    std::span<mathboard::Stroke> strokes) {
+  MATHBOARD_TRACE_SCOPE("PlaceOnGrid");
+  const StageTimer stageTimer(Stage::PlaceOnGrid);
+
   // calculate boundaries of grid
   cv::Point2f bot_right_corner{0, 0};
   cv::Point2f top_left_corner{INFINITY, INFINITY};
@@ -0,0 +1,168 @@
+// header
+#include "json_writer.hpp"
+
+// std
+#include <cassert>
+#include <charconv>
+#include <cmath>
+
+namespace mathboard {
+
+void JsonWriter::Clear() {
+  m_Buffer.clear();
+  m_HasValue.clear();
+  m_AfterKey = false;
+}
+
+std::string JsonWriter::Take() {
+  std::string message = std::move(m_Buffer);
+  m_Buffer = std::string();
+  m_Buffer.reserve(message.size());
+  Clear();
+  return message;
+}
+
+JsonWriter &JsonWriter::BeginObject() {
+  BeforeValue();
+  m_Buffer.push_back('{');
+  m_HasValue.push_back(false);
+  return *this;
+}
+
+JsonWriter &JsonWriter::EndObject() {
+  assert(!m_HasValue.empty() && "EndObject() without BeginObject()");
+  m_HasValue.pop_back();
+  m_Buffer.push_back('}');
+  return *this;
+}
+
+JsonWriter &JsonWriter::BeginArray() {
+  BeforeValue();
+  m_Buffer.push_back('[');
+  m_HasValue.push_back(false);
+  return *this;
+}
+
+JsonWriter &JsonWriter::EndArray() {
+  assert(!m_HasValue.empty() && "EndArray() without BeginArray()");
+  m_HasValue.pop_back();
+  m_Buffer.push_back(']');
+  return *this;
+}
+
+JsonWriter &JsonWriter::Key(std::string_view key) {
+  BeforeValue();
+  AppendEscaped(key);
+  m_Buffer.push_back(':');
+  m_AfterKey = true;
+  return *this;
+}
+
+JsonWriter &JsonWriter::String(std::string_view value) {
+  BeforeValue();
+  AppendEscaped(value);
+  return *this;
+}
+
+JsonWriter &JsonWriter::Int(std::int64_t value) {
+  BeforeValue();
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  m_Buffer.append(digits, result.ptr);
+  return *this;
+}
+
+JsonWriter &JsonWriter::UInt(std::uint64_t value) {
+  BeforeValue();
+  char digits[24];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  m_Buffer.append(digits, result.ptr);
+  return *this;
+}
+
+JsonWriter &JsonWriter::Double(double value) {
+  if (!std::isfinite(value)) {
+    return Null();
+  }
+  BeforeValue();
+  char digits[32];
+  const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  m_Buffer.append(digits, result.ptr);
+  return *this;
+}
+
+JsonWriter &JsonWriter::Bool(bool value) {
+  BeforeValue();
+  m_Buffer.append(value ? "true" : "false");
+  return *this;
+}
+
+JsonWriter &JsonWriter::Null() {
+  BeforeValue();
+  m_Buffer.append("null");
+  return *this;
+}
+
+JsonWriter &JsonWriter::Raw(std::string_view json) {
+  BeforeValue();
+  m_Buffer.append(json);
+  return *this;
+}
+
+void JsonWriter::BeforeValue() {
+  if (m_AfterKey) {
+    m_AfterKey = false;
+    return;
+  }
+  if (m_HasValue.empty()) {
+    return;
+  }
+  if (m_HasValue.back()) {
+    m_Buffer.push_back(',');
+  }
+  m_HasValue.back() = true;
+}
+
+void JsonWriter::AppendEscaped(std::string_view text) {
+  constexpr char kHex[] = "0123456789abcdef";
+
+  m_Buffer.push_back('"');
+  // Copy the runs without anything to escape in one go
+  std::size_t run = 0;
+  for (std::size_t i = 0; i < text.size(); i++) {
+    const unsigned char byte = static_cast<unsigned char>(text[i]);
+    if (byte >= 0x20 && byte != '"' && byte != '\\') {
+      continue;
+    }
+    m_Buffer.append(text.data() + run, i - run);
+    run = i + 1;
+
+    m_Buffer.push_back('\\');
+    switch (byte) {
+    case '"':
+      m_Buffer.push_back('"');
+      break;
+    case '\\':
+      m_Buffer.push_back('\\');
+      break;
+    case '\n':
+      m_Buffer.push_back('n');
+      break;
+    case '\r':
+      m_Buffer.push_back('r');
+      break;
+    case '\t':
+      m_Buffer.push_back('t');
+      break;
+    default:
+      m_Buffer.append("u00");
+      m_Buffer.push_back(kHex[byte >> 4]);
+      m_Buffer.push_back(kHex[byte & 0xf]);
+      break;
+    }
+  }
+  m_Buffer.append(text.data() + run, text.size() - run);
+  m_Buffer.push_back('"');
+}
+
+} // namespace mathboard
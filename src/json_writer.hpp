@@ -0,0 +1,61 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mathboard {
+
+// Writes JSON text straight into a buffer kept from one message to the next,
+// instead of building a nlohmann::json tree and dumping it. Values go in the
+// order they're written and the writer places the commas:
+//   writer.BeginObject().Key("status").String("ok").EndObject();
+// Keep one per thread and Clear() it for every message, the buffer keeps its
+// capacity so a warm writer doesn't allocate.
+class JsonWriter {
+public:
+  void Clear();
+
+  JsonWriter &BeginObject();
+  JsonWriter &EndObject();
+  JsonWriter &BeginArray();
+  JsonWriter &EndArray();
+
+  // Key of the next value, inside an object
+  JsonWriter &Key(std::string_view key);
+
+  JsonWriter &String(std::string_view value);
+  JsonWriter &Int(std::int64_t value);
+  JsonWriter &UInt(std::uint64_t value);
+  // Shortest form reading back the same double, null when not finite
+  JsonWriter &Double(double value);
+  JsonWriter &Bool(bool value);
+  JsonWriter &Null();
+  // Value already serialized as JSON
+  JsonWriter &Raw(std::string_view json);
+
+  // Valid until the writer is changed
+  std::string_view View() const { return m_Buffer; }
+
+  // Move the message out and Clear(). The next message gets a buffer with
+  // room for one of the same size, handing a message over costs the
+  // allocation a copy would but no copying.
+  std::string Take();
+
+private:
+  // Comma before every value but the first of its object or array
+  void BeforeValue();
+  void AppendEscaped(std::string_view text);
+
+private:
+  std::string m_Buffer{};
+  // Whether the open objects and arrays have a value yet, innermost last
+  std::vector<bool> m_HasValue{};
+  // A key was just written, its value needs no comma
+  bool m_AfterKey{false};
+};
+
+} // namespace mathboard
@@ -0,0 +1,107 @@
+// header
+#include "live_strokes.hpp"
+
+namespace mathboard {
+
+const Stroke *LiveStrokes::Append(std::int64_t board_id,
+                                  std::uint32_t stroke_id,
+                                  std::span<const cv::Point> points) {
+  const auto speculation = m_Speculations.find(board_id);
+  if (speculation != m_Speculations.end()) {
+    speculation->second->Cancel();
+    m_Speculations.erase(speculation);
+  }
+
+  auto it = m_Strokes.find({board_id, stroke_id});
+  // Vectors growing might take more for a while, close enough
+  std::size_t needed = points.size() * sizeof(cv::Point);
+  if (it == m_Strokes.end()) {
+    needed += sizeof(Stroke);
+  }
+  if (m_Memory + needed > m_MaxMemory) {
+    return nullptr;
+  }
+
+  if (it == m_Strokes.end()) {
+    if (points.empty()) {
+      return nullptr;
+    }
+    // Positioned at its first point
+    const cv::Point2f position(static_cast<float>(points.front().x),
+                               static_cast<float>(points.front().y));
+    it = m_Strokes
+             .emplace(std::make_pair(board_id, stroke_id),
+                      LiveStroke{Stroke(static_cast<int>(stroke_id), position),
+                                 0, {}})
+             .first;
+    m_Memory += it->second.stroke.GetMemoryUsage();
+  }
+
+  LiveStroke &live = it->second;
+  if (live.point_count + points.size() > kMaxPoints) {
+    return nullptr;
+  }
+
+  const cv::Point2f position = live.stroke.GetPosition();
+  const cv::Point origin(static_cast<int>(position.x),
+                         static_cast<int>(position.y));
+  m_Relative.clear();
+  for (const cv::Point &point : points) {
+    m_Relative.emplace_back(point.x - origin.x, point.y - origin.y);
+  }
+  const std::size_t memoryBefore = live.stroke.GetMemoryUsage();
+  live.stroke.AppendPoints(m_Relative);
+  m_Memory += live.stroke.GetMemoryUsage() - memoryBefore;
+  live.point_count += points.size();
+  live.last_points = std::chrono::steady_clock::now();
+  return &live.stroke;
+}
+
+std::optional<Stroke> LiveStrokes::Finish(std::int64_t board_id,
+                                          std::uint32_t stroke_id) {
+  const auto it = m_Strokes.find({board_id, stroke_id});
+  if (it == m_Strokes.end()) {
+    return std::nullopt;
+  }
+  m_Memory -= it->second.stroke.GetMemoryUsage();
+  std::optional<Stroke> stroke(std::move(it->second.stroke));
+  m_Strokes.erase(it);
+  // Drawn up or left of its first point, the points were relative to it
+  stroke->MoveOriginToBoundingBox();
+  return stroke;
+}
+
+std::shared_ptr<Speculation> LiveStrokes::Speculate(std::int64_t board_id) {
+  std::shared_ptr<Speculation> &speculation = m_Speculations[board_id];
+  if (speculation) {
+    speculation->Cancel();
+  }
+  speculation = std::make_shared<Speculation>();
+  return speculation;
+}
+
+std::size_t
+LiveStrokes::EvictIdle(std::chrono::steady_clock::time_point now,
+                       std::chrono::steady_clock::duration timeout) {
+  std::size_t evicted = 0;
+  for (auto it = m_Strokes.begin(); it != m_Strokes.end();) {
+    if (now - it->second.last_points > timeout) {
+      m_Memory -= it->second.stroke.GetMemoryUsage();
+      it = m_Strokes.erase(it);
+      evicted++;
+    } else {
+      ++it;
+    }
+  }
+  // Speculations nothing works on anymore
+  for (auto it = m_Speculations.begin(); it != m_Speculations.end();) {
+    if (it->second.use_count() == 1) {
+      it = m_Speculations.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return evicted;
+}
+
+} // namespace mathboard
@@ -0,0 +1,95 @@
+#pragma once
+
+// local
+#include "stroke.hpp"
+
+// libs
+// opencv
+#include <opencv2/core/types.hpp>
+
+// std
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+// Work started speculatively when the pen lifted, outdated as soon as new
+// points arrive on the board
+class Speculation {
+public:
+  // Skip what's left of the work, its result would be stale
+  void Cancel() { m_Cancelled.store(true, std::memory_order_relaxed); }
+
+  bool IsCancelled() const {
+    return m_Cancelled.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<bool> m_Cancelled{false};
+};
+
+// Strokes still being drawn, grown by the batches of points a client streams
+// while the pen moves, and the speculation of every board. Only used by the
+// thread reading the messages.
+class LiveStrokes {
+public:
+  // Longer strokes are refused
+  static constexpr std::size_t kMaxPoints = 64 * 1024;
+
+  // Points beyond `max_memory` bytes, all the unfinished strokes together,
+  // are refused
+  explicit LiveStrokes(std::size_t max_memory = 64 * 1024 * 1024)
+      : m_MaxMemory(max_memory) {}
+
+  // Append points in board pixels to the stroke, the first batch starts it.
+  // Cancels the speculation of the board. Returns nullptr when the stroke
+  // would get longer than kMaxPoints or the strokes over the memory limit.
+  const Stroke *Append(std::int64_t board_id, std::uint32_t stroke_id,
+                       std::span<const cv::Point> points);
+
+  // Take the stroke out once the pen lifted, nullopt when it got no points.
+  // Its position is the top-left corner of its bounding box, wherever the
+  // pen went from its first point.
+  std::optional<Stroke> Finish(std::int64_t board_id,
+                               std::uint32_t stroke_id);
+
+  // New speculation of the board, the previous one is cancelled
+  std::shared_ptr<Speculation> Speculate(std::int64_t board_id);
+
+  // Drop the strokes which got no points for `timeout`, left behind by
+  // clients disconnecting mid stroke. Returns how many.
+  std::size_t EvictIdle(std::chrono::steady_clock::time_point now,
+                        std::chrono::steady_clock::duration timeout);
+
+  std::size_t Size() const { return m_Strokes.size(); }
+
+  // Bytes held by the unfinished strokes
+  std::size_t GetMemoryUsage() const { return m_Memory; }
+
+private:
+  struct LiveStroke {
+    Stroke stroke{};
+    std::size_t point_count{0};
+    std::chrono::steady_clock::time_point last_points{};
+  };
+
+  const std::size_t m_MaxMemory;
+  std::size_t m_Memory{0};
+  // By board and stroke id
+  std::map<std::pair<std::int64_t, std::uint32_t>, LiveStroke> m_Strokes{};
+  std::unordered_map<std::int64_t, std::shared_ptr<Speculation>>
+      m_Speculations{};
+  // Points of the batch relative to the stroke, reused by every Append()
+  std::vector<cv::Point> m_Relative{};
+};
+
+} // namespace mathboard
@@ -0,0 +1,228 @@
+// header
+#include "async_sink.hpp"
+
+// libs
+// spdlog
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <utility>
+
+namespace mathboard {
+
+namespace {
+
+// Attempts at making room before DropOldest gives up on the new message,
+// other threads may keep filling the slot it freed
+constexpr int kDropOldestAttempts = 4;
+
+std::shared_ptr<AsyncSink> &GetInstalledSink() {
+  static std::shared_ptr<AsyncSink> sink{};
+  return sink;
+}
+
+} // namespace
+
+std::optional<LogOverflowPolicy> ParseLogOverflowPolicy(std::string_view name) {
+  if (name == "block") {
+    return LogOverflowPolicy::Block;
+  }
+  if (name == "drop-newest") {
+    return LogOverflowPolicy::DropNewest;
+  }
+  if (name == "drop-oldest") {
+    return LogOverflowPolicy::DropOldest;
+  }
+  return std::nullopt;
+}
+
+AsyncSink::AsyncSink(std::shared_ptr<spdlog::sinks::sink> backend,
+                     const AsyncLoggingOptions &options)
+    : m_Backend(std::move(backend)), m_OverflowPolicy(options.overflow_policy),
+      m_Queue(options.queue_size) {
+  m_Writer = std::thread(&AsyncSink::WriterLoop, this);
+}
+
+AsyncSink::~AsyncSink() {
+  m_Queue.Close();
+  {
+    // The writer either sees the queue closed or gets the notification
+    std::lock_guard<std::mutex> lockWake(m_MutexWriterWake);
+  }
+  m_WriterWake.notify_one();
+  if (m_Writer.joinable()) {
+    m_Writer.join();
+  }
+}
+
+void AsyncSink::log(const spdlog::details::log_msg &msg) {
+  Enqueue(Entry{spdlog::details::log_msg_buffer(msg), 0});
+}
+
+void AsyncSink::flush() {
+  // Logged by the backend itself, the writer can't wait for itself
+  if (std::this_thread::get_id() == m_Writer.get_id()) {
+    return;
+  }
+
+  std::uint64_t request = 0;
+  {
+    std::lock_guard<std::mutex> lockFlush(m_MutexFlush);
+    request = ++m_FlushRequests;
+  }
+  // Waits for space whatever the policy, the caller waits anyway
+  if (!m_Queue.Push(Entry{{}, request})) {
+    return;
+  }
+  WakeWriter();
+
+  std::unique_lock<std::mutex> lockFlush(m_MutexFlush);
+  m_FlushCompleted.wait(lockFlush, [this, request]() {
+    return m_FlushedRequest >= request || m_WriterStopped;
+  });
+}
+
+void AsyncSink::set_pattern(const std::string &pattern) {
+  m_Backend->set_pattern(pattern);
+}
+
+void AsyncSink::set_formatter(std::unique_ptr<spdlog::formatter> formatter) {
+  m_Backend->set_formatter(std::move(formatter));
+}
+
+void AsyncSink::Enqueue(Entry &&entry) {
+  switch (m_OverflowPolicy) {
+  case LogOverflowPolicy::Block:
+    if (!m_Queue.Push(std::move(entry))) {
+      m_Dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    break;
+  case LogOverflowPolicy::DropNewest:
+    if (!m_Queue.TryPush(std::move(entry))) {
+      m_Dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    break;
+  case LogOverflowPolicy::DropOldest: {
+    bool pushed = false;
+    for (int attempt = 0; attempt < kDropOldestAttempts; attempt++) {
+      pushed = m_Queue.TryPush(std::move(entry));
+      if (pushed) {
+        break;
+      }
+      Entry oldest;
+      if (!m_Queue.TryPop(oldest)) {
+        continue;
+      }
+      if (oldest.flush != 0) {
+        // A flush has its caller waiting, queue it again. Flushing later
+        // still writes out everything logged before it.
+        m_Queue.Push(std::move(oldest));
+      } else {
+        m_Dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if (!pushed) {
+      m_Dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    break;
+  }
+  }
+  WakeWriter();
+}
+
+void AsyncSink::WakeWriter() {
+  // Pairs with the fence in WaitForEntry, either the writer sees the pushed
+  // entry or this thread sees it waiting
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_WriterWaiting.load(std::memory_order_relaxed)) {
+    {
+      std::lock_guard<std::mutex> lockWake(m_MutexWriterWake);
+    }
+    m_WriterWake.notify_one();
+  }
+}
+
+bool AsyncSink::WaitForEntry(Entry &entry) {
+  while (!m_Queue.TryPop(entry)) {
+    if (m_Queue.IsClosed()) {
+      // Messages logged before Close() are still written
+      return m_Queue.Pop(entry);
+    }
+
+    std::unique_lock<std::mutex> lockWake(m_MutexWriterWake);
+    m_WriterWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // Pushed before the loggers could see the writer waiting
+    if (m_Queue.TryPop(entry)) {
+      m_WriterWaiting.store(false, std::memory_order_relaxed);
+      return true;
+    }
+    m_WriterWake.wait(lockWake, [this]() {
+      return m_Queue.SizeApprox() > 0 || m_Queue.IsClosed();
+    });
+    m_WriterWaiting.store(false, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+void AsyncSink::CompleteFlush(std::uint64_t flush) {
+  {
+    std::lock_guard<std::mutex> lockFlush(m_MutexFlush);
+    m_FlushedRequest = std::max(m_FlushedRequest, flush);
+  }
+  m_FlushCompleted.notify_all();
+}
+
+void AsyncSink::WriterLoop() {
+  Entry entry;
+  while (WaitForEntry(entry)) {
+    try {
+      if (entry.flush != 0) {
+        m_Backend->flush();
+      } else {
+        m_Backend->log(entry.msg);
+      }
+    } catch (const std::exception &e) {
+      // Nowhere left to log it, the writer keeps going
+      std::fprintf(stderr, "[AsyncSink::WriterLoop]: %s\n", e.what());
+    }
+    if (entry.flush != 0) {
+      CompleteFlush(entry.flush);
+    }
+  }
+  m_Backend->flush();
+
+  {
+    std::lock_guard<std::mutex> lockFlush(m_MutexFlush);
+    m_WriterStopped = true;
+  }
+  m_FlushCompleted.notify_all();
+}
+
+void InitAsyncLogging(const AsyncLoggingOptions &options) {
+  auto sink = std::make_shared<AsyncSink>(
+      std::make_shared<spdlog::sinks::stdout_color_sink_mt>(), options);
+  auto logger = std::make_shared<spdlog::logger>("mathboard", sink);
+  logger->set_level(
+      static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+  // Errors reach the terminal even if the daemon dies right after, flush()
+  // waits for the writer
+  logger->flush_on(spdlog::level::err);
+
+  spdlog::set_default_logger(logger);
+  GetInstalledSink() = sink;
+}
+
+std::uint64_t GetDroppedLogMessages() {
+  const std::shared_ptr<AsyncSink> &sink = GetInstalledSink();
+  return sink ? sink->GetDroppedCount() : 0;
+}
+
+} // namespace mathboard
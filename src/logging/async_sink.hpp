@@ -0,0 +1,119 @@
+#pragma once
+
+// local
+#include "../concurrency/bounded_queue.hpp"
+
+// libs
+// spdlog
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/sinks/sink.h>
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace mathboard {
+
+// What a logging thread does when the queue is full
+enum class LogOverflowPolicy {
+  // Wait for the writer, no message is lost but logging can stall a request
+  Block,
+  // Drop the message being logged
+  DropNewest,
+  // Drop the oldest queued message to make room, keeps the most recent ones
+  DropOldest
+};
+
+std::optional<LogOverflowPolicy> ParseLogOverflowPolicy(std::string_view name);
+
+struct AsyncLoggingOptions {
+  // Messages waiting for the writer, rounded up to a power of two
+  std::size_t queue_size{8192};
+  LogOverflowPolicy overflow_policy{LogOverflowPolicy::DropOldest};
+};
+
+// Sink handing the messages over to a writer thread through a lock-free
+// bounded queue, the logging thread only copies the message. Formatting and
+// the write to `backend` happen on the writer thread.
+class AsyncSink : public spdlog::sinks::sink {
+public:
+  AsyncSink(std::shared_ptr<spdlog::sinks::sink> backend,
+            const AsyncLoggingOptions &options = {});
+
+  // Writes out the queued messages, then joins the writer
+  ~AsyncSink() override;
+
+  AsyncSink(const AsyncSink &) = delete;
+  AsyncSink &operator=(const AsyncSink &) = delete;
+
+  void log(const spdlog::details::log_msg &msg) override;
+
+  // Wait until the writer wrote every message logged before and flushed the
+  // backend. Never dropped by the overflow policy.
+  void flush() override;
+
+  // Only meant to be called before logging starts, the writer thread uses
+  // the formatter without a lock
+  void set_pattern(const std::string &pattern) override;
+  void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override;
+
+  // Messages lost to the overflow policy
+  std::uint64_t GetDroppedCount() const {
+    return m_Dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Entry {
+    spdlog::details::log_msg_buffer msg{};
+    // Number of the flush request, 0 for messages
+    std::uint64_t flush{0};
+  };
+
+  void Enqueue(Entry &&entry);
+  // Wake the writer if it waits for messages
+  void WakeWriter();
+  // Wait for the next entry, false once the queue is closed and drained
+  bool WaitForEntry(Entry &entry);
+  void CompleteFlush(std::uint64_t flush);
+  void WriterLoop();
+
+private:
+  std::shared_ptr<spdlog::sinks::sink> m_Backend;
+  const LogOverflowPolicy m_OverflowPolicy;
+  BoundedQueue<Entry> m_Queue;
+  std::atomic<std::uint64_t> m_Dropped{0};
+
+  // The idle writer sleeps on m_WriterWake, loggers only take the mutex when
+  // it announced it in m_WriterWaiting
+  std::mutex m_MutexWriterWake{};
+  std::condition_variable m_WriterWake{};
+  std::atomic<bool> m_WriterWaiting{false};
+
+  // Flush requests numbered in order, the newest one written out wrote out
+  // every earlier one too
+  std::mutex m_MutexFlush{};
+  std::condition_variable m_FlushCompleted{};
+  std::uint64_t m_FlushRequests{0};
+  std::uint64_t m_FlushedRequest{0};
+  bool m_WriterStopped = false;
+
+  std::thread m_Writer;
+};
+
+// Replace the default logger with one writing to stdout through an
+// AsyncSink. The runtime level matches SPDLOG_ACTIVE_LEVEL, lower levels are
+// compiled out of the SPDLOG_* macros anyway.
+void InitAsyncLogging(const AsyncLoggingOptions &options = {});
+
+// Messages dropped by the sink installed by InitAsyncLogging, 0 without it
+std::uint64_t GetDroppedLogMessages();
+
+} // namespace mathboard
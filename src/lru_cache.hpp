@@ -0,0 +1,161 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+// Bounded least recently used cache safe to use from many threads. Keys are
+// spread over independently locked shards, each shard evicts its own least
+// recently used entry, so the recency order is only exact per shard.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+public:
+  struct Stats {
+    std::uint64_t hits{0};
+    std::uint64_t misses{0};
+    std::uint64_t evictions{0};
+  };
+
+  explicit LruCache(std::size_t capacity, std::size_t shard_count = 16)
+      : m_Shards(std::max<std::size_t>(1, std::min(shard_count, capacity))) {
+    SetCapacity(capacity);
+  }
+
+  // Return copy of the cached value and mark it as the most recently used
+  std::optional<Value> Get(const Key &key) {
+    Shard &shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      m_Misses.fetch_add(1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    m_Hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second->second;
+  }
+
+  // Insert or replace the value, evicting the least recently used entries of
+  // the shard when it's full
+  void Put(const Key &key, Value value) {
+    Shard &shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      it->second->second = std::move(value);
+      shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+      return;
+    }
+
+    // Room for the new entry
+    EvictOverCapacity(shard, GetShardCapacity() - 1);
+
+    shard.entries.emplace_front(key, std::move(value));
+    shard.index.emplace(key, shard.entries.begin());
+  }
+
+  // Remove the entry, return whether it was cached
+  bool Erase(const Key &key) {
+    Shard &shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      return false;
+    }
+    shard.entries.erase(it->second);
+    shard.index.erase(it);
+    return true;
+  }
+
+  void Clear() {
+    for (Shard &shard : m_Shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.index.clear();
+      shard.entries.clear();
+    }
+  }
+
+  // Change the total capacity, shrinking evicts the least recently used
+  // entries of every shard right away
+  void SetCapacity(std::size_t capacity) {
+    const std::size_t shardCapacity = std::max<std::size_t>(
+        1, (capacity + m_Shards.size() - 1) / m_Shards.size());
+    m_ShardCapacity.store(shardCapacity, std::memory_order_relaxed);
+    for (Shard &shard : m_Shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      EvictOverCapacity(shard, shardCapacity);
+    }
+  }
+
+  std::size_t Capacity() const { return GetShardCapacity() * m_Shards.size(); }
+
+  std::size_t Size() const {
+    std::size_t size = 0;
+    for (const Shard &shard : m_Shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      size += shard.entries.size();
+    }
+    return size;
+  }
+
+  Stats GetStats() const {
+    return Stats{m_Hits.load(std::memory_order_relaxed),
+                 m_Misses.load(std::memory_order_relaxed),
+                 m_Evictions.load(std::memory_order_relaxed)};
+  }
+
+private:
+  struct Shard {
+    mutable std::mutex mutex{};
+    // Most recently used first
+    std::list<std::pair<Key, Value>> entries{};
+    std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator,
+                       Hash>
+        index{};
+  };
+
+  Shard &GetShard(const Key &key) {
+    return m_Shards[m_Hash(key) % m_Shards.size()];
+  }
+
+  std::size_t GetShardCapacity() const {
+    return m_ShardCapacity.load(std::memory_order_relaxed);
+  }
+
+  // Drop the least recently used entries until the shard holds at most
+  // `capacity`, the shard's mutex has to be held
+  void EvictOverCapacity(Shard &shard, std::size_t capacity) {
+    while (shard.entries.size() > capacity) {
+      shard.index.erase(shard.entries.back().first);
+      shard.entries.pop_back();
+      m_Evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  std::vector<Shard> m_Shards;
+  // Changed by SetCapacity while the shards are in use
+  std::atomic<std::size_t> m_ShardCapacity{1};
+  Hash m_Hash{};
+  std::atomic<std::uint64_t> m_Hits{0};
+  std::atomic<std::uint64_t> m_Misses{0};
+  std::atomic<std::uint64_t> m_Evictions{0};
+};
+
+} // namespace mathboard
@@ -1,4 +1,176 @@
 // local
+#include "batch.hpp"
 #include "daemon.hpp"
+#include "logging/async_sink.hpp"
+#include "supervisor/supervisor.hpp"
 
-int main() { mathboard::Daemon(); }
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+void PrintUsage(const char *program) {
+  spdlog::info(
+      "Usage: {} [--batch input --output output [--checkpoint path]\n"
+      "  [--overwrite]]\n"
+      "  [--transport name] [--workers count] [--record path]\n"
+      "  [--metrics-file path] [--metrics-interval-ms ms]\n"
+      "  [--stage-concurrency name=threads] [--stage-queue-size size]\n"
+      "  [--session-memory-mb mb] [--session-idle-timeout-s seconds]\n"
+      "  [--log-queue-size size] [--log-overflow policy]\n",
+      program);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  mathboard::DaemonOptions options{};
+  mathboard::BatchOptions batchOptions{};
+  mathboard::AsyncLoggingOptions loggingOptions{};
+  bool batch = false;
+  // Set to fork the daemon into worker processes behind a supervisor
+  std::optional<std::size_t> workers{};
+  // Applied to the pipeline of the daemon or of the batch
+  std::map<std::string, std::size_t> stageConcurrency{};
+  std::optional<std::size_t> stageQueueSize{};
+
+  // Numbers are read with std::stoi and alike, which throw on bad values
+  int i = 1;
+  try {
+    for (; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--batch" && i + 1 < argc) {
+        batch = true;
+        batchOptions.input = argv[++i];
+      } else if (arg == "--output" && i + 1 < argc) {
+        batchOptions.output = argv[++i];
+      } else if (arg == "--checkpoint" && i + 1 < argc) {
+        batchOptions.checkpoint = argv[++i];
+      } else if (arg == "--overwrite") {
+        batchOptions.overwrite = true;
+      } else if (arg == "--transport" && i + 1 < argc) {
+        const std::string transportName = argv[++i];
+        const std::optional<mathboard::Transport> transport =
+            mathboard::ParseTransport(transportName);
+        if (!transport) {
+          spdlog::error("[main]: Unknown transport {}.\n", transportName);
+          return 1;
+        }
+        options.transport = *transport;
+      } else if (arg == "--workers" && i + 1 < argc) {
+        workers = std::stoul(argv[++i]);
+      } else if (arg == "--record" && i + 1 < argc) {
+        options.record_path = argv[++i];
+      } else if (arg == "--metrics-file" && i + 1 < argc) {
+        options.metrics_path = argv[++i];
+      } else if (arg == "--metrics-interval-ms" && i + 1 < argc) {
+        options.metrics_interval =
+            std::chrono::milliseconds(std::stoi(argv[++i]));
+      } else if (arg == "--stage-concurrency" && i + 1 < argc) {
+        // name=threads, e.g. contour=8
+        const std::string stage = argv[++i];
+        const std::size_t separator = stage.find('=');
+        if (separator == std::string::npos) {
+          spdlog::error("[main]: Expected name=threads, got {}.\n", stage);
+          return 1;
+        }
+        stageConcurrency[stage.substr(0, separator)] =
+            std::stoul(stage.substr(separator + 1));
+      } else if (arg == "--stage-queue-size" && i + 1 < argc) {
+        stageQueueSize = std::stoul(argv[++i]);
+      } else if (arg == "--session-memory-mb" && i + 1 < argc) {
+        options.sessions.max_memory = std::stoul(argv[++i]) * 1024 * 1024;
+      } else if (arg == "--session-idle-timeout-s" && i + 1 < argc) {
+        options.sessions.idle_timeout =
+            std::chrono::seconds(std::stoi(argv[++i]));
+      } else if (arg == "--log-queue-size" && i + 1 < argc) {
+        loggingOptions.queue_size = std::stoul(argv[++i]);
+      } else if (arg == "--log-overflow" && i + 1 < argc) {
+        const std::string policyName = argv[++i];
+        const std::optional<mathboard::LogOverflowPolicy> policy =
+            mathboard::ParseLogOverflowPolicy(policyName);
+        if (!policy) {
+          spdlog::error("[main]: Unknown log overflow policy {}.\n",
+                        policyName);
+          return 1;
+        }
+        loggingOptions.overflow_policy = *policy;
+      } else {
+        spdlog::error("[main]: Unknown argument {}.\n", arg);
+        PrintUsage(argv[0]);
+        return 1;
+      }
+    }
+  } catch (const std::logic_error &) {
+    // std::invalid_argument or std::out_of_range of the value at `i`
+    spdlog::error("[main]: Invalid value {} of {}.\n", argv[i], argv[i - 1]);
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  mathboard::RequestPipelineOptions &pipelineOptions =
+      batch ? batchOptions.pipeline : options.pipeline;
+  for (const auto &[stage, concurrency] : stageConcurrency) {
+    pipelineOptions.stage_concurrency[stage] = concurrency;
+  }
+  if (stageQueueSize) {
+    pipelineOptions.stage_queue_size = *stageQueueSize;
+  }
+
+  // Forks before any thread is started, the workers start their own logging
+  if (workers && !batch) {
+    if (options.transport != mathboard::Transport::Socket) {
+      spdlog::warn("[main]: Workers are connected through sockets, ignoring "
+                   "--transport.\n");
+    }
+    // Every worker writes its own files, e.g. mathboard.worker-0.prom
+    const auto workerPath = [](const std::filesystem::path &path,
+                               std::size_t worker) {
+      if (path.empty()) {
+        return path;
+      }
+      std::filesystem::path workerPath = path;
+      workerPath.replace_filename(path.stem().string() + ".worker-" +
+                                  std::to_string(worker) +
+                                  path.extension().string());
+      return workerPath;
+    };
+
+    const bool succeeded = mathboard::RunSupervisor(
+        mathboard::SupervisorOptions{*workers},
+        [&](std::size_t worker, std::int32_t channel_fd) {
+          mathboard::DaemonOptions workerOptions = options;
+          workerOptions.handoff_fd = channel_fd;
+          workerOptions.metrics_path = workerPath(options.metrics_path, worker);
+          workerOptions.record_path = workerPath(options.record_path, worker);
+          mathboard::InitAsyncLogging(loggingOptions);
+          mathboard::Daemon(workerOptions);
+          spdlog::shutdown();
+        });
+    spdlog::shutdown();
+    return succeeded ? 0 : 1;
+  }
+
+  // Requests only pay for copying their messages into the queue
+  mathboard::InitAsyncLogging(loggingOptions);
+
+  if (batch) {
+    const bool succeeded = mathboard::RunBatch(batchOptions);
+    spdlog::shutdown();
+    return succeeded ? 0 : 1;
+  }
+
+  mathboard::Daemon(options);
+  spdlog::shutdown();
+}
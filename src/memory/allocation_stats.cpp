@@ -0,0 +1,102 @@
+// header
+#include "allocation_stats.hpp"
+
+// std
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace mathboard {
+namespace allocationCounters {
+
+std::atomic<std::uint64_t> heapAllocations{0};
+std::atomic<std::uint64_t> heapDeallocations{0};
+std::atomic<std::uint64_t> matPoolHits{0};
+std::atomic<std::uint64_t> matPoolMisses{0};
+std::atomic<std::uint64_t> arenaUpstreamAllocations{0};
+
+} // namespace allocationCounters
+
+AllocationStats GetAllocationStats() {
+  using namespace allocationCounters;
+  return AllocationStats{
+      heapAllocations.load(std::memory_order_relaxed),
+      heapDeallocations.load(std::memory_order_relaxed),
+      matPoolHits.load(std::memory_order_relaxed),
+      matPoolMisses.load(std::memory_order_relaxed),
+      arenaUpstreamAllocations.load(std::memory_order_relaxed)};
+}
+
+} // namespace mathboard
+
+#ifdef MATHBOARD_COUNT_ALLOCATIONS
+
+// Replace the global allocation functions so every malloc done through
+// new/delete gets counted. The nothrow variants forward here by default.
+
+void *operator new(std::size_t size) {
+  mathboard::allocationCounters::heapAllocations.fetch_add(
+      1, std::memory_order_relaxed);
+
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void operator delete(void *ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  mathboard::allocationCounters::heapDeallocations.fetch_add(
+      1, std::memory_order_relaxed);
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept { ::operator delete(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  ::operator delete(ptr);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  mathboard::allocationCounters::heapAllocations.fetch_add(
+      1, std::memory_order_relaxed);
+
+  // aligned_alloc requires size to be a multiple of the alignment
+  const std::size_t align = static_cast<std::size_t>(alignment);
+  const std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) &
+                              ~(align - 1);
+  if (void *ptr = std::aligned_alloc(align, rounded)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return ::operator new(size, alignment);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+  ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+  ::operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+  ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+  ::operator delete(ptr);
+}
+
+#endif
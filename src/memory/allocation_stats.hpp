@@ -0,0 +1,48 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <cstdint>
+
+namespace mathboard {
+
+// Snapshot of the process wide allocation counters. Subtract two snapshots to
+// get the number of allocations done in between (e.g. per request).
+struct AllocationStats {
+  // Calls to the global operator new/delete. Only counted when the project is
+  // built with MATHBOARD_COUNT_ALLOCATIONS, otherwise they stay 0.
+  std::uint64_t heap_allocations{0};
+  std::uint64_t heap_deallocations{0};
+
+  // cv::Mat buffers served from / missing in the per-thread buffer pools
+  std::uint64_t mat_pool_hits{0};
+  std::uint64_t mat_pool_misses{0};
+
+  // Allocations the request arena couldn't serve from its own buffer
+  std::uint64_t arena_upstream_allocations{0};
+
+  AllocationStats operator-(const AllocationStats &other) const {
+    return AllocationStats{
+        heap_allocations - other.heap_allocations,
+        heap_deallocations - other.heap_deallocations,
+        mat_pool_hits - other.mat_pool_hits,
+        mat_pool_misses - other.mat_pool_misses,
+        arena_upstream_allocations - other.arena_upstream_allocations};
+  }
+};
+
+namespace allocationCounters {
+
+// Raw counters, incremented with relaxed ordering from the allocators
+extern std::atomic<std::uint64_t> heapAllocations;
+extern std::atomic<std::uint64_t> heapDeallocations;
+extern std::atomic<std::uint64_t> matPoolHits;
+extern std::atomic<std::uint64_t> matPoolMisses;
+extern std::atomic<std::uint64_t> arenaUpstreamAllocations;
+
+} // namespace allocationCounters
+
+// Returns current values of all the allocation counters
+AllocationStats GetAllocationStats();
+
+} // namespace mathboard
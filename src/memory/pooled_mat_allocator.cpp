@@ -0,0 +1,203 @@
+// header
+#include "pooled_mat_allocator.hpp"
+
+// local
+#include "allocation_stats.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace mathboard {
+
+namespace {
+
+// Per-thread cache of free buffers and free UMatData headers
+struct BufferPool {
+  // One free list per power of two size class
+  std::array<std::vector<void *>, 64> buffers{};
+  std::vector<void *> headers{};
+  std::size_t cached_bytes{0};
+
+  ~BufferPool();
+};
+
+// Buffers freed by another thread than the one which allocated them
+struct SharedPool {
+  std::mutex mutex{};
+  std::array<std::vector<void *>, 64> buffers{};
+  std::size_t cached_bytes{0};
+};
+
+thread_local BufferPool pool{};
+
+// Never destroyed, Mats can still be freed after static destructors ran
+SharedPool &GetSharedPool() {
+  static SharedPool *shared = new SharedPool{};
+  return *shared;
+}
+
+// Mats destroyed after the thread's pool (e.g. static ones at exit) must go
+// straight to the heap
+thread_local bool poolAlive = true;
+
+BufferPool::~BufferPool() {
+  poolAlive = false;
+  for (std::size_t i = 0; i < buffers.size(); i++) {
+    for (void *buffer : buffers[i]) {
+      cv::fastFree(buffer);
+    }
+  }
+  for (void *header : headers) {
+    ::operator delete(header);
+  }
+}
+
+std::size_t SizeClass(const std::size_t size) {
+  return std::countr_zero(
+      std::bit_ceil(std::max(size, PooledMatAllocator::kMinBufferSize)));
+}
+
+cv::UMatData *AcquireHeader(const cv::MatAllocator *allocator) {
+  void *storage;
+  if (!poolAlive || pool.headers.empty()) {
+    storage = ::operator new(sizeof(cv::UMatData));
+  } else {
+    storage = pool.headers.back();
+    pool.headers.pop_back();
+  }
+  return new (storage) cv::UMatData(allocator);
+}
+
+void ReleaseHeader(cv::UMatData *data) {
+  data->~UMatData();
+  if (poolAlive &&
+      pool.headers.size() < PooledMatAllocator::kMaxPooledHeaders) {
+    pool.headers.push_back(data);
+  } else {
+    ::operator delete(data);
+  }
+}
+
+uchar *AcquireBuffer(const std::size_t size_class) {
+  const std::size_t buffer_size = std::size_t{1} << size_class;
+  if (poolAlive && !pool.buffers[size_class].empty()) {
+    allocationCounters::matPoolHits.fetch_add(1, std::memory_order_relaxed);
+    void *buffer = pool.buffers[size_class].back();
+    pool.buffers[size_class].pop_back();
+    pool.cached_bytes -= buffer_size;
+    return static_cast<uchar *>(buffer);
+  }
+
+  SharedPool &shared = GetSharedPool();
+  {
+    std::lock_guard lock(shared.mutex);
+    if (!shared.buffers[size_class].empty()) {
+      allocationCounters::matPoolHits.fetch_add(1, std::memory_order_relaxed);
+      void *buffer = shared.buffers[size_class].back();
+      shared.buffers[size_class].pop_back();
+      shared.cached_bytes -= buffer_size;
+      return static_cast<uchar *>(buffer);
+    }
+  }
+
+  allocationCounters::matPoolMisses.fetch_add(1, std::memory_order_relaxed);
+  return static_cast<uchar *>(cv::fastMalloc(buffer_size));
+}
+
+// Keep the buffer for the next Mat of the same size class unless the pool
+// it goes to is already full
+void ReleaseBuffer(void *buffer, const std::size_t size_class,
+                   const void *owner) {
+  const std::size_t buffer_size = std::size_t{1} << size_class;
+  if (poolAlive && owner == &pool) {
+    if (pool.cached_bytes + buffer_size <=
+        PooledMatAllocator::kMaxPooledBytes) {
+      pool.buffers[size_class].push_back(buffer);
+      pool.cached_bytes += buffer_size;
+      return;
+    }
+  } else {
+    SharedPool &shared = GetSharedPool();
+    std::lock_guard lock(shared.mutex);
+    if (shared.cached_bytes + buffer_size <=
+        PooledMatAllocator::kMaxSharedPooledBytes) {
+      shared.buffers[size_class].push_back(buffer);
+      shared.cached_bytes += buffer_size;
+      return;
+    }
+  }
+  cv::fastFree(buffer);
+}
+
+} // namespace
+
+PooledMatAllocator *PooledMatAllocator::Instance() {
+  static PooledMatAllocator instance{};
+  return &instance;
+}
+
+cv::UMatData *PooledMatAllocator::allocate(int dims, const int *sizes,
+                                           int type, void *data,
+                                           std::size_t *step,
+                                           cv::AccessFlag /*flags*/,
+                                           cv::UMatUsageFlags
+                                           /*usage_flags*/) const {
+  // Same step computation as cv::StdMatAllocator
+  std::size_t total = CV_ELEM_SIZE(type);
+  for (int i = dims - 1; i >= 0; i--) {
+    if (step) {
+      if (data && step[i] != CV_AUTOSTEP) {
+        CV_Assert(total <= step[i]);
+        total = step[i];
+      } else {
+        step[i] = total;
+      }
+    }
+    total *= sizes[i];
+  }
+
+  cv::UMatData *u = AcquireHeader(this);
+  u->size = total;
+
+  // Wrapping memory owned by the user, nothing to allocate
+  if (data) {
+    u->data = u->origdata = static_cast<uchar *>(data);
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+    return u;
+  }
+
+  u->data = u->origdata = AcquireBuffer(SizeClass(total));
+  // The allocating thread's pool, the buffer goes back to it if it's freed
+  // on the same thread
+  u->userdata = &pool;
+  return u;
+}
+
+bool PooledMatAllocator::allocate(cv::UMatData *data,
+                                  cv::AccessFlag /*access_flags*/,
+                                  cv::UMatUsageFlags /*usage_flags*/) const {
+  return data != nullptr;
+}
+
+void PooledMatAllocator::deallocate(cv::UMatData *data) const {
+  if (!data) {
+    return;
+  }
+
+  CV_Assert(data->urefcount == 0);
+  CV_Assert(data->refcount == 0);
+
+  if (!(data->flags & cv::UMatData::USER_ALLOCATED)) {
+    ReleaseBuffer(data->origdata, SizeClass(data->size), data->userdata);
+    data->origdata = nullptr;
+  }
+
+  ReleaseHeader(data);
+}
+
+} // namespace mathboard
@@ -0,0 +1,46 @@
+#pragma once
+
+// libs
+// opencv
+#include <opencv2/core/mat.hpp>
+
+// std
+#include <cstddef>
+
+namespace mathboard {
+
+// cv::MatAllocator that recycles pixel buffers instead of returning them to
+// the heap. Every thread keeps its own pool of free buffers bucketed by
+// power of two size classes, so there's no locking on the hot path. Buffers
+// freed on a different thread than the one which allocated them go to a
+// shared pool instead, where a thread whose own pool has none looks before
+// going to the heap: a thread only freeing Mats made elsewhere doesn't hoard
+// their buffers.
+class PooledMatAllocator : public cv::MatAllocator {
+public:
+  // Buffers smaller than this are rounded up to it
+  static constexpr std::size_t kMinBufferSize = 4 * 1024;
+
+  // Upper limit of bytes cached in one thread's pool. Anything above is freed.
+  static constexpr std::size_t kMaxPooledBytes = 256 * 1024 * 1024;
+
+  // Upper limit of bytes cached in the pool shared by all threads
+  static constexpr std::size_t kMaxSharedPooledBytes = 256 * 1024 * 1024;
+
+  // Free UMatData headers kept by one thread
+  static constexpr std::size_t kMaxPooledHeaders = 1024;
+
+  // Process wide instance, pass it to cv::Mat::setDefaultAllocator
+  static PooledMatAllocator *Instance();
+
+  cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+                         std::size_t *step, cv::AccessFlag flags,
+                         cv::UMatUsageFlags usage_flags) const override;
+
+  bool allocate(cv::UMatData *data, cv::AccessFlag access_flags,
+                cv::UMatUsageFlags usage_flags) const override;
+
+  void deallocate(cv::UMatData *data) const override;
+};
+
+} // namespace mathboard
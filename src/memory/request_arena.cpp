@@ -0,0 +1,44 @@
+// header
+#include "request_arena.hpp"
+
+// local
+#include "allocation_stats.hpp"
+
+namespace mathboard {
+
+RequestArena::RequestArena(std::size_t initial_size)
+    : m_Capacity(initial_size),
+      m_Buffer(std::make_unique<std::byte[]>(initial_size)) {
+  m_Resource.emplace(m_Buffer.get(), m_Capacity, &m_Upstream);
+}
+
+void RequestArena::Reset() {
+  // Return the upstream chunks
+  m_Resource->release();
+
+  // The last request didn't fit, grow the buffer so the next one will
+  if (m_Upstream.m_Bytes > 0) {
+    m_Capacity += m_Upstream.m_Bytes;
+    m_Resource.reset();
+    m_Buffer = std::make_unique<std::byte[]>(m_Capacity);
+  }
+
+  m_Upstream.m_Bytes = 0;
+  m_Resource.emplace(m_Buffer.get(), m_Capacity, &m_Upstream);
+}
+
+void *RequestArena::CountingResource::do_allocate(std::size_t bytes,
+                                                  std::size_t alignment) {
+  allocationCounters::arenaUpstreamAllocations.fetch_add(
+      1, std::memory_order_relaxed);
+  m_Bytes += bytes;
+  return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void RequestArena::CountingResource::do_deallocate(void *ptr,
+                                                   std::size_t bytes,
+                                                   std::size_t alignment) {
+  std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+}
+
+} // namespace mathboard
@@ -0,0 +1,61 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace mathboard {
+
+// Monotonic arena living for the whole duration of a single request.
+// Everything allocated through Resource() is released at once by Reset().
+// The arena remembers how much memory the previous requests needed and grows
+// its own buffer so that in steady state no request has to go to the heap.
+class RequestArena {
+public:
+  explicit RequestArena(std::size_t initial_size = 64 * 1024);
+
+  RequestArena(const RequestArena &) = delete;
+  RequestArena &operator=(const RequestArena &) = delete;
+
+  // Memory resource to pass into std::pmr containers
+  std::pmr::memory_resource *Resource() { return &*m_Resource; }
+
+  // Release everything allocated in the current request. Containers using
+  // Resource() must be destroyed before calling this.
+  void Reset();
+
+  // Size of the arena's own buffer
+  std::size_t Capacity() const { return m_Capacity; }
+
+  // Bytes requested from the upstream resource since the last Reset()
+  std::size_t UpstreamBytes() const { return m_Upstream.m_Bytes; }
+
+private:
+  // Upstream of the monotonic resource. Counts everything that didn't fit
+  // into the arena's buffer.
+  class CountingResource : public std::pmr::memory_resource {
+  public:
+    std::size_t m_Bytes{0};
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *ptr, std::size_t bytes,
+                       std::size_t alignment) override;
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+  };
+
+private:
+  std::size_t m_Capacity{0};
+  std::unique_ptr<std::byte[]> m_Buffer{};
+  CountingResource m_Upstream{};
+  // monotonic_buffer_resource can't be reassigned, so it's rebuilt in place
+  // whenever the buffer grows
+  std::optional<std::pmr::monotonic_buffer_resource> m_Resource{};
+};
+
+} // namespace mathboard
@@ -0,0 +1,400 @@
+// header
+#include "metrics.hpp"
+
+// local
+#include "../concurrency/periodic_export.hpp"
+#include "../concurrency/thread_registry.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// posix
+#include <unistd.h>
+
+namespace mathboard {
+
+namespace {
+
+constexpr std::size_t kStageCount = static_cast<std::size_t>(Stage::Count);
+
+// Indexed by Stage
+constexpr std::string_view kStageNames[kStageCount] = {
+    "read",    "parse_json",     "open_file", "gray_scale",
+    "binarize", "segment",       "simplify",  "place_on_grid",
+    "predict", "recognize_text", "solve",     "request"};
+
+// Seconds the request rate of Snapshot is averaged over
+constexpr std::int64_t kRateWindowSeconds = 10;
+
+// Histograms observed by one thread, written only by that thread
+struct ThreadHistograms {
+  struct StageHistogram {
+    std::array<std::atomic<std::uint64_t>, Metrics::kBucketCount> buckets{};
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> sum_us{0};
+  };
+
+  // Requests finished within one second since the start, -1 while reset
+  struct RequestSecond {
+    std::atomic<std::int64_t> second{-1};
+    std::atomic<std::uint64_t> count{0};
+  };
+
+  std::array<StageHistogram, kStageCount> stages{};
+  // Slot `second % size`, one more than the window so the current second
+  // doesn't overwrite the oldest one of the window
+  std::array<RequestSecond, kRateWindowSeconds + 1> request_seconds{};
+};
+
+// Single writer, a relaxed load and store is enough and cheaper than fetch_add
+void Increment(std::atomic<std::uint64_t> &counter, std::uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+std::chrono::steady_clock::time_point GetStartTime() {
+  static const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  return start;
+}
+
+std::int64_t SecondsSinceStart(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::seconds>(time -
+                                                          GetStartTime())
+      .count();
+}
+
+// Observations of an exited thread still count, fold them into `retired`.
+// Called under the registry lock, the only writer of `retired`.
+void RetireHistograms(const ThreadHistograms &thread,
+                      ThreadHistograms &retired) {
+  for (std::size_t stage = 0; stage < kStageCount; stage++) {
+    const auto &from = thread.stages[stage];
+    auto &into = retired.stages[stage];
+    for (std::size_t i = 0; i < Metrics::kBucketCount; i++) {
+      Increment(into.buckets[i],
+                from.buckets[i].load(std::memory_order_relaxed));
+    }
+    Increment(into.count, from.count.load(std::memory_order_relaxed));
+    Increment(into.sum_us, from.sum_us.load(std::memory_order_relaxed));
+  }
+
+  for (std::size_t i = 0; i < thread.request_seconds.size(); i++) {
+    const auto &from = thread.request_seconds[i];
+    auto &into = retired.request_seconds[i];
+    const std::int64_t second = from.second.load(std::memory_order_relaxed);
+    const std::uint64_t count = from.count.load(std::memory_order_relaxed);
+    const std::int64_t retiredSecond =
+        into.second.load(std::memory_order_relaxed);
+    if (second > retiredSecond) {
+      into.count.store(count, std::memory_order_relaxed);
+      into.second.store(second, std::memory_order_release);
+    } else if (second == retiredSecond) {
+      Increment(into.count, count);
+    }
+  }
+}
+
+ThreadRegistry<ThreadHistograms> &GetRegistry() {
+  static ThreadRegistry<ThreadHistograms> registry(RetireHistograms);
+  return registry;
+}
+
+struct Gauges {
+  std::mutex mutex{};
+  std::map<std::string, std::function<double()>> gauges{};
+};
+
+Gauges &GetGauges() {
+  static Gauges gauges{};
+  return gauges;
+}
+
+void CountRequest(ThreadHistograms &histograms, std::int64_t second) {
+  auto &slot =
+      histograms.request_seconds[static_cast<std::size_t>(second) %
+                                 histograms.request_seconds.size()];
+  if (slot.second.load(std::memory_order_relaxed) != second) {
+    // Readers skip the slot while it's reset
+    slot.second.store(-1, std::memory_order_relaxed);
+    slot.count.store(0, std::memory_order_relaxed);
+    slot.second.store(second, std::memory_order_release);
+  }
+  Increment(slot.count, 1);
+}
+
+Metrics::Histogram
+MergeHistograms(const std::vector<std::shared_ptr<ThreadHistograms>> &threads,
+                const ThreadHistograms &retired, Stage stage) {
+  Metrics::Histogram merged;
+  const auto merge = [&merged, stage](const ThreadHistograms &thread) {
+    const auto &histogram = thread.stages[static_cast<std::size_t>(stage)];
+    for (std::size_t i = 0; i < Metrics::kBucketCount; i++) {
+      merged.buckets[i] +=
+          histogram.buckets[i].load(std::memory_order_relaxed);
+    }
+    merged.count += histogram.count.load(std::memory_order_relaxed);
+    merged.sum_us += histogram.sum_us.load(std::memory_order_relaxed);
+  };
+  for (const auto &thread : threads) {
+    merge(*thread);
+  }
+  merge(retired);
+  return merged;
+}
+
+// Requests per second over the complete seconds of the last
+// kRateWindowSeconds, the same for every caller
+double
+RequestRate(const std::vector<std::shared_ptr<ThreadHistograms>> &threads,
+            const ThreadHistograms &retired, std::int64_t now) {
+  const std::int64_t first =
+      std::max<std::int64_t>(0, now - kRateWindowSeconds);
+  if (now == first) {
+    return 0.0;
+  }
+
+  std::uint64_t requests = 0;
+  const auto count = [&requests, first, now](const ThreadHistograms &thread) {
+    for (const auto &slot : thread.request_seconds) {
+      const std::int64_t second = slot.second.load(std::memory_order_acquire);
+      const std::uint64_t slotCount =
+          slot.count.load(std::memory_order_relaxed);
+      // Skip slots reset while they were read
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (second >= first && second < now &&
+          slot.second.load(std::memory_order_relaxed) == second) {
+        requests += slotCount;
+      }
+    }
+  };
+  for (const auto &thread : threads) {
+    count(*thread);
+  }
+  count(retired);
+  return static_cast<double>(requests) / static_cast<double>(now - first);
+}
+
+// Resident set size from /proc, 0 when it can't be read
+std::uint64_t ReadRssBytes() {
+  std::ifstream statm("/proc/self/statm");
+  std::uint64_t size = 0;
+  std::uint64_t resident = 0;
+  if (!(statm >> size >> resident)) {
+    return 0;
+  }
+  return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Histograms and gauges read together, gauge callbacks run under the lock
+struct Readings {
+  std::array<Metrics::Histogram, kStageCount> histograms{};
+  double requests_per_second{0.0};
+  std::map<std::string, double> gauges{};
+};
+
+Readings Read() {
+  Readings readings;
+  const std::int64_t now = SecondsSinceStart(std::chrono::steady_clock::now());
+  GetRegistry().Read(
+      [&readings, now](
+          const std::vector<std::shared_ptr<ThreadHistograms>> &threads,
+          const ThreadHistograms &retired) {
+        for (std::size_t i = 0; i < kStageCount; i++) {
+          readings.histograms[i] =
+              MergeHistograms(threads, retired, static_cast<Stage>(i));
+        }
+        readings.requests_per_second = RequestRate(threads, retired, now);
+      });
+
+  Gauges &gauges = GetGauges();
+  std::lock_guard<std::mutex> lockGauges(gauges.mutex);
+  for (const auto &[name, read] : gauges.gauges) {
+    readings.gauges[name] = read();
+  }
+  return readings;
+}
+
+PeriodicExport &GetPrometheusExport() {
+  // The export thread reads the registries until it's joined
+  GetRegistry();
+  GetGauges();
+  static PeriodicExport prometheusExport{};
+  return prometheusExport;
+}
+
+} // namespace
+
+std::string_view GetStageName(Stage stage) {
+  return kStageNames[static_cast<std::size_t>(stage)];
+}
+
+double Metrics::Histogram::Quantile(double quantile) const {
+  if (count == 0) {
+    return 0.0;
+  }
+
+  const double rank = quantile * static_cast<double>(count);
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBucketCount; i++) {
+    seen += buckets[i];
+    if (static_cast<double>(seen) >= rank) {
+      return static_cast<double>(std::uint64_t{1} << i);
+    }
+  }
+  return static_cast<double>(std::uint64_t{1} << (kBucketCount - 1));
+}
+
+void Metrics::Observe(Stage stage, std::chrono::nanoseconds latency) {
+  const std::uint64_t us = static_cast<std::uint64_t>(
+      std::max<std::int64_t>(0, latency.count() / 1000));
+  // Smallest i with us <= 2^i
+  const std::size_t bucket = std::min<std::size_t>(
+      us <= 1 ? 0 : std::bit_width(us - 1), kBucketCount - 1);
+
+  ThreadHistograms &histograms = GetRegistry().Local();
+  auto &histogram = histograms.stages[static_cast<std::size_t>(stage)];
+  Increment(histogram.buckets[bucket], 1);
+  Increment(histogram.sum_us, us);
+  Increment(histogram.count, 1);
+  if (stage == Stage::Request) {
+    CountRequest(histograms,
+                 SecondsSinceStart(std::chrono::steady_clock::now()));
+  }
+}
+
+void Metrics::RegisterGauge(const std::string &name,
+                            std::function<double()> read) {
+  Gauges &gauges = GetGauges();
+  std::lock_guard<std::mutex> lockGauges(gauges.mutex);
+  gauges.gauges[name] = std::move(read);
+}
+
+void Metrics::UnregisterGauge(const std::string &name) {
+  Gauges &gauges = GetGauges();
+  std::lock_guard<std::mutex> lockGauges(gauges.mutex);
+  gauges.gauges.erase(name);
+}
+
+Metrics::Histogram Metrics::GetHistogram(Stage stage) {
+  return GetRegistry().Read(
+      [stage](const std::vector<std::shared_ptr<ThreadHistograms>> &threads,
+              const ThreadHistograms &retired) {
+        return MergeHistograms(threads, retired, stage);
+      });
+}
+
+nlohmann::json Metrics::Snapshot() {
+  JsonWriter writer{};
+  writer.BeginObject();
+  WriteSnapshot(writer);
+  writer.EndObject();
+  return nlohmann::json::parse(writer.View());
+}
+
+void Metrics::WriteSnapshot(JsonWriter &writer) {
+  const Readings readings = Read();
+  const Histogram &requests =
+      readings.histograms[static_cast<std::size_t>(Stage::Request)];
+
+  const double uptime = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - GetStartTime())
+                            .count();
+
+  writer.Key("uptimeSeconds")
+      .Double(uptime)
+      .Key("requestsTotal")
+      .UInt(requests.count)
+      .Key("requestsPerSecond")
+      .Double(readings.requests_per_second)
+      .Key("rssBytes")
+      .UInt(ReadRssBytes());
+
+  writer.Key("stages").BeginObject();
+  for (std::size_t i = 0; i < kStageCount; i++) {
+    const Histogram &histogram = readings.histograms[i];
+    writer.Key(kStageNames[i])
+        .BeginObject()
+        .Key("count")
+        .UInt(histogram.count)
+        .Key("meanUs")
+        .Double(histogram.count == 0
+                    ? 0.0
+                    : static_cast<double>(histogram.sum_us) /
+                          static_cast<double>(histogram.count))
+        .Key("p50Us")
+        .Double(histogram.Quantile(0.5))
+        .Key("p90Us")
+        .Double(histogram.Quantile(0.9))
+        .Key("p99Us")
+        .Double(histogram.Quantile(0.99))
+        .EndObject();
+  }
+  writer.EndObject();
+
+  writer.Key("gauges").BeginObject();
+  for (const auto &[name, value] : readings.gauges) {
+    writer.Key(name).Double(value);
+  }
+  writer.EndObject();
+}
+
+void Metrics::WritePrometheus(std::ostream &output) {
+  const Readings readings = Read();
+
+  output << "# HELP mathboard_stage_latency_seconds Latency of the request "
+            "stages.\n"
+         << "# TYPE mathboard_stage_latency_seconds histogram\n";
+  for (std::size_t i = 0; i < kStageCount; i++) {
+    const Histogram &histogram = readings.histograms[i];
+    const std::string_view stage = kStageNames[i];
+
+    // Prometheus buckets are cumulative
+    std::uint64_t cumulative = 0;
+    for (std::size_t bucket = 0; bucket + 1 < kBucketCount; bucket++) {
+      cumulative += histogram.buckets[bucket];
+      output << "mathboard_stage_latency_seconds_bucket{stage=\"" << stage
+             << "\",le=\""
+             << static_cast<double>(std::uint64_t{1} << bucket) * 1e-6
+             << "\"} " << cumulative << '\n';
+    }
+    output << "mathboard_stage_latency_seconds_bucket{stage=\"" << stage
+           << "\",le=\"+Inf\"} " << histogram.count << '\n'
+           << "mathboard_stage_latency_seconds_sum{stage=\"" << stage
+           << "\"} " << static_cast<double>(histogram.sum_us) * 1e-6 << '\n'
+           << "mathboard_stage_latency_seconds_count{stage=\"" << stage
+           << "\"} " << histogram.count << '\n';
+  }
+
+  output << "# HELP mathboard_requests_total Requests handled.\n"
+         << "# TYPE mathboard_requests_total counter\n"
+         << "mathboard_requests_total "
+         << readings.histograms[static_cast<std::size_t>(Stage::Request)]
+                .count
+         << '\n';
+
+  output << "# HELP mathboard_resident_memory_bytes Resident set size.\n"
+         << "# TYPE mathboard_resident_memory_bytes gauge\n"
+         << "mathboard_resident_memory_bytes " << ReadRssBytes() << '\n';
+
+  for (const auto &[name, value] : readings.gauges) {
+    output << "# TYPE mathboard_" << name << " gauge\n"
+           << "mathboard_" << name << ' ' << value << '\n';
+  }
+}
+
+void Metrics::StartPrometheusExport(const std::filesystem::path &path,
+                                    std::chrono::milliseconds interval) {
+  GetPrometheusExport().Start(path, interval, WritePrometheus);
+}
+
+void Metrics::StopPrometheusExport() { GetPrometheusExport().Stop(); }
+
+} // namespace mathboard
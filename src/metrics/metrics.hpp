@@ -0,0 +1,151 @@
+#pragma once
+
+// libs
+// json
+#include <nlohmann/json.hpp>
+
+// local
+#include "../json_writer.hpp"
+
+// std
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+// Stages of a request with their own latency histogram
+enum class Stage {
+  Read,
+  ParseJson,
+  OpenFile,
+  GrayScale,
+  Binarize,
+  Segment,
+  Simplify,
+  PlaceOnGrid,
+  Predict,
+  RecognizeText,
+  Solve,
+  // Whole request, its count is the number of requests
+  Request,
+  Count
+};
+
+std::string_view GetStageName(Stage stage);
+
+// Latency histograms of the stages plus gauges read on demand. Every thread
+// observes into its own histograms, readers merge them, so the hot path is a
+// couple of relaxed loads and stores without locks. Histograms of exited
+// threads are merged into one and released.
+class Metrics {
+public:
+  // Bucket i counts latencies up to 2^i microseconds, the last one the rest
+  static constexpr std::size_t kBucketCount = 28;
+
+  struct Histogram {
+    std::array<std::uint64_t, kBucketCount> buckets{};
+    std::uint64_t count{0};
+    std::uint64_t sum_us{0};
+
+    // Upper bound of the bucket holding the `quantile`, in microseconds
+    double Quantile(double quantile) const;
+  };
+
+  static void Observe(Stage stage, std::chrono::nanoseconds latency);
+
+  // Register a value read at snapshot time, e.g. a queue depth. Registering
+  // the same name again replaces the callback.
+  static void RegisterGauge(const std::string &name,
+                            std::function<double()> read);
+
+  // Once it returns the gauge's callback isn't running and won't be called
+  // anymore
+  static void UnregisterGauge(const std::string &name);
+
+  static Histogram GetHistogram(Stage stage);
+
+  // Snapshot of histograms, request rate, gauges and RSS, the reply to the
+  // daemon's stats command. The rate is averaged over the last complete
+  // seconds, independent of when snapshots are taken.
+  static nlohmann::json Snapshot();
+
+  // Same snapshot as the fields of the object `writer` is in
+  static void WriteSnapshot(JsonWriter &writer);
+
+  // Same data in Prometheus text exposition format
+  static void WritePrometheus(std::ostream &output);
+
+  // Rewrite `path` in Prometheus format every `interval` from a background
+  // thread, for node_exporter's textfile collector and alike
+  static void StartPrometheusExport(const std::filesystem::path &path,
+                                    std::chrono::milliseconds interval);
+
+  static void StopPrometheusExport();
+};
+
+// Observes the time between construction and destruction
+class StageTimer {
+public:
+  explicit StageTimer(Stage stage)
+      : m_Stage(stage), m_Start(std::chrono::steady_clock::now()) {}
+
+  ~StageTimer() {
+    Metrics::Observe(m_Stage, std::chrono::steady_clock::now() - m_Start);
+  }
+
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+  Stage m_Stage;
+  std::chrono::steady_clock::time_point m_Start;
+};
+
+// Gauges reading objects of a scope, e.g. the daemon's sessions, unregistered
+// before the objects they read are destroyed
+class ScopedGauges {
+public:
+  ScopedGauges() = default;
+
+  ~ScopedGauges() { Clear(); }
+
+  ScopedGauges(ScopedGauges &&other) noexcept
+      : m_Names(std::exchange(other.m_Names, {})) {}
+
+  ScopedGauges &operator=(ScopedGauges &&other) noexcept {
+    if (this != &other) {
+      Clear();
+      m_Names = std::exchange(other.m_Names, {});
+    }
+    return *this;
+  }
+
+  ScopedGauges(const ScopedGauges &) = delete;
+  ScopedGauges &operator=(const ScopedGauges &) = delete;
+
+  void Register(const std::string &name, std::function<double()> read) {
+    Metrics::RegisterGauge(name, std::move(read));
+    m_Names.push_back(name);
+  }
+
+  void Clear() {
+    for (const std::string &name : m_Names) {
+      Metrics::UnregisterGauge(name);
+    }
+    m_Names.clear();
+  }
+
+private:
+  std::vector<std::string> m_Names{};
+};
+
+} // namespace mathboard
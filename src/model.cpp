@@ -1,6 +1,10 @@
 // header
 #include "model.hpp"
 
+// local
+#include "metrics/metrics.hpp"
+#include "tracing/tracer.hpp"
+
 // libs
 // tensorflow-lite
 #include "spdlog/spdlog.h"
@@ -28,6 +32,8 @@ Model::Model(const std::filesystem::path &model_filename) {
   m_Interpreter->AllocateTensors();
 }
 uint32_t Model::Predict(cv::Mat character) const {
+  MATHBOARD_TRACE_SCOPE("Model::Predict");
+  const StageTimer stageTimer(Stage::Predict);
   if(character.rows != 28 || character.cols != 28
     || character.channels() != 1 || character.type() != CV_32F) {
     spdlog::error("Wrong matrix format\n");
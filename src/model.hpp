@@ -10,6 +10,8 @@
 
 namespace mathboard {
 
+// The weights are mmap'd read-only by BuildFromFile and never copied, so the
+// workers of a supervisor share one copy of them through the page cache
 class Model {
 public:
   Model(const std::filesystem::path &model_filename);
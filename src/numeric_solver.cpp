@@ -0,0 +1,153 @@
+// header
+#include "numeric_solver.hpp"
+
+// local
+#include "compiled_expression.hpp"
+
+// libs
+// symengine
+#include <symengine/visitor.h>
+
+// std
+#include <algorithm>
+#include <cmath>
+
+namespace mathboard {
+
+namespace {
+
+// Number of samples looking for sign changes
+constexpr std::size_t kSampleCount = 4096;
+// Samples evaluated between two deadline checks
+constexpr std::size_t kSampleBatch = 256;
+// Bisection steps before switching to Newton
+constexpr int kBisectionSteps = 30;
+constexpr int kNewtonSteps = 20;
+// |f(x)| below which x is accepted as a root
+constexpr double kResidualTolerance = 1e-9;
+
+bool HasExpired(std::chrono::steady_clock::time_point deadline,
+                const std::atomic<bool> *cancelled) {
+  return (cancelled && cancelled->load(std::memory_order_relaxed)) ||
+         std::chrono::steady_clock::now() >= deadline;
+}
+
+} // namespace
+
+std::vector<double>
+FindRealRoots(const SymEngine::RCP<const SymEngine::Basic> &expr,
+              const SymEngine::RCP<const SymEngine::Symbol> &symbol,
+              std::chrono::steady_clock::time_point deadline, double range,
+              const std::atomic<bool> *cancelled) {
+  std::vector<double> roots;
+
+  // Only expressions of the single symbol can be evaluated
+  for (const auto &free_symbol : SymEngine::free_symbols(*expr)) {
+    if (!SymEngine::eq(*free_symbol, *symbol)) {
+      return roots;
+    }
+  }
+
+  const CompiledExpression function(expr, {symbol});
+  const CompiledExpression derivative(expr->diff(symbol), {symbol});
+
+  const auto f = [&function](double x) {
+    return function.EvaluatePoint({&x, 1});
+  };
+  const auto df = [&derivative](double x) {
+    return derivative.EvaluatePoint({&x, 1});
+  };
+
+  // Sample densely around 0, where handwritten equations usually have roots
+  std::vector<double> xs(kSampleCount);
+  std::vector<double> ys(kSampleCount);
+  for (std::size_t i = 0; i < kSampleCount; i++) {
+    const double t = 2.0 * static_cast<double>(i) / (kSampleCount - 1) - 1.0;
+    xs[i] = range * t * t * t;
+  }
+  std::size_t sampled = 0;
+  for (; sampled < kSampleCount; sampled += kSampleBatch) {
+    if (HasExpired(deadline, cancelled)) {
+      break;
+    }
+    const std::size_t end = std::min(sampled + kSampleBatch, kSampleCount);
+    const double *input = xs.data() + sampled;
+    function.EvaluateBatch({&input, 1}, {ys.data() + sampled, end - sampled});
+  }
+  sampled = std::min(sampled, kSampleCount);
+
+  // Newton iterations from x, return whether it converged to a root
+  const auto polish = [&](double &x) {
+    for (int step = 0; step < kNewtonSteps; step++) {
+      const double y = f(x);
+      if (std::abs(y) < kResidualTolerance) {
+        return true;
+      }
+      const double dy = df(x);
+      if (!std::isfinite(dy) || dy == 0.0) {
+        break;
+      }
+      x -= y / dy;
+      if (!std::isfinite(x)) {
+        return false;
+      }
+    }
+    return std::abs(f(x)) < kResidualTolerance;
+  };
+
+  for (std::size_t i = 0; i + 1 < sampled && !HasExpired(deadline, cancelled);
+       i++) {
+    double a = xs[i];
+    double b = xs[i + 1];
+    double fa = ys[i];
+    const double fb = ys[i + 1];
+    if (!std::isfinite(fa) || !std::isfinite(fb)) {
+      continue;
+    }
+
+    if (fa == 0.0) {
+      roots.push_back(a);
+      continue;
+    }
+
+    if ((fa < 0.0) != (fb < 0.0)) {
+      // Sign change, bracket the root
+      for (int step = 0; step < kBisectionSteps; step++) {
+        const double mid = 0.5 * (a + b);
+        const double fmid = f(mid);
+        if ((fa < 0.0) == (fmid < 0.0)) {
+          a = mid;
+          fa = fmid;
+        } else {
+          b = mid;
+        }
+      }
+      // Poles change sign too, they never pass the residual check
+      double x = 0.5 * (a + b);
+      if (polish(x)) {
+        roots.push_back(x);
+      }
+    } else if (i > 0 && std::isfinite(ys[i - 1]) &&
+               std::abs(fa) < std::abs(ys[i - 1]) &&
+               std::abs(fa) < std::abs(fb)) {
+      // Local minimum of |f| without a sign change, possibly a double root
+      double x = a;
+      if (polish(x)) {
+        roots.push_back(x);
+      }
+    }
+  }
+
+  // Remove duplicates found from neighbouring samples
+  std::sort(roots.begin(), roots.end());
+  roots.erase(std::unique(roots.begin(), roots.end(),
+                          [](double lhs, double rhs) {
+                            return std::abs(lhs - rhs) <=
+                                   1e-7 * std::max(1.0, std::abs(lhs));
+                          }),
+              roots.end());
+
+  return roots;
+}
+
+} // namespace mathboard
@@ -0,0 +1,28 @@
+#pragma once
+
+// libs
+// symengine
+#include <symengine/basic.h>
+#include <symengine/symbol.h>
+
+// std
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace mathboard {
+
+// Find real roots of `expr` = 0 in `symbol` numerically. The expression is
+// sampled over a range growing cubically from 0 up to +-`range`, sign changes
+// are bracketed with bisection and every root is polished with Newton's
+// method on the compiled derivative. Stops early at `deadline`, or once
+// `cancelled` is set, and returns what was found so far. Every other free
+// symbol has to be substituted beforehand, otherwise nothing is found.
+std::vector<double>
+FindRealRoots(const SymEngine::RCP<const SymEngine::Basic> &expr,
+              const SymEngine::RCP<const SymEngine::Symbol> &symbol,
+              std::chrono::steady_clock::time_point deadline,
+              double range = 1000.0,
+              const std::atomic<bool> *cancelled = nullptr);
+
+} // namespace mathboard
@@ -1,17 +1,29 @@
 // header
 #include "opencv_helper.hpp"
 
+// local
+#include "concurrency/bounded_queue.hpp"
+#include "metrics/metrics.hpp"
+#include "tracing/tracer.hpp"
+
 // lib
 // spdlog
 #include <spdlog/spdlog.h>
 
 // std
+#include <algorithm>
 #include <filesystem>
+#include <map>
+#include <optional>
+#include <thread>
 
 namespace mathboard {
 
 // Open file
 void OpenCVHelper::OpenFile(const std::filesystem::path &file) {
+  MATHBOARD_TRACE_SCOPE("OpenCVHelper::OpenFile");
+  const StageTimer stageTimer(Stage::OpenFile);
+
   // Stop the rendering while new file isn't loaded yet
   m_ShouldRender = false;
 
@@ -65,80 +77,228 @@ void OpenCVHelper::OpenFile(const std::filesystem::path &file) {
 }
 
 // Render the whole video capture
-void OpenCVHelper::RenderVideo() {
-  // Stop the rendering while new file isn't loaded yet or when finished
-  while (GetCurrentFrameIndex() <= GetTotalFrameCount() && m_ShouldRender) {
-    {
-      // Make sure you don't change m_Frame while it's being used somewhere else
-      // Make sure that the video capture doesn't change while it's being
-      // accessed here
-      std::lock_guard<std::mutex> lockVideoCapture(m_MutexVideoCapture);
-      std::lock_guard<std::mutex> lockFrame(m_MutexFrame);
+void OpenCVHelper::RenderVideo(const FrameCallback &callback,
+                               std::uint32_t worker_count,
+                               std::uint32_t queue_size) {
+  if (worker_count == 0) {
+    worker_count = std::max(1U, std::thread::hardware_concurrency());
+  }
+  queue_size = std::max(queue_size, 1U);
 
-      // Read next frame from the video
-      m_VideoCapture >> m_Frame;
+  // Frame being processed, index of the frame and of the slot holding it
+  struct FrameTask {
+    std::uint32_t index{0};
+    std::uint32_t slot{0};
+  };
+
+  // Reusable frames, decoding into a slot reuses its buffer
+  std::vector<cv::Mat> slots(queue_size);
+  BoundedQueue<std::uint32_t> freeSlots(queue_size);
+  BoundedQueue<FrameTask> decodedFrames(queue_size);
+  for (std::uint32_t slot = 0; slot < queue_size; slot++) {
+    freeSlots.Push(slot);
+  }
+
+  // Results finished out of order wait here until the previous frames are
+  // done
+  std::mutex mutexResults{};
+  std::map<std::uint32_t, FrameResult> pendingResults{};
+  std::uint32_t nextResultIndex = 0;
+
+  const std::uint32_t size = m_Size;
+  const BinarizationMethod binarization = m_Binarization;
+
+  const auto worker = [&]() {
+    FrameTask task;
+    while (decodedFrames.Pop(task)) {
+      const cv::Mat &frame = slots[task.slot];
+
+      FrameResult result{task.index, {}, {}};
+      ConvertFrame(frame, size, result.luminance);
+
+      result.strokes = SegmentBoard(BinarizeBoard(frame, binarization));
+
+      // The frame isn't needed anymore, let the decoder reuse it
+      freeSlots.Push(task.slot);
+
+      std::lock_guard<std::mutex> lockResults(mutexResults);
+      pendingResults.emplace(task.index, std::move(result));
+      for (auto it = pendingResults.begin();
+           it != pendingResults.end() && it->first == nextResultIndex;
+           it = pendingResults.erase(it)) {
+        if (callback) {
+          callback(std::move(it->second));
+        }
+        nextResultIndex++;
+      }
     }
+  };
 
-    // cv::CAP_PROP_POS_FRAMES begins counting from 1
-    // (0 means frame is not loaded)
-    ConvertFrame(static_cast<std::int32_t>(GetCurrentFrameIndex()) - 1);
+  std::vector<std::thread> workers;
+  workers.reserve(worker_count);
+  for (std::uint32_t i = 0; i < worker_count; i++) {
+    workers.emplace_back(worker);
+  }
+
+  // Slot of the last decoded frame
+  std::optional<std::uint32_t> lastSlot{};
+
+  // Decode thread
+  std::thread decoder([&]() {
+    std::uint32_t index = 0;
+    std::uint32_t slot;
+
+    // Stop the rendering while new file isn't loaded yet or when finished
+    while (m_ShouldRender && freeSlots.Pop(slot)) {
+      bool decoded;
+      {
+        // Make sure that the video capture doesn't change while it's being
+        // accessed here
+        std::lock_guard<std::mutex> lockVideoCapture(m_MutexVideoCapture);
+
+        // Read next frame from the video. A failed read() empties the Mat,
+        // grab() first so the end of the video leaves the slot, which may
+        // hold the last frame, alone.
+        decoded = m_VideoCapture.grab() && m_VideoCapture.retrieve(slots[slot]);
+      }
+
+      if (!decoded || slots[slot].empty()) {
+        if (lastSlot == slot) {
+          lastSlot.reset();
+        }
+        break;
+      }
+
+      lastSlot = slot;
+      decodedFrames.Push(FrameTask{index++, slot});
+    }
+
+    // Let the workers finish the frames already decoded
+    decodedFrames.Close();
+  });
+
+  decoder.join();
+  for (auto &thread : workers) {
+    thread.join();
+  }
+
+  {
+    // Keep the last frame available through GetFrame()
+    std::lock_guard<std::mutex> lockFrame(m_MutexFrame);
+    if (lastSlot) {
+      m_Frame = slots[*lastSlot];
+    }
   }
 }
 
 // Convert a frame
-void OpenCVHelper::ConvertFrame(const std::uint32_t index) {
+void OpenCVHelper::ConvertFrame(const std::uint32_t /*index*/) {
   // Make sure that the frame doesn't change while it's being accessed here
   std::lock_guard<std::mutex> lockFrame(m_MutexFrame);
 
-  if (m_Frame.empty() || m_Frame.cols == 0 || m_Frame.rows == 0) {
+  ConvertFrame(m_Frame, m_Size, m_Luminance);
+}
+
+// Convert the given frame
+void OpenCVHelper::ConvertFrame(const cv::Mat &frame,
+                                const std::uint32_t size,
+                                cv::Mat &luminance) {
+  if (frame.empty() || frame.cols == 0 || frame.rows == 0 ||
+      frame.type() != CV_8UC3) {
+    luminance.release();
     return;
   }
 
   // Calculate the aspect ratio of the original frame
   const float aspectRatio =
-      static_cast<float>(m_Frame.rows) / static_cast<float>(m_Frame.cols);
+      static_cast<float>(frame.rows) / static_cast<float>(frame.cols);
 
-  // Calculate the block size based on desired size
-  const std::uint32_t blockSizeX = std::max(
-      1U, m_Frame.cols / static_cast<std::uint32_t>(m_Size / aspectRatio));
+  // Calculate the block size based on desired size. A size of 0 or a frame
+  // much taller than wide would ask for no blocks at all, there's at least
+  // one.
+  const std::uint32_t blocksPerRow =
+      std::max(1U, static_cast<std::uint32_t>(size / aspectRatio));
+  const std::uint32_t blocksPerColumn = std::max(1U, size);
 
-  const std::uint32_t blockSizeY = std::max(1U, m_Frame.rows / m_Size);
+  const std::uint32_t blockSizeX = std::max(1U, frame.cols / blocksPerRow);
+  const std::uint32_t blockSizeY = std::max(1U, frame.rows / blocksPerColumn);
 
   // Calculate the number of blocks.
-  const std::uint32_t numBlocksX = m_Frame.cols / blockSizeX;
-  const std::uint32_t numBlocksY = m_Frame.rows / blockSizeY;
-
-  for (std::uint32_t i = 0; i < numBlocksX; i++) {
-    for (std::uint32_t j = 0; j < numBlocksY; j++) {
-      std::uint32_t sum_r = 0;
-      std::uint32_t sum_g = 0;
-      std::uint32_t sum_b = 0;
-
-      // Calculate the average for each block
-      for (std::uint32_t bi = 0; bi < blockSizeX; ++bi) {
-        for (std::uint32_t bj = 0; bj < blockSizeY; ++bj) {
-          const cv::Vec3b pixel =
-              m_Frame.at<cv::Vec3b>(j * blockSizeY + bj, i * blockSizeX + bi);
-
-          // OpenCV has BGR color format
-          const std::uint8_t b = pixel[0];
-          const std::uint8_t g = pixel[1];
-          const std::uint8_t r = pixel[2];
-
-          sum_r += r;
-          sum_g += g;
-          sum_b += b;
-        }
+  const std::uint32_t numBlocksX = frame.cols / blockSizeX;
+  const std::uint32_t numBlocksY = frame.rows / blockSizeY;
+
+  // Summed-area table of r + g + b with a zero first row and column. It's
+  // computed modulo 2^32, block sums are still exact as long as a single
+  // block sums to less than 2^32. Reused between frames of the same size.
+  // The parallel loops run on other threads, so they have to capture the
+  // table by a plain reference.
+  thread_local cv::Mat sumTableStorage;
+  cv::Mat &sumTable = sumTableStorage;
+  sumTable.create(frame.rows + 1, frame.cols + 1, CV_32SC1);
+  sumTable.row(0).setTo(0);
+
+  const int rows = frame.rows;
+  const int cols = frame.cols;
+
+  // Prefix sums of every row, rows are independent
+  cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range &range) {
+    for (int y = range.start; y < range.end; y++) {
+      const uchar *pixel = frame.ptr<uchar>(y);
+      std::uint32_t *sum = sumTable.ptr<std::uint32_t>(y + 1);
+
+      // Channel sums first, this loop vectorizes
+      for (int x = 0; x < cols; x++) {
+        sum[x + 1] = static_cast<std::uint32_t>(pixel[3 * x]) +
+                     pixel[3 * x + 1] + pixel[3 * x + 2];
       }
 
-      // Calculate average luminance of the frame region
-      const unsigned long avg =
-          (sum_r + sum_g + sum_b) / (3 * blockSizeX * blockSizeY);
+      sum[0] = 0;
+      for (int x = 1; x <= cols; x++) {
+        sum[x] += sum[x - 1];
+      }
+    }
+  });
 
-      // TODO
-      // Do something with the average color
+  // Accumulate the rows down, every thread owns a strip of columns and adds
+  // whole rows, which vectorizes
+  constexpr int kStripWidth = 256;
+  const int strips = (cols + 1 + kStripWidth - 1) / kStripWidth;
+  cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range &range) {
+    const int begin = range.start * kStripWidth;
+    const int end = std::min(range.end * kStripWidth, cols + 1);
+    for (int y = 1; y <= rows; y++) {
+      const std::uint32_t *above = sumTable.ptr<std::uint32_t>(y - 1);
+      std::uint32_t *sum = sumTable.ptr<std::uint32_t>(y);
+      for (int x = begin; x < end; x++) {
+        sum[x] += above[x];
+      }
     }
-  }
+  });
+
+  luminance.create(numBlocksY, numBlocksX, CV_8UC1);
+
+  const std::uint32_t blockDivisor = 3 * blockSizeX * blockSizeY;
+
+  // Average luminance of every block from the four corners of the block
+  const cv::Range blockRows(0, static_cast<int>(numBlocksY));
+  cv::parallel_for_(blockRows, [&](const cv::Range &range) {
+    for (int j = range.start; j < range.end; j++) {
+      const std::uint32_t *top = sumTable.ptr<std::uint32_t>(j * blockSizeY);
+      const std::uint32_t *bottom =
+          sumTable.ptr<std::uint32_t>((j + 1) * blockSizeY);
+      uchar *avg = luminance.ptr<uchar>(j);
+
+      for (std::uint32_t i = 0; i < numBlocksX; i++) {
+        const std::uint32_t left = i * blockSizeX;
+        const std::uint32_t right = left + blockSizeX;
+        const std::uint32_t sum =
+            bottom[right] - bottom[left] - top[right] + top[left];
+
+        // Calculate average luminance of the frame region
+        avg[i] = static_cast<uchar>(sum / blockDivisor);
+      }
+    }
+  });
 }
 
 } // namespace mathboard
@@ -1,16 +1,34 @@
 #pragma once
 
+// local
+#include "image_processing.hpp"
+#include "stroke.hpp"
+
 // lib
 // OpenCV
 #include <opencv2/opencv.hpp>
 
 // std
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <mutex>
 #include <filesystem>
+#include <vector>
 
 namespace mathboard {
 
+// Everything extracted from a single video frame
+struct FrameResult {
+  std::uint32_t index{0};
+  // Average luminance of every block, see ConvertFrame
+  cv::Mat luminance{};
+  std::vector<Stroke> strokes{};
+};
+
+// Receives processed frames, always in frame order
+using FrameCallback = std::function<void(FrameResult &&)>;
+
 class OpenCVHelper {
 public:
   OpenCVHelper() = default;
@@ -24,12 +42,24 @@ public:
   // Open file
   void OpenFile(const std::filesystem::path &file);
 
-  // Render the whole video capture
-  void RenderVideo();
+  // Render the whole video capture. A decode thread fills a ring of reusable
+  // frames, `worker_count` threads (0 means one per core) convert them and
+  // extract strokes. Decoding waits whenever all `queue_size` frames are in
+  // flight.
+  void RenderVideo(const FrameCallback &callback = {},
+                   std::uint32_t worker_count = 0,
+                   std::uint32_t queue_size = 8);
 
-  // Convert a frame
+  // Convert a frame, the result is available through GetLuminance()
   void ConvertFrame(const std::uint32_t index);
 
+  // Convert the given BGR frame into a CV_8U matrix of average luminance of
+  // its blocks, about `size` blocks per column. `luminance` is reused when it
+  // already has the right size. Block sums come from a summed-area table, so
+  // every block costs O(1).
+  static void ConvertFrame(const cv::Mat &frame, const std::uint32_t size,
+                           cv::Mat &luminance);
+
   // Get framerate
   std::uint32_t GetFramerate() const {
     // Return framerate or 1 for images
@@ -49,6 +79,9 @@ public:
 
   cv::Mat GetFrame() const { return m_Frame; }
 
+  // Block luminance of the last frame converted by ConvertFrame(index)
+  cv::Mat GetLuminance() const { return m_Luminance; }
+
   // Get whether a video or an image is loaded
   bool IsVideo() const { return m_IsVideo; }
 
@@ -70,6 +103,11 @@ public:
     m_ShouldRender = should_render;
   }
 
+  // Set binarization used for stroke extraction from video frames
+  void SetBinarizationMethod(const BinarizationMethod method) {
+    m_Binarization = method;
+  }
+
   // Set current frame index
   void SetCurrentFrameIndex(const std::uint32_t index) {
     m_VideoCapture.set(cv::CAP_PROP_POS_FRAMES, index);
@@ -80,17 +118,23 @@ private: // Attributes
   bool m_IsVideo = false;
 
   // Should you contine rendering?
-  bool m_ShouldRender = false;
+  std::atomic<bool> m_ShouldRender = false;
 
   // Blocksize
   std::uint32_t m_Size = 1;
 
+  // Binarization of video frames before stroke extraction
+  BinarizationMethod m_Binarization = BinarizationMethod::Global;
+
   // Vidoe capture
   cv::VideoCapture m_VideoCapture{};
 
   // Video frame or image
   cv::Mat m_Frame{};
 
+  // Block luminance of m_Frame
+  cv::Mat m_Luminance{};
+
   // Make sure that the video capture does't get updated in two places
   // at the same time
   std::mutex m_MutexVideoCapture{};
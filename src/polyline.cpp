@@ -0,0 +1,81 @@
+// header
+#include "polyline.hpp"
+
+// libs
+// opencv
+#include <opencv2/imgproc.hpp>
+
+// std
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+namespace mathboard {
+
+std::vector<cv::Point> SimplifyPolyline(std::span<const cv::Point> points,
+                                        double tolerance, bool closed) {
+  std::vector<cv::Point> simplified;
+  if (points.size() < 3 || tolerance <= 0.0) {
+    simplified.assign(points.begin(), points.end());
+    return simplified;
+  }
+
+  // cv::approxPolyDP is Douglas-Peucker, wrap the span without copying
+  const cv::Mat input(static_cast<int>(points.size()), 1, CV_32SC2,
+                      const_cast<cv::Point *>(points.data()));
+  cv::approxPolyDP(input, simplified, tolerance, closed);
+  return simplified;
+}
+
+EncodedPolyline EncodePolyline(std::span<const cv::Point> points) {
+  EncodedPolyline encoded{};
+  if (points.empty()) {
+    return encoded;
+  }
+
+  constexpr int kMaxStep = std::numeric_limits<std::int16_t>::max();
+
+  encoded.origin = points.front();
+  encoded.point_count = 1;
+  encoded.deltas.reserve(2 * (points.size() - 1));
+
+  for (std::size_t i = 1; i < points.size(); i++) {
+    int dx = points[i].x - points[i - 1].x;
+    int dy = points[i].y - points[i - 1].y;
+
+    // Split the step into pieces that fit into int16
+    const int steps = 1 + std::max(std::abs(dx), std::abs(dy)) / (kMaxStep + 1);
+    for (int step = steps; step > 0; step--) {
+      const int step_dx = dx / step;
+      const int step_dy = dy / step;
+      encoded.deltas.push_back(static_cast<std::int16_t>(step_dx));
+      encoded.deltas.push_back(static_cast<std::int16_t>(step_dy));
+      encoded.point_count++;
+      dx -= step_dx;
+      dy -= step_dy;
+    }
+  }
+
+  return encoded;
+}
+
+std::vector<cv::Point> DecodePolyline(const EncodedPolyline &polyline) {
+  std::vector<cv::Point> points;
+  if (polyline.point_count == 0) {
+    return points;
+  }
+
+  points.reserve(polyline.point_count);
+  points.push_back(polyline.origin);
+
+  cv::Point current = polyline.origin;
+  for (std::size_t i = 0; i + 1 < polyline.deltas.size(); i += 2) {
+    current.x += polyline.deltas[i];
+    current.y += polyline.deltas[i + 1];
+    points.push_back(current);
+  }
+
+  return points;
+}
+
+} // namespace mathboard
@@ -0,0 +1,38 @@
+#pragma once
+
+// libs
+// opencv
+#include <opencv2/core/types.hpp>
+
+// std
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace mathboard {
+
+// Polyline stored as its first point followed by int16 deltas between
+// consecutive points. A contour point takes 4 bytes instead of 8 and deltas
+// compress well when cached or sent over the wire.
+struct EncodedPolyline {
+  // Number of points of the decoded polyline
+  std::uint32_t point_count{0};
+  // First point, absolute coordinates
+  cv::Point origin{0, 0};
+  // Interleaved dx, dy of every following point
+  std::vector<std::int16_t> deltas{};
+};
+
+// Simplify the contour with Douglas-Peucker, `tolerance` is the maximal
+// distance in pixels of the removed points from the simplified polyline
+std::vector<cv::Point> SimplifyPolyline(std::span<const cv::Point> points,
+                                        double tolerance, bool closed = true);
+
+// Delta encode the points. Steps too long for int16 are split, so decoding
+// can return a few extra collinear points.
+EncodedPolyline EncodePolyline(std::span<const cv::Point> points);
+
+// Return the absolute points of the encoded polyline
+std::vector<cv::Point> DecodePolyline(const EncodedPolyline &polyline);
+
+} // namespace mathboard
@@ -0,0 +1,37 @@
+// header
+#include "request_board_id.hpp"
+
+namespace mathboard {
+
+namespace {
+
+// boardId of a board or stroke, -1 unless it's an integer
+std::int64_t GetBoardId(const nlohmann::json &object) {
+  const auto boardId = object.find("boardId");
+  if (boardId != object.end() && boardId->is_number_integer()) {
+    return boardId->get<std::int64_t>();
+  }
+  return -1;
+}
+
+} // namespace
+
+std::int64_t GetRequestBoardId(const nlohmann::json &request) {
+  // Malformed requests fail in the pipeline, not here
+  const auto boardId = request.find("boardId");
+  if (boardId != request.end() && boardId->is_number_integer()) {
+    return boardId->get<std::int64_t>();
+  }
+  const auto board = request.find("board");
+  if (board != request.end() && board->is_object()) {
+    return GetBoardId(*board);
+  }
+  const auto strokes = request.find("strokes");
+  if (strokes != request.end() && strokes->is_array() && !strokes->empty() &&
+      strokes->front().is_object()) {
+    return GetBoardId(strokes->front());
+  }
+  return -1;
+}
+
+} // namespace mathboard
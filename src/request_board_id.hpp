@@ -0,0 +1,16 @@
+#pragma once
+
+// libs
+// json
+#include <nlohmann/json.hpp>
+
+// std
+#include <cstdint>
+
+namespace mathboard {
+
+// boardId of the message (session deltas), of the board or of the first
+// stroke, -1 without any
+std::int64_t GetRequestBoardId(const nlohmann::json &request);
+
+} // namespace mathboard
@@ -0,0 +1,225 @@
+// header
+#include "request_pipeline.hpp"
+
+// local
+#include "image_processing.hpp"
+#include "opencv_helper.hpp"
+#include "tracing/tracer.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <iterator>
+#include <optional>
+#include <utility>
+
+namespace mathboard {
+
+namespace {
+
+RequestPipeline::StageOptions
+GetStageOptions(const RequestPipelineOptions &options,
+                const std::string &name) {
+  RequestPipeline::StageOptions stageOptions{};
+  const auto concurrency = options.stage_concurrency.find(name);
+  if (concurrency != options.stage_concurrency.end()) {
+    stageOptions.concurrency = concurrency->second;
+  }
+  stageOptions.queue_size = options.stage_queue_size;
+  return stageOptions;
+}
+
+bool Decode(RequestWork &work) {
+  MATHBOARD_TRACE_CONTEXT(work.request_id, work.board_id);
+  MATHBOARD_TRACE_SCOPE("RequestPipeline::Decode");
+  OpenCVHelper opencvHelper{};
+  if (work.request.contains("board")) {
+    opencvHelper.OpenFile(work.request["board"]["path"]);
+    work.images.push_back(opencvHelper.GetFrame());
+    return true;
+  }
+
+  auto &strokesData = work.request["strokes"];
+  work.images.reserve(strokesData.size());
+  for (auto &strokeData : strokesData) {
+    opencvHelper.OpenFile(strokeData["path"]);
+    work.images.push_back(opencvHelper.GetFrame());
+  }
+  return true;
+}
+
+bool Preprocess(RequestWork &work) {
+  MATHBOARD_TRACE_CONTEXT(work.request_id, work.board_id);
+  MATHBOARD_TRACE_SCOPE("RequestPipeline::Preprocess");
+  if (work.request.contains("board")) {
+    const std::string binarizationName =
+        work.request["board"].value("binarization", "global");
+    const std::optional<BinarizationMethod> binarization =
+        ParseBinarizationMethod(binarizationName);
+    if (!binarization) {
+      work.error = "Unknown binarization method " + binarizationName;
+      spdlog::error("[RequestPipeline::Preprocess]: {}.\n", work.error);
+      return false;
+    }
+    work.images[0] = BinarizeBoard(work.images[0], *binarization);
+    return true;
+  }
+
+  for (cv::Mat &image : work.images) {
+    image = GrayScaleImage(image);
+  }
+  return true;
+}
+
+bool Contour(RequestWork &work) {
+  MATHBOARD_TRACE_CONTEXT(work.request_id, work.board_id);
+  MATHBOARD_TRACE_SCOPE("RequestPipeline::Contour");
+  if (work.request.contains("board")) {
+    std::vector<Stroke> boardStrokes = SegmentBoard(work.images[0]);
+    work.strokes.assign(std::make_move_iterator(boardStrokes.begin()),
+                        std::make_move_iterator(boardStrokes.end()));
+  } else {
+    auto &strokesData = work.request["strokes"];
+    work.strokes.reserve(strokesData.size());
+    for (std::size_t i = 0; i != strokesData.size(); i++) {
+      auto &strokeData = strokesData[i];
+      work.strokes.emplace_back(strokeData["id"], strokeData["x"],
+                                strokeData["y"], work.images[i]);
+    }
+  }
+
+  // The images aren't needed anymore, give their buffers back
+  work.images.clear();
+  return true;
+}
+
+bool Simplify(RequestWork &work) {
+  MATHBOARD_TRACE_CONTEXT(work.request_id, work.board_id);
+  MATHBOARD_TRACE_SCOPE("RequestPipeline::Simplify");
+  const double simplifyTolerance =
+      work.request.value("simplifyTolerance", kDefaultSimplifyTolerance);
+  if (simplifyTolerance > 0.0) {
+    SimplifyStrokes(work.strokes, simplifyTolerance);
+  }
+  return true;
+}
+
+} // namespace
+
+std::unique_ptr<RequestWork> ArenaPool::CreateWork() {
+  std::unique_ptr<RequestArena> arena;
+  if (!m_Arenas.TryPop(arena)) {
+    arena = std::make_unique<RequestArena>();
+  }
+  return std::make_unique<RequestWork>(std::move(arena));
+}
+
+void ArenaPool::Release(std::unique_ptr<RequestWork> &work) {
+  // Destroy the request before releasing the memory its strokes use
+  std::unique_ptr<RequestArena> arena = std::move(work->arena);
+  work.reset();
+  arena->Reset();
+  m_Arenas.TryPush(std::move(arena));
+}
+
+void WriteStrokeJson(JsonWriter &writer, const Stroke &stroke,
+                     bool contours) {
+  const cv::Rect box = stroke.GetBoundingBox();
+  writer.BeginObject()
+      .Key("id")
+      .UInt(stroke.GetIndex())
+      .Key("x")
+      .Double(stroke.GetPosition().x)
+      .Key("y")
+      .Double(stroke.GetPosition().y)
+      .Key("boundingBox")
+      .BeginArray()
+      .Int(box.x)
+      .Int(box.y)
+      .Int(box.width)
+      .Int(box.height)
+      .EndArray();
+
+  if (contours) {
+    writer.Key("contours").BeginArray();
+    for (const auto &contour : stroke.GetContours()) {
+      writer.BeginArray();
+      for (const cv::Point &point : contour) {
+        writer.Int(point.x).Int(point.y);
+      }
+      writer.EndArray();
+    }
+    writer.EndArray();
+  }
+  writer.EndObject();
+}
+
+void AddRequestStages(RequestPipeline &pipeline,
+                      const RequestPipelineOptions &options, ArenaPool &arenas,
+                      RequestCallback on_finished, StageCallback on_dropped,
+                      StageCallback on_progress) {
+  const auto stage = [&on_progress](const std::string &name,
+                                    bool (*function)(RequestWork &)) {
+    return [name, function,
+            on_progress](std::unique_ptr<RequestWork> &work) {
+      if (!function(*work)) {
+        return false;
+      }
+      if (work->stream && on_progress) {
+        on_progress(*work, name);
+      }
+      return true;
+    };
+  };
+  pipeline.AddStage("decode", stage("decode", Decode),
+                    GetStageOptions(options, "decode"));
+  pipeline.AddStage("preprocess", stage("preprocess", Preprocess),
+                    GetStageOptions(options, "preprocess"));
+  pipeline.AddStage("contour", stage("contour", Contour),
+                    GetStageOptions(options, "contour"));
+  pipeline.AddStage("simplify", stage("simplify", Simplify),
+                    GetStageOptions(options, "simplify"));
+
+  pipeline.AddStage(
+      "finish",
+      [&arenas, on_finished = std::move(on_finished)](
+          std::unique_ptr<RequestWork> &work) {
+        Metrics::Observe(Stage::Request,
+                         std::chrono::steady_clock::now() - work->received);
+        if (on_finished) {
+          on_finished(*work);
+        }
+        arenas.Release(work);
+        return true;
+      },
+      GetStageOptions(options, "finish"));
+
+  pipeline.SetDropHandler(
+      [&arenas, on_dropped = std::move(on_dropped)](
+          std::unique_ptr<RequestWork> &work, const std::string &stage) {
+        if (on_dropped) {
+          on_dropped(*work, stage);
+        }
+        arenas.Release(work);
+      });
+}
+
+ScopedGauges RegisterPipelineGauges(const RequestPipeline &pipeline) {
+  ScopedGauges gauges{};
+  const auto stats = pipeline.GetStats();
+  for (std::size_t i = 0; i < stats.size(); i++) {
+    gauges.Register("pipeline_" + stats[i].name + "_queued",
+                    [&pipeline, i]() {
+                      return static_cast<double>(
+                          pipeline.GetStats()[i].queued);
+                    });
+    gauges.Register("pipeline_" + stats[i].name + "_busy", [&pipeline, i]() {
+      return static_cast<double>(pipeline.GetStats()[i].busy);
+    });
+  }
+  return gauges;
+}
+
+} // namespace mathboard
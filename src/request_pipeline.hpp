@@ -0,0 +1,119 @@
+#pragma once
+
+// local
+#include "concurrency/bounded_queue.hpp"
+#include "concurrency/pipeline.hpp"
+#include "json_writer.hpp"
+#include "memory/request_arena.hpp"
+#include "metrics/metrics.hpp"
+#include "request_board_id.hpp"
+#include "stroke.hpp"
+
+// libs
+// json
+#include <nlohmann/json.hpp>
+// opencv
+#include <opencv2/core/mat.hpp>
+
+// std
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace mathboard {
+
+// Default Douglas-Peucker tolerance of the stroke contours, in pixels
+constexpr double kDefaultSimplifyTolerance = 1.0;
+
+struct RequestPipelineOptions {
+  // Worker threads of the stages, 0 means one per core
+  std::map<std::string, std::size_t> stage_concurrency{{"decode", 2},
+                                                       {"preprocess", 2},
+                                                       {"contour", 0},
+                                                       {"simplify", 2},
+                                                       {"finish", 1}};
+  // Batches of requests waiting in front of every stage
+  std::size_t stage_queue_size{16};
+};
+
+// Request moving through the pipeline, in the format described in
+// daemon.hpp. Passed around by pointer, so `strokes` never moves away from
+// its arena.
+struct RequestWork {
+  explicit RequestWork(std::unique_ptr<RequestArena> request_arena)
+      : arena(std::move(request_arena)), strokes(arena->Resource()) {}
+
+  std::uint64_t request_id{0};
+  std::int64_t board_id{-1};
+  std::chrono::steady_clock::time_point received{};
+  nlohmann::json request{};
+  // Where the request came from, for reporting
+  std::string source{};
+  // Connection the daemon replies to, unused in batch mode
+  std::int32_t client_fd{-1};
+  std::uint64_t connection_id{0};
+  // Place of a session delta in its board's order, see BoardSessions
+  std::uint64_t session_sequence{0};
+  // Report the request after every stage, not only once it's finished
+  bool stream{false};
+  // Decoded images, the whole board or one per stroke
+  std::vector<cv::Mat> images{};
+  // Why a stage dropped the request
+  std::string error{};
+  // Backs `strokes`, declared before them so it outlives them
+  std::unique_ptr<RequestArena> arena;
+  std::pmr::vector<Stroke> strokes;
+};
+
+using RequestPipeline = Pipeline<std::unique_ptr<RequestWork>>;
+
+// Called by the finish stage with every processed request
+using RequestCallback = std::function<void(RequestWork &)>;
+// Called with a request and the name of a stage
+using StageCallback = std::function<void(RequestWork &, const std::string &)>;
+
+// Stroke as an object of the batch results and the streamed replies: id,
+// position, bounding box and, with `contours`, the flat x0, y0, x1, y1, ...
+// points of every contour
+void WriteStrokeJson(JsonWriter &writer, const Stroke &stroke, bool contours);
+
+// Arenas of finished requests, reused by the next ones. A request takes one
+// when it's created and returns it once it's done, so there are only ever as
+// many arenas as requests in flight.
+class ArenaPool {
+public:
+  explicit ArenaPool(std::size_t capacity = 256) : m_Arenas(capacity) {}
+
+  // Create a request backed by a pooled arena
+  std::unique_ptr<RequestWork> CreateWork();
+
+  // Destroy the request and keep its arena for the next one
+  void Release(std::unique_ptr<RequestWork> &work);
+
+private:
+  BoundedQueue<std::unique_ptr<RequestArena>> m_Arenas;
+};
+
+// decode -> preprocess -> contour -> simplify -> finish. Dropped requests go
+// to `on_dropped` with RequestWork::error set when the stage knew why.
+// Requests with RequestWork::stream set go to `on_progress` after each stage
+// before finish. The callbacks run on the pipeline's threads, before the
+// request is released.
+void AddRequestStages(RequestPipeline &pipeline,
+                      const RequestPipelineOptions &options, ArenaPool &arenas,
+                      RequestCallback on_finished,
+                      StageCallback on_dropped = {},
+                      StageCallback on_progress = {});
+
+// Queue depth and busy workers of every stage as `pipeline_<stage>_queued`
+// and `pipeline_<stage>_busy`, unregistered when the returned gauges are
+// destroyed. The pipeline must outlive them.
+ScopedGauges RegisterPipelineGauges(const RequestPipeline &pipeline);
+
+} // namespace mathboard
@@ -1,17 +1,26 @@
 // header
 #include "stroke.hpp"
 
+// local
+#include "metrics/metrics.hpp"
+#include "tracing/tracer.hpp"
+
 // libs
 //opencv
 #include <opencv2/core/mat.hpp>
+#include <opencv2/core/utility.hpp>
 #include <opencv2/imgproc.hpp>
 //spdlog
 #include <spdlog/spdlog.h>
 
+// std
+#include <algorithm>
+
 namespace mathboard {
 
 Stroke::Stroke(int index, float pos_x, float pos_y, cv::Mat grayscale_image)
     : m_Index(index), m_Position(cv::Point2f{pos_x, pos_y}) {
+  MATHBOARD_TRACE_SCOPE("Stroke::Stroke");
   if (grayscale_image.channels() != 1) {
     spdlog::error("[Stroke::Stroke]: grayscale_image isn't grayscale.\n");
   }
@@ -24,6 +33,7 @@ Stroke::Stroke(int index, float pos_x, float pos_y, cv::Mat grayscale_image)
 }
 Stroke::Stroke(int index, cv::Point2f position, cv::Mat grayscale_image)
     : m_Index(index), m_Position(position) {
+  MATHBOARD_TRACE_SCOPE("Stroke::Stroke");
   if (grayscale_image.channels() != 1) {
     spdlog::error("[Stroke::Stroke]: grayscale_image isn't grayscale.\n");
   }
@@ -35,4 +45,100 @@ Stroke::Stroke(int index, cv::Point2f position, cv::Mat grayscale_image)
   }
 }
 
+Stroke::Stroke(int index, cv::Point2f position)
+    : m_Index(index), m_Position(position), m_Open(true) {}
+
+void Stroke::AppendPoints(std::span<const cv::Point> points) {
+  if (points.empty()) {
+    return;
+  }
+  if (m_Contours.empty()) {
+    m_Contours.emplace_back();
+  }
+
+  // Only the new points are looked at, not the whole path again
+  int minX = points.front().x;
+  int minY = points.front().y;
+  int maxX = minX;
+  int maxY = minY;
+  for (const cv::Point &point : points) {
+    minX = std::min(minX, point.x);
+    minY = std::min(minY, point.y);
+    maxX = std::max(maxX, point.x);
+    maxY = std::max(maxY, point.y);
+  }
+  const cv::Rect added(minX, minY, maxX - minX + 1, maxY - minY + 1);
+  m_BoundingBox = m_Contours.front().empty() ? added : m_BoundingBox | added;
+
+  m_Contours.front().insert(m_Contours.front().end(), points.begin(),
+                            points.end());
+}
+
+void Stroke::MoveOriginToBoundingBox() {
+  const cv::Point offset = m_BoundingBox.tl();
+  for (auto &contour : m_Contours) {
+    for (cv::Point &point : contour) {
+      point -= offset;
+    }
+  }
+  m_BoundingBox -= offset;
+  m_Position += cv::Point2f(static_cast<float>(offset.x),
+                            static_cast<float>(offset.y));
+}
+
+std::vector<std::vector<cv::Point>> Stroke::GetContours() const {
+  if (!m_Contours.empty() || m_EncodedContours.empty()) {
+    return m_Contours;
+  }
+
+  std::vector<std::vector<cv::Point>> contours;
+  contours.reserve(m_EncodedContours.size());
+  for (const auto &encoded : m_EncodedContours) {
+    contours.push_back(DecodePolyline(encoded));
+  }
+  return contours;
+}
+
+std::size_t Stroke::GetMemoryUsage() const {
+  std::size_t usage = sizeof(Stroke);
+  for (const auto &contour : m_Contours) {
+    usage += sizeof(contour) + contour.capacity() * sizeof(cv::Point);
+  }
+  for (const auto &encoded : m_EncodedContours) {
+    usage += sizeof(encoded) + encoded.deltas.capacity() * sizeof(std::int16_t);
+  }
+  return usage;
+}
+
+void Stroke::Simplify(double tolerance) {
+  // Already simplified
+  if (m_Contours.empty()) {
+    return;
+  }
+
+  m_EncodedContours.clear();
+  m_EncodedContours.reserve(m_Contours.size());
+  for (const auto &contour : m_Contours) {
+    m_EncodedContours.push_back(
+        EncodePolyline(SimplifyPolyline(contour, tolerance, !m_Open)));
+  }
+
+  // Free the raw points
+  std::vector<std::vector<cv::Point>>().swap(m_Contours);
+}
+
+void SimplifyStrokes(std::span<Stroke> strokes, double tolerance) {
+  MATHBOARD_TRACE_SCOPE("SimplifyStrokes");
+  const StageTimer stageTimer(Stage::Simplify);
+  MATHBOARD_TRACE_CAPTURE_CONTEXT(traceContext);
+
+  cv::parallel_for_(cv::Range(0, static_cast<int>(strokes.size())),
+                    [&](const cv::Range &range) {
+                      MATHBOARD_TRACE_CONTEXT(traceContext);
+                      for (int i = range.start; i < range.end; i++) {
+                        strokes[i].Simplify(tolerance);
+                      }
+                    });
+}
+
 } // namespace mathboard
@@ -1,9 +1,18 @@
 #pragma once
 
+// local
+#include "polyline.hpp"
+
 // libs
 // OpenCV
 #include <opencv2/core/types.hpp>
 
+// std
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
 namespace mathboard {
 
 // class holding basic information about image of stroke
@@ -12,19 +21,55 @@ public:
   Stroke() = default;
   Stroke(int index, float pos_x, float pos_y, cv::Mat grayscale_image);
   Stroke(int index, cv::Point2f position, cv::Mat grayscale_image);
+  // Stroke drawn live, an open polyline grown with AppendPoints()
+  Stroke(int index, cv::Point2f position);
 
 public:
   cv::Point2f GetPosition() const { return m_Position; }
+  void SetPosition(cv::Point2f position) { m_Position = position; }
   cv::Rect GetBoundingBox() const { return m_BoundingBox; }
-  int GetWidth() const { return m_BoundingBox.height; }
-  int GetHeight() const { return m_BoundingBox.width; }
-  std::vector<std::vector<cv::Point>> GetContours() const { return m_Contours; }
+  // Bounding box at the stroke's position, in board pixels
+  cv::Rect GetBoardBoundingBox() const {
+    return cv::Rect(m_BoundingBox.x + static_cast<int>(m_Position.x),
+                    m_BoundingBox.y + static_cast<int>(m_Position.y),
+                    m_BoundingBox.width, m_BoundingBox.height);
+  }
+  int GetWidth() const { return m_BoundingBox.width; }
+  int GetHeight() const { return m_BoundingBox.height; }
+  std::vector<std::vector<cv::Point>> GetContours() const;
+  const std::vector<EncodedPolyline> &GetEncodedContours() const {
+    return m_EncodedContours;
+  }
   std::uint32_t GetIndex() const { return m_Index; }
+  // Bytes held by the stroke, its contours included
+  std::size_t GetMemoryUsage() const;
+
+  // Extend the polyline of a live stroke with points relative to its
+  // position, the bounding box grows with them. Only before Simplify().
+  void AppendPoints(std::span<const cv::Point> points);
+
+  // Move the position to the top-left corner of the bounding box and the
+  // points with it, the stroke stays where it is on the board. Objects are
+  // indexed from their position, e.g. by the Grid. Only before Simplify().
+  void MoveOriginToBoundingBox();
+
+  // Simplify the contours with the given tolerance in pixels and keep only
+  // their delta encoded form. The bounding box stays unchanged.
+  void Simplify(double tolerance);
+
 private:
   std::uint32_t m_Index{0};
   cv::Point2f m_Position;
+  // Raw contours, released by Simplify()
   std::vector<std::vector<cv::Point>> m_Contours;
+  // Simplified contours, filled by Simplify()
+  std::vector<EncodedPolyline> m_EncodedContours;
   cv::Rect m_BoundingBox;
+  // Drawn live, the only contour is the pen's path and isn't closed
+  bool m_Open{false};
 };
 
+// Simplify contours of all the strokes, strokes are processed in parallel
+void SimplifyStrokes(std::span<Stroke> strokes, double tolerance);
+
 } // namespace mathboard
@@ -0,0 +1,65 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+// Maps keys to one of `node_count` nodes. Every node owns
+// `points_per_node` points on a ring of 64-bit hashes and a key goes to the
+// owner of the first point at or after its own hash, so adding or removing a
+// node only moves the keys next to its points, about 1 / node_count of them.
+class ConsistentHashRing {
+public:
+  explicit ConsistentHashRing(std::size_t node_count,
+                              std::size_t points_per_node = 128)
+      : m_NodeCount(node_count) {
+    m_Points.reserve(node_count * points_per_node);
+    for (std::size_t node = 0; node < node_count; node++) {
+      for (std::size_t point = 0; point < points_per_node; point++) {
+        m_Points.emplace_back(Hash((static_cast<std::uint64_t>(node) << 32) |
+                                   static_cast<std::uint64_t>(point)),
+                              node);
+      }
+    }
+    std::sort(m_Points.begin(), m_Points.end());
+  }
+
+  std::size_t GetNodeCount() const { return m_NodeCount; }
+
+  // Node owning `key`, 0 when the ring has no nodes
+  std::size_t GetNode(std::int64_t key) const {
+    if (m_Points.empty()) {
+      return 0;
+    }
+    const std::uint64_t hash = Hash(static_cast<std::uint64_t>(key));
+    auto point = std::lower_bound(
+        m_Points.begin(), m_Points.end(), hash,
+        [](const std::pair<std::uint64_t, std::size_t> &point,
+           std::uint64_t value) { return point.first < value; });
+    // Wraps around to the first point
+    if (point == m_Points.end()) {
+      point = m_Points.begin();
+    }
+    return point->second;
+  }
+
+  // splitmix64 finalizer, consecutive board ids end up far apart
+  static std::uint64_t Hash(std::uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+  }
+
+private:
+  std::size_t m_NodeCount;
+  // (hash, node), sorted by hash
+  std::vector<std::pair<std::uint64_t, std::size_t>> m_Points{};
+};
+
+} // namespace mathboard
@@ -0,0 +1,605 @@
+// header
+#include "supervisor.hpp"
+
+// local
+#include "consistent_hash_ring.hpp"
+#include "request_board_id.hpp"
+#include "unix_socket_server/handoff_socket_server.hpp"
+#include "unix_socket_server/message_framer.hpp"
+#include "unix_socket_server/unix_socket_server.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+// json
+#include <nlohmann/json.hpp>
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// linux std
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace mathboard {
+
+namespace {
+
+// A worker exiting sooner than that waits before it's started again, so a
+// worker that can't start doesn't turn into a fork loop
+constexpr std::chrono::seconds kRestartDelay{1};
+
+constexpr std::size_t kReadBufferSize = 64 * 1024;
+// Bytes queued for a connection that doesn't take them, past it the
+// connections feeding it aren't read anymore until it catches up
+constexpr std::size_t kMaxOutboundBytes = 4 * 1024 * 1024;
+
+// Written to by the signal handler, wakes up the poll
+std::atomic<int> g_SignalPipe{-1};
+std::atomic<bool> g_Stopping{false};
+
+void OnSignal(int signal) {
+  if (signal != SIGCHLD) {
+    g_Stopping.store(true);
+  }
+  const char byte = 0;
+  // Nothing to do if the pipe is full, it's readable already
+  [[maybe_unused]] const ssize_t written =
+      write(g_SignalPipe.load(), &byte, sizeof(byte));
+}
+
+class Supervisor {
+public:
+  Supervisor(const SupervisorOptions &options, const WorkerMain &worker_main)
+      : m_WorkerMain(worker_main),
+        m_Ring(options.workers != 0
+                   ? options.workers
+                   : std::max(1u, std::thread::hardware_concurrency())),
+        m_Workers(m_Ring.GetNodeCount()) {}
+
+  ~Supervisor() {
+    for (const auto &[clientFd, client] : m_Clients) {
+      m_Server->Close(clientFd);
+    }
+    for (const auto &[upstreamFd, upstream] : m_Upstreams) {
+      close(upstreamFd);
+    }
+    for (const Worker &worker : m_Workers) {
+      if (worker.channel_fd >= 0) {
+        close(worker.channel_fd);
+      }
+    }
+  }
+
+  bool Run(const std::filesystem::path &socket_path);
+
+private:
+  struct Worker {
+    pid_t pid{-1};
+    // Supervisor's end of the handoff channel
+    std::int32_t channel_fd{-1};
+    std::chrono::steady_clock::time_point started{};
+  };
+
+  struct Client {
+    // Connection to every worker, -1 until it sent the worker something
+    std::vector<std::int32_t> upstream_fds{};
+    MessageFramer requests{};
+  };
+
+  // Connection of a client to a worker, the worker has the other end
+  struct Upstream {
+    std::int32_t client_fd{-1};
+    std::size_t worker{0};
+    MessageFramer replies{};
+  };
+
+  // Bytes a non-blocking socket didn't take yet, sent once it's writable
+  struct Outbound {
+    std::string data{};
+    std::size_t sent{0};
+  };
+
+  bool StartWorker(std::size_t index, bool delayed);
+  void StopWorkers();
+  void ReapWorkers();
+  std::size_t Route(const nlohmann::json &message) const;
+  std::int32_t GetUpstream(std::int32_t client_fd, std::size_t worker);
+  void CloseUpstream(std::int32_t upstream_fd);
+  void CloseClient(std::int32_t client_fd);
+  void HandleClient(std::int32_t client_fd);
+  void HandleUpstream(std::int32_t upstream_fd);
+  // Queue the messages, a line each, and send what the socket takes right
+  // away. Return false when the connection failed.
+  bool Send(std::int32_t socket_fd,
+            const std::vector<std::string_view> &messages);
+  // Send queued bytes until the socket is full, false when it failed
+  bool Flush(std::int32_t socket_fd);
+  bool IsBacklogged(std::int32_t socket_fd) const;
+  // Read a client only while its workers take its requests, and a worker's
+  // connection only while the client takes its replies
+  short GetPollEvents(std::int32_t socket_fd) const;
+
+private:
+  const WorkerMain &m_WorkerMain;
+  std::unique_ptr<UnixSocketServer> m_Server{};
+  ConsistentHashRing m_Ring;
+  std::vector<Worker> m_Workers;
+  int m_SignalPipe[2]{-1, -1};
+
+  std::unordered_map<std::int32_t, Client> m_Clients{};
+  std::unordered_map<std::int32_t, Upstream> m_Upstreams{};
+  // The sockets are non-blocking, one slow reader mustn't stall the others
+  std::unordered_map<std::int32_t, Outbound> m_Outbound{};
+  // Closed at the end of a poll round, a new connection reusing the number
+  // would otherwise be taken for one that was ready
+  std::vector<std::int32_t> m_Closed{};
+
+  std::vector<pollfd> m_PollFds{};
+  std::vector<unsigned char> m_Buffer{};
+  // Messages of a read, per worker
+  std::vector<std::vector<std::string_view>> m_Routed{};
+  std::vector<std::string_view> m_Replies{};
+};
+
+bool Supervisor::StartWorker(std::size_t index, bool delayed) {
+  int channel[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) < 0) {
+    spdlog::error("[Supervisor::StartWorker]: Could not create the handoff "
+                  "channel.\n");
+    return false;
+  }
+
+  const pid_t supervisorPid = getpid();
+  const pid_t pid = fork();
+  if (pid < 0) {
+    spdlog::error("[Supervisor::StartWorker]: Could not fork worker {}.\n",
+                  index);
+    close(channel[0]);
+    close(channel[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    std::signal(SIGCHLD, SIG_DFL);
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    std::signal(SIGPIPE, SIG_DFL);
+    // Don't outlive the supervisor
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != supervisorPid) {
+      _exit(1);
+    }
+
+    // Only the channel is the worker's, copies of the supervisor's fds
+    // would keep its connections from ever seeing EOF
+    close(channel[0]);
+    close(m_Server->GetServerSocketFd());
+    close(m_SignalPipe[0]);
+    close(m_SignalPipe[1]);
+    for (const auto &[clientFd, client] : m_Clients) {
+      close(clientFd);
+    }
+    for (const auto &[upstreamFd, upstream] : m_Upstreams) {
+      close(upstreamFd);
+    }
+    for (const std::int32_t socketFd : m_Closed) {
+      close(socketFd);
+    }
+    for (const Worker &worker : m_Workers) {
+      if (worker.channel_fd >= 0) {
+        close(worker.channel_fd);
+      }
+    }
+
+    if (delayed) {
+      std::this_thread::sleep_for(kRestartDelay);
+    }
+    m_WorkerMain(index, channel[1]);
+    // Skip the destructors, they belong to the supervisor
+    _exit(0);
+  }
+
+  close(channel[1]);
+  Worker &worker = m_Workers[index];
+  if (worker.channel_fd >= 0) {
+    close(worker.channel_fd);
+  }
+  worker.pid = pid;
+  worker.channel_fd = channel[0];
+  worker.started = std::chrono::steady_clock::now();
+  spdlog::info("[Supervisor] - Worker {} started, pid {}.\n", index, pid);
+  return true;
+}
+
+void Supervisor::StopWorkers() {
+  for (const Worker &worker : m_Workers) {
+    if (worker.pid > 0) {
+      kill(worker.pid, SIGTERM);
+    }
+  }
+  for (Worker &worker : m_Workers) {
+    if (worker.pid > 0) {
+      waitpid(worker.pid, nullptr, 0);
+      worker.pid = -1;
+    }
+  }
+}
+
+void Supervisor::ReapWorkers() {
+  int status = 0;
+  pid_t pid;
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    for (std::size_t index = 0; index < m_Workers.size(); index++) {
+      Worker &worker = m_Workers[index];
+      if (worker.pid != pid) {
+        continue;
+      }
+      worker.pid = -1;
+      if (WIFSIGNALED(status)) {
+        spdlog::error("[Supervisor] - Worker {} was killed by signal {}.\n",
+                      index, WTERMSIG(status));
+      } else {
+        spdlog::error("[Supervisor] - Worker {} exited with status {}.\n",
+                      index, WEXITSTATUS(status));
+      }
+
+      if (!g_Stopping.load()) {
+        const bool delayed =
+            std::chrono::steady_clock::now() - worker.started < kRestartDelay;
+        StartWorker(index, delayed);
+      }
+    }
+  }
+}
+
+std::size_t Supervisor::Route(const nlohmann::json &message) const {
+  if (message.is_discarded()) {
+    // The worker replies with the error
+    return m_Ring.GetNode(-1);
+  }
+  const auto worker = message.find("worker");
+  if (worker != message.end() && worker->is_number_unsigned() &&
+      worker->get<std::size_t>() < m_Workers.size()) {
+    return worker->get<std::size_t>();
+  }
+  return m_Ring.GetNode(GetRequestBoardId(message));
+}
+
+std::int32_t Supervisor::GetUpstream(std::int32_t client_fd,
+                                     std::size_t worker) {
+  std::int32_t &upstreamFd = m_Clients[client_fd].upstream_fds[worker];
+  if (upstreamFd >= 0) {
+    return upstreamFd;
+  }
+
+  int pair[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+    spdlog::error("[Supervisor::GetUpstream]: Could not create the "
+                  "connection to worker {}.\n",
+                  worker);
+    return -1;
+  }
+  const bool handedOver = HandoffSocketServer::SendConnection(
+      m_Workers[worker].channel_fd, pair[1]);
+  close(pair[1]);
+  if (!handedOver) {
+    close(pair[0]);
+    return -1;
+  }
+
+  // Only our end, the worker's is a separate file description
+  fcntl(pair[0], F_SETFL, fcntl(pair[0], F_GETFL) | O_NONBLOCK);
+  upstreamFd = pair[0];
+  m_Upstreams[upstreamFd] = Upstream{client_fd, worker, {}};
+  return upstreamFd;
+}
+
+void Supervisor::CloseUpstream(std::int32_t upstream_fd) {
+  const auto upstream = m_Upstreams.find(upstream_fd);
+  if (upstream == m_Upstreams.end()) {
+    return;
+  }
+  const auto client = m_Clients.find(upstream->second.client_fd);
+  if (client != m_Clients.end()) {
+    client->second.upstream_fds[upstream->second.worker] = -1;
+  }
+  m_Upstreams.erase(upstream);
+  m_Outbound.erase(upstream_fd);
+  m_Closed.push_back(upstream_fd);
+}
+
+void Supervisor::CloseClient(std::int32_t client_fd) {
+  const auto client = m_Clients.find(client_fd);
+  if (client == m_Clients.end()) {
+    return;
+  }
+  // The workers see EOF and drop their end
+  for (const std::int32_t upstreamFd : client->second.upstream_fds) {
+    if (upstreamFd >= 0) {
+      m_Upstreams.erase(upstreamFd);
+      m_Outbound.erase(upstreamFd);
+      m_Closed.push_back(upstreamFd);
+    }
+  }
+  m_Clients.erase(client);
+  m_Outbound.erase(client_fd);
+  m_Closed.push_back(client_fd);
+}
+
+void Supervisor::HandleClient(std::int32_t client_fd) {
+  m_Buffer.resize(kReadBufferSize);
+  if (!m_Server->Read(client_fd, m_Buffer) || m_Buffer.empty()) {
+    CloseClient(client_fd);
+    return;
+  }
+
+  // Messages for the same worker go out together
+  MessageFramer &framer = m_Clients[client_fd].requests;
+  framer.Append(m_Buffer.data(), m_Buffer.size());
+  m_Routed.resize(m_Workers.size());
+  std::string_view message;
+  while (framer.Next(message)) {
+    const nlohmann::json request =
+        nlohmann::json::parse(message.begin(), message.end(), nullptr, false);
+    m_Routed[Route(request)].push_back(message);
+  }
+
+  for (std::size_t worker = 0; worker < m_Routed.size(); worker++) {
+    if (m_Routed[worker].empty()) {
+      continue;
+    }
+    const std::int32_t upstreamFd = GetUpstream(client_fd, worker);
+    if (upstreamFd < 0 || !Send(upstreamFd, m_Routed[worker])) {
+      spdlog::error("[Supervisor] - Could not forward {} messages to worker "
+                    "{}.\n",
+                    m_Routed[worker].size(), worker);
+      if (upstreamFd >= 0) {
+        CloseUpstream(upstreamFd);
+      }
+      // The client matches the replies to its requests by their requestId
+      std::vector<std::string> replies;
+      replies.reserve(m_Routed[worker].size());
+      for (const std::string_view routed : m_Routed[worker]) {
+        nlohmann::json reply{{"status", "error"},
+                             {"error", "Worker unavailable"}};
+        const nlohmann::json request = nlohmann::json::parse(
+            routed.begin(), routed.end(), nullptr, false);
+        if (request.is_object() && request.contains("requestId")) {
+          reply["requestId"] = request["requestId"];
+        }
+        replies.push_back(reply.dump());
+      }
+      if (!Send(client_fd, std::vector<std::string_view>(replies.begin(),
+                                                         replies.end()))) {
+        CloseClient(client_fd);
+        break;
+      }
+    }
+  }
+  for (std::vector<std::string_view> &routed : m_Routed) {
+    routed.clear();
+  }
+}
+
+void Supervisor::HandleUpstream(std::int32_t upstream_fd) {
+  Upstream &upstream = m_Upstreams.at(upstream_fd);
+
+  m_Buffer.resize(kReadBufferSize);
+  if (!m_Server->Read(upstream_fd, m_Buffer) || m_Buffer.empty()) {
+    // The worker went away, a restarted one gets a new connection
+    CloseUpstream(upstream_fd);
+    return;
+  }
+
+  // Only whole replies, those of other workers go to the same client
+  upstream.replies.Append(m_Buffer.data(), m_Buffer.size());
+  std::string_view reply;
+  while (upstream.replies.Next(reply)) {
+    m_Replies.push_back(reply);
+  }
+  if (m_Replies.empty()) {
+    return;
+  }
+  const std::int32_t clientFd = upstream.client_fd;
+  const bool sent = Send(clientFd, m_Replies);
+  m_Replies.clear();
+  if (!sent) {
+    CloseClient(clientFd);
+  }
+}
+
+bool Supervisor::Send(std::int32_t socket_fd,
+                      const std::vector<std::string_view> &messages) {
+  Outbound &outbound = m_Outbound[socket_fd];
+  // What was sent already isn't kept around
+  outbound.data.erase(0, outbound.sent);
+  outbound.sent = 0;
+  for (const std::string_view message : messages) {
+    outbound.data.append(message);
+    outbound.data.push_back('\n');
+  }
+  return Flush(socket_fd);
+}
+
+bool Supervisor::Flush(std::int32_t socket_fd) {
+  const auto found = m_Outbound.find(socket_fd);
+  if (found == m_Outbound.end()) {
+    return true;
+  }
+
+  Outbound &outbound = found->second;
+  while (outbound.sent < outbound.data.size()) {
+    const ssize_t written =
+        send(socket_fd, outbound.data.data() + outbound.sent,
+             outbound.data.size() - outbound.sent, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // The rest goes out once poll() says the socket is writable
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    outbound.sent += static_cast<std::size_t>(written);
+  }
+  m_Outbound.erase(found);
+  return true;
+}
+
+bool Supervisor::IsBacklogged(std::int32_t socket_fd) const {
+  const auto outbound = m_Outbound.find(socket_fd);
+  return outbound != m_Outbound.end() &&
+         outbound->second.data.size() - outbound->second.sent >
+             kMaxOutboundBytes;
+}
+
+short Supervisor::GetPollEvents(std::int32_t socket_fd) const {
+  bool backlogged = false;
+  const auto client = m_Clients.find(socket_fd);
+  if (client != m_Clients.end()) {
+    for (const std::int32_t upstreamFd : client->second.upstream_fds) {
+      backlogged = backlogged || (upstreamFd >= 0 && IsBacklogged(upstreamFd));
+    }
+  } else {
+    backlogged = IsBacklogged(m_Upstreams.at(socket_fd).client_fd);
+  }
+
+  short events = backlogged ? 0 : POLLIN;
+  if (m_Outbound.contains(socket_fd)) {
+    events |= POLLOUT;
+  }
+  return events;
+}
+
+bool Supervisor::Run(const std::filesystem::path &socket_path) {
+  m_Server.reset(UnixSocketServer::Instance(Transport::Socket));
+  if (!m_Server->Init(socket_path)) {
+    spdlog::error("[Supervisor] - Failed to initialize the Unix Socket "
+                  "Server.\n");
+    return false;
+  }
+
+  if (pipe2(m_SignalPipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+    spdlog::error("[Supervisor] - Could not create the signal pipe.\n");
+    return false;
+  }
+  g_Stopping = false;
+  g_SignalPipe = m_SignalPipe[1];
+  const auto previousChild = std::signal(SIGCHLD, OnSignal);
+  const auto previousInterrupt = std::signal(SIGINT, OnSignal);
+  const auto previousTerminate = std::signal(SIGTERM, OnSignal);
+  // A worker that went away shows up as EOF on its connections
+  const auto previousPipe = std::signal(SIGPIPE, SIG_IGN);
+
+  m_Server->Listen();
+  for (std::size_t index = 0; index < m_Workers.size(); index++) {
+    StartWorker(index, false);
+  }
+  spdlog::info("[Supervisor] - Server is listening, {} workers.\n",
+               m_Workers.size());
+
+  while (!g_Stopping.load()) {
+    m_PollFds.clear();
+    m_PollFds.push_back(pollfd{m_SignalPipe[0], POLLIN, 0});
+    m_PollFds.push_back(pollfd{m_Server->GetServerSocketFd(), POLLIN, 0});
+    for (const auto &[clientFd, client] : m_Clients) {
+      m_PollFds.push_back(pollfd{clientFd, GetPollEvents(clientFd), 0});
+    }
+    for (const auto &[upstreamFd, upstream] : m_Upstreams) {
+      m_PollFds.push_back(pollfd{upstreamFd, GetPollEvents(upstreamFd), 0});
+    }
+
+    if (poll(m_PollFds.data(), m_PollFds.size(), -1) < 0) {
+      if (errno != EINTR) {
+        spdlog::error("[Supervisor] - Failed to poll the connections.\n");
+      }
+      continue;
+    }
+
+    for (const pollfd &pollFd : m_PollFds) {
+      const std::int32_t socketFd = pollFd.fd;
+      if (pollFd.revents == 0) {
+        continue;
+      }
+
+      // Queued bytes first, that makes room for the replies read below
+      if ((pollFd.revents & POLLOUT) != 0 && !Flush(socketFd)) {
+        if (m_Clients.contains(socketFd)) {
+          CloseClient(socketFd);
+        } else {
+          CloseUpstream(socketFd);
+        }
+        continue;
+      }
+      // A hang up is reported as readable, reading it returns 0 bytes
+      if ((pollFd.revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+        continue;
+      }
+
+      if (socketFd == m_SignalPipe[0]) {
+        char bytes[64];
+        while (read(m_SignalPipe[0], bytes, sizeof(bytes)) > 0) {
+        }
+        ReapWorkers();
+      } else if (socketFd == m_Server->GetServerSocketFd()) {
+        void *client_addr = nullptr;
+        int client_fd;
+        if (!m_Server->Accept(client_fd, &client_addr)) {
+          spdlog::error("[Supervisor] - Failed to accept the connection.\n");
+          continue;
+        }
+        std::free(client_addr);
+        fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+        m_Clients[client_fd].upstream_fds.assign(m_Workers.size(), -1);
+      } else if (m_Clients.contains(socketFd)) {
+        HandleClient(socketFd);
+      } else if (m_Upstreams.contains(socketFd)) {
+        // Not closed by a client handled earlier in this round
+        HandleUpstream(socketFd);
+      }
+    }
+
+    for (const std::int32_t socketFd : m_Closed) {
+      m_Server->Close(socketFd);
+    }
+    m_Closed.clear();
+  }
+
+  spdlog::info("[Supervisor] - Stopping the workers.\n");
+  StopWorkers();
+
+  std::signal(SIGCHLD, previousChild);
+  std::signal(SIGINT, previousInterrupt);
+  std::signal(SIGTERM, previousTerminate);
+  std::signal(SIGPIPE, previousPipe);
+  g_SignalPipe = -1;
+  close(m_SignalPipe[0]);
+  close(m_SignalPipe[1]);
+  return true;
+}
+
+} // namespace
+
+bool RunSupervisor(const SupervisorOptions &options,
+                   const WorkerMain &worker_main) {
+  Supervisor supervisor(options, worker_main);
+  return supervisor.Run(options.socket_path);
+}
+
+} // namespace mathboard
@@ -0,0 +1,42 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+
+namespace mathboard {
+
+struct SupervisorOptions {
+  // Worker processes, 0 starts one per core
+  std::size_t workers{0};
+  std::filesystem::path socket_path{"socket.sock"};
+};
+
+// Runs in a forked worker: `channel_fd` is where the supervisor hands the
+// worker its connections, see HandoffSocketServer
+using WorkerMain =
+    std::function<void(std::size_t worker, std::int32_t channel_fd)>;
+
+// Bind the socket once and fork `options.workers` processes running
+// `worker_main`. Every message from a client is routed to the worker owning
+// its boardId on a ConsistentHashRing, so a board's caches stay warm in one
+// process; the message is forwarded over a socketpair per client and worker,
+// and the replies on it are passed back to the client. A `"worker": n` field
+// sends a message (e.g. a stats command) to worker n. The sockets are
+// non-blocking, what a connection doesn't take right away is queued until
+// it's writable, and a client isn't read while a worker is behind on its
+// requests (nor a worker while the client is behind on its replies).
+//
+// A worker that exits is forked again under the same index, so it gets the
+// same boards back (after a second's delay when it didn't live that long).
+// Requests it had in flight get no reply. SIGINT and SIGTERM stop the
+// workers and return.
+//
+// Has to be called while the process has a single thread: the workers are
+// forked from it. Return false when the socket can't be set up.
+bool RunSupervisor(const SupervisorOptions &options,
+                   const WorkerMain &worker_main);
+
+} // namespace mathboard
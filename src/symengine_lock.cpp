@@ -0,0 +1,19 @@
+// header
+#include "symengine_lock.hpp"
+
+// libs
+// symengine
+#include <symengine/symengine_config.h>
+
+namespace mathboard {
+
+std::unique_lock<std::mutex> LockSymEngine() {
+#ifdef WITH_SYMENGINE_THREAD_SAFE
+  return std::unique_lock<std::mutex>{};
+#else
+  static std::mutex mutexSymEngine{};
+  return std::unique_lock<std::mutex>(mutexSymEngine);
+#endif
+}
+
+} // namespace mathboard
@@ -0,0 +1,15 @@
+#pragma once
+
+// std
+#include <mutex>
+
+namespace mathboard {
+
+// SymEngine's reference counting is only atomic when it's built with
+// WITH_SYMENGINE_THREAD_SAFE, otherwise even unrelated expressions share
+// counted singletons (zero, one, ...) and only one thread may use SymEngine
+// at a time. Hold the returned lock while using SymEngine from threads, in
+// thread safe builds it doesn't lock anything.
+std::unique_lock<std::mutex> LockSymEngine();
+
+} // namespace mathboard
@@ -0,0 +1,411 @@
+// header
+#include "system_solver.hpp"
+
+// local
+#include "compiled_expression.hpp"
+#include "equation_parser.hpp"
+#include "symengine_lock.hpp"
+#include "tracing/tracer.hpp"
+
+// libs
+// opencv
+#include <opencv2/core.hpp>
+// spdlog
+#include <spdlog/spdlog.h>
+// symengine
+#include <symengine/eval_double.h>
+#include <symengine/subs.h>
+#include <symengine/visitor.h>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace mathboard {
+
+namespace {
+
+using ExpressionRef = SymEngine::RCP<const SymEngine::Basic>;
+using SymbolRef = SymEngine::RCP<const SymEngine::Symbol>;
+
+constexpr int kMaxNewtonSteps = 100;
+// Halvings of a Newton step that doesn't reduce the residual
+constexpr int kMaxStepHalvings = 30;
+// Largest |equation| accepted as solved
+constexpr double kResidualTolerance = 1e-9;
+// Newton starts away from 0, where log, division, ... aren't defined
+constexpr double kInitialGuess = 1.0;
+
+// Equations sharing symbols
+struct System {
+  std::vector<std::size_t> equations{};
+  std::vector<SymbolRef> symbols{};
+};
+
+// Representative of the union-find set of `i`
+std::size_t FindSet(std::vector<std::size_t> &parents, std::size_t i) {
+  while (parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+// Group equations connected by shared symbols, equations without symbols
+// don't belong to any system
+std::vector<System>
+GroupSystems(const std::vector<std::optional<ExpressionRef>> &expressions) {
+  std::vector<std::size_t> parents(expressions.size());
+  for (std::size_t i = 0; i < parents.size(); i++) {
+    parents[i] = i;
+  }
+
+  // First equation using each symbol, ordered by name
+  std::map<std::string, std::size_t> firstUse;
+  std::map<std::string, SymbolRef> symbols;
+  for (std::size_t i = 0; i < expressions.size(); i++) {
+    if (!expressions[i]) {
+      continue;
+    }
+    for (const auto &symbol : SymEngine::free_symbols(**expressions[i])) {
+      const std::string name = symbol->__str__();
+      const auto [it, inserted] = firstUse.emplace(name, i);
+      if (inserted) {
+        symbols.emplace(name,
+                        SymEngine::rcp_static_cast<const SymEngine::Symbol>(
+                            symbol));
+      } else {
+        parents[FindSet(parents, i)] = FindSet(parents, it->second);
+      }
+    }
+  }
+
+  // Systems ordered by their first equation
+  std::vector<System> systems;
+  std::unordered_map<std::size_t, std::size_t> systemIndex;
+  for (std::size_t i = 0; i < expressions.size(); i++) {
+    if (!expressions[i] || SymEngine::free_symbols(**expressions[i]).empty()) {
+      continue;
+    }
+    const auto [it, inserted] =
+        systemIndex.emplace(FindSet(parents, i), systems.size());
+    if (inserted) {
+      systems.emplace_back();
+    }
+    systems[it->second].equations.push_back(i);
+  }
+
+  for (const auto &[name, equation] : firstUse) {
+    systems[systemIndex.at(FindSet(parents, equation))].symbols.push_back(
+        symbols.at(name));
+  }
+
+  return systems;
+}
+
+// Fill A x = b of a linear system, return false when it isn't linear. Only
+// derivatives by the symbols of each equation are taken, the rest of the row
+// stays zero, so large sparse boards don't pay for every pair.
+bool BuildLinearSystem(const std::vector<ExpressionRef> &expressions,
+                       const std::vector<SymbolRef> &symbols, cv::Mat &A,
+                       cv::Mat &b) {
+  std::unordered_map<std::string, int> columns;
+  for (std::size_t j = 0; j < symbols.size(); j++) {
+    columns.emplace(symbols[j]->get_name(), static_cast<int>(j));
+  }
+
+  A = cv::Mat::zeros(static_cast<int>(expressions.size()),
+                     static_cast<int>(symbols.size()), CV_64F);
+  b = cv::Mat::zeros(static_cast<int>(expressions.size()), 1, CV_64F);
+
+  try {
+    for (std::size_t i = 0; i < expressions.size(); i++) {
+      const int row = static_cast<int>(i);
+      SymEngine::map_basic_basic zeros;
+      for (const auto &symbol : SymEngine::free_symbols(*expressions[i])) {
+        const auto sym =
+            SymEngine::rcp_static_cast<const SymEngine::Symbol>(symbol);
+        const ExpressionRef derivative = expressions[i]->diff(sym);
+        if (!SymEngine::free_symbols(*derivative).empty()) {
+          return false;
+        }
+        A.at<double>(row, columns.at(sym->get_name())) =
+            SymEngine::eval_double(*derivative);
+        zeros.emplace(symbol, SymEngine::zero);
+      }
+      b.at<double>(row) =
+          -SymEngine::eval_double(*expressions[i]->subs(zeros));
+    }
+  } catch (const std::exception &) {
+    // Coefficients which aren't real numbers
+    return false;
+  }
+
+  return cv::checkRange(A) && cv::checkRange(b);
+}
+
+// Solve A x = b and return the rank of A. Systems of lower rank than their
+// symbols get the minimum norm solution, inconsistent ones the least squares
+// solution, see IsConsistent.
+std::size_t SolveLinearSystem(const cv::Mat &A, const cv::Mat &b,
+                              std::vector<double> &values, double &residual) {
+  cv::Mat x;
+  std::size_t rank = static_cast<std::size_t>(A.cols);
+  if (A.rows != A.cols || !cv::solve(A, b, x, cv::DECOMP_LU)) {
+    const cv::SVD svd(A);
+    // Singular values within the rounding error of the largest are zero
+    const double tolerance = svd.w.at<double>(0) * std::max(A.rows, A.cols) *
+                             std::numeric_limits<double>::epsilon();
+    rank = static_cast<std::size_t>(cv::countNonZero(svd.w > tolerance));
+    svd.backSubst(b, x);
+  }
+
+  residual = cv::norm(A * x - b, cv::NORM_INF);
+  values.assign(x.begin<double>(), x.end<double>());
+  return rank;
+}
+
+// Whether the solution of A x = b with `residual` satisfies every equation
+bool IsConsistent(const cv::Mat &b, double residual) {
+  return residual <=
+         kResidualTolerance * std::max(1.0, cv::norm(b, cv::NORM_INF));
+}
+
+double MaxNorm(const std::vector<double> &values) {
+  double norm = 0.0;
+  for (const double value : values) {
+    if (!std::isfinite(value)) {
+      return std::numeric_limits<double>::infinity();
+    }
+    norm = std::max(norm, std::abs(value));
+  }
+  return norm;
+}
+
+// Equations of a non-linear system and the non-zero entries of their
+// Jacobian, compiled
+struct NonLinearSystem {
+  struct JacobianEntry {
+    int row;
+    int column;
+    CompiledExpression derivative;
+  };
+
+  std::vector<CompiledExpression> functions{};
+  std::vector<JacobianEntry> jacobian{};
+  std::size_t symbol_count{0};
+
+  // Whether evaluating the system runs bytecode only, without SymEngine
+  bool IsCompiled() const {
+    return std::all_of(functions.begin(), functions.end(),
+                       [](const CompiledExpression &function) {
+                         return function.IsCompiled();
+                       }) &&
+           std::all_of(jacobian.begin(), jacobian.end(),
+                       [](const JacobianEntry &entry) {
+                         return entry.derivative.IsCompiled();
+                       });
+  }
+};
+
+NonLinearSystem
+CompileNonLinearSystem(const std::vector<ExpressionRef> &expressions,
+                       const std::vector<SymbolRef> &symbols) {
+  NonLinearSystem system;
+  system.symbol_count = symbols.size();
+  system.functions.reserve(expressions.size());
+  for (std::size_t i = 0; i < expressions.size(); i++) {
+    system.functions.emplace_back(expressions[i], symbols);
+    for (std::size_t j = 0; j < symbols.size(); j++) {
+      if (!SymEngine::has_symbol(*expressions[i], *symbols[j])) {
+        continue;
+      }
+      system.jacobian.push_back(NonLinearSystem::JacobianEntry{
+          static_cast<int>(i), static_cast<int>(j),
+          CompiledExpression(expressions[i]->diff(symbols[j]), symbols)});
+    }
+  }
+  return system;
+}
+
+// Release the SymEngine lock for a scope that doesn't use SymEngine and take
+// it back at its end, exceptions included
+class ScopedUnlock {
+public:
+  ScopedUnlock(std::unique_lock<std::mutex> &lock, bool unlock)
+      : m_Lock(lock), m_Unlocked(unlock && lock.owns_lock()) {
+    if (m_Unlocked) {
+      m_Lock.unlock();
+    }
+  }
+  ~ScopedUnlock() {
+    if (m_Unlocked) {
+      m_Lock.lock();
+    }
+  }
+  ScopedUnlock(const ScopedUnlock &) = delete;
+  ScopedUnlock &operator=(const ScopedUnlock &) = delete;
+
+private:
+  std::unique_lock<std::mutex> &m_Lock;
+  bool m_Unlocked;
+};
+
+// Damped Newton iterations on the compiled equations and Jacobian, return
+// empty vector when they didn't converge
+std::vector<double>
+SolveNonLinearSystem(const NonLinearSystem &system,
+                     std::chrono::steady_clock::time_point deadline,
+                     double &residual) {
+  const std::vector<CompiledExpression> &functions = system.functions;
+  const auto &jacobian = system.jacobian;
+
+  const auto evaluate = [&functions](const std::vector<double> &point,
+                                     std::vector<double> &values) {
+    for (std::size_t i = 0; i < functions.size(); i++) {
+      values[i] = functions[i].EvaluatePoint(point);
+    }
+  };
+
+  std::vector<double> x(system.symbol_count, kInitialGuess);
+  std::vector<double> fx(functions.size());
+  std::vector<double> candidate(x.size());
+  std::vector<double> fCandidate(fx.size());
+  cv::Mat J(static_cast<int>(functions.size()),
+            static_cast<int>(system.symbol_count), CV_64F);
+  cv::Mat F(static_cast<int>(functions.size()), 1, CV_64F);
+  cv::Mat step;
+
+  evaluate(x, fx);
+  residual = MaxNorm(fx);
+
+  for (int iteration = 0; iteration < kMaxNewtonSteps; iteration++) {
+    if (residual < kResidualTolerance) {
+      return x;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+
+    J.setTo(0.0);
+    for (const NonLinearSystem::JacobianEntry &entry : jacobian) {
+      J.at<double>(entry.row, entry.column) =
+          entry.derivative.EvaluatePoint(x);
+    }
+    for (std::size_t i = 0; i < fx.size(); i++) {
+      F.at<double>(static_cast<int>(i)) = -fx[i];
+    }
+    if (!cv::checkRange(J)) {
+      // Derivative not defined at x
+      break;
+    }
+    if (J.rows != J.cols || !cv::solve(J, F, step, cv::DECOMP_LU)) {
+      cv::solve(J, F, step, cv::DECOMP_SVD);
+    }
+
+    // Halve the step until it reduces the residual
+    double scale = 1.0;
+    double candidateResidual = std::numeric_limits<double>::infinity();
+    for (int halving = 0; halving < kMaxStepHalvings; halving++) {
+      for (std::size_t j = 0; j < x.size(); j++) {
+        candidate[j] = x[j] + scale * step.at<double>(static_cast<int>(j));
+      }
+      evaluate(candidate, fCandidate);
+      candidateResidual = MaxNorm(fCandidate);
+      if (candidateResidual < residual) {
+        break;
+      }
+      scale *= 0.5;
+    }
+    if (!(candidateResidual < residual)) {
+      // Stuck in a local minimum of the residual
+      break;
+    }
+
+    x.swap(candidate);
+    fx.swap(fCandidate);
+    residual = candidateResidual;
+  }
+
+  if (residual < kResidualTolerance) {
+    return x;
+  }
+  return {};
+}
+
+} // namespace
+
+std::vector<SystemSolution>
+SolveSystems(const std::vector<std::string> &equations,
+             std::chrono::milliseconds budget) {
+  MATHBOARD_TRACE_SCOPE("SolveSystems");
+
+  std::unique_lock<std::mutex> lockSymEngine = LockSymEngine();
+
+  std::vector<std::optional<ExpressionRef>> expressions(equations.size());
+  for (std::size_t i = 0; i < equations.size(); i++) {
+    try {
+      expressions[i] = ParseEquation(equations[i]);
+    } catch (const std::exception &e) {
+      spdlog::error("[SolveSystems]: Could not parse equation {}: {}.\n",
+                    equations[i], e.what());
+    }
+  }
+
+  std::vector<SystemSolution> solutions;
+  for (const System &system : GroupSystems(expressions)) {
+    const auto start = std::chrono::steady_clock::now();
+
+    SystemSolution &solution = solutions.emplace_back();
+    solution.equations = system.equations;
+    for (const SymbolRef &symbol : system.symbols) {
+      solution.symbols.push_back(symbol->get_name());
+    }
+
+    std::vector<ExpressionRef> systemExpressions;
+    systemExpressions.reserve(system.equations.size());
+    for (const std::size_t equation : system.equations) {
+      systemExpressions.push_back(*expressions[equation]);
+    }
+
+    cv::Mat A;
+    cv::Mat b;
+    if (BuildLinearSystem(systemExpressions, system.symbols, A, b)) {
+      solution.kind = SystemKind::Linear;
+      std::vector<double> values;
+      solution.rank = SolveLinearSystem(A, b, values, solution.residual);
+      if (IsConsistent(b, solution.residual)) {
+        solution.unique = solution.rank == solution.symbols.size();
+        solution.values = std::move(values);
+      }
+    } else {
+      solution.kind = SystemKind::NonLinear;
+      const NonLinearSystem compiled =
+          CompileNonLinearSystem(systemExpressions, system.symbols);
+      // The iterations only run bytecode, let other threads use SymEngine.
+      // The lock is back before `compiled` releases its expressions.
+      const ScopedUnlock unlockSymEngine(lockSymEngine, compiled.IsCompiled());
+      solution.values =
+          SolveNonLinearSystem(compiled, start + budget, solution.residual);
+    }
+
+    solution.solve_time =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    SPDLOG_DEBUG("[SolveSystems]: {} system of {} equations in {} unknowns "
+                 "took {} us, residual {}.\n",
+                 solution.kind == SystemKind::Linear ? "Linear" : "Non-linear",
+                 solution.equations.size(), solution.symbols.size(),
+                 solution.solve_time.count(), solution.residual);
+  }
+
+  return solutions;
+}
+
+} // namespace mathboard
@@ -0,0 +1,50 @@
+#pragma once
+
+// local
+#include "equation_solver.hpp"
+
+// std
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mathboard {
+
+enum class SystemKind { Linear, NonLinear };
+
+// Solution of equations sharing symbols, solved together
+struct SystemSolution {
+  // Indices of the equations of the system in the solved board
+  std::vector<std::size_t> equations{};
+  // Unknowns of the system, sorted
+  std::vector<std::string> symbols{};
+  // Value of every symbol, empty when the system wasn't solved or has no
+  // solution
+  std::vector<double> values{};
+  SystemKind kind{SystemKind::Linear};
+  // Rank of a linear system's coefficient matrix, 0 for non-linear systems
+  std::size_t rank{0};
+  // Whether `values` is the only solution. Consistent linear systems of lower
+  // rank than their symbols have infinitely many, `values` then holds the one
+  // of minimum norm. Never set for non-linear systems, Newton's method finds
+  // one solution without telling whether there are others.
+  bool unique{false};
+  // Largest |equation| at the solution
+  double residual{0.0};
+  // Time spent building and solving the system
+  std::chrono::microseconds solve_time{0};
+};
+
+// Solve all sanitized equations of one board, see
+// EquationSolver::SanitizeEquation. Equations are grouped into systems by
+// shared symbols, e.g. `2*X+Y-(3)` and `X-Y-(0)` form one system of X and Y.
+// Linear systems are solved directly with LU decomposition, or with SVD when
+// they're singular, over or underdetermined. Inconsistent linear systems get
+// no values. Non-linear systems fall back to damped Newton iterations on the
+// Jacobian of the SymEngine derivatives, stopping at `budget` per system.
+std::vector<SystemSolution>
+SolveSystems(const std::vector<std::string> &equations,
+             std::chrono::milliseconds budget = kDefaultSolveBudget);
+
+} // namespace mathboard
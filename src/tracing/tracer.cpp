@@ -0,0 +1,195 @@
+// header
+#include "tracer.hpp"
+
+// local
+#include "../concurrency/periodic_export.hpp"
+#include "../concurrency/thread_registry.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+// posix
+#include <unistd.h>
+
+namespace mathboard {
+
+namespace {
+
+// Slot of the ring. Fields are relaxed atomics, plain stores on common CPUs,
+// so dumping while the owner overwrites a slot isn't a data race.
+struct EventSlot {
+  std::atomic<const char *> name{nullptr};
+  std::atomic<std::int64_t> start_ns{0};
+  std::atomic<std::int64_t> duration_ns{0};
+  std::atomic<std::uint64_t> request_id{0};
+  std::atomic<std::int64_t> board_id{-1};
+};
+
+std::uint32_t NextThreadId() {
+  static std::atomic<std::uint32_t> threadCount{0};
+  return ++threadCount;
+}
+
+// Ring of the events of one thread, written only by that thread
+struct ThreadBuffer {
+  std::uint32_t thread_id = NextThreadId();
+  std::array<EventSlot, Tracer::kThreadBufferSize> events{};
+  // Number of events ever written, published after the event
+  std::atomic<std::uint64_t> written{0};
+};
+
+// Newest events of exited threads, so short lived workers still show up in
+// the trace without keeping a ring per thread that ever traced
+struct RetiredEvents {
+  struct Event {
+    std::uint32_t thread_id;
+    TraceEvent event;
+  };
+
+  std::deque<Event> events{};
+};
+
+// Copy events still in the ring, oldest first
+void CopyEvents(const ThreadBuffer &buffer, std::vector<TraceEvent> &events) {
+  const std::uint64_t size = Tracer::kThreadBufferSize;
+  const std::uint64_t end = buffer.written.load(std::memory_order_acquire);
+  const std::uint64_t begin = end > size ? end - size : 0;
+
+  const std::size_t first = events.size();
+  for (std::uint64_t i = begin; i < end; i++) {
+    const EventSlot &slot = buffer.events[i % size];
+    events.push_back(TraceEvent{
+        slot.name.load(std::memory_order_relaxed),
+        slot.start_ns.load(std::memory_order_relaxed),
+        slot.duration_ns.load(std::memory_order_relaxed),
+        TraceContext{slot.request_id.load(std::memory_order_relaxed),
+                     slot.board_id.load(std::memory_order_relaxed)}});
+  }
+
+  // The writer kept going meanwhile, drop the slots it may have reused
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const std::uint64_t written = buffer.written.load(std::memory_order_acquire);
+  const std::uint64_t valid = written >= size ? written - size + 1 : 0;
+  if (valid > begin) {
+    const std::size_t overwritten =
+        static_cast<std::size_t>(std::min(valid, end) - begin);
+    events.erase(events.begin() + first, events.begin() + first + overwritten);
+  }
+}
+
+ThreadRegistry<ThreadBuffer, RetiredEvents> &GetRegistry() {
+  static ThreadRegistry<ThreadBuffer, RetiredEvents> registry(
+      [](const ThreadBuffer &buffer, RetiredEvents &retired) {
+        std::vector<TraceEvent> events;
+        CopyEvents(buffer, events);
+        for (const TraceEvent &event : events) {
+          retired.events.push_back(
+              RetiredEvents::Event{buffer.thread_id, event});
+        }
+        while (retired.events.size() > Tracer::kThreadBufferSize) {
+          retired.events.pop_front();
+        }
+      });
+  return registry;
+}
+
+PeriodicExport &GetContinuousDump() {
+  // The dump thread reads the registry until it's joined, construct the
+  // registry first so it's destroyed last
+  GetRegistry();
+  static PeriodicExport dump{};
+  return dump;
+}
+
+// Complete event, timestamps in microseconds
+void WriteEvent(std::ostream &output, int pid, std::uint32_t thread_id,
+                const TraceEvent &event) {
+  output << "\n{\"name\":\"" << event.name
+         << "\",\"cat\":\"mathboard\",\"ph\":\"X\",\"pid\":" << pid
+         << ",\"tid\":" << thread_id
+         << ",\"ts\":" << static_cast<double>(event.start_ns) / 1000.0
+         << ",\"dur\":" << static_cast<double>(event.duration_ns) / 1000.0
+         << ",\"args\":{\"requestId\":" << event.context.request_id
+         << ",\"boardId\":" << event.context.board_id << "}}";
+}
+
+} // namespace
+
+void Tracer::Record(const char *name, std::int64_t start_ns,
+                    std::int64_t end_ns) {
+  ThreadBuffer &buffer = GetRegistry().Local();
+  const TraceContext &context = CurrentContext();
+  const std::uint64_t index = buffer.written.load(std::memory_order_relaxed);
+  EventSlot &slot = buffer.events[index % kThreadBufferSize];
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.start_ns.store(start_ns, std::memory_order_relaxed);
+  slot.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+  slot.request_id.store(context.request_id, std::memory_order_relaxed);
+  slot.board_id.store(context.board_id, std::memory_order_relaxed);
+  buffer.written.store(index + 1, std::memory_order_release);
+}
+
+TraceContext &Tracer::CurrentContext() {
+  thread_local TraceContext context{};
+  return context;
+}
+
+void Tracer::WriteChromeTrace(std::ostream &output) {
+  // Taken together, a thread exiting meanwhile is in exactly one of them
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  std::deque<RetiredEvents::Event> retired;
+  GetRegistry().Read(
+      [&](const std::vector<std::shared_ptr<ThreadBuffer>> &running,
+          const RetiredEvents &exited) {
+        buffers = running;
+        retired = exited.events;
+      });
+
+  const int pid = static_cast<int>(getpid());
+  std::vector<TraceEvent> events;
+
+  const std::ios::fmtflags flags = output.flags();
+  const std::streamsize precision = output.precision();
+  output << std::fixed << std::setprecision(3);
+
+  output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const RetiredEvents::Event &event : retired) {
+    output << (first ? "" : ",");
+    WriteEvent(output, pid, event.thread_id, event.event);
+    first = false;
+  }
+  for (const auto &buffer : buffers) {
+    events.clear();
+    CopyEvents(*buffer, events);
+
+    for (const TraceEvent &event : events) {
+      output << (first ? "" : ",");
+      WriteEvent(output, pid, buffer->thread_id, event);
+      first = false;
+    }
+  }
+  output << "\n]}\n";
+
+  output.flags(flags);
+  output.precision(precision);
+}
+
+bool Tracer::DumpChromeTrace(const std::filesystem::path &path) {
+  return WriteFileAtomically(path, WriteChromeTrace);
+}
+
+void Tracer::StartContinuousDump(const std::filesystem::path &path,
+                                 std::chrono::milliseconds interval) {
+  GetContinuousDump().Start(path, interval, WriteChromeTrace);
+}
+
+void Tracer::StopContinuousDump() { GetContinuousDump().Stop(); }
+
+} // namespace mathboard
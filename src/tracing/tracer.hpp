@@ -0,0 +1,140 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+namespace mathboard {
+
+// Request the current thread works on, every span recorded meanwhile is
+// tagged with it
+struct TraceContext {
+  std::uint64_t request_id{0};
+  // -1 when the request isn't bound to a board
+  std::int64_t board_id{-1};
+};
+
+// Completed span
+struct TraceEvent {
+  // String literal, never copied nor freed
+  const char *name{nullptr};
+  std::int64_t start_ns{0};
+  std::int64_t duration_ns{0};
+  TraceContext context{};
+};
+
+// Collects spans into per-thread ring buffers. Each thread only ever writes
+// its own buffer, so recording is a handful of relaxed stores without any
+// lock or read-modify-write. Dumping reads the buffers concurrently and drops
+// events overwritten while they were being copied. The buffer of a thread is
+// released when it exits, its newest events move to a ring shared by all
+// exited threads.
+//
+// Spans are only recorded in builds with MATHBOARD_ENABLE_TRACING, use the
+// MATHBOARD_TRACE_* macros, they compile to nothing otherwise.
+class Tracer {
+public:
+  // Events kept per thread, the oldest are overwritten. Dumps skip the slot
+  // the owner may be writing, so they hold one event less once it's full.
+  static constexpr std::size_t kThreadBufferSize = 8192;
+
+  // Nanoseconds of the steady clock
+  static std::int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static void Record(const char *name, std::int64_t start_ns,
+                     std::int64_t end_ns);
+
+  // Context of the calling thread
+  static TraceContext &CurrentContext();
+
+  // Write every buffered event as Chrome trace-event JSON, open it in
+  // chrome://tracing or ui.perfetto.dev
+  static void WriteChromeTrace(std::ostream &output);
+
+  // Write the trace to `path`, replacing it atomically
+  static bool DumpChromeTrace(const std::filesystem::path &path);
+
+  // Rewrite `path` with the buffered events every `interval` from a
+  // background thread. The per-thread rings bound the file size, it always
+  // holds the most recent events. Restarts the dump when already running.
+  static void StartContinuousDump(const std::filesystem::path &path,
+                                  std::chrono::milliseconds interval);
+
+  static void StopContinuousDump();
+};
+
+// Records the lifetime of the object as a span
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name)
+      : m_Name(name), m_Start(Tracer::Now()) {}
+
+  ~TraceSpan() { Tracer::Record(m_Name, m_Start, Tracer::Now()); }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *m_Name;
+  std::int64_t m_Start;
+};
+
+// Sets the context of the calling thread, the previous one is restored on
+// destruction
+class TraceContextScope {
+public:
+  explicit TraceContextScope(const TraceContext &context)
+      : m_Previous(Tracer::CurrentContext()) {
+    Tracer::CurrentContext() = context;
+  }
+
+  TraceContextScope(std::uint64_t request_id, std::int64_t board_id)
+      : TraceContextScope(TraceContext{request_id, board_id}) {}
+
+  ~TraceContextScope() { Tracer::CurrentContext() = m_Previous; }
+
+  TraceContextScope(const TraceContextScope &) = delete;
+  TraceContextScope &operator=(const TraceContextScope &) = delete;
+
+private:
+  TraceContext m_Previous;
+};
+
+} // namespace mathboard
+
+#ifdef MATHBOARD_ENABLE_TRACING
+
+#define MATHBOARD_TRACE_CONCAT_IMPL(a, b) a##b
+#define MATHBOARD_TRACE_CONCAT(a, b) MATHBOARD_TRACE_CONCAT_IMPL(a, b)
+
+// Record the rest of the enclosing scope as span `name`, a string literal
+#define MATHBOARD_TRACE_SCOPE(name)                                           \
+  const ::mathboard::TraceSpan MATHBOARD_TRACE_CONCAT(traceSpan_,            \
+                                                      __LINE__)(name)
+
+// Tag spans of the rest of the enclosing scope with the request and board,
+// or with a TraceContext captured on another thread
+#define MATHBOARD_TRACE_CONTEXT(...)                                          \
+  const ::mathboard::TraceContextScope MATHBOARD_TRACE_CONCAT(                \
+      traceContext_, __LINE__)(__VA_ARGS__)
+
+// Copy the calling thread's context into `variable`, to hand it to
+// MATHBOARD_TRACE_CONTEXT on other threads
+#define MATHBOARD_TRACE_CAPTURE_CONTEXT(variable)                             \
+  const ::mathboard::TraceContext variable =                                  \
+      ::mathboard::Tracer::CurrentContext()
+
+#else
+
+#define MATHBOARD_TRACE_SCOPE(name) static_cast<void>(0)
+#define MATHBOARD_TRACE_CONTEXT(...) static_cast<void>(0)
+#define MATHBOARD_TRACE_CAPTURE_CONTEXT(variable) static_cast<void>(0)
+
+#endif
@@ -0,0 +1,50 @@
+// header
+#include "traffic_recorder.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+// json
+#include <nlohmann/json.hpp>
+
+// std
+#include <string>
+
+namespace mathboard {
+
+bool TrafficRecorder::Open(const std::filesystem::path &path) {
+  m_File.open(path, std::ios::out | std::ios::trunc);
+  if (!m_File) {
+    spdlog::error("[TrafficRecorder::Open]: Could not open {}.\n",
+                  path.string());
+    return false;
+  }
+  m_Start = std::chrono::steady_clock::now();
+  m_LastFlush = m_Start;
+  return true;
+}
+
+void TrafficRecorder::Record(std::uint64_t connection,
+                             std::string_view request) {
+  if (!m_File.is_open()) {
+    return;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  const nlohmann::json line{
+      {"offsetUs",
+       std::chrono::duration_cast<std::chrono::microseconds>(now - m_Start)
+           .count()},
+      {"connection", connection},
+      // Kept as text, so malformed requests are replayed as they came
+      {"request", std::string(request)}};
+  m_File << line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace)
+         << '\n';
+
+  if (now - m_LastFlush >= std::chrono::seconds(1)) {
+    m_File.flush();
+    m_LastFlush = now;
+  }
+}
+
+} // namespace mathboard
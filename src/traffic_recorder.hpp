@@ -0,0 +1,40 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+
+namespace mathboard {
+
+/*
+Capture of the requests a daemon received, replayed by
+tools/load_generator. One JSON object per line:
+```
+{
+  offsetUs: number;     // since the recording started
+  connection: number;   // id of the client connection
+  request: string;      // one message, as the client sent it
+}
+```
+*/
+class TrafficRecorder {
+public:
+  // Start a new capture at `path`, truncating it
+  bool Open(const std::filesystem::path &path);
+
+  bool IsOpen() const { return m_File.is_open(); }
+
+  // Append a message. Only called from the daemon loop, the file is flushed
+  // about once a second rather than after every request.
+  void Record(std::uint64_t connection, std::string_view request);
+
+private:
+  std::ofstream m_File{};
+  std::chrono::steady_clock::time_point m_Start{};
+  std::chrono::steady_clock::time_point m_LastFlush{};
+};
+
+} // namespace mathboard
@@ -0,0 +1,265 @@
+// header
+#include "connection_registry.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <cerrno>
+
+// linux std
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace mathboard {
+
+namespace {
+
+// Forget what's queued for a connection that can't be written anymore
+void DropQueued(std::vector<std::string> &queued, std::size_t &queued_bytes) {
+  for (const std::string &message : queued) {
+    queued_bytes -= message.size();
+  }
+  queued.clear();
+}
+
+std::size_t CountBytes(const PendingWrite &pending) {
+  std::size_t bytes = 0;
+  for (const std::string &message : pending.messages) {
+    bytes += message.size();
+  }
+  return bytes;
+}
+
+} // namespace
+
+ConnectionRegistry::ConnectionRegistry(UnixSocketServer &server)
+    : m_Server(server) {
+  if (pipe2(m_WakePipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+    spdlog::error("[ConnectionRegistry::ConnectionRegistry]: Could not "
+                  "create the flusher's pipe.\n");
+  }
+  m_Flusher = std::thread([this]() { FlushBacklog(); });
+}
+
+ConnectionRegistry::~ConnectionRegistry() {
+  {
+    std::lock_guard lock(m_Mutex);
+    m_Stopping = true;
+  }
+  Wake();
+  m_Flusher.join();
+
+  for (const auto &[socketFd, connection] : m_Connections) {
+    m_Server.Close(socketFd);
+  }
+  for (const int fd : m_WakePipe) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+std::uint64_t ConnectionRegistry::Add(std::int32_t socket_fd) {
+  std::lock_guard lock(m_Mutex);
+  const std::uint64_t id = m_NextId++;
+  auto connection = std::make_shared<Connection>();
+  connection->id = id;
+  m_Connections[socket_fd] = std::move(connection);
+  return id;
+}
+
+void ConnectionRegistry::Remove(std::int32_t socket_fd) {
+  // Closed under the lock, no writer can get the fd once it's reused
+  std::unique_lock lock(m_Mutex);
+  const auto connection = m_Connections.find(socket_fd);
+  if (connection == m_Connections.end()) {
+    return;
+  }
+  const std::shared_ptr<Connection> removed = connection->second;
+  m_Connections.erase(connection);
+  // The flusher could wait for a client that stopped reading, fail its
+  // write instead. The fd stays open until the writer is done.
+  m_Server.Shutdown(socket_fd);
+  Wake();
+  m_WriteDone.wait(lock, [&removed]() { return !removed->writing; });
+  m_Server.Close(socket_fd);
+}
+
+bool ConnectionRegistry::Write(std::int32_t socket_fd, std::uint64_t id,
+                               std::string msg) {
+  std::unique_lock lock(m_Mutex);
+  const auto found = m_Connections.find(socket_fd);
+  if (found == m_Connections.end() || found->second->id != id ||
+      found->second->overflowed) {
+    return false;
+  }
+  const std::shared_ptr<Connection> connection = found->second;
+  if (connection->queued_bytes + msg.size() > kMaxQueuedBytes) {
+    spdlog::error("[ConnectionRegistry::Write]: More than {} bytes queued "
+                  "for a client, disconnecting it.\n",
+                  kMaxQueuedBytes);
+    connection->overflowed = true;
+    DropQueued(connection->queued, connection->queued_bytes);
+    // The writer drops the unsent rest once its write fails
+    m_Server.Shutdown(socket_fd);
+    Wake();
+    return false;
+  }
+  connection->queued_bytes += msg.size();
+  connection->queued.push_back(std::move(msg));
+  if (connection->writing) {
+    return true;
+  }
+
+  connection->writing = true;
+  const bool succeeded =
+      WriteQueued(lock, socket_fd, *connection, kMaxWriteBatches);
+  HandOver(socket_fd, connection);
+  return succeeded;
+}
+
+bool ConnectionRegistry::WriteQueued(std::unique_lock<std::mutex> &lock,
+                                     std::int32_t socket_fd,
+                                     Connection &connection,
+                                     int max_batches) {
+  bool succeeded = true;
+  PendingWrite &unsent = connection.unsent;
+  for (int written = 0;
+       written < max_batches && succeeded &&
+       (!connection.queued.empty() || !unsent.messages.empty());
+       written++) {
+    for (std::string &message : connection.queued) {
+      unsent.messages.push_back(std::move(message));
+    }
+    connection.queued.clear();
+    const std::size_t bytes = CountBytes(unsent);
+    lock.unlock();
+
+    succeeded = m_Server.TryWriteV(socket_fd, unsent);
+
+    lock.lock();
+    connection.queued_bytes -= bytes - CountBytes(unsent);
+    // The socket is full, the rest waits for it to have room
+    if (!unsent.messages.empty()) {
+      break;
+    }
+  }
+
+  // The next writes would fail the same way
+  if (!succeeded) {
+    DropQueued(connection.queued, connection.queued_bytes);
+    connection.queued_bytes -= CountBytes(unsent);
+    unsent = PendingWrite{};
+  }
+  return succeeded;
+}
+
+void ConnectionRegistry::HandOver(
+    std::int32_t socket_fd, const std::shared_ptr<Connection> &connection) {
+  if (connection->queued.empty() && connection->unsent.messages.empty()) {
+    connection->writing = false;
+    m_WriteDone.notify_all();
+  } else {
+    m_Backlog.emplace_back(socket_fd, connection);
+    Wake();
+  }
+}
+
+void ConnectionRegistry::Wake() {
+  const char wake = 0;
+  // A full pipe already wakes the flusher
+  [[maybe_unused]] const ssize_t written = write(m_WakePipe[1], &wake, 1);
+}
+
+void ConnectionRegistry::FlushBacklog() {
+  // Connections the flusher writes, in the order they came
+  std::vector<Pending> waiting;
+  std::vector<pollfd> pollFds;
+  std::unique_lock lock(m_Mutex);
+  while (true) {
+    for (Pending &pending : m_Backlog) {
+      waiting.push_back(std::move(pending));
+    }
+    m_Backlog.clear();
+
+    // Stopping once the clients took what they take without waiting, one
+    // that doesn't read isn't waited for
+    if (m_Stopping) {
+      std::erase_if(waiting, [this](const Pending &pending) {
+        Connection &connection = *pending.second;
+        if (connection.unsent.messages.empty()) {
+          return false;
+        }
+        DropQueued(connection.queued, connection.queued_bytes);
+        connection.queued_bytes -= CountBytes(connection.unsent);
+        connection.unsent = PendingWrite{};
+        connection.writing = false;
+        m_WriteDone.notify_all();
+        return true;
+      });
+      if (waiting.empty()) {
+        return;
+      }
+    }
+
+    // Connections with only queued replies are written right away, the
+    // others once their socket has room
+    pollFds.assign(1, pollfd{m_WakePipe[0], POLLIN, 0});
+    int timeout = -1;
+    for (const auto &[socketFd, connection] : waiting) {
+      pollFds.push_back(pollfd{socketFd, POLLOUT, 0});
+      if (connection->unsent.messages.empty()) {
+        timeout = 0;
+      }
+    }
+    lock.unlock();
+    // Interrupted by a signal, nothing is reported and the loop comes back
+    poll(pollFds.data(), pollFds.size(), timeout);
+    char drained[64];
+    while (read(m_WakePipe[0], drained, sizeof(drained)) > 0) {
+    }
+    lock.lock();
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < waiting.size(); i++) {
+      const auto &[socketFd, connection] = waiting[i];
+      if (connection->unsent.messages.empty() || pollFds[i + 1].revents != 0) {
+        WriteQueued(lock, socketFd, *connection, 1);
+      }
+      if (connection->queued.empty() && connection->unsent.messages.empty()) {
+        connection->writing = false;
+        m_WriteDone.notify_all();
+      } else {
+        // Behind the other connections if there's more
+        waiting[kept++] = std::move(waiting[i]);
+      }
+    }
+    waiting.resize(kept);
+  }
+}
+
+std::uint64_t ConnectionRegistry::GetId(std::int32_t socket_fd) const {
+  std::lock_guard lock(m_Mutex);
+  const auto connection = m_Connections.find(socket_fd);
+  return connection == m_Connections.end() ? 0 : connection->second->id;
+}
+
+std::vector<std::int32_t> ConnectionRegistry::GetFds() const {
+  std::lock_guard lock(m_Mutex);
+  std::vector<std::int32_t> socketFds;
+  socketFds.reserve(m_Connections.size());
+  for (const auto &[socketFd, connection] : m_Connections) {
+    socketFds.push_back(socketFd);
+  }
+  return socketFds;
+}
+
+std::size_t ConnectionRegistry::Size() const {
+  std::lock_guard lock(m_Mutex);
+  return m_Connections.size();
+}
+
+} // namespace mathboard
@@ -0,0 +1,115 @@
+#pragma once
+
+// local
+#include "unix_socket_server.hpp"
+
+// std
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mathboard {
+
+// Open client connections of a server. Replies are written from the pipeline
+// threads while the daemon loop accepts and closes connections, so every
+// connection gets an id: a reply for a connection that closed in the meantime
+// is dropped instead of going to a client that reused its fd.
+//
+// Replies are queued per connection, the thread finding no write in progress
+// writes everything queued so far with one TryWriteV(). Replies finishing
+// while a write is in flight are batched into the next one instead of waiting
+// for a lock around the socket. Writes never wait for the client: the socket
+// takes what fits and the registry's flusher thread writes the rest once
+// poll() reports it writable. After kMaxWriteBatches writes the rest goes to
+// the flusher too, a busy connection doesn't keep a pipeline thread from its
+// other requests.
+class ConnectionRegistry {
+public:
+  // Bytes queued for a connection before it's disconnected, a client that
+  // stopped reading can't grow the daemon without limit
+  static constexpr std::size_t kMaxQueuedBytes = 16 << 20;
+
+  // TryWriteV() calls made by the thread queuing a reply
+  static constexpr int kMaxWriteBatches = 4;
+
+  explicit ConnectionRegistry(UnixSocketServer &server);
+
+  // Flushes what the clients still take, then closes the connections left
+  ~ConnectionRegistry();
+
+  ConnectionRegistry(const ConnectionRegistry &) = delete;
+  ConnectionRegistry &operator=(const ConnectionRegistry &) = delete;
+
+  // Track an accepted connection, returns its id
+  std::uint64_t Add(std::int32_t socket_fd);
+
+  // Close the connection and forget it. What's left to write is dropped by
+  // shutting the connection down first.
+  void Remove(std::int32_t socket_fd);
+
+  // Queue a message (one line) for the connection if it's still the one with
+  // `id`, return false if it isn't or the write failed. A connection with
+  // more than kMaxQueuedBytes queued is shut down, the daemon loop then reads
+  // EOF and removes it.
+  bool Write(std::int32_t socket_fd, std::uint64_t id, std::string msg);
+
+  std::uint64_t GetId(std::int32_t socket_fd) const;
+
+  std::vector<std::int32_t> GetFds() const;
+
+  std::size_t Size() const;
+
+private:
+  struct Connection {
+    std::uint64_t id{0};
+    std::vector<std::string> queued{};
+    // Taken from `queued` but not fully written, only the writer touches it
+    PendingWrite unsent{};
+    // Queued and unsent
+    std::size_t queued_bytes{0};
+    // A thread or the flusher is writing, it picks up what's queued
+    bool writing{false};
+    // Shut down for queuing too much, later replies are dropped
+    bool overflowed{false};
+  };
+
+  using Pending = std::pair<std::int32_t, std::shared_ptr<Connection>>;
+
+  // Write up to `max_batches` batches with `lock` released during the
+  // writes, stops early once the socket is full
+  bool WriteQueued(std::unique_lock<std::mutex> &lock, std::int32_t socket_fd,
+                   Connection &connection, int max_batches);
+
+  // Done writing if nothing is left, the flusher takes over otherwise
+  void HandOver(std::int32_t socket_fd,
+                const std::shared_ptr<Connection> &connection);
+
+  // Interrupt the flusher's poll(), to look at the backlog again
+  void Wake();
+
+  // Flusher thread, one batch per writable connection in turn
+  void FlushBacklog();
+
+  UnixSocketServer &m_Server;
+  mutable std::mutex m_Mutex;
+  // Signaled when a connection's writer is done
+  std::condition_variable m_WriteDone;
+  std::unordered_map<std::int32_t, std::shared_ptr<Connection>> m_Connections;
+  std::uint64_t m_NextId{1};
+  // Connections left to the flusher, still marked as writing
+  std::deque<Pending> m_Backlog;
+  // Read end polled by the flusher, written by Wake()
+  int m_WakePipe[2]{-1, -1};
+  bool m_Stopping{false};
+  std::thread m_Flusher;
+};
+
+} // namespace mathboard
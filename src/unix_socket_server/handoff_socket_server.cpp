@@ -0,0 +1,80 @@
+#ifdef __linux__
+
+// header
+#include "handoff_socket_server.hpp"
+
+// lib
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <cstdlib>
+#include <cstring>
+
+namespace mathboard {
+
+bool HandoffSocketServer::Init(const std::filesystem::path &) {
+  // m_SocketPath stays empty, the socket file belongs to the supervisor
+  if (m_SocketServFd < 0) {
+    spdlog::error("[HandoffSocketServer::Init]: No handoff channel.\n");
+    return false;
+  }
+  return true;
+}
+
+bool HandoffSocketServer::Accept(int &socket_cli_fd, void **sock_cli_addr) {
+  char byte = 0;
+  iovec payload{&byte, sizeof(byte)};
+  alignas(cmsghdr) unsigned char control[CMSG_SPACE(sizeof(int))]{};
+
+  msghdr message{};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  const ssize_t received = recvmsg(m_SocketServFd, &message, MSG_CMSG_CLOEXEC);
+  const cmsghdr *rights = CMSG_FIRSTHDR(&message);
+  if (received != sizeof(byte) || rights == nullptr ||
+      rights->cmsg_type != SCM_RIGHTS ||
+      rights->cmsg_len != CMSG_LEN(sizeof(int))) {
+    spdlog::error("[HandoffSocketServer::Accept]: No connection was handed "
+                  "over.\n");
+    return false;
+  }
+  std::memcpy(&socket_cli_fd, CMSG_DATA(rights), sizeof(int));
+
+  // Same contract as LinuxUnixSocketServer, the caller frees the address
+  *sock_cli_addr = calloc(1, sizeof(sockaddr_un));
+  return true;
+}
+
+bool HandoffSocketServer::SendConnection(std::int32_t channel_fd,
+                                         std::int32_t socket_fd) {
+  char byte = 0;
+  iovec payload{&byte, sizeof(byte)};
+  alignas(cmsghdr) unsigned char control[CMSG_SPACE(sizeof(int))]{};
+
+  msghdr message{};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  cmsghdr *rights = CMSG_FIRSTHDR(&message);
+  rights->cmsg_level = SOL_SOCKET;
+  rights->cmsg_type = SCM_RIGHTS;
+  rights->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(rights), &socket_fd, sizeof(int));
+
+  if (sendmsg(channel_fd, &message, MSG_NOSIGNAL) != sizeof(byte)) {
+    spdlog::error("[HandoffSocketServer::SendConnection]: Could not hand the "
+                  "connection over.\n");
+    return false;
+  }
+  return true;
+}
+
+} // namespace mathboard
+
+#endif
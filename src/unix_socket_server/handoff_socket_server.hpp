@@ -0,0 +1,39 @@
+#pragma once
+#ifdef __linux__
+
+// prototype
+#include "linux_unix_socket_server.hpp"
+
+// std
+#include <cstdint>
+#include <filesystem>
+
+namespace mathboard {
+
+// Server of a supervisor's worker process: it doesn't bind a socket of its
+// own, connections are handed over (with SCM_RIGHTS) on `channel_fd`, one
+// end of a socketpair whose other end stays in the supervisor. The channel
+// takes the place of the listening socket, so it's what GetServerSocketFd()
+// returns and Poll() reports it ready when a connection waits to be
+// accepted.
+class HandoffSocketServer : public LinuxUnixSocketServer {
+public:
+  explicit HandoffSocketServer(std::int32_t channel_fd) {
+    m_SocketServFd = channel_fd;
+  }
+
+  // The socket was bound by the supervisor, only checks the channel
+  bool Init(const std::filesystem::path &socket_path) override;
+
+  void Listen() override {}
+
+  bool Accept(int &socket_cli_fd, void **sock_cli_addr) override;
+
+  // Supervisor side: hand `socket_fd` over to the worker at the other end of
+  // `channel_fd`. The caller keeps its own copy of the fd.
+  static bool SendConnection(std::int32_t channel_fd, std::int32_t socket_fd);
+};
+
+} // namespace mathboard
+
+#endif
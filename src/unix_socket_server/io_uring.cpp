@@ -0,0 +1,153 @@
+#ifdef __linux__
+
+// header
+#include "io_uring.hpp"
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// linux std
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace mathboard {
+
+namespace {
+
+int Setup(unsigned entries, io_uring_params &params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int EnterRing(int ring_fd, unsigned to_submit, unsigned min_complete,
+              unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+int Register(int ring_fd, unsigned opcode, const void *arg, unsigned count) {
+  return static_cast<int>(
+      syscall(__NR_io_uring_register, ring_fd, opcode, arg, count));
+}
+
+template <typename T> T *At(void *base, std::uint32_t offset) {
+  return reinterpret_cast<T *>(static_cast<unsigned char *>(base) + offset);
+}
+
+} // namespace
+
+IoUring::~IoUring() {
+  if (m_Sqes != nullptr) {
+    munmap(m_Sqes, m_SqesSize);
+  }
+  if (m_Rings != nullptr) {
+    munmap(m_Rings, m_RingsSize);
+  }
+  if (m_RingFd >= 0) {
+    close(m_RingFd);
+  }
+}
+
+bool IoUring::Init(unsigned entries) {
+  io_uring_params params{};
+  m_RingFd = Setup(entries, params);
+  if (m_RingFd < 0) {
+    return false;
+  }
+  // Kernels before 5.4 map the queues separately, not worth supporting
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+    return false;
+  }
+
+  const std::size_t sqSize =
+      params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+  const std::size_t cqSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  m_RingsSize = std::max(sqSize, cqSize);
+  void *rings = mmap(nullptr, m_RingsSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, m_RingFd, IORING_OFF_SQ_RING);
+  if (rings == MAP_FAILED) {
+    return false;
+  }
+  m_Rings = rings;
+
+  m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = mmap(nullptr, m_SqesSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_RingFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return false;
+  }
+  m_Sqes = static_cast<io_uring_sqe *>(sqes);
+
+  m_SqHead = At<std::atomic<std::uint32_t>>(m_Rings, params.sq_off.head);
+  m_SqTail = At<std::atomic<std::uint32_t>>(m_Rings, params.sq_off.tail);
+  m_SqArray = At<std::uint32_t>(m_Rings, params.sq_off.array);
+  m_SqMask = *At<std::uint32_t>(m_Rings, params.sq_off.ring_mask);
+  m_SqEntries = params.sq_entries;
+  m_CqHead = At<std::atomic<std::uint32_t>>(m_Rings, params.cq_off.head);
+  m_CqTail = At<std::atomic<std::uint32_t>>(m_Rings, params.cq_off.tail);
+  m_Cqes = At<io_uring_cqe>(m_Rings, params.cq_off.cqes);
+  m_CqMask = *At<std::uint32_t>(m_Rings, params.cq_off.ring_mask);
+  m_LocalTail = m_SqTail->load(std::memory_order_relaxed);
+
+  // Which opcodes the kernel knows, the probe itself needs 5.6
+  constexpr unsigned kProbeOps = 256;
+  std::vector<unsigned char> probeMemory(
+      sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op), 0);
+  auto *probe = reinterpret_cast<io_uring_probe *>(probeMemory.data());
+  if (Register(m_RingFd, IORING_REGISTER_PROBE, probe, kProbeOps) < 0) {
+    return false;
+  }
+  m_SupportedOps.assign(probe->ops_len, 0);
+  for (std::size_t i = 0; i < probe->ops_len; i++) {
+    m_SupportedOps[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) != 0;
+  }
+  return true;
+}
+
+bool IoUring::IsOpSupported(std::uint8_t op) const {
+  return op < m_SupportedOps.size() && m_SupportedOps[op] != 0;
+}
+
+bool IoUring::RegisterBuffers(const std::vector<iovec> &buffers) {
+  return Register(m_RingFd, IORING_REGISTER_BUFFERS, buffers.data(),
+                  static_cast<unsigned>(buffers.size())) == 0;
+}
+
+io_uring_sqe *IoUring::GetSqe() {
+  const std::uint32_t head = m_SqHead->load(std::memory_order_acquire);
+  if (m_LocalTail - head >= m_SqEntries) {
+    return nullptr;
+  }
+  const std::uint32_t index = m_LocalTail & m_SqMask;
+  m_SqArray[index] = index;
+  m_LocalTail++;
+  io_uring_sqe *sqe = &m_Sqes[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+unsigned IoUring::Flush() {
+  m_SqTail->store(m_LocalTail, std::memory_order_release);
+  // Everything the kernel hasn't consumed yet, including entries left over
+  // by an earlier short submission
+  return m_LocalTail - m_SqHead->load(std::memory_order_acquire);
+}
+
+bool IoUring::Enter(unsigned to_submit, unsigned wait_for) {
+  if (to_submit == 0 && wait_for == 0) {
+    return true;
+  }
+
+  const unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+  if (EnterRing(m_RingFd, to_submit, wait_for, flags) < 0) {
+    return errno == EINTR || errno == EAGAIN || errno == EBUSY;
+  }
+  return true;
+}
+
+} // namespace mathboard
+
+#endif
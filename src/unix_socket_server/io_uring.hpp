@@ -0,0 +1,88 @@
+#pragma once
+#ifdef __linux__
+
+// std
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// linux std
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+namespace mathboard {
+
+// Minimal io_uring over the kernel interface, just what IoUringServer needs:
+// one submission and one completion queue mapped from the ring fd.
+//
+// Submission isn't thread-safe, callers serialize GetSqe()/Submit(). The
+// completions are only reaped by a single thread.
+class IoUring {
+public:
+  IoUring() = default;
+  ~IoUring();
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  // Fails on kernels without io_uring (or where it's disabled by seccomp)
+  bool Init(unsigned entries);
+
+  bool IsOpSupported(std::uint8_t op) const;
+
+  // Pin `buffers` for IORING_OP_READ_FIXED, indexed in order
+  bool RegisterBuffers(const std::vector<iovec> &buffers);
+
+  // Next free submission entry, cleared, nullptr if the queue is full
+  io_uring_sqe *GetSqe();
+
+  // Publish the entries handed out so far, returns how many the kernel
+  // hasn't consumed yet
+  unsigned Flush();
+
+  // Submit `to_submit` entries and wait for `wait_for` completions. Doesn't
+  // touch the submission queue, so it can run without the callers' lock.
+  // Returns false on errors other than an interrupted wait.
+  bool Enter(unsigned to_submit, unsigned wait_for);
+
+  bool Submit(unsigned wait_for = 0) { return Enter(Flush(), wait_for); }
+
+  // Call `handle` with every available completion, then release them
+  template <typename Handler> std::size_t ReapCompletions(Handler &&handle) {
+    std::uint32_t head = m_CqHead->load(std::memory_order_relaxed);
+    const std::uint32_t tail = m_CqTail->load(std::memory_order_acquire);
+    const std::size_t count = tail - head;
+    for (; head != tail; head++) {
+      handle(m_Cqes[head & m_CqMask]);
+    }
+    m_CqHead->store(tail, std::memory_order_release);
+    return count;
+  }
+
+private:
+  int m_RingFd{-1};
+  void *m_Rings{nullptr};
+  std::size_t m_RingsSize{0};
+  io_uring_sqe *m_Sqes{nullptr};
+  std::size_t m_SqesSize{0};
+
+  // Shared with the kernel
+  std::atomic<std::uint32_t> *m_SqHead{nullptr};
+  std::atomic<std::uint32_t> *m_SqTail{nullptr};
+  std::uint32_t *m_SqArray{nullptr};
+  std::uint32_t m_SqMask{0};
+  std::uint32_t m_SqEntries{0};
+  std::atomic<std::uint32_t> *m_CqHead{nullptr};
+  std::atomic<std::uint32_t> *m_CqTail{nullptr};
+  io_uring_cqe *m_Cqes{nullptr};
+  std::uint32_t m_CqMask{0};
+
+  // Entries handed out by GetSqe(), published to the kernel on Submit()
+  std::uint32_t m_LocalTail{0};
+  std::vector<std::uint8_t> m_SupportedOps{};
+};
+
+} // namespace mathboard
+
+#endif
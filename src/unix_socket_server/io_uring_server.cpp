@@ -0,0 +1,394 @@
+#ifdef __linux__
+
+// header
+#include "io_uring_server.hpp"
+
+// lib
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+
+// linux std
+#include <sys/socket.h>
+
+namespace mathboard {
+
+namespace {
+
+constexpr unsigned kRingEntries = 256;
+// Registered read buffers, connections past that read into their own
+constexpr std::size_t kRegisteredBuffers = 64;
+constexpr std::size_t kBufferSize = 64 * 1024;
+
+// The low bits of user_data tell the operations apart, the rest is an id
+constexpr std::uint64_t kAcceptOperation = 0;
+constexpr std::uint64_t kReadOperation = 1;
+constexpr std::uint64_t kSendOperation = 2;
+constexpr std::uint64_t kOperationMask = 3;
+
+} // namespace
+
+IoUringServer *IoUringServer::Create() {
+  std::unique_ptr<IoUringServer> server(new IoUringServer());
+  if (!server->m_Ring.Init(kRingEntries)) {
+    return nullptr;
+  }
+  for (const std::uint8_t op :
+       {IORING_OP_ACCEPT, IORING_OP_READ_FIXED, IORING_OP_RECV,
+        IORING_OP_SEND}) {
+    if (!server->m_Ring.IsOpSupported(op)) {
+      return nullptr;
+    }
+  }
+
+  std::vector<iovec> buffers;
+  for (std::size_t i = 0; i < kRegisteredBuffers; i++) {
+    server->m_Buffers.push_back(std::make_unique<unsigned char[]>(kBufferSize));
+    buffers.push_back(iovec{server->m_Buffers.back().get(), kBufferSize});
+    server->m_FreeSlots.push_back(static_cast<int>(i));
+  }
+  // Pinning can fail under a low RLIMIT_MEMLOCK, reads then use their own
+  // buffers
+  if (!server->m_Ring.RegisterBuffers(buffers)) {
+    spdlog::warn("[IoUringServer::Create]: Could not register the read "
+                 "buffers.\n");
+    server->m_Buffers.clear();
+    server->m_FreeSlots.clear();
+  }
+  return server.release();
+}
+
+IoUringServer::~IoUringServer() {
+  for (const auto &[socketFd, connection] : m_Connections) {
+    LinuxUnixSocketServer::Close(socketFd);
+  }
+}
+
+void IoUringServer::Listen() {
+  LinuxUnixSocketServer::Listen();
+  std::lock_guard lock(m_Mutex);
+  ArmAccept();
+}
+
+io_uring_sqe *IoUringServer::GetSqe() {
+  io_uring_sqe *sqe = m_Ring.GetSqe();
+  while (sqe == nullptr) {
+    // Full, hand the queued entries to the kernel to make room
+    m_Ring.Submit();
+    sqe = m_Ring.GetSqe();
+  }
+  return sqe;
+}
+
+void IoUringServer::ArmAccept() {
+  io_uring_sqe *sqe = GetSqe();
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = m_SocketServFd;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  if (m_MultishotAccept) {
+    // One submission keeps accepting until it fails (5.19+)
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  }
+  sqe->user_data = kAcceptOperation;
+}
+
+void IoUringServer::ArmRead(const std::shared_ptr<Connection> &connection) {
+  std::lock_guard lock(m_Mutex);
+  if (connection->slot < 0 && !m_FreeSlots.empty()) {
+    connection->slot = m_FreeSlots.back();
+    m_FreeSlots.pop_back();
+  }
+
+  io_uring_sqe *sqe = GetSqe();
+  sqe->fd = connection->socket_fd;
+  // One byte short, like LinuxUnixSocketServer::Read
+  sqe->len = kBufferSize - 1;
+  if (connection->slot >= 0) {
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->addr = reinterpret_cast<std::uint64_t>(
+        m_Buffers[static_cast<std::size_t>(connection->slot)].get());
+    sqe->buf_index = static_cast<std::uint16_t>(connection->slot);
+  } else {
+    connection->buffer.resize(kBufferSize);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->addr = reinterpret_cast<std::uint64_t>(connection->buffer.data());
+  }
+
+  const std::uint64_t id = m_NextOperation++;
+  sqe->user_data = (id << 2) | kReadOperation;
+  m_Reads[id] = connection;
+  connection->read_in_flight = true;
+}
+
+void IoUringServer::ArmSend(const std::shared_ptr<WriteQueue> &queue) {
+  const std::string &message = queue->messages.front();
+  io_uring_sqe *sqe = GetSqe();
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = queue->socket_fd;
+  sqe->addr = reinterpret_cast<std::uint64_t>(message.data() + queue->sent);
+  sqe->len = static_cast<std::uint32_t>(message.size() - queue->sent);
+  sqe->msg_flags = MSG_NOSIGNAL;
+
+  const std::uint64_t id = m_NextOperation++;
+  sqe->user_data = (id << 2) | kSendOperation;
+  m_Sends[id] = queue;
+  queue->in_flight = true;
+}
+
+void IoUringServer::ReapCompletions() {
+  m_Ring.ReapCompletions([this](const io_uring_cqe &cqe) {
+    const std::uint64_t type = cqe.user_data & kOperationMask;
+    const std::uint64_t id = cqe.user_data >> 2;
+
+    if (type == kAcceptOperation) {
+      if (cqe.res >= 0) {
+        m_Accepted.push_back(cqe.res);
+      } else if (cqe.res == -EINVAL && m_MultishotAccept) {
+        spdlog::warn("[IoUringServer::ReapCompletions]: No multishot "
+                     "accept, accepting one connection at a time.\n");
+        m_MultishotAccept = false;
+      } else {
+        spdlog::error("[IoUringServer::ReapCompletions]: Could not accept "
+                      "the connection.\n");
+      }
+      // Gone once it doesn't promise more completions
+      if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+        std::lock_guard lock(m_Mutex);
+        ArmAccept();
+      }
+      return;
+    }
+
+    if (type == kReadOperation) {
+      const auto read = m_Reads.find(id);
+      const std::shared_ptr<Connection> connection = std::move(read->second);
+      m_Reads.erase(read);
+      connection->read_in_flight = false;
+      if (connection->closed) {
+        if (connection->slot >= 0) {
+          std::lock_guard lock(m_Mutex);
+          m_FreeSlots.push_back(connection->slot);
+        }
+        return;
+      }
+      connection->completed = true;
+      connection->result = cqe.res;
+      return;
+    }
+
+    std::lock_guard lock(m_Mutex);
+    const auto send = m_Sends.find(id);
+    const std::shared_ptr<WriteQueue> queue = std::move(send->second);
+    m_Sends.erase(send);
+    queue->in_flight = false;
+    if (queue->closed) {
+      return;
+    }
+    if (cqe.res < 0) {
+      spdlog::error("[IoUringServer::ReapCompletions]: Could not write to "
+                    "the socket.\n");
+      queue->messages.clear();
+      queue->sent = 0;
+      queue->queued_bytes = 0;
+      return;
+    }
+
+    // Short sends continue where they stopped
+    queue->sent += static_cast<std::size_t>(cqe.res);
+    if (queue->sent == queue->messages.front().size()) {
+      queue->queued_bytes -= queue->messages.front().size();
+      queue->messages.pop_front();
+      queue->sent = 0;
+    }
+    if (!queue->messages.empty()) {
+      ArmSend(queue);
+    }
+  });
+}
+
+bool IoUringServer::Poll(const std::vector<std::int32_t> &socket_fds,
+                         std::vector<std::int32_t> &ready) {
+  for (;;) {
+    ReapCompletions();
+
+    ready.clear();
+    for (const std::int32_t socketFd : socket_fds) {
+      if (socketFd == m_SocketServFd) {
+        if (!m_Accepted.empty()) {
+          ready.push_back(socketFd);
+        }
+        continue;
+      }
+      const auto connection = m_Connections.find(socketFd);
+      if (connection != m_Connections.end() &&
+          connection->second->completed) {
+        ready.push_back(socketFd);
+      }
+    }
+    if (!ready.empty()) {
+      return true;
+    }
+
+    // Reads re-armed since the last call go out with the wait
+    unsigned toSubmit;
+    {
+      std::lock_guard lock(m_Mutex);
+      toSubmit = m_Ring.Flush();
+    }
+    if (!m_Ring.Enter(toSubmit, 1)) {
+      spdlog::error("[IoUringServer::Poll]: Could not wait for "
+                    "completions.\n");
+      return false;
+    }
+  }
+}
+
+bool IoUringServer::Accept(int &socket_cli_fd, void **sock_cli_addr) {
+  std::vector<std::int32_t> ready;
+  while (m_Accepted.empty()) {
+    if (!Poll({m_SocketServFd}, ready)) {
+      spdlog::error(
+          "[IoUringServer::Accept]: Could not accept the connection.\n");
+      return false;
+    }
+  }
+  socket_cli_fd = m_Accepted.front();
+  m_Accepted.pop_front();
+
+  // Same contract as LinuxUnixSocketServer, the caller frees the address.
+  // The peer of a Unix socket is unnamed anyway.
+  *sock_cli_addr = calloc(1, sizeof(sockaddr_un));
+
+  auto connection = std::make_shared<Connection>();
+  connection->socket_fd = socket_cli_fd;
+  m_Connections[socket_cli_fd] = connection;
+  ArmRead(connection);
+  return true;
+}
+
+bool IoUringServer::Read(const std::int32_t socket_fd,
+                         std::vector<unsigned char> &buffer) {
+  const auto found = m_Connections.find(socket_fd);
+  if (found == m_Connections.end()) {
+    return LinuxUnixSocketServer::Read(socket_fd, buffer);
+  }
+  const std::shared_ptr<Connection> connection = found->second;
+
+  std::vector<std::int32_t> ready;
+  while (!connection->completed) {
+    if (!Poll({socket_fd}, ready)) {
+      return false;
+    }
+  }
+
+  if (connection->result < 0) {
+    connection->completed = false;
+    spdlog::error("[IoUringServer::Read]: Could not read from the socket.\n");
+    return false;
+  }
+
+  // An empty buffer would read like EOF
+  const auto result = static_cast<std::size_t>(connection->result);
+  const std::size_t size = std::min(result - connection->consumed,
+                                    std::max<std::size_t>(buffer.size(), 1));
+  const unsigned char *data =
+      connection->slot >= 0
+          ? m_Buffers[static_cast<std::size_t>(connection->slot)].get()
+          : connection->buffer.data();
+  buffer.assign(data + connection->consumed,
+                data + connection->consumed + size);
+  connection->consumed += size;
+  if (connection->consumed < result) {
+    // The read buffer is only reused once it's all handed out
+    return true;
+  }
+  connection->completed = false;
+  connection->consumed = 0;
+
+  // Nothing more comes after EOF
+  if (result > 0) {
+    ArmRead(connection);
+  }
+  return true;
+}
+
+bool IoUringServer::Write(const std::int32_t socket_fd,
+                          const std::vector<unsigned char> &buffer) {
+  return WriteString(socket_fd, std::string(buffer.begin(), buffer.end()));
+}
+
+bool IoUringServer::WriteString(const std::int32_t socket_fd,
+                                const std::string &msg) {
+  unsigned toSubmit = 0;
+  {
+    std::lock_guard lock(m_Mutex);
+    std::shared_ptr<WriteQueue> &queue = m_WriteQueues[socket_fd];
+    if (queue == nullptr) {
+      queue = std::make_shared<WriteQueue>();
+      queue->socket_fd = socket_fd;
+    }
+    if (queue->queued_bytes + msg.size() > kMaxQueuedBytes) {
+      spdlog::error("[IoUringServer::WriteString]: The client doesn't read "
+                    "its replies, disconnecting it.\n");
+      // Its read completes with EOF, the daemon loop closes it then
+      shutdown(socket_fd, SHUT_RDWR);
+      return false;
+    }
+    queue->messages.push_back(msg);
+    queue->queued_bytes += msg.size();
+    // Sends to a socket go out one at a time, so they can't be reordered
+    if (!queue->in_flight) {
+      ArmSend(queue);
+      toSubmit = m_Ring.Flush();
+    }
+  }
+  return m_Ring.Enter(toSubmit, 0);
+}
+
+bool IoUringServer::WriteV(const std::int32_t socket_fd,
+                           const std::vector<std::string_view> &messages) {
+  // Joined into a single send, it's queued behind the others anyway
+  return UnixSocketServer::WriteV(socket_fd, messages);
+}
+
+bool IoUringServer::TryWriteV(const std::int32_t socket_fd,
+                              PendingWrite &pending) {
+  return UnixSocketServer::TryWriteV(socket_fd, pending);
+}
+
+void IoUringServer::Close(const std::int32_t socket_fd) {
+  {
+    std::lock_guard lock(m_Mutex);
+    // A read or send queued for the fd has to reach the kernel while the fd
+    // is still this connection's, once it's closed a new connection can get
+    // the same number
+    m_Ring.Submit();
+    const auto queue = m_WriteQueues.find(socket_fd);
+    if (queue != m_WriteQueues.end()) {
+      queue->second->closed = true;
+      m_WriteQueues.erase(queue);
+    }
+  }
+
+  const auto connection = m_Connections.find(socket_fd);
+  if (connection != m_Connections.end()) {
+    // Wakes up a read still in flight, its completion frees the buffer
+    connection->second->closed = true;
+    if (connection->second->read_in_flight) {
+      shutdown(socket_fd, SHUT_RDWR);
+    } else if (connection->second->slot >= 0) {
+      std::lock_guard lock(m_Mutex);
+      m_FreeSlots.push_back(connection->second->slot);
+    }
+    m_Connections.erase(connection);
+  }
+  LinuxUnixSocketServer::Close(socket_fd);
+}
+
+} // namespace mathboard
+
+#endif
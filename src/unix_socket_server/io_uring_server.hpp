@@ -0,0 +1,126 @@
+#pragma once
+#ifdef __linux__
+
+// prototype
+#include "linux_unix_socket_server.hpp"
+
+// local
+#include "io_uring.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mathboard {
+
+// Unix socket server doing its I/O through io_uring: one multishot accept
+// stays armed on the listening socket, every connection has a read in flight
+// (into a registered buffer while there are free ones) and replies are queued
+// as sends. Poll() submits everything queued since the last call and waits
+// for completions in a single io_uring_enter, so a loop over many clients
+// costs one syscall per batch instead of a poll, read and write per request.
+//
+// Accept, Read, Poll and Close are called from the daemon loop, Write and
+// WriteString from any thread.
+class IoUringServer : public LinuxUnixSocketServer {
+public:
+  // Replies queued for a connection that doesn't read them. Writes past it
+  // fail and the connection is shut down.
+  static constexpr std::size_t kMaxQueuedBytes = 16 * 1024 * 1024;
+
+  // nullptr when the kernel lacks io_uring or one of the operations used
+  static IoUringServer *Create();
+
+  ~IoUringServer() override;
+
+  void Listen() override;
+
+  bool Accept(int &socket_cli_fd, void **sock_cli_addr) override;
+
+  // Bytes that don't fit `buffer` are returned by the next calls, the
+  // connection stays ready until they're all read
+  bool Read(const std::int32_t socket_fd,
+            std::vector<unsigned char> &buffer) override;
+
+  bool Write(const std::int32_t socket_fd,
+             const std::vector<unsigned char> &buffer) override;
+
+  bool WriteString(const std::int32_t socket_fd,
+                   const std::string &msg) override;
+
+  bool WriteV(const std::int32_t socket_fd,
+              const std::vector<std::string_view> &messages) override;
+
+  // Sends are queued and don't wait for the client, like WriteV()
+  bool TryWriteV(const std::int32_t socket_fd, PendingWrite &pending) override;
+
+  bool Poll(const std::vector<std::int32_t> &socket_fds,
+            std::vector<std::int32_t> &ready) override;
+
+  void Close(const std::int32_t socket_fd) override;
+
+private:
+  struct Connection {
+    std::int32_t socket_fd{-1};
+    // Registered buffer the reads go to, -1 reads into `buffer`
+    int slot{-1};
+    std::vector<unsigned char> buffer{};
+    // A read completed with `result` and wasn't handed out yet
+    bool completed{false};
+    int result{0};
+    // Bytes of the result already handed out
+    std::size_t consumed{0};
+    bool read_in_flight{false};
+    bool closed{false};
+  };
+
+  struct WriteQueue {
+    std::int32_t socket_fd{-1};
+    std::deque<std::string> messages{};
+    // Bytes of the front message already sent
+    std::size_t sent{0};
+    // Bytes of all messages, the sent ones included
+    std::size_t queued_bytes{0};
+    bool in_flight{false};
+    bool closed{false};
+  };
+
+  IoUringServer() = default;
+
+  io_uring_sqe *GetSqe();
+  void ArmAccept();
+  void ArmRead(const std::shared_ptr<Connection> &connection);
+  void ArmSend(const std::shared_ptr<WriteQueue> &queue);
+  void ReapCompletions();
+
+private:
+  // Registered buffers, declared before the ring so they outlive it
+  std::vector<std::unique_ptr<unsigned char[]>> m_Buffers{};
+  std::vector<int> m_FreeSlots{};
+  IoUring m_Ring{};
+  bool m_MultishotAccept{true};
+
+  // Used by the daemon loop only
+  std::deque<std::int32_t> m_Accepted{};
+  std::unordered_map<std::int32_t, std::shared_ptr<Connection>>
+      m_Connections{};
+  std::unordered_map<std::uint64_t, std::shared_ptr<Connection>> m_Reads{};
+
+  // Guards the submission queue and the writes
+  std::mutex m_Mutex{};
+  std::unordered_map<std::int32_t, std::shared_ptr<WriteQueue>>
+      m_WriteQueues{};
+  std::unordered_map<std::uint64_t, std::shared_ptr<WriteQueue>> m_Sends{};
+  std::uint64_t m_NextOperation{1};
+};
+
+} // namespace mathboard
+
+#endif
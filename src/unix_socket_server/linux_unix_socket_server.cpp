@@ -5,6 +5,11 @@
 // spdlog
 #include <spdlog/spdlog.h>
 
+// std
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+
 namespace mathboard {
 
 bool LinuxUnixSocketServer::Init(const std::filesystem::path &socket_path) {
@@ -78,6 +83,7 @@ bool LinuxUnixSocketServer::Read(const std::int32_t socket_fd,
     return false;
   }
 
+  buffer.resize(static_cast<std::size_t>(byte_read));
   return true;
 }
 
@@ -109,4 +115,135 @@ bool LinuxUnixSocketServer::WriteString(const std::int32_t socket_fd,
   return true;
 }
 
+bool LinuxUnixSocketServer::WriteV(
+    const std::int32_t socket_fd,
+    const std::vector<std::string_view> &messages) {
+  static constexpr char kNewline = '\n';
+  std::vector<iovec> parts;
+  parts.reserve(2 * messages.size());
+  for (const std::string_view message : messages) {
+    parts.push_back(iovec{const_cast<char *>(message.data()), message.size()});
+    parts.push_back(iovec{const_cast<char *>(&kNewline), 1});
+  }
+
+  // sendmsg rather than writev, a client that went away is an error here
+  // and not a SIGPIPE
+  std::size_t first = 0;
+  while (first < parts.size()) {
+    msghdr message{};
+    message.msg_iov = parts.data() + first;
+    message.msg_iovlen = std::min<std::size_t>(parts.size() - first, IOV_MAX);
+    std::ptrdiff_t written = sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      spdlog::error(
+          "[LinuxUnixSocketServer::WriteV]: Could not write to the socket.\n");
+      return false;
+    }
+
+    // Skip what was sent, a short write continues in the middle of a part
+    while (first < parts.size() &&
+           static_cast<std::size_t>(written) >= parts[first].iov_len) {
+      written -= static_cast<std::ptrdiff_t>(parts[first].iov_len);
+      first++;
+    }
+    if (written > 0) {
+      parts[first].iov_base =
+          static_cast<char *>(parts[first].iov_base) + written;
+      parts[first].iov_len -= static_cast<std::size_t>(written);
+    }
+  }
+  return true;
+}
+
+bool LinuxUnixSocketServer::TryWriteV(const std::int32_t socket_fd,
+                                      PendingWrite &pending) {
+  static constexpr char kNewline = '\n';
+  while (!pending.messages.empty()) {
+    // Every message and its newline, the first one from `offset`
+    std::vector<iovec> parts;
+    parts.reserve(std::min<std::size_t>(2 * pending.messages.size(), IOV_MAX));
+    std::size_t skip = pending.offset;
+    for (std::size_t i = 0;
+         i < pending.messages.size() && parts.size() + 2 <= IOV_MAX; i++) {
+      std::string &message = pending.messages[i];
+      if (skip < message.size()) {
+        parts.push_back(iovec{message.data() + skip, message.size() - skip});
+        skip = 0;
+      } else {
+        skip -= message.size();
+      }
+      if (skip == 0) {
+        parts.push_back(iovec{const_cast<char *>(&kNewline), 1});
+      }
+    }
+
+    msghdr header{};
+    header.msg_iov = parts.data();
+    header.msg_iovlen = parts.size();
+    std::ptrdiff_t written =
+        sendmsg(socket_fd, &header, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // The client isn't reading, the rest waits for POLLOUT
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      spdlog::error("[LinuxUnixSocketServer::TryWriteV]: Could not write to "
+                    "the socket.\n");
+      return false;
+    }
+
+    // Forget the messages sent with their newline, keep where the first
+    // one left off
+    std::size_t sent = pending.offset + static_cast<std::size_t>(written);
+    while (!pending.messages.empty() &&
+           sent >= pending.messages.front().size() + 1) {
+      sent -= pending.messages.front().size() + 1;
+      pending.messages.pop_front();
+    }
+    pending.offset = sent;
+  }
+  return true;
+}
+
+bool LinuxUnixSocketServer::Poll(const std::vector<std::int32_t> &socket_fds,
+                                 std::vector<std::int32_t> &ready) {
+  std::vector<pollfd> pollFds(socket_fds.size());
+  for (std::size_t i = 0; i < socket_fds.size(); i++) {
+    pollFds[i] = pollfd{socket_fds[i], POLLIN, 0};
+  }
+
+  ready.clear();
+  if (poll(pollFds.data(), pollFds.size(), -1) < 0) {
+    // Interrupted by a signal, nothing is ready yet
+    if (errno == EINTR) {
+      return true;
+    }
+    spdlog::error("[LinuxUnixSocketServer::Poll]: Could not poll the "
+                  "sockets.\n");
+    return false;
+  }
+
+  for (const pollfd &pollFd : pollFds) {
+    // A hang up is reported as readable, reading it returns 0 bytes
+    if (pollFd.revents & (POLLIN | POLLHUP | POLLERR)) {
+      ready.push_back(pollFd.fd);
+    }
+  }
+  return true;
+}
+
+void LinuxUnixSocketServer::Shutdown(const std::int32_t socket_fd) {
+  shutdown(socket_fd, SHUT_RDWR);
+}
+
+void LinuxUnixSocketServer::Close(const std::int32_t socket_fd) {
+  close(socket_fd);
+}
+
 } // namespace mathboard
@@ -7,9 +7,11 @@
 // std
 #include <cstdint>
 #include <filesystem>
+#include <string_view>
 #include <vector>
 
 // linux std
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -39,6 +41,19 @@ public:
 
   bool WriteString(const std::int32_t socket_fd,
                    const std::string &msg) override;
+
+  bool WriteV(const std::int32_t socket_fd,
+              const std::vector<std::string_view> &messages) override;
+
+  // sendmsg with MSG_DONTWAIT, stops where the socket buffer is full
+  bool TryWriteV(const std::int32_t socket_fd, PendingWrite &pending) override;
+
+  bool Poll(const std::vector<std::int32_t> &socket_fds,
+            std::vector<std::int32_t> &ready) override;
+
+  void Shutdown(const std::int32_t socket_fd) override;
+
+  void Close(const std::int32_t socket_fd) override;
 };
 
 } // namespace mathboard
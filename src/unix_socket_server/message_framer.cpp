@@ -0,0 +1,64 @@
+// header
+#include "message_framer.hpp"
+
+namespace mathboard {
+
+void MessageFramer::Append(const void *data, std::size_t size) {
+  // Drop the messages already handed out
+  if (m_Start > 0) {
+    m_Buffer.erase(0, m_Start);
+    m_Scanned -= m_Start;
+    m_Start = 0;
+  }
+  m_Buffer.append(static_cast<const char *>(data), size);
+}
+
+bool MessageFramer::Next(std::string_view &message) {
+  while (m_Scanned < m_Buffer.size()) {
+    const char byte = m_Buffer[m_Scanned++];
+
+    if (!m_Started) {
+      // Whitespace between messages
+      if (byte == ' ' || byte == '\t' || byte == '\r' || byte == '\n') {
+        m_Start = m_Scanned;
+        continue;
+      }
+      m_Started = true;
+    }
+
+    if (m_InString) {
+      if (m_Escaped) {
+        m_Escaped = false;
+      } else if (byte == '\\') {
+        m_Escaped = true;
+      } else if (byte == '"') {
+        m_InString = false;
+      }
+      continue;
+    }
+
+    std::size_t end = 0;
+    if (byte == '"') {
+      m_InString = true;
+    } else if (byte == '{' || byte == '[') {
+      m_Depth++;
+    } else if ((byte == '}' || byte == ']') && m_Depth > 0) {
+      if (--m_Depth == 0) {
+        end = m_Scanned;
+      }
+    } else if (byte == '\n' && m_Depth == 0) {
+      end = m_Scanned - 1;
+    }
+
+    if (end != 0) {
+      message = std::string_view(m_Buffer).substr(m_Start, end - m_Start);
+      m_Start = m_Scanned;
+      m_Depth = 0;
+      m_Started = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace mathboard
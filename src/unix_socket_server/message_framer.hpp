@@ -0,0 +1,41 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace mathboard {
+
+// Splits the byte stream of a connection into messages. A message is a
+// complete top-level JSON object or array, or anything else up to the next
+// newline (so an invalid line still becomes a message and gets an error
+// reply). Clients can send newline-delimited JSON or just concatenate the
+// objects, and a message can arrive over any number of reads.
+//
+// The bytes are scanned once: the nesting depth and string state carry over
+// from one Append() to the next.
+class MessageFramer {
+public:
+  void Append(const void *data, std::size_t size);
+
+  // Next complete message, false once only an incomplete one is left. The
+  // view is valid until the next Append().
+  bool Next(std::string_view &message);
+
+  // Bytes of the incomplete message waiting for the rest
+  std::size_t Pending() const { return m_Buffer.size() - m_Start; }
+
+private:
+  std::string m_Buffer{};
+  // First byte of the current message, and of what's not scanned yet
+  std::size_t m_Start{0};
+  std::size_t m_Scanned{0};
+  // Scan state of the current message
+  std::size_t m_Depth{0};
+  bool m_InString{false};
+  bool m_Escaped{false};
+  bool m_Started{false};
+};
+
+} // namespace mathboard
@@ -0,0 +1,171 @@
+// header
+#include "shared_memory_client.hpp"
+
+// lib
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <cstring>
+#include <string>
+#include <thread>
+
+// linux std
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace mathboard {
+
+namespace {
+
+// Polls of the reply ring before going to sleep on the eventfd, a reply
+// arriving within a few microseconds costs no syscall
+constexpr std::uint32_t kSpinCount = 2000;
+
+} // namespace
+
+bool SharedMemoryClient::Connect(const std::filesystem::path &socket_path) {
+  Close();
+
+  m_SocketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (m_SocketFd < 0) {
+    spdlog::error(
+        "[SharedMemoryClient::Connect]: Could not open the socket.\n");
+    return false;
+  }
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const std::string path = socket_path.string();
+  path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  if (connect(m_SocketFd, reinterpret_cast<sockaddr *>(&address),
+              sizeof(address)) < 0) {
+    spdlog::error("[SharedMemoryClient::Connect]: Could not connect to {}.\n",
+                  path);
+    Close();
+    return false;
+  }
+
+  // Segment and eventfds come with the handshake
+  SharedMemoryHandshake handshake{};
+  iovec payload{&handshake, sizeof(handshake)};
+  int fds[3] = {-1, -1, -1};
+  alignas(cmsghdr) unsigned char control[CMSG_SPACE(sizeof(fds))]{};
+
+  msghdr message{};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  const ssize_t received = recvmsg(m_SocketFd, &message, MSG_CMSG_CLOEXEC);
+  const cmsghdr *rights = CMSG_FIRSTHDR(&message);
+  if (received != static_cast<ssize_t>(sizeof(handshake)) ||
+      rights == nullptr || rights->cmsg_type != SCM_RIGHTS ||
+      rights->cmsg_len != CMSG_LEN(sizeof(fds))) {
+    spdlog::error(
+        "[SharedMemoryClient::Connect]: The server sent no segment.\n");
+    Close();
+    return false;
+  }
+  std::memcpy(fds, CMSG_DATA(rights), sizeof(fds));
+  m_RequestEvent = fds[1];
+  m_ReplyEvent = fds[2];
+
+  const SharedMemoryLayout layout(handshake.ring_capacity);
+  m_Size = layout.TotalSize();
+  void *memory =
+      mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+  close(fds[0]);
+  if (memory == MAP_FAILED) {
+    spdlog::error(
+        "[SharedMemoryClient::Connect]: Could not map the segment.\n");
+    Close();
+    return false;
+  }
+  m_Memory = memory;
+  m_Requests = layout.Requests(m_Memory, false);
+  m_Replies = layout.Replies(m_Memory, false);
+  return true;
+}
+
+bool SharedMemoryClient::Send(std::string_view message) {
+  if (!IsConnected() || message.empty() ||
+      message.size() > m_Requests.MaxMessageSize()) {
+    spdlog::error("[SharedMemoryClient::Send]: Can't send a message of {} "
+                  "bytes.\n",
+                  message.size());
+    return false;
+  }
+
+  while (!m_Requests.TryPush(message)) {
+    std::this_thread::yield();
+  }
+  if (m_Requests.WakeConsumer()) {
+    eventfd_write(m_RequestEvent, 1);
+  }
+  return true;
+}
+
+bool SharedMemoryClient::Receive(std::vector<unsigned char> &buffer,
+                                 std::chrono::milliseconds timeout) {
+  if (!IsConnected()) {
+    return false;
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  for (;;) {
+    for (std::uint32_t i = 0; i < kSpinCount; i++) {
+      const SharedMemoryRing::PopResult popped = m_Replies.TryPop(buffer);
+      if (popped == SharedMemoryRing::PopResult::Popped) {
+        return true;
+      }
+      if (popped == SharedMemoryRing::PopResult::Corrupted) {
+        spdlog::error("[SharedMemoryClient::Receive]: The reply ring is "
+                      "corrupted.\n");
+        Close();
+        return false;
+      }
+    }
+
+    m_Replies.SetConsumerWaiting(true);
+    if (m_Replies.Empty()) {
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0) {
+        m_Replies.SetConsumerWaiting(false);
+        return false;
+      }
+      // The socket only becomes readable when the server hangs up
+      pollfd pollFds[2] = {{m_ReplyEvent, POLLIN, 0},
+                           {m_SocketFd, POLLIN, 0}};
+      poll(pollFds, 2, static_cast<int>(left.count()));
+      if (pollFds[1].revents != 0 && m_Replies.Empty()) {
+        m_Replies.SetConsumerWaiting(false);
+        return false;
+      }
+      eventfd_t count;
+      eventfd_read(m_ReplyEvent, &count);
+    }
+    m_Replies.SetConsumerWaiting(false);
+  }
+}
+
+void SharedMemoryClient::Close() {
+  if (m_Memory != nullptr) {
+    munmap(m_Memory, m_Size);
+    m_Memory = nullptr;
+  }
+  for (int *fd : {&m_RequestEvent, &m_ReplyEvent, &m_SocketFd}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+} // namespace mathboard
@@ -0,0 +1,54 @@
+#pragma once
+#ifdef __linux__
+
+// local
+#include "shared_memory_ring.hpp"
+
+// std
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+namespace mathboard {
+
+// Client side of SharedMemoryServer, for a frontend on the same host.
+// Connect() does the handshake over the Unix socket, messages then only go
+// through the shared rings. Closing the client closes the connection. Not
+// thread-safe, use one client per thread.
+class SharedMemoryClient {
+public:
+  SharedMemoryClient() = default;
+
+  ~SharedMemoryClient() { Close(); }
+
+  SharedMemoryClient(const SharedMemoryClient &) = delete;
+  SharedMemoryClient &operator=(const SharedMemoryClient &) = delete;
+
+  bool Connect(const std::filesystem::path &socket_path);
+
+  bool IsConnected() const { return m_SocketFd >= 0; }
+
+  // Queue a message for the daemon, waits while the request ring is full
+  bool Send(std::string_view message);
+
+  // Wait for the next reply, false after `timeout`
+  bool Receive(std::vector<unsigned char> &buffer,
+               std::chrono::milliseconds timeout);
+
+  void Close();
+
+private:
+  int m_SocketFd{-1};
+  void *m_Memory{nullptr};
+  std::size_t m_Size{0};
+  SharedMemoryRing m_Requests{};
+  SharedMemoryRing m_Replies{};
+  int m_RequestEvent{-1};
+  int m_ReplyEvent{-1};
+};
+
+} // namespace mathboard
+
+#endif
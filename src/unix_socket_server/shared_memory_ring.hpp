@@ -0,0 +1,178 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <vector>
+
+namespace mathboard {
+
+// Single-producer single-consumer ring of length-prefixed messages, living in
+// memory shared by two processes. The positions only ever grow, the byte at
+// position p is data[p & (capacity - 1)].
+//
+// The consumer announces it's about to sleep with SetConsumerWaiting() and
+// checks the ring once more, the producer only wakes it up (through an
+// eventfd) when WakeConsumer() says it's waiting. Both sides use sequentially
+// consistent operations for that handshake, so either the consumer sees the
+// new message or the producer sees the flag, and a busy consumer costs the
+// producer no syscall.
+class SharedMemoryRing {
+public:
+  struct Header {
+    // Bytes written by the producer
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    // Bytes read by the consumer
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    alignas(64) std::atomic<std::uint32_t> consumer_waiting{0};
+  };
+
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free &&
+                    std::atomic<std::uint32_t>::is_always_lock_free,
+                "Atomics in shared memory have to be lock free");
+
+  // Bytes a ring of `capacity` takes, header included. `capacity` has to be
+  // a power of two.
+  static constexpr std::size_t RequiredSize(std::size_t capacity) {
+    return sizeof(Header) + capacity;
+  }
+
+  SharedMemoryRing() = default;
+
+  // Use a ring at `memory`, set it up first when `initialize` is true (only
+  // on the side creating the segment)
+  SharedMemoryRing(void *memory, std::size_t capacity, bool initialize)
+      : m_Header(static_cast<Header *>(memory)),
+        m_Data(static_cast<unsigned char *>(memory) + sizeof(Header)),
+        m_Capacity(capacity) {
+    if (initialize) {
+      new (m_Header) Header{};
+    }
+  }
+
+  // Largest message that fits in the empty ring
+  std::size_t MaxMessageSize() const {
+    return m_Capacity - sizeof(std::uint32_t);
+  }
+
+  // Return false if there's not enough free space right now
+  bool TryPush(std::string_view message) {
+    const std::uint64_t head = m_Header->head.load(std::memory_order_relaxed);
+    const std::uint64_t tail = m_Header->tail.load(std::memory_order_acquire);
+    const std::size_t required = sizeof(std::uint32_t) + message.size();
+    if (required > m_Capacity - (head - tail)) {
+      return false;
+    }
+
+    const auto size = static_cast<std::uint32_t>(message.size());
+    CopyIn(head, &size, sizeof(size));
+    CopyIn(head + sizeof(size), message.data(), message.size());
+    m_Header->head.store(head + required, std::memory_order_seq_cst);
+    return true;
+  }
+
+  enum class PopResult { Empty, Popped, Corrupted };
+
+  // `buffer` is resized to the popped message. The positions and sizes come
+  // from the other process, ones that can't be right are a protocol error,
+  // Corrupted, and nothing is read.
+  PopResult TryPop(std::vector<unsigned char> &buffer) {
+    const std::uint64_t tail = m_Header->tail.load(std::memory_order_relaxed);
+    const std::uint64_t head = m_Header->head.load(std::memory_order_seq_cst);
+    if (head == tail) {
+      return PopResult::Empty;
+    }
+
+    const std::uint64_t available = head - tail;
+    if (available > m_Capacity || available < sizeof(std::uint32_t)) {
+      return PopResult::Corrupted;
+    }
+    std::uint32_t size = 0;
+    CopyOut(tail, &size, sizeof(size));
+    if (sizeof(size) + std::uint64_t{size} > available) {
+      return PopResult::Corrupted;
+    }
+
+    buffer.resize(size);
+    CopyOut(tail + sizeof(size), buffer.data(), size);
+    m_Header->tail.store(tail + sizeof(size) + size,
+                         std::memory_order_release);
+    return PopResult::Popped;
+  }
+
+  bool Empty() const {
+    return m_Header->head.load(std::memory_order_seq_cst) ==
+           m_Header->tail.load(std::memory_order_relaxed);
+  }
+
+  // Consumer: call before checking Empty() one last time and sleeping
+  void SetConsumerWaiting(bool waiting) {
+    m_Header->consumer_waiting.store(waiting ? 1 : 0,
+                                     std::memory_order_seq_cst);
+  }
+
+  // Producer: true if the consumer has to be woken up after a push
+  bool WakeConsumer() {
+    return m_Header->consumer_waiting.exchange(0, std::memory_order_seq_cst) !=
+           0;
+  }
+
+private:
+  void CopyIn(std::uint64_t position, const void *source, std::size_t size) {
+    const std::size_t offset = position & (m_Capacity - 1);
+    const std::size_t first = std::min(size, m_Capacity - offset);
+    std::memcpy(m_Data + offset, source, first);
+    std::memcpy(m_Data, static_cast<const unsigned char *>(source) + first,
+                size - first);
+  }
+
+  void CopyOut(std::uint64_t position, void *destination,
+               std::size_t size) const {
+    const std::size_t offset = position & (m_Capacity - 1);
+    const std::size_t first = std::min(size, m_Capacity - offset);
+    std::memcpy(destination, m_Data + offset, first);
+    std::memcpy(static_cast<unsigned char *>(destination) + first, m_Data,
+                size - first);
+  }
+
+private:
+  Header *m_Header{nullptr};
+  unsigned char *m_Data{nullptr};
+  std::size_t m_Capacity{0};
+};
+
+// Shared memory segment of a connection: the request ring (client to
+// server) followed by the reply ring (server to client)
+struct SharedMemoryLayout {
+  explicit SharedMemoryLayout(std::size_t ring_capacity)
+      : capacity(std::bit_ceil(ring_capacity)),
+        ring_size(SharedMemoryRing::RequiredSize(capacity)) {}
+
+  std::size_t TotalSize() const { return 2 * ring_size; }
+
+  SharedMemoryRing Requests(void *memory, bool initialize) const {
+    return SharedMemoryRing(memory, capacity, initialize);
+  }
+
+  SharedMemoryRing Replies(void *memory, bool initialize) const {
+    return SharedMemoryRing(static_cast<unsigned char *>(memory) + ring_size,
+                            capacity, initialize);
+  }
+
+  std::size_t capacity;
+  std::size_t ring_size;
+};
+
+// Sent by the server with the segment's memfd and the request and reply
+// eventfds
+struct SharedMemoryHandshake {
+  std::uint64_t ring_capacity{0};
+};
+
+} // namespace mathboard
@@ -0,0 +1,324 @@
+// header
+#include "shared_memory_server.hpp"
+
+// lib
+// spdlog
+#include <spdlog/spdlog.h>
+
+// std
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+// linux std
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+namespace mathboard {
+
+namespace {
+
+// How long a reply waits for a client that doesn't empty its ring
+constexpr std::chrono::seconds kWriteTimeout{1};
+
+// Checks of the request rings before Poll() goes to sleep, under load the
+// next request usually shows up within that time and costs no syscall
+constexpr std::uint32_t kSpinCount = 2000;
+
+} // namespace
+
+SharedMemoryServer::Connection::~Connection() {
+  if (memory != nullptr) {
+    munmap(memory, size);
+  }
+  if (request_event >= 0) {
+    close(request_event);
+  }
+  if (reply_event >= 0) {
+    close(reply_event);
+  }
+}
+
+SharedMemoryServer::~SharedMemoryServer() {
+  for (const auto &[socketFd, connection] : m_Connections) {
+    LinuxUnixSocketServer::Close(socketFd);
+  }
+}
+
+bool SharedMemoryServer::Accept(int &socket_cli_fd, void **sock_cli_addr) {
+  if (!LinuxUnixSocketServer::Accept(socket_cli_fd, sock_cli_addr)) {
+    return false;
+  }
+
+  auto connection = std::make_shared<Connection>();
+  if (!Handshake(socket_cli_fd, *connection)) {
+    LinuxUnixSocketServer::Close(socket_cli_fd);
+    return false;
+  }
+
+  std::lock_guard lock(m_Mutex);
+  m_Connections[socket_cli_fd] = std::move(connection);
+  return true;
+}
+
+bool SharedMemoryServer::Handshake(int socket_fd, Connection &connection) {
+  const int memoryFd = memfd_create("mathboard", MFD_CLOEXEC);
+  if (memoryFd < 0) {
+    spdlog::error(
+        "[SharedMemoryServer::Handshake]: Could not create the segment.\n");
+    return false;
+  }
+
+  connection.size = m_Layout.TotalSize();
+  if (ftruncate(memoryFd, static_cast<off_t>(connection.size)) < 0) {
+    spdlog::error(
+        "[SharedMemoryServer::Handshake]: Could not size the segment.\n");
+    close(memoryFd);
+    return false;
+  }
+
+  void *memory = mmap(nullptr, connection.size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, memoryFd, 0);
+  if (memory == MAP_FAILED) {
+    spdlog::error(
+        "[SharedMemoryServer::Handshake]: Could not map the segment.\n");
+    close(memoryFd);
+    return false;
+  }
+  connection.memory = memory;
+  connection.requests = m_Layout.Requests(memory, true);
+  connection.replies = m_Layout.Replies(memory, true);
+
+  connection.request_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  connection.reply_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (connection.request_event < 0 || connection.reply_event < 0) {
+    spdlog::error(
+        "[SharedMemoryServer::Handshake]: Could not create the eventfds.\n");
+    close(memoryFd);
+    return false;
+  }
+
+  // Hand the segment and the eventfds over to the client
+  SharedMemoryHandshake handshake{m_Layout.capacity};
+  iovec payload{&handshake, sizeof(handshake)};
+  const int fds[3] = {memoryFd, connection.request_event,
+                      connection.reply_event};
+  alignas(cmsghdr) unsigned char control[CMSG_SPACE(sizeof(fds))]{};
+
+  msghdr message{};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  cmsghdr *rights = CMSG_FIRSTHDR(&message);
+  rights->cmsg_level = SOL_SOCKET;
+  rights->cmsg_type = SCM_RIGHTS;
+  rights->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(rights), fds, sizeof(fds));
+
+  const bool sent = sendmsg(socket_fd, &message, MSG_NOSIGNAL) ==
+                    static_cast<ssize_t>(sizeof(handshake));
+  // The mapping and the client's copy keep the segment alive
+  close(memoryFd);
+  if (!sent) {
+    spdlog::error(
+        "[SharedMemoryServer::Handshake]: Could not send the segment.\n");
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<SharedMemoryServer::Connection>
+SharedMemoryServer::Find(std::int32_t socket_fd) {
+  std::lock_guard lock(m_Mutex);
+  const auto connection = m_Connections.find(socket_fd);
+  return connection == m_Connections.end() ? nullptr : connection->second;
+}
+
+bool SharedMemoryServer::Read(const std::int32_t socket_fd,
+                              std::vector<unsigned char> &buffer) {
+  const std::shared_ptr<Connection> connection = Find(socket_fd);
+  if (connection == nullptr) {
+    return LinuxUnixSocketServer::Read(socket_fd, buffer);
+  }
+
+  // Shut down, reported as EOF so the caller closes it
+  if (connection->shut_down) {
+    buffer.clear();
+    return true;
+  }
+
+  switch (connection->requests.TryPop(buffer)) {
+  case SharedMemoryRing::PopResult::Popped:
+    return true;
+  case SharedMemoryRing::PopResult::Corrupted:
+    // Closed by the caller like any other failed read
+    spdlog::error("[SharedMemoryServer::Read]: The request ring is "
+                  "corrupted.\n");
+    return false;
+  case SharedMemoryRing::PopResult::Empty:
+    break;
+  }
+
+  // No message, so Poll() woke us up because the socket hung up
+  unsigned char byte;
+  const ssize_t received =
+      recv(socket_fd, &byte, sizeof(byte), MSG_DONTWAIT | MSG_PEEK);
+  if (received == 0) {
+    buffer.clear();
+    return true;
+  }
+
+  spdlog::error("[SharedMemoryServer::Read]: No message to read.\n");
+  return false;
+}
+
+bool SharedMemoryServer::Push(std::int32_t socket_fd,
+                              std::string_view message) {
+  const std::shared_ptr<Connection> connection = Find(socket_fd);
+  if (connection == nullptr) {
+    spdlog::error("[SharedMemoryServer::Push]: Unknown connection.\n");
+    return false;
+  }
+  if (message.empty() ||
+      message.size() > connection->replies.MaxMessageSize()) {
+    spdlog::error("[SharedMemoryServer::Push]: Message of {} bytes doesn't "
+                  "fit the ring.\n",
+                  message.size());
+    return false;
+  }
+
+  std::lock_guard lock(connection->write_mutex);
+
+  // Wait for the client to make room, a client that stopped reading only
+  // costs its own replies
+  const auto deadline = std::chrono::steady_clock::now() + kWriteTimeout;
+  while (!connection->replies.TryPush(message)) {
+    if (connection->shut_down) {
+      return false;
+    }
+    if (std::chrono::steady_clock::now() > deadline) {
+      spdlog::error("[SharedMemoryServer::Push]: The reply ring is full.\n");
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+
+  if (connection->replies.WakeConsumer()) {
+    eventfd_write(connection->reply_event, 1);
+  }
+  return true;
+}
+
+bool SharedMemoryServer::Write(const std::int32_t socket_fd,
+                               const std::vector<unsigned char> &buffer) {
+  return Push(socket_fd,
+              std::string_view(reinterpret_cast<const char *>(buffer.data()),
+                               buffer.size()));
+}
+
+bool SharedMemoryServer::WriteString(const std::int32_t socket_fd,
+                                     const std::string &msg) {
+  return Push(socket_fd, msg);
+}
+
+bool SharedMemoryServer::WriteV(
+    const std::int32_t socket_fd,
+    const std::vector<std::string_view> &messages) {
+  // The ring keeps the messages apart, no newline needed
+  for (const std::string_view message : messages) {
+    if (!Push(socket_fd, message)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SharedMemoryServer::TryWriteV(const std::int32_t socket_fd,
+                                   PendingWrite &pending) {
+  return UnixSocketServer::TryWriteV(socket_fd, pending);
+}
+
+bool SharedMemoryServer::Poll(const std::vector<std::int32_t> &socket_fds,
+                              std::vector<std::int32_t> &ready) {
+  ready.clear();
+
+  std::vector<std::shared_ptr<Connection>> connections(socket_fds.size());
+  for (std::size_t i = 0; i < socket_fds.size(); i++) {
+    connections[i] = Find(socket_fds[i]);
+  }
+
+  bool pending = false;
+  for (std::uint32_t spin = 0; spin < kSpinCount && !pending; spin++) {
+    for (const std::shared_ptr<Connection> &connection : connections) {
+      if (connection != nullptr && !connection->requests.Empty()) {
+        pending = true;
+        break;
+      }
+    }
+  }
+
+  std::vector<pollfd> pollFds;
+  pollFds.reserve(2 * socket_fds.size());
+  // Don't sleep if a connection already has a message waiting, but still
+  // look for new clients and hang ups
+  for (std::size_t i = 0; i < socket_fds.size(); i++) {
+    pollFds.push_back(pollfd{socket_fds[i], POLLIN, 0});
+    if (connections[i] != nullptr) {
+      connections[i]->requests.SetConsumerWaiting(true);
+      pending = pending || !connections[i]->requests.Empty();
+      pollFds.push_back(pollfd{connections[i]->request_event, POLLIN, 0});
+    }
+  }
+
+  const int result = poll(pollFds.data(), pollFds.size(), pending ? 0 : -1);
+  if (result < 0 && errno != EINTR) {
+    spdlog::error("[SharedMemoryServer::Poll]: Could not poll the "
+                  "sockets.\n");
+    return false;
+  }
+
+  std::size_t pollIndex = 0;
+  for (std::size_t i = 0; i < socket_fds.size(); i++) {
+    const bool socketReady = result > 0 && pollFds[pollIndex].revents != 0;
+    pollIndex++;
+    if (connections[i] == nullptr) {
+      if (socketReady) {
+        ready.push_back(socket_fds[i]);
+      }
+      continue;
+    }
+
+    const bool eventReady = result > 0 && pollFds[pollIndex].revents != 0;
+    pollIndex++;
+    connections[i]->requests.SetConsumerWaiting(false);
+    // Only reset the eventfds that fired, the others would just fail
+    if (eventReady) {
+      eventfd_t count;
+      eventfd_read(connections[i]->request_event, &count);
+    }
+    if (socketReady || !connections[i]->requests.Empty()) {
+      ready.push_back(socket_fds[i]);
+    }
+  }
+  return true;
+}
+
+void SharedMemoryServer::Shutdown(const std::int32_t socket_fd) {
+  const std::shared_ptr<Connection> connection = Find(socket_fd);
+  if (connection != nullptr) {
+    connection->shut_down = true;
+  }
+  LinuxUnixSocketServer::Shutdown(socket_fd);
+}
+
+void SharedMemoryServer::Close(const std::int32_t socket_fd) {
+  {
+    std::lock_guard lock(m_Mutex);
+    m_Connections.erase(socket_fd);
+  }
+  LinuxUnixSocketServer::Close(socket_fd);
+}
+
+} // namespace mathboard
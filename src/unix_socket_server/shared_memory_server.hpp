@@ -0,0 +1,100 @@
+#pragma once
+#ifdef __linux__
+
+// prototype
+#include "linux_unix_socket_server.hpp"
+
+// local
+#include "shared_memory_ring.hpp"
+
+// std
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mathboard {
+
+// Messages go through a pair of lock-free rings in a memfd segment shared
+// with the client instead of through the socket, which is only used for the
+// handshake and to notice the client going away. Accept() creates the
+// segment and two eventfds and hands them over with SCM_RIGHTS, the
+// connection keeps being identified by its socket fd, so the daemon loop
+// doesn't know the difference. Clients connect with SharedMemoryClient.
+//
+// Accept, Read, Poll and Close are called from the daemon loop, Write and
+// WriteString from any thread.
+class SharedMemoryServer : public LinuxUnixSocketServer {
+public:
+  explicit SharedMemoryServer(std::size_t ring_capacity = 1 << 20)
+      : m_Layout(ring_capacity) {}
+
+  ~SharedMemoryServer() override;
+
+  bool Accept(int &socket_cli_fd, void **sock_cli_addr) override;
+
+  // Read one whole message, whatever the size of the buffer
+  bool Read(const std::int32_t socket_fd,
+            std::vector<unsigned char> &buffer) override;
+
+  bool Write(const std::int32_t socket_fd,
+             const std::vector<unsigned char> &buffer) override;
+
+  bool WriteString(const std::int32_t socket_fd,
+                   const std::string &msg) override;
+
+  bool WriteV(const std::int32_t socket_fd,
+              const std::vector<std::string_view> &messages) override;
+
+  // Replies go to the ring, a full one waits at most for the write timeout
+  bool TryWriteV(const std::int32_t socket_fd, PendingWrite &pending) override;
+
+  bool Poll(const std::vector<std::int32_t> &socket_fds,
+            std::vector<std::int32_t> &ready) override;
+
+  // Also fails a reply waiting for room in the ring
+  void Shutdown(const std::int32_t socket_fd) override;
+
+  void Close(const std::int32_t socket_fd) override;
+
+private:
+  struct Connection {
+    ~Connection();
+
+    void *memory{nullptr};
+    std::size_t size{0};
+    SharedMemoryRing requests{};
+    SharedMemoryRing replies{};
+    // Signaled by the client after a request, by us after a reply
+    int request_event{-1};
+    int reply_event{-1};
+    // The reply ring has a single producer
+    std::mutex write_mutex{};
+    // Set by Shutdown(), replies fail and reads see EOF
+    std::atomic<bool> shut_down{false};
+  };
+
+  bool Handshake(int socket_fd, Connection &connection);
+
+  // Keeps the connection mapped while a writer uses it, even if it's closed
+  // in the meantime
+  std::shared_ptr<Connection> Find(std::int32_t socket_fd);
+
+  bool Push(std::int32_t socket_fd, std::string_view message);
+
+private:
+  const SharedMemoryLayout m_Layout;
+  std::mutex m_Mutex{};
+  std::unordered_map<std::int32_t, std::shared_ptr<Connection>>
+      m_Connections{};
+};
+
+} // namespace mathboard
+
+#endif
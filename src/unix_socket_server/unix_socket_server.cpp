@@ -1,12 +1,61 @@
 // header
 #include "unix_socket_server.hpp"
+#include "io_uring_server.hpp"
 #include "linux_unix_socket_server.hpp"
+#include "shared_memory_server.hpp"
+
+// lib
+// spdlog
+#include <spdlog/spdlog.h>
 
 namespace mathboard {
 
-UnixSocketServer *UnixSocketServer::Instance() {
+std::optional<Transport> ParseTransport(std::string_view name) {
+  if (name == "socket") {
+    return Transport::Socket;
+  }
+  if (name == "io-uring") {
+    return Transport::IoUring;
+  }
+  if (name == "shared-memory") {
+    return Transport::SharedMemory;
+  }
+  return std::nullopt;
+}
+
+bool UnixSocketServer::WriteV(const std::int32_t socket_fd,
+                              const std::vector<std::string_view> &messages) {
+  std::string joined;
+  for (const std::string_view message : messages) {
+    joined.append(message);
+    joined.push_back('\n');
+  }
+  return WriteString(socket_fd, joined);
+}
+
+bool UnixSocketServer::TryWriteV(const std::int32_t socket_fd,
+                                 PendingWrite &pending) {
+  const std::deque<std::string> taken = std::move(pending.messages);
+  pending = PendingWrite{};
+  const std::vector<std::string_view> messages(taken.begin(), taken.end());
+  return WriteV(socket_fd, messages);
+}
+
+UnixSocketServer *UnixSocketServer::Instance(Transport transport) {
 #ifdef __linux__
-  UnixSocketServer *instance = new LinuxUnixSocketServer();
+  UnixSocketServer *instance = nullptr;
+  if (transport == Transport::IoUring) {
+    instance = IoUringServer::Create();
+    if (instance == nullptr) {
+      spdlog::warn("[UnixSocketServer::Instance]: io_uring isn't available, "
+                   "falling back to poll().\n");
+    }
+  } else if (transport == Transport::SharedMemory) {
+    instance = new SharedMemoryServer();
+  }
+  if (instance == nullptr) {
+    instance = new LinuxUnixSocketServer();
+  }
 
 #elif _WIN32
   // TODO
@@ -1,17 +1,43 @@
 #pragma once
 
 // std
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
 namespace mathboard {
 
+// How messages travel between the clients and the server
+enum class Transport {
+  // Read and written through the Unix socket
+  Socket,
+  // Through the Unix socket as well, batching the syscalls with io_uring.
+  // Falls back to Socket on kernels without it, see IoUringServer
+  IoUring,
+  // Through rings in memory shared with the client, the socket is only used
+  // for the handshake, see SharedMemoryServer
+  SharedMemory
+};
+
+std::optional<Transport> ParseTransport(std::string_view name);
+
+// Messages a connection didn't take yet, see UnixSocketServer::TryWriteV()
+struct PendingWrite {
+  std::deque<std::string> messages{};
+  // Bytes of the first message already written, its newline included
+  std::size_t offset{0};
+};
+
 class UnixSocketServer {
 public:
   virtual ~UnixSocketServer() = default;
 
-  static UnixSocketServer *Instance();
+  static UnixSocketServer *Instance(Transport transport = Transport::Socket);
 
   virtual bool Init(const std::filesystem::path &socket_path) = 0;
 
@@ -19,6 +45,8 @@ public:
 
   virtual bool Accept(int &socket_cli_fd, void **sock_cli_addr) = 0;
 
+  // Read what's available, up to buffer.size() - 1 bytes. The buffer is
+  // resized to the bytes read, it's empty once the client disconnected.
   virtual bool Read(const std::int32_t socket_fd,
                     std::vector<unsigned char> &buffer) = 0;
 
@@ -28,6 +56,30 @@ public:
   virtual bool WriteString(const std::int32_t socket_fd,
                            const std::string &msg) = 0;
 
+  // Write every message followed by a newline, gathered into as few writes
+  // as the transport allows. The default joins them for WriteString.
+  virtual bool WriteV(const std::int32_t socket_fd,
+                      const std::vector<std::string_view> &messages);
+
+  // Write the pending messages like WriteV(), as far as the connection takes
+  // them without waiting for the client, and take what's written out of
+  // `pending`. Return false when the connection failed. The default writes
+  // them all with WriteV(), for transports whose writes don't block on the
+  // client.
+  virtual bool TryWriteV(const std::int32_t socket_fd, PendingWrite &pending);
+
+  // Wait until some of `socket_fds` are readable or closed by the peer and
+  // store them in `ready`. The server's own fd is ready when a client waits
+  // to be accepted.
+  virtual bool Poll(const std::vector<std::int32_t> &socket_fds,
+                    std::vector<std::int32_t> &ready) = 0;
+
+  // Stop the connection's I/O but keep its fd: blocked and later writes
+  // fail, reads see EOF. Close() still has to be called.
+  virtual void Shutdown(const std::int32_t socket_fd) = 0;
+
+  virtual void Close(const std::int32_t socket_fd) = 0;
+
   virtual std::int32_t GetServerSocketFd() const { return m_SocketServFd; }
 
 protected:
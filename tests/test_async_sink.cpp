@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include "../src/logging/async_sink.hpp"
+
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/spdlog.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Collects the payloads, the first message blocks until Release() so the
+// queue fills up behind it
+class StalledSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+  void WaitUntilStalled() {
+    std::unique_lock<std::mutex> lockGate(m_GateMutex);
+    m_Gate.wait(lockGate, [this]() { return m_Stalled; });
+  }
+
+  void Release() {
+    {
+      std::lock_guard<std::mutex> lockGate(m_GateMutex);
+      m_Released = true;
+    }
+    m_Gate.notify_all();
+  }
+
+  std::vector<std::string> payloads{};
+
+protected:
+  void sink_it_(const spdlog::details::log_msg &msg) override {
+    payloads.emplace_back(msg.payload.data(), msg.payload.size());
+
+    std::unique_lock<std::mutex> lockGate(m_GateMutex);
+    m_Stalled = true;
+    m_Gate.notify_all();
+    m_Gate.wait(lockGate, [this]() { return m_Released; });
+  }
+
+  void flush_() override {}
+
+private:
+  std::mutex m_GateMutex{};
+  std::condition_variable m_Gate{};
+  bool m_Stalled = false;
+  bool m_Released = false;
+};
+
+std::vector<std::string> LogWhileStalled(mathboard::LogOverflowPolicy policy,
+                                         std::uint64_t &dropped) {
+  auto backend = std::make_shared<StalledSink>();
+  {
+    auto sink = std::make_shared<mathboard::AsyncSink>(
+        backend, mathboard::AsyncLoggingOptions{4, policy});
+    spdlog::logger logger("test", sink);
+
+    logger.info("0");
+    backend->WaitUntilStalled();
+    for (int i = 1; i < 8; i++) {
+      logger.info("{}", i);
+    }
+    dropped = sink->GetDroppedCount();
+    backend->Release();
+  }
+  return backend->payloads;
+}
+
+} // namespace
+
+TEST(AsyncSink, BlocksUntilEveryMessageIsWritten) {
+  auto backend = std::make_shared<StalledSink>();
+  backend->Release();
+  std::uint64_t dropped = 0;
+  {
+    auto sink = std::make_shared<mathboard::AsyncSink>(
+        backend,
+        mathboard::AsyncLoggingOptions{4, mathboard::LogOverflowPolicy::Block});
+    spdlog::logger logger("test", sink);
+    // Far more than the queue holds, logging waits for the writer
+    for (int i = 0; i < 1000; i++) {
+      logger.info("{}", i);
+    }
+    dropped = sink->GetDroppedCount();
+  }
+
+  EXPECT_EQ(dropped, 0u);
+  ASSERT_EQ(backend->payloads.size(), 1000u);
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(backend->payloads[i], std::to_string(i));
+  }
+}
+
+TEST(AsyncSink, DropsNewestMessages) {
+  std::uint64_t dropped = 0;
+  const std::vector<std::string> payloads =
+      LogWhileStalled(mathboard::LogOverflowPolicy::DropNewest, dropped);
+  EXPECT_EQ(dropped, 3u);
+  EXPECT_EQ(payloads, (std::vector<std::string>{"0", "1", "2", "3", "4"}));
+}
+
+TEST(AsyncSink, DropsOldestMessages) {
+  std::uint64_t dropped = 0;
+  const std::vector<std::string> payloads =
+      LogWhileStalled(mathboard::LogOverflowPolicy::DropOldest, dropped);
+  EXPECT_EQ(dropped, 3u);
+  EXPECT_EQ(payloads, (std::vector<std::string>{"0", "4", "5", "6", "7"}));
+}
+
+namespace {
+
+class CountingSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+  std::vector<std::string> payloads{};
+  int flushes = 0;
+
+protected:
+  void sink_it_(const spdlog::details::log_msg &msg) override {
+    payloads.emplace_back(msg.payload.data(), msg.payload.size());
+  }
+
+  void flush_() override { flushes++; }
+};
+
+} // namespace
+
+TEST(AsyncSink, FlushWaitsForTheWriter) {
+  for (const mathboard::LogOverflowPolicy policy :
+       {mathboard::LogOverflowPolicy::Block,
+        mathboard::LogOverflowPolicy::DropNewest,
+        mathboard::LogOverflowPolicy::DropOldest}) {
+    auto backend = std::make_shared<CountingSink>();
+    auto sink = std::make_shared<mathboard::AsyncSink>(
+        backend, mathboard::AsyncLoggingOptions{4, policy});
+    spdlog::logger logger("test", sink);
+    logger.flush_on(spdlog::level::err);
+
+    logger.info("first");
+    logger.flush();
+    ASSERT_FALSE(backend->payloads.empty());
+    EXPECT_EQ(backend->payloads.back(), "first");
+    EXPECT_EQ(backend->flushes, 1);
+
+    // Errors are written out before logging returns
+    logger.error("failed");
+    EXPECT_EQ(backend->payloads.back(), "failed");
+    EXPECT_EQ(backend->flushes, 2);
+  }
+}
+
+TEST(AsyncSink, FlushIsNotDroppedWhenTheQueueIsFull) {
+  auto backend = std::make_shared<StalledSink>();
+  {
+    auto sink = std::make_shared<mathboard::AsyncSink>(
+        backend, mathboard::AsyncLoggingOptions{
+                     4, mathboard::LogOverflowPolicy::DropOldest});
+    spdlog::logger logger("test", sink);
+
+    logger.info("0");
+    backend->WaitUntilStalled();
+    std::thread flusher([&logger]() { logger.flush(); });
+    // Pushes the flush out of the queue's way, it has to be queued again
+    for (int i = 1; i < 16; i++) {
+      logger.info("{}", i);
+    }
+    backend->Release();
+    // Returns once the writer got to the flush
+    flusher.join();
+  }
+  EXPECT_EQ(backend->payloads.front(), "0");
+  EXPECT_EQ(backend->payloads.back(), "15");
+}
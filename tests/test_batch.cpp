@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include "../src/batch.hpp"
+
+#include <nlohmann/json.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<nlohmann::json> ReadResults(const std::filesystem::path &path) {
+  std::vector<nlohmann::json> results;
+  std::ifstream file(path);
+  for (std::string line; std::getline(file, line);) {
+    results.push_back(nlohmann::json::parse(line));
+  }
+  return results;
+}
+
+std::string ReadFile(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return std::move(contents).str();
+}
+
+// Empty directory for the test's files, removed again at the end
+class BatchTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    m_Directory = std::filesystem::temp_directory_path() /
+                  ("mathboard_test_batch_" +
+                   std::string(::testing::UnitTest::GetInstance()
+                                   ->current_test_info()
+                                   ->name()));
+    std::filesystem::remove_all(m_Directory);
+    std::filesystem::create_directories(m_Directory);
+
+    m_Options.input = m_Directory / "requests.jsonl";
+    m_Options.output = m_Directory / "results.jsonl";
+  }
+
+  void TearDown() override { std::filesystem::remove_all(m_Directory); }
+
+  // Request with a single stroke, a 10x10 square at (5, 5) of its image
+  std::string MakeStrokeRequest(int board_id) {
+    const std::filesystem::path image = m_Directory / "stroke.png";
+    if (!std::filesystem::exists(image)) {
+      cv::Mat stroke = cv::Mat::zeros(30, 30, CV_8UC3);
+      cv::rectangle(stroke, cv::Rect(5, 5, 10, 10),
+                    cv::Scalar(255, 255, 255), cv::FILLED);
+      cv::imwrite(image.string(), stroke);
+    }
+    return nlohmann::json{{"boardId", board_id},
+                          {"strokes",
+                           {{{"id", 7},
+                             {"x", 3.0},
+                             {"y", 4.0},
+                             {"path", image.string()}}}}}
+        .dump();
+  }
+
+  std::filesystem::path m_Directory{};
+  mathboard::BatchOptions m_Options{};
+};
+
+} // namespace
+
+TEST_F(BatchTest, ResumesFromTheCheckpoint) {
+  const mathboard::BatchOptions &options = m_Options;
+
+  // Invalid requests never reach the pipeline, they get an error result
+  {
+    std::ofstream input(options.input);
+    input << "not json\n\n{}\n";
+  }
+  ASSERT_TRUE(mathboard::RunBatch(options));
+  EXPECT_EQ(ReadResults(options.output).size(), 2u);
+
+  // A result past the checkpoint, as if the batch got killed
+  {
+    std::ofstream output(options.output, std::ios::app);
+    output << "{\"partial\n";
+    std::ofstream input(options.input, std::ios::app);
+    input << "[]\n{\"strokes\": 1}\n";
+  }
+  ASSERT_TRUE(mathboard::RunBatch(options));
+
+  const std::vector<nlohmann::json> results = ReadResults(options.output);
+  ASSERT_EQ(results.size(), 4u);
+  for (std::size_t i = 0; i < results.size(); i++) {
+    EXPECT_EQ(results[i]["index"], i);
+    EXPECT_TRUE(results[i].contains("error"));
+  }
+  EXPECT_EQ(results[0]["source"], options.input.string() + ":1");
+  EXPECT_EQ(results[2]["source"], options.input.string() + ":4");
+}
+
+TEST_F(BatchTest, WritesTheStrokesOfSuccessfulRequests) {
+  {
+    std::ofstream input(m_Options.input);
+    input << MakeStrokeRequest(42) << '\n';
+  }
+  ASSERT_TRUE(mathboard::RunBatch(m_Options));
+
+  const std::vector<nlohmann::json> results = ReadResults(m_Options.output);
+  ASSERT_EQ(results.size(), 1u);
+  const nlohmann::json &result = results[0];
+  EXPECT_FALSE(result.contains("error"));
+  EXPECT_EQ(result["index"], 0);
+  EXPECT_EQ(result["source"], m_Options.input.string() + ":1");
+  EXPECT_EQ(result["boardId"], 42);
+  ASSERT_EQ(result["strokes"].size(), 1u);
+  const nlohmann::json &stroke = result["strokes"][0];
+  EXPECT_EQ(stroke["id"], 7);
+  EXPECT_EQ(stroke["x"], 3.0);
+  EXPECT_EQ(stroke["y"], 4.0);
+  EXPECT_EQ(stroke["boundingBox"], nlohmann::json({5, 5, 10, 10}));
+  EXPECT_FALSE(stroke["contours"].empty());
+}
+
+TEST_F(BatchTest, ResumesAfterAnInterruption) {
+  constexpr std::size_t kRequestCount = 6;
+  {
+    std::ofstream input(m_Options.input);
+    for (std::size_t i = 0; i < kRequestCount; i++) {
+      input << MakeStrokeRequest(static_cast<int>(i)) << '\n';
+    }
+  }
+  m_Options.checkpoint_interval = 2;
+  ASSERT_TRUE(mathboard::RunBatch(m_Options));
+  ASSERT_EQ(ReadResults(m_Options.output).size(), kRequestCount);
+  const std::string complete = ReadFile(m_Options.output);
+
+  // Killed after checkpointing two results, with two more written and a
+  // third one half written
+  std::size_t checkpointed = 0;
+  for (int line = 0; line < 2; line++) {
+    checkpointed = complete.find('\n', checkpointed) + 1;
+  }
+  std::size_t written = checkpointed;
+  for (int line = 0; line < 2; line++) {
+    written = complete.find('\n', written) + 1;
+  }
+  std::filesystem::resize_file(m_Options.output, written + 10);
+  {
+    std::ofstream checkpoint(m_Options.output.string() + ".checkpoint",
+                             std::ios::trunc);
+    checkpoint << nlohmann::json{{"completed", 2},
+                                 {"outputBytes", checkpointed}}
+                      .dump();
+  }
+
+  ASSERT_TRUE(mathboard::RunBatch(m_Options));
+  EXPECT_EQ(ReadFile(m_Options.output), complete);
+
+  // Everything is done, a third run doesn't add anything
+  ASSERT_TRUE(mathboard::RunBatch(m_Options));
+  EXPECT_EQ(ReadFile(m_Options.output), complete);
+}
+
+TEST_F(BatchTest, RefusesToTruncateAnOutputWithoutCheckpoint) {
+  {
+    std::ofstream input(m_Options.input);
+    input << "{}\n";
+    std::ofstream output(m_Options.output);
+    output << "someone else's results\n";
+  }
+  EXPECT_FALSE(mathboard::RunBatch(m_Options));
+  EXPECT_EQ(ReadFile(m_Options.output), "someone else's results\n");
+
+  m_Options.overwrite = true;
+  ASSERT_TRUE(mathboard::RunBatch(m_Options));
+  const std::vector<nlohmann::json> results = ReadResults(m_Options.output);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_TRUE(results[0].contains("error"));
+
+  // With a checkpoint, overwriting starts over instead of resuming
+  ASSERT_TRUE(mathboard::RunBatch(m_Options));
+  EXPECT_EQ(ReadResults(m_Options.output).size(), 1u);
+}
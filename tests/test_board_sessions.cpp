@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include "../src/board_sessions.hpp"
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Filled rectangle stroke, a square by default
+mathboard::Stroke MakeStroke(std::uint32_t id, float x, float y,
+                             cv::Size size = cv::Size(10, 10)) {
+  cv::Mat image = cv::Mat::zeros(size.height + 2, size.width + 2, CV_8UC1);
+  cv::rectangle(image, cv::Rect(cv::Point(1, 1), size), cv::Scalar(255),
+                cv::FILLED);
+  return mathboard::Stroke(static_cast<int>(id), x, y, image);
+}
+
+mathboard::BoardDelta Add(std::vector<mathboard::Stroke> strokes) {
+  mathboard::BoardDelta delta{};
+  delta.type = mathboard::BoardDelta::Type::Add;
+  delta.strokes = std::move(strokes);
+  return delta;
+}
+
+mathboard::BoardDelta Remove(std::uint32_t stroke_id) {
+  mathboard::BoardDelta delta{};
+  delta.type = mathboard::BoardDelta::Type::Remove;
+  delta.stroke_id = stroke_id;
+  return delta;
+}
+
+mathboard::BoardDelta Move(std::uint32_t stroke_id, float x, float y) {
+  mathboard::BoardDelta delta{};
+  delta.type = mathboard::BoardDelta::Type::Move;
+  delta.stroke_id = stroke_id;
+  delta.position = cv::Point2f(x, y);
+  return delta;
+}
+
+// Begin and complete the delta right away
+mathboard::BoardDeltaResult Apply(mathboard::BoardSessions &sessions,
+                                  std::int64_t board_id,
+                                  mathboard::BoardDelta delta) {
+  mathboard::BoardDeltaResult applied{};
+  sessions.Complete(board_id, sessions.Begin(board_id), std::move(delta),
+                    [&applied](const mathboard::BoardDeltaResult &result) {
+                      applied = result;
+                    });
+  return applied;
+}
+
+} // namespace
+
+TEST(BoardSessions, AppliesDeltasInTheOrderTheyBegan) {
+  mathboard::BoardSessions sessions{};
+  const std::uint64_t add = sessions.Begin(1);
+  const std::uint64_t remove = sessions.Begin(1);
+  const std::uint64_t failed = sessions.Begin(1);
+
+  std::vector<mathboard::BoardDeltaResult> results;
+  const auto collect = [&results](const mathboard::BoardDeltaResult &result) {
+    results.push_back(result);
+  };
+
+  // The remove waits for the add begun before it
+  sessions.Complete(1, remove, Remove(1), collect);
+  sessions.Complete(1, failed, mathboard::BoardDelta{}, collect);
+  EXPECT_TRUE(results.empty());
+
+  std::vector<mathboard::Stroke> strokes;
+  strokes.push_back(MakeStroke(1, 0, 0));
+  strokes.push_back(MakeStroke(2, 1000, 1000));
+  sessions.Complete(1, add, Add(std::move(strokes)), collect);
+
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_TRUE(results[0].applied);
+  EXPECT_EQ(results[0].stroke_count, 2u);
+  EXPECT_TRUE(results[1].applied);
+  EXPECT_EQ(results[1].stroke_count, 1u);
+  EXPECT_FALSE(results[2].applied);
+  EXPECT_EQ(results[2].stroke_count, 1u);
+}
+
+TEST(BoardSessions, InvalidatesOnlyTheNeighbors) {
+  mathboard::BoardSessions sessions{};
+  std::vector<mathboard::Stroke> strokes;
+  strokes.push_back(MakeStroke(1, 0, 0));
+  strokes.push_back(MakeStroke(2, 20, 0));
+  strokes.push_back(MakeStroke(3, 1000, 1000));
+  EXPECT_EQ(Apply(sessions, 1, Add(std::move(strokes))).invalidated,
+            (std::vector<std::uint32_t>{1, 2, 3}));
+
+  // Far from the others
+  strokes.clear();
+  strokes.push_back(MakeStroke(4, 2000, 2000));
+  EXPECT_EQ(Apply(sessions, 1, Add(std::move(strokes))).invalidated,
+            (std::vector<std::uint32_t>{4}));
+
+  const mathboard::BoardDeltaResult moved = Apply(sessions, 1, Move(3, 30, 0));
+  EXPECT_EQ(moved.invalidated, (std::vector<std::uint32_t>{1, 2, 3}));
+
+  const mathboard::BoardDeltaResult removed = Apply(sessions, 1, Remove(1));
+  EXPECT_EQ(removed.invalidated, (std::vector<std::uint32_t>{2, 3}));
+  EXPECT_EQ(removed.stroke_count, 3u);
+
+  const mathboard::BoardDeltaResult unknown = Apply(sessions, 1, Remove(1));
+  EXPECT_FALSE(unknown.applied);
+  EXPECT_EQ(unknown.error, "Unknown stroke 1");
+}
+
+TEST(BoardSessions, InvalidatesAlongTheWholeStroke) {
+  mathboard::BoardSessions sessions{};
+  std::vector<mathboard::Stroke> strokes;
+  // A fraction bar three cells wide, and a digit above its right end
+  strokes.push_back(MakeStroke(1, 0, 300, cv::Size(300, 4)));
+  strokes.push_back(MakeStroke(2, 280, 270));
+  EXPECT_EQ(Apply(sessions, 1, Add(std::move(strokes))).invalidated,
+            (std::vector<std::uint32_t>{1, 2}));
+
+  // A tall stroke reaching down to the bar's left end
+  strokes.clear();
+  strokes.push_back(MakeStroke(3, 0, 0, cv::Size(4, 280)));
+  EXPECT_EQ(Apply(sessions, 1, Add(std::move(strokes))).invalidated,
+            (std::vector<std::uint32_t>{1, 3}));
+}
+
+TEST(BoardSessions, EvictsIdleAndLeastRecentlyUsedSessions) {
+  mathboard::BoardSessions measured{};
+  std::vector<mathboard::Stroke> strokes;
+  strokes.push_back(MakeStroke(1, 0, 0));
+  Apply(measured, 1, Add(std::move(strokes)));
+  const std::size_t sessionMemory = measured.GetMemoryUsage();
+
+  // Room for one session
+  mathboard::BoardSessionOptions options{};
+  options.max_memory = sessionMemory * 3 / 2;
+  options.idle_timeout = std::chrono::seconds(10);
+  mathboard::BoardSessions sessions(options);
+  for (std::int64_t board = 1; board <= 2; board++) {
+    strokes.clear();
+    strokes.push_back(MakeStroke(1, 0, 0));
+    EXPECT_TRUE(Apply(sessions, board, Add(std::move(strokes))).applied);
+  }
+  EXPECT_EQ(sessions.Size(), 1u);
+  EXPECT_EQ(sessions.GetEvictions(), 1u);
+  EXPECT_EQ(sessions.GetMemoryUsage(), sessionMemory);
+
+  // Board 1 was evicted, board 2 is still there
+  EXPECT_FALSE(Apply(sessions, 1, Remove(1)).applied);
+  EXPECT_TRUE(Apply(sessions, 2, Move(1, 10, 10)).applied);
+
+  EXPECT_EQ(sessions.EvictIdle(), 0u);
+  EXPECT_EQ(sessions.EvictIdle(std::chrono::steady_clock::now() +
+                               std::chrono::seconds(11)),
+            1u);
+  EXPECT_EQ(sessions.Size(), 0u);
+  EXPECT_EQ(sessions.GetMemoryUsage(), 0u);
+}
+
+TEST(BoardSessions, GroupsTouchingStrokesIntoASymbol) {
+  mathboard::BoardSessions sessions{};
+  std::vector<mathboard::Stroke> strokes;
+  // Two overlapping strokes, a separate one in the same grid cell and one
+  // far away
+  strokes.push_back(MakeStroke(1, 0, 0));
+  strokes.push_back(MakeStroke(2, 5, 5));
+  strokes.push_back(MakeStroke(3, 60, 0));
+  strokes.push_back(MakeStroke(4, 1000, 1000));
+  Apply(sessions, 1, Add(std::move(strokes)));
+
+  const mathboard::BoardSymbol plus = sessions.GetSymbol(1, 2);
+  EXPECT_EQ(plus.strokes, (std::vector<std::uint32_t>{1, 2}));
+  EXPECT_EQ(plus.bounding_box.x, 1);
+  EXPECT_EQ(plus.bounding_box.width, 15);
+
+  EXPECT_EQ(sessions.GetSymbol(1, 3).strokes,
+            std::vector<std::uint32_t>{3});
+  EXPECT_TRUE(sessions.GetSymbol(1, 5).strokes.empty());
+  EXPECT_TRUE(sessions.GetSymbol(2, 1).strokes.empty());
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include "../src/concurrency/bounded_queue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(BoundedQueue, Capacity) {
+  mathboard::BoundedQueue<int> queue(5);
+
+  EXPECT_EQ(queue.Capacity(), 8);
+
+  for (int i = 0; i < 8; i++) {
+    EXPECT_TRUE(queue.TryPush(int{i}));
+  }
+  EXPECT_FALSE(queue.TryPush(8));
+  EXPECT_EQ(queue.SizeApprox(), 8);
+}
+
+TEST(BoundedQueue, Order) {
+  mathboard::BoundedQueue<int> queue(4);
+
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 4; i++) {
+      EXPECT_TRUE(queue.TryPush(round * 4 + i));
+    }
+    for (int i = 0; i < 4; i++) {
+      int value = -1;
+      EXPECT_TRUE(queue.TryPop(value));
+      EXPECT_EQ(value, round * 4 + i);
+    }
+  }
+
+  int value;
+  EXPECT_FALSE(queue.TryPop(value));
+}
+
+TEST(BoundedQueue, Close) {
+  mathboard::BoundedQueue<int> queue(4);
+
+  EXPECT_TRUE(queue.Push(1));
+  queue.Close();
+
+  EXPECT_FALSE(queue.Push(2));
+
+  // Items pushed before closing are still delivered
+  int value = 0;
+  EXPECT_TRUE(queue.Pop(value));
+  EXPECT_EQ(value, 1);
+  EXPECT_FALSE(queue.Pop(value));
+}
+
+TEST(BoundedQueue, MultipleProducersAndConsumers) {
+  constexpr int kThreads = 4;
+  constexpr int kItemsPerThread = 10000;
+  mathboard::BoundedQueue<int> queue(16);
+
+  std::vector<std::thread> producers;
+  for (int t = 0; t < kThreads; t++) {
+    producers.emplace_back([&queue] {
+      for (int i = 1; i <= kItemsPerThread; i++) {
+        queue.Push(i);
+      }
+    });
+  }
+
+  std::vector<long long> sums(kThreads, 0);
+  std::vector<std::thread> consumers;
+  for (int t = 0; t < kThreads; t++) {
+    consumers.emplace_back([&queue, &sums, t] {
+      int value;
+      while (queue.Pop(value)) {
+        sums[t] += value;
+      }
+    });
+  }
+
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  queue.Close();
+  for (auto &consumer : consumers) {
+    consumer.join();
+  }
+
+  long long total = 0;
+  for (const long long sum : sums) {
+    total += sum;
+  }
+  EXPECT_EQ(total, static_cast<long long>(kThreads) * kItemsPerThread *
+                       (kItemsPerThread + 1) / 2);
+}
+
+TEST(BoundedQueue, CloseKeepsItemsOfPushesInProgress) {
+  // Producers racing Close(): every push that returned true has to be
+  // popped
+  for (int round = 0; round < 200; round++) {
+    mathboard::BoundedQueue<int> queue(64);
+    std::atomic<int> pushed{0};
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; t++) {
+      producers.emplace_back([&queue, &pushed] {
+        for (int i = 0; i < 8; i++) {
+          if (queue.TryPush(1)) {
+            pushed++;
+          }
+        }
+      });
+    }
+
+    int popped = 0;
+    std::thread consumer([&queue, &popped] {
+      int value;
+      while (queue.Pop(value)) {
+        popped += value;
+      }
+    });
+
+    queue.Close();
+    for (auto &producer : producers) {
+      producer.join();
+    }
+    consumer.join();
+    EXPECT_EQ(popped, pushed.load());
+  }
+}
+
+TEST(BoundedQueue, SleepingWaitersAreWoken) {
+  mathboard::BoundedQueue<int> queue(2);
+
+  // Long past the spinning, Pop sleeps until the push
+  int popped = -1;
+  std::thread consumer([&queue, &popped]() { queue.Pop(popped); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_TRUE(queue.Push(7));
+  consumer.join();
+  EXPECT_EQ(popped, 7);
+
+  // A full queue, Push sleeps until the pop
+  EXPECT_TRUE(queue.Push(1));
+  EXPECT_TRUE(queue.Push(2));
+  std::thread producer([&queue]() { EXPECT_TRUE(queue.Push(3)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  int value = 0;
+  EXPECT_TRUE(queue.Pop(value));
+  producer.join();
+
+  // Close() wakes both sides
+  std::thread blockedPush([&queue]() { EXPECT_FALSE(queue.Push(4)); });
+  mathboard::BoundedQueue<int> empty(2);
+  std::thread blockedPop([&empty]() {
+    int ignored = 0;
+    EXPECT_FALSE(empty.Pop(ignored));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  queue.Close();
+  empty.Close();
+  blockedPush.join();
+  blockedPop.join();
+  for (int expected : {2, 3}) {
+    EXPECT_TRUE(queue.Pop(value));
+    EXPECT_EQ(value, expected);
+  }
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include "../src/compiled_expression.hpp"
+#include "../src/equation_parser.hpp"
+
+#include <symengine/lambda_double.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Every opcode of the machine at least once, inputs stay in their domains
+// for X in [-3, 3]
+const std::vector<std::string> kEquations{
+    // Constant, Variable and Add
+    "X+2",
+    // Mul
+    "3*X-X*X*X",
+    // Div
+    "1/(X+5)",
+    // PowInt
+    "X**2+X**5",
+    "(X+4)**(-3)",
+    // Pow
+    "2**X+(X+4)**1.5",
+    // Sqrt, Exp and the other functions of one argument
+    "sqrt(X+4)",
+    "sin(X)+cos(X)+tan(X/2)",
+    "asin(X/4)+acos(X/4)+atan(X)",
+    "sinh(X)+cosh(X)+tanh(X)",
+    "exp(X)*log(X+4)",
+    "abs(X)-pi",
+    "sin(X)/X+X**2/100"};
+
+std::vector<double> MakeInputs(std::size_t count) {
+  std::vector<double> xs(count);
+  for (std::size_t i = 0; i < count; i++) {
+    xs[i] = -3.0 + 6.0 * static_cast<double>(i) / count + 1e-3;
+  }
+  return xs;
+}
+
+// SymEngine's own evaluation of the equation at x
+double Reference(const std::string &equation, double x) {
+  SymEngine::LambdaRealDoubleVisitor visitor;
+  visitor.init({SymEngine::symbol("X")}, *mathboard::ParseEquation(equation));
+  double y = 0.0;
+  visitor.call(&y, &x);
+  return y;
+}
+
+void ExpectMatches(const std::string &equation, const std::vector<double> &xs,
+                   const std::vector<double> &ys) {
+  ASSERT_EQ(xs.size(), ys.size());
+  SymEngine::LambdaRealDoubleVisitor visitor;
+  visitor.init({SymEngine::symbol("X")}, *mathboard::ParseEquation(equation));
+  for (std::size_t i = 0; i < xs.size(); i++) {
+    double expected = 0.0;
+    visitor.call(&expected, &xs[i]);
+    ASSERT_NEAR(ys[i], expected, 1e-12 * std::max(1.0, std::abs(expected)))
+        << equation << " at " << xs[i];
+  }
+}
+
+} // namespace
+
+TEST(CompiledExpression, EveryOpcodeMatchesSymEngine) {
+  for (const std::string &equation : kEquations) {
+    const auto compiled =
+        mathboard::CompiledExpression::FromEquation(equation, {"X"});
+    EXPECT_TRUE(compiled.IsCompiled()) << equation;
+
+    for (const double x : {-2.5, 0.5, 2.75}) {
+      const double expected = Reference(equation, x);
+      EXPECT_NEAR(compiled.EvaluatePoint({&x, 1}), expected,
+                  1e-12 * std::max(1.0, std::abs(expected)))
+          << equation << " at " << x;
+    }
+  }
+}
+
+TEST(CompiledExpression, BatchesOfAnySize) {
+  // Less than a block, exactly one, a partial last block and many blocks
+  for (const std::size_t count :
+       {std::size_t{1}, std::size_t{7},
+        mathboard::CompiledExpression::kBlockSize,
+        mathboard::CompiledExpression::kBlockSize + 45, std::size_t{3000}}) {
+    const std::vector<double> xs = MakeInputs(count);
+    const double *input = xs.data();
+    for (const std::string &equation : kEquations) {
+      const auto compiled =
+          mathboard::CompiledExpression::FromEquation(equation, {"X"});
+      std::vector<double> ys(count);
+      compiled.EvaluateBatch({&input, 1}, ys);
+      ExpectMatches(equation, xs, ys);
+    }
+  }
+}
+
+TEST(CompiledExpression, ParallelChunks) {
+  // Several parallel chunks, the last one partial
+  const std::vector<double> xs =
+      MakeInputs(16 * mathboard::CompiledExpression::kBlockSize * 3 + 17);
+  for (const std::string &equation : kEquations) {
+    const auto compiled =
+        mathboard::CompiledExpression::FromEquation(equation, {"X"});
+    ExpectMatches(equation, xs, compiled.Evaluate(xs));
+  }
+
+  const auto compiled =
+      mathboard::CompiledExpression::FromEquation("X**2", {"X"});
+  const std::vector<double> table = compiled.Tabulate(-1.0, 1.0, 5);
+  EXPECT_EQ(table, (std::vector<double>{1.0, 0.25, 0.0, 0.25, 1.0}));
+}
+
+TEST(CompiledExpression, SeveralSymbols) {
+  const std::string equation = "X*Y+X/Y-Y**3";
+  const auto compiled =
+      mathboard::CompiledExpression::FromEquation(equation, {"X", "Y"});
+  EXPECT_TRUE(compiled.IsCompiled());
+  EXPECT_EQ(compiled.GetSymbolCount(), 2u);
+
+  SymEngine::LambdaRealDoubleVisitor visitor;
+  visitor.init({SymEngine::symbol("X"), SymEngine::symbol("Y")},
+               *mathboard::ParseEquation(equation));
+
+  const std::vector<double> xs =
+      MakeInputs(mathboard::CompiledExpression::kBlockSize + 3);
+  std::vector<double> ys(xs.size());
+  for (std::size_t i = 0; i < xs.size(); i++) {
+    ys[i] = 1.0 + static_cast<double>(i % 7);
+  }
+  const double *inputs[] = {xs.data(), ys.data()};
+  std::vector<double> outputs(xs.size());
+  compiled.EvaluateBatch(inputs, outputs);
+
+  for (std::size_t i = 0; i < xs.size(); i++) {
+    const double point[] = {xs[i], ys[i]};
+    double expected = 0.0;
+    visitor.call(&expected, point);
+    const double tolerance = 1e-12 * std::max(1.0, std::abs(expected));
+    EXPECT_NEAR(outputs[i], expected, tolerance);
+    EXPECT_NEAR(compiled.EvaluatePoint(point), expected, tolerance);
+  }
+}
@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include "../src/daemon.hpp"
+
+#include <nlohmann/json.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Records the replies the registry writes instead of using sockets
+class ReplyServer : public mathboard::UnixSocketServer {
+public:
+  bool Init(const std::filesystem::path &) override { return true; }
+  void Listen() override {}
+  bool Accept(int &, void **) override { return false; }
+  bool Read(const std::int32_t, std::vector<unsigned char> &) override {
+    return false;
+  }
+  bool Write(const std::int32_t, const std::vector<unsigned char> &) override {
+    return true;
+  }
+  bool WriteString(const std::int32_t, const std::string &) override {
+    return true;
+  }
+  bool WriteV(const std::int32_t,
+              const std::vector<std::string_view> &messages) override {
+    std::lock_guard lock(mutex);
+    for (const std::string_view message : messages) {
+      replies.push_back(nlohmann::json::parse(message));
+    }
+    return true;
+  }
+  bool Poll(const std::vector<std::int32_t> &,
+            std::vector<std::int32_t> &) override {
+    return true;
+  }
+  void Shutdown(const std::int32_t) override {}
+  void Close(const std::int32_t) override {}
+
+  std::mutex mutex{};
+  std::vector<nlohmann::json> replies{};
+};
+
+// Request of the connection with `stroke_count` one point strokes
+std::unique_ptr<mathboard::RequestWork>
+MakeWork(mathboard::ArenaPool &arenas,
+         mathboard::ConnectionRegistry &connections,
+         std::size_t stroke_count) {
+  std::unique_ptr<mathboard::RequestWork> work = arenas.CreateWork();
+  work->request_id = 1;
+  work->request = nlohmann::json{{"requestId", 42}, {"stream", true}};
+  work->client_fd = 3;
+  work->connection_id = connections.GetId(3);
+  work->stream = true;
+  for (std::size_t i = 0; i < stroke_count; i++) {
+    mathboard::Stroke stroke(static_cast<int>(i),
+                             cv::Point2f(static_cast<float>(i), 0.0f));
+    const cv::Point point(0, 0);
+    stroke.AppendPoints({&point, 1});
+    work->strokes.push_back(std::move(stroke));
+  }
+  return work;
+}
+
+} // namespace
+
+TEST(Daemon, SendPartialRepliesInChunks) {
+  ReplyServer server{};
+  mathboard::ConnectionRegistry connections(server);
+  connections.Add(3);
+  mathboard::ArenaPool arenas{};
+  const std::size_t strokeCount = 2 * mathboard::kPartialReplyStrokes + 2;
+  std::unique_ptr<mathboard::RequestWork> work =
+      MakeWork(arenas, connections, strokeCount);
+
+  // No strokes yet before contour
+  mathboard::SendPartialReplies(connections, *work, "decode");
+  mathboard::SendPartialReplies(connections, *work, "preprocess");
+  ASSERT_EQ(server.replies.size(), 2u);
+  EXPECT_EQ(server.replies[0]["stage"], "decode");
+  EXPECT_EQ(server.replies[1]["stage"], "preprocess");
+  for (const nlohmann::json &reply : server.replies) {
+    EXPECT_EQ(reply["status"], "ok");
+    EXPECT_EQ(reply["requestId"], 42);
+    EXPECT_EQ(reply["partial"], true);
+    EXPECT_FALSE(reply.contains("strokes"));
+  }
+
+  // Every stroke once, in order, kPartialReplyStrokes at most per reply
+  for (const std::string stage : {"contour", "simplify"}) {
+    server.replies.clear();
+    mathboard::SendPartialReplies(connections, *work, stage);
+    ASSERT_EQ(server.replies.size(), 3u) << stage;
+    std::size_t next = 0;
+    for (const nlohmann::json &reply : server.replies) {
+      EXPECT_EQ(reply["stage"], stage);
+      EXPECT_EQ(reply["partial"], true);
+      for (const nlohmann::json &stroke : reply["strokes"]) {
+        EXPECT_EQ(stroke["id"], next++);
+        // Contours only once they're simplified
+        EXPECT_EQ(stroke.contains("contours"), stage == "simplify");
+      }
+    }
+    EXPECT_EQ(server.replies[0]["strokes"].size(),
+              mathboard::kPartialReplyStrokes);
+    EXPECT_EQ(server.replies[2]["strokes"].size(), 2u);
+    EXPECT_EQ(next, strokeCount);
+  }
+
+  // A board without strokes still gets its reply
+  server.replies.clear();
+  std::unique_ptr<mathboard::RequestWork> empty =
+      MakeWork(arenas, connections, 0);
+  mathboard::SendPartialReplies(connections, *empty, "contour");
+  ASSERT_EQ(server.replies.size(), 1u);
+  EXPECT_TRUE(server.replies[0]["strokes"].empty());
+
+  arenas.Release(work);
+  arenas.Release(empty);
+}
+
+TEST(Daemon, StreamsEveryStageBeforeTheFinalReply) {
+  const std::filesystem::path image =
+      std::filesystem::temp_directory_path() / "mathboard_test_stream.png";
+  cv::Mat board = cv::Mat::zeros(100, 200, CV_8UC3);
+  for (int i = 0; i < 3; i++) {
+    cv::rectangle(board, cv::Rect(20 + 60 * i, 40, 20, 20),
+                  cv::Scalar(255, 255, 255), cv::FILLED);
+  }
+  cv::imwrite(image.string(), board);
+
+  ReplyServer server{};
+  {
+    mathboard::ConnectionRegistry connections(server);
+    const std::uint64_t connectionId = connections.Add(3);
+    mathboard::ArenaPool arenas{};
+    mathboard::RequestPipeline pipeline{};
+    // Replies like the daemon's
+    mathboard::AddRequestStages(
+        pipeline, {}, arenas,
+        [&connections](mathboard::RequestWork &work) {
+          mathboard::JsonWriter &writer = mathboard::GetReplyWriter();
+          mathboard::BeginReply(writer, true, work.request["requestId"])
+              .Key("strokes")
+              .UInt(work.strokes.size())
+              .EndObject();
+          mathboard::SendReply(connections, work.client_fd,
+                               work.connection_id, writer);
+        },
+        {},
+        [&connections](mathboard::RequestWork &work,
+                       const std::string &stage) {
+          mathboard::SendPartialReplies(connections, work, stage);
+        });
+    pipeline.Start();
+
+    std::unique_ptr<mathboard::RequestWork> work = arenas.CreateWork();
+    work->request = nlohmann::json{{"requestId", 42},
+                                   {"stream", true},
+                                   {"board", {{"path", image.string()}}}};
+    work->client_fd = 3;
+    work->connection_id = connectionId;
+    work->stream = true;
+    ASSERT_TRUE(pipeline.Submit(std::move(work)));
+    pipeline.Close();
+    pipeline.Wait();
+  }
+  std::filesystem::remove(image);
+
+  ASSERT_EQ(server.replies.size(), 5u);
+  const std::vector<std::string> stages{"decode", "preprocess", "contour",
+                                        "simplify"};
+  for (std::size_t i = 0; i < stages.size(); i++) {
+    EXPECT_EQ(server.replies[i]["partial"], true);
+    EXPECT_EQ(server.replies[i]["stage"], stages[i]);
+  }
+  const nlohmann::json &finished = server.replies.back();
+  EXPECT_FALSE(finished.contains("partial"));
+  EXPECT_EQ(finished["requestId"], 42);
+  EXPECT_EQ(finished["strokes"], server.replies[2]["strokes"].size());
+}
+
+TEST(Daemon, CommandsOfTheWrongTypeGetAnError) {
+  mathboard::JsonWriter writer{};
+  for (const char *command :
+       {R"({"command": 1})", R"({"command": null})",
+        R"({"command": "trace"})", R"({"command": "trace", "path": 3})",
+        R"({"command": "trace", "path": "/tmp/trace.json",
+            "intervalMs": "100"})",
+        R"({"command": "unknown"})"}) {
+    writer.Clear();
+    mathboard::HandleCommand(writer, nlohmann::json::parse(command), 42);
+    const nlohmann::json reply = nlohmann::json::parse(writer.View());
+    EXPECT_EQ(reply["status"], "error") << command;
+    EXPECT_EQ(reply["requestId"], 42) << command;
+    EXPECT_TRUE(reply["error"].is_string()) << command;
+  }
+
+  writer.Clear();
+  mathboard::HandleCommand(writer, nlohmann::json{{"command", "stats"}}, 42);
+  const nlohmann::json stats = nlohmann::json::parse(writer.View());
+  EXPECT_EQ(stats["status"], "ok");
+  EXPECT_EQ(stats["requestId"], 42);
+  EXPECT_TRUE(stats["stages"].contains("request"));
+}
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include "../src/equation_parser.hpp"
+#include "../src/equation_solver.hpp"
+
+#include <symengine/parser.h>
+
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// SanitizeEquation before the tokenizer, the parser is checked against it
+std::string LegacySanitizeEquation(const std::string &rawEquation) {
+  std::string sanitized;
+  for (const char c : rawEquation) {
+    if (std::isalnum(static_cast<unsigned char>(c)) ||
+        std::string("+-*/=().").find(c) != std::string::npos) {
+      sanitized += c;
+    }
+  }
+
+  size_t equalPos = sanitized.find('=');
+  if (equalPos != std::string::npos) {
+    std::string left = sanitized.substr(0, equalPos);
+    std::string right = sanitized.substr(equalPos + 1);
+    sanitized = left + "-(" + right + ")";
+  }
+  return sanitized;
+}
+
+bool Equivalent(const std::string &raw, const std::string &expected) {
+  return SymEngine::eq(*mathboard::ParseEquation(raw),
+                       *SymEngine::parse(expected));
+}
+
+// Well formed random expression, one token per element
+void RandomExpression(std::mt19937 &rng, int depth,
+                      std::vector<std::string> &tokens) {
+  static const std::vector<std::string> leaves = {"X", "Y",  "Z",   "2",
+                                                  "7", "13", "2.5", "0.25"};
+  static const std::vector<std::string> functions = {"sin", "cos", "exp",
+                                                     "log", "sqrt"};
+  static const std::vector<std::string> operators = {"+", "-", "*", "/"};
+
+  std::uniform_int_distribution<int> pick(0, depth > 0 ? 5 : 0);
+  switch (pick(rng)) {
+  case 0:
+    tokens.push_back(leaves[rng() % leaves.size()]);
+    break;
+  case 1:
+  case 2:
+    RandomExpression(rng, depth - 1, tokens);
+    tokens.push_back(operators[rng() % operators.size()]);
+    RandomExpression(rng, depth - 1, tokens);
+    break;
+  case 3:
+    tokens.push_back(functions[rng() % functions.size()]);
+    tokens.push_back("(");
+    RandomExpression(rng, depth - 1, tokens);
+    tokens.push_back(")");
+    break;
+  case 4:
+    tokens.push_back("(");
+    RandomExpression(rng, depth - 1, tokens);
+    tokens.push_back(")");
+    tokens.push_back("**");
+    tokens.push_back(std::to_string(1 + rng() % 3));
+    break;
+  case 5:
+    tokens.push_back("(");
+    tokens.push_back("-");
+    RandomExpression(rng, depth - 1, tokens);
+    tokens.push_back(")");
+    break;
+  }
+}
+
+} // namespace
+
+TEST(EquationParser, Precedence) {
+  EXPECT_TRUE(Equivalent("2+3*X**2", "2+3*X**2"));
+  EXPECT_TRUE(Equivalent("-X**2", "-(X**2)"));
+  EXPECT_TRUE(Equivalent("2**3**2", "2**9"));
+  EXPECT_TRUE(Equivalent("X/2/Y", "(X/2)/Y"));
+  EXPECT_TRUE(Equivalent("2X+1=5", "2*X+1-(5)"));
+}
+
+TEST(EquationParser, NormalizesOcrConfusions) {
+  EXPECT_TRUE(Equivalent("2x+lO=O", "2*X+10"));
+  EXPECT_TRUE(Equivalent("3 \xC3\x97 x = 1.5", "3*X-1.5"));
+  EXPECT_TRUE(Equivalent("x^2 \xE2\x88\x92 l", "X**2-1"));
+  // Function names keep their letters
+  EXPECT_TRUE(Equivalent("exp(x)+log(x)", "exp(X)+log(X)"));
+  EXPECT_TRUE(Equivalent("(x+1)(x-1)", "(X+1)*(X-1)"));
+}
+
+TEST(EquationParser, RejectsMalformedEquations) {
+  EXPECT_THROW(mathboard::ParseEquation(""), std::runtime_error);
+  EXPECT_THROW(mathboard::ParseEquation("(X+1"), std::runtime_error);
+  EXPECT_THROW(mathboard::ParseEquation("X+1)"), std::runtime_error);
+  EXPECT_THROW(mathboard::ParseEquation("X=1=2"), std::runtime_error);
+  EXPECT_THROW(mathboard::ParseEquation("X+"), std::runtime_error);
+}
+
+TEST(EquationParser, SanitizedEquationParsesTheSame) {
+  const std::string raw = "2x(x+l) = 4O";
+  const std::string sanitized =
+      mathboard::EquationSolver::SanitizeEquation(raw);
+
+  EXPECT_EQ(sanitized, "2*X*(X+1)-(40)");
+  EXPECT_TRUE(SymEngine::eq(*mathboard::ParseEquation(raw),
+                            *SymEngine::parse(sanitized)));
+}
+
+TEST(EquationParser, SanitizerRejectsWhatTheParserRejects) {
+  for (const std::string raw :
+       {"X=1=2", "X+1)=2", "(X=1)", "(X+1=2", "sin X=1", "X+cos"}) {
+    EXPECT_THROW(mathboard::ParseEquation(raw), std::runtime_error) << raw;
+    EXPECT_EQ(mathboard::EquationSolver::SanitizeEquation(raw), "") << raw;
+  }
+
+  // Function applications stay intact
+  EXPECT_EQ(mathboard::EquationSolver::SanitizeEquation("2sin(x) = l"),
+            "2*sin(X)-(1)");
+}
+
+// Random equations with OCR noise between the tokens have to parse to the
+// same expression as SymEngine's parser on the old sanitized string
+TEST(EquationParser, FuzzAgainstLegacySanitizer) {
+  static const std::vector<std::string> noise = {"", "", "", " ", "  ",
+                                                 "\t", "$", "?", "#"};
+
+  std::mt19937 rng(20240501);
+  for (int i = 0; i < 2000; i++) {
+    std::vector<std::string> tokens;
+    RandomExpression(rng, 4, tokens);
+    if (rng() % 2 == 0) {
+      tokens.push_back("=");
+      RandomExpression(rng, 2, tokens);
+    }
+
+    std::string raw;
+    for (const std::string &token : tokens) {
+      raw += noise[rng() % noise.size()];
+      raw += token;
+    }
+
+    SymEngine::RCP<const SymEngine::Basic> expected;
+    try {
+      expected = SymEngine::parse(LegacySanitizeEquation(raw));
+    } catch (const std::exception &) {
+      EXPECT_ANY_THROW(mathboard::ParseEquation(raw)) << raw;
+      continue;
+    }
+
+    const auto actual = mathboard::ParseEquation(raw);
+    EXPECT_TRUE(SymEngine::eq(*expected, *actual))
+        << raw << ": " << expected->__str__() << " != " << actual->__str__();
+
+    const std::string sanitized =
+        mathboard::EquationSolver::SanitizeEquation(raw);
+    EXPECT_TRUE(SymEngine::eq(*expected, *SymEngine::parse(sanitized)))
+        << raw << ": " << sanitized;
+  }
+}
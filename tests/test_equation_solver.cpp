@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include "../src/concurrency/thread_pool.hpp"
+#include "../src/equation_solver.hpp"
+
+#include <symengine/symengine_config.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Values = std::unordered_map<std::string, std::vector<double>>;
+
+// Cache counters changed since `before`
+mathboard::EquationSolver::CacheStats
+CacheStatsSince(const mathboard::EquationSolver::CacheStats &before) {
+  const auto after = mathboard::EquationSolver::GetCacheStats();
+  return {after.expression_hits - before.expression_hits,
+          after.expression_misses - before.expression_misses,
+          after.solution_hits - before.solution_hits,
+          after.solution_misses - before.solution_misses};
+}
+
+} // namespace
+
+TEST(EquationSolver, CachesSolutions) {
+  mathboard::EquationSolver::ConfigureCache(16, true);
+  mathboard::EquationSolver::ClearCache();
+
+  auto before = mathboard::EquationSolver::GetCacheStats();
+  const Values solved = mathboard::EquationSolver::SolveFor("2*X-4", {"X"});
+  ASSERT_EQ(solved.at("X").size(), 1u);
+  EXPECT_DOUBLE_EQ(solved.at("X")[0], 2.0);
+  auto stats = CacheStatsSince(before);
+  // Neither the equation nor its normal form were cached
+  EXPECT_EQ(stats.solution_hits, 0u);
+  EXPECT_EQ(stats.solution_misses, 2u);
+  EXPECT_EQ(stats.expression_misses, 1u);
+
+  before = mathboard::EquationSolver::GetCacheStats();
+  EXPECT_EQ(mathboard::EquationSolver::SolveFor("2*X-4", {"X"}), solved);
+  stats = CacheStatsSince(before);
+  EXPECT_EQ(stats.solution_hits, 1u);
+  EXPECT_EQ(stats.solution_misses, 0u);
+  EXPECT_EQ(stats.expression_hits + stats.expression_misses, 0u);
+
+  // Same normal form, solved through the first equation's solution
+  before = mathboard::EquationSolver::GetCacheStats();
+  EXPECT_EQ(mathboard::EquationSolver::SolveFor("X*2-4", {"X"}), solved);
+  stats = CacheStatsSince(before);
+  EXPECT_EQ(stats.solution_hits, 1u);
+  EXPECT_EQ(stats.solution_misses, 1u);
+
+  // Cached under its own key now
+  before = mathboard::EquationSolver::GetCacheStats();
+  EXPECT_EQ(mathboard::EquationSolver::SolveFor("X*2-4", {"X"}), solved);
+  EXPECT_EQ(CacheStatsSince(before).solution_hits, 1u);
+}
+
+TEST(EquationSolver, CacheKeysIncludeSymbolsAndNormalization) {
+  mathboard::EquationSolver::ConfigureCache(16, false);
+  mathboard::EquationSolver::ClearCache();
+
+  mathboard::EquationSolver::SolveFor("X-Y", {"X"});
+  auto before = mathboard::EquationSolver::GetCacheStats();
+  // Solving for another symbol isn't a hit
+  mathboard::EquationSolver::SolveFor("X-Y", {"Y"});
+  EXPECT_EQ(CacheStatsSince(before).solution_hits, 0u);
+
+  mathboard::EquationSolver::SolveFor("2*X-4", {"X"});
+  before = mathboard::EquationSolver::GetCacheStats();
+  // Without normalization equivalent equations are solved again
+  mathboard::EquationSolver::SolveFor("X*2-4", {"X"});
+  EXPECT_EQ(CacheStatsSince(before).solution_hits, 0u);
+
+  mathboard::EquationSolver::ClearCache();
+  before = mathboard::EquationSolver::GetCacheStats();
+  mathboard::EquationSolver::SolveFor("2*X-4", {"X"});
+  EXPECT_EQ(CacheStatsSince(before).solution_hits, 0u);
+
+  mathboard::EquationSolver::ConfigureCache(1024, true);
+}
+
+TEST(EquationSolver, NumericRootsAfterSymbolicTimeout) {
+  mathboard::EquationSolver::ClearCache();
+
+  // No time for the symbolic solve, the numeric one still gets its slice
+  const mathboard::SolveBudget budget{std::chrono::milliseconds(0),
+                                      std::chrono::milliseconds(1000)};
+  auto solved =
+      mathboard::EquationSolver::SolveFor("X**4-5*X**2+4", {"X"}, budget);
+  std::vector<mathboard::Root> roots = solved.at("X");
+  std::sort(roots.begin(), roots.end(),
+            [](const mathboard::Root &first, const mathboard::Root &second) {
+              return first.value < second.value;
+            });
+
+  const std::vector<double> expected{-2.0, -1.0, 1.0, 2.0};
+  ASSERT_EQ(roots.size(), expected.size());
+  for (std::size_t i = 0; i < roots.size(); i++) {
+    EXPECT_NEAR(roots[i].value, expected[i], 1e-9);
+#ifdef WITH_SYMENGINE_THREAD_SAFE
+    // Only a thread safe SymEngine is abandoned at the deadline
+    EXPECT_EQ(roots[i].method, mathboard::SolveMethod::Numeric);
+#endif
+  }
+
+#ifdef WITH_SYMENGINE_THREAD_SAFE
+  // The timed out result isn't cached, with time the solve is exact
+  solved = mathboard::EquationSolver::SolveFor(
+      "X**4-5*X**2+4", {"X"}, std::chrono::milliseconds(5000));
+  ASSERT_EQ(solved.at("X").size(), expected.size());
+  for (const mathboard::Root &root : solved.at("X")) {
+    EXPECT_EQ(root.method, mathboard::SolveMethod::Symbolic);
+  }
+#endif
+}
+
+TEST(EquationSolver, SolveBatchDeliversEveryResult) {
+  mathboard::ThreadPool pool(1);
+  const std::vector<std::string> equations{"X-1", "X**2-4", "X+(", "Y+3"};
+
+  // A single worker solves them in order
+  std::vector<mathboard::BatchResult> results;
+  const auto handle = mathboard::EquationSolver::SolveBatch(
+      equations,
+      [&results](mathboard::BatchResult &&result) {
+        results.push_back(std::move(result));
+      },
+      mathboard::kDefaultSolveBudget, pool);
+  handle->Wait();
+  EXPECT_TRUE(handle->IsDone());
+
+  ASSERT_EQ(results.size(), equations.size());
+  for (std::size_t i = 0; i < results.size(); i++) {
+    EXPECT_EQ(results[i].index, i);
+    EXPECT_EQ(results[i].equation, equations[i]);
+  }
+  ASSERT_EQ(results[0].roots.at("X").size(), 1u);
+  EXPECT_DOUBLE_EQ(results[0].roots.at("X")[0].value, 1.0);
+  EXPECT_EQ(results[1].roots.at("X").size(), 2u);
+  // Parse errors come back as the result's error, not as an exception
+  EXPECT_FALSE(results[2].error.empty());
+  EXPECT_TRUE(results[2].roots.empty());
+  EXPECT_EQ(results[3].symbols, std::vector<std::string>{"Y"});
+  EXPECT_DOUBLE_EQ(results[3].roots.at("Y")[0].value, -3.0);
+}
+
+TEST(EquationSolver, CancelledBatchSkipsQueuedEquations) {
+  mathboard::ThreadPool pool(1);
+
+  // Keep the only worker busy until the batch is cancelled
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  pool.Submit([released]() { released.wait(); });
+
+  std::atomic<int> delivered{0};
+  const auto handle = mathboard::EquationSolver::SolveBatch(
+      {"X-1", "X-2", "X-3"},
+      [&delivered](mathboard::BatchResult &&) { delivered++; },
+      mathboard::kDefaultSolveBudget, pool);
+  EXPECT_FALSE(handle->IsDone());
+
+  handle->Cancel();
+  release.set_value();
+  handle->Wait();
+  EXPECT_TRUE(handle->IsDone());
+  EXPECT_EQ(delivered.load(), 0);
+}
+
+TEST(EquationSolver, CancelStopsTheNumericSearch) {
+  mathboard::EquationSolver::ClearCache();
+  const auto before = mathboard::EquationSolver::GetCacheStats();
+
+  // Not a polynomial, solved numerically only
+  const std::atomic<bool> cancelled{true};
+  const mathboard::SolveBudget budget{std::chrono::milliseconds(1000),
+                                      std::chrono::milliseconds(1000),
+                                      &cancelled};
+  const auto start = std::chrono::steady_clock::now();
+  mathboard::EquationSolver::SolveFor("sin(X)-X/10", {"X"}, budget);
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(500));
+
+  // Cut short, so not cached
+  mathboard::EquationSolver::SolveFor("sin(X)-X/10", {"X"});
+  EXPECT_EQ(CacheStatsSince(before).solution_hits, 0u);
+}
@@ -129,4 +129,37 @@ TEST_F(GridTest, ExistingIntersection) {
   EXPECT_EQ(grid.GetIntersections().front(), pair0);
   EXPECT_EQ(grid.GetIntersections().back(), pair2);
 }
+
+TEST_F(GridTest, Remove) {
+  Shape s0 = Shape(0, cv::Point2f(21.37f, 69.0f), cv::Size2i(10, 5));
+  Shape s1 = Shape(1, cv::Point2f(21.37f, 69.0f), cv::Size2i(20, 20));
+  mathboard::Grid<Shape> grid = GetGrid();
+  grid.Insert(&s0);
+  grid.Insert(&s1);
+  grid.Remove(&s0);
+  EXPECT_EQ(grid.Size(), 1);
+  EXPECT_EQ(grid.GetIntersections().size(), 0);
+  // Removing it twice changes nothing
+  grid.Remove(&s0);
+  EXPECT_EQ(grid.Size(), 1);
+}
+
+TEST_F(GridTest, GetNeighbors) {
+  Shape s0 = Shape(0, cv::Point2f(40, 40), cv::Size2i(10, 5));
+  Shape s1 = Shape(1, cv::Point2f(45, 42), cv::Size2i(20, 20));
+  Shape s2 = Shape(2, cv::Point2f(20, 90), cv::Size2i(6, 6));
+  mathboard::Grid<Shape> grid = GetGrid();
+  grid.Insert(&s0);
+  grid.Insert(&s1);
+  grid.Insert(&s2);
+  EXPECT_EQ(grid.GetNeighbors(&s0), std::vector<Shape *>{&s1});
+  EXPECT_TRUE(grid.GetNeighbors(&s2).empty());
+
+  // Moved next to s2
+  grid.Remove(&s1);
+  s1.SetPosition(22, 88);
+  grid.Insert(&s1);
+  EXPECT_TRUE(grid.GetNeighbors(&s0).empty());
+  EXPECT_EQ(grid.GetNeighbors(&s2), std::vector<Shape *>{&s1});
+}
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include "../src/image_processing.hpp"
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+TEST(SegmentBoard, SplitsBoardIntoComponents) {
+  cv::Mat board = cv::Mat::zeros(100, 200, CV_8UC1);
+  cv::rectangle(board, cv::Rect(10, 10, 20, 30), cv::Scalar(255), cv::FILLED);
+  cv::circle(board, cv::Point(150, 60), 10, cv::Scalar(255), cv::FILLED);
+  // Noise, below the minimal pixel count
+  board.at<uchar>(90, 100) = 255;
+
+  const std::vector<mathboard::Stroke> strokes =
+      mathboard::SegmentBoard(board);
+  ASSERT_EQ(strokes.size(), 2u);
+
+  // Labels go in scan order, the rectangle comes first
+  EXPECT_EQ(strokes[0].GetIndex(), 0u);
+  EXPECT_EQ(strokes[0].GetPosition(), cv::Point2f(10.0f, 10.0f));
+  EXPECT_EQ(strokes[0].GetBoardBoundingBox(), cv::Rect(10, 10, 20, 30));
+
+  EXPECT_EQ(strokes[1].GetIndex(), 1u);
+  EXPECT_EQ(strokes[1].GetPosition(), cv::Point2f(140.0f, 50.0f));
+  EXPECT_EQ(strokes[1].GetBoardBoundingBox(), cv::Rect(140, 50, 21, 21));
+}
+
+TEST(SegmentBoard, MasksOutNeighborsInsideTheBoundingBox) {
+  cv::Mat board = cv::Mat::zeros(60, 60, CV_8UC1);
+  // An L with a separate dot inside its bounding box
+  cv::rectangle(board, cv::Rect(5, 5, 4, 40), cv::Scalar(255), cv::FILLED);
+  cv::rectangle(board, cv::Rect(5, 41, 40, 4), cv::Scalar(255), cv::FILLED);
+  cv::rectangle(board, cv::Rect(30, 10, 5, 5), cv::Scalar(255), cv::FILLED);
+
+  const std::vector<mathboard::Stroke> strokes =
+      mathboard::SegmentBoard(board);
+  ASSERT_EQ(strokes.size(), 2u);
+  EXPECT_EQ(strokes[0].GetBoardBoundingBox(), cv::Rect(5, 5, 40, 40));
+  // The L's contour doesn't pick up the dot
+  EXPECT_EQ(strokes[0].GetContours().size(), 1u);
+  EXPECT_EQ(strokes[1].GetBoardBoundingBox(), cv::Rect(30, 10, 5, 5));
+}
+
+TEST(SegmentBoard, RejectsColorImages) {
+  const cv::Mat board = cv::Mat::zeros(10, 10, CV_8UC3);
+  EXPECT_TRUE(mathboard::SegmentBoard(board).empty());
+  EXPECT_TRUE(mathboard::SegmentBoard(cv::Mat{}).empty());
+}
+
+namespace {
+
+// Sauvola threshold of every pixel computed straight from its window
+cv::Mat NaiveSauvola(const cv::Mat &image, int window_size, double k) {
+  const int radius = window_size / 2;
+  cv::Mat output(image.size(), CV_8UC1);
+  for (int y = 0; y < image.rows; y++) {
+    for (int x = 0; x < image.cols; x++) {
+      const int y0 = std::max(y - radius, 0);
+      const int y1 = std::min(y + radius + 1, image.rows);
+      const int x0 = std::max(x - radius, 0);
+      const int x1 = std::min(x + radius + 1, image.cols);
+      std::int64_t sum = 0;
+      std::int64_t sqsum = 0;
+      for (int wy = y0; wy < y1; wy++) {
+        for (int wx = x0; wx < x1; wx++) {
+          const int value = image.at<uchar>(wy, wx);
+          sum += value;
+          sqsum += value * value;
+        }
+      }
+      const double area = static_cast<double>((y1 - y0) * (x1 - x0));
+      const double mean = static_cast<double>(sum) / area;
+      const double variance =
+          static_cast<double>(sqsum) / area - mean * mean;
+      const double deviation = std::sqrt(std::max(variance, 0.0));
+      const double threshold = mean * (1.0 + k * (deviation / 128.0 - 1.0));
+      output.at<uchar>(y, x) = image.at<uchar>(y, x) > threshold ? 255 : 0;
+    }
+  }
+  return output;
+}
+
+// Uneven background with dark text-like strokes
+cv::Mat MakeGradientBoard(int rows, int cols) {
+  cv::Mat board(rows, cols, CV_8UC1);
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x < cols; x++) {
+      board.at<uchar>(y, x) =
+          static_cast<uchar>(120 + (x + y) * 100 / (rows + cols));
+    }
+  }
+  cv::Mat noise(rows, cols, CV_8UC1);
+  cv::randu(noise, 0, 16);
+  board += noise;
+  cv::line(board, cv::Point(5, 5), cv::Point(cols - 5, rows - 5),
+           cv::Scalar(30), 3);
+  cv::circle(board, cv::Point(cols / 2, rows / 3), 20, cv::Scalar(40), 2);
+  return board;
+}
+
+} // namespace
+
+TEST(BinarizeImage, OtsuMatchesOpenCV) {
+  const cv::Mat board = MakeGradientBoard(90, 140);
+  cv::Mat expected;
+  cv::threshold(board, expected, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+  const cv::Mat binarized =
+      mathboard::BinarizeImage(board, mathboard::BinarizationMethod::Otsu);
+  EXPECT_EQ(cv::countNonZero(binarized != expected), 0);
+
+  cv::threshold(board, expected, 128, 255, cv::THRESH_BINARY);
+  EXPECT_EQ(cv::countNonZero(mathboard::BinarizeImage(board) != expected), 0);
+}
+
+TEST(BinarizeImage, SauvolaMatchesNaiveWindows) {
+  // Several tiles, the last ones partial, and windows clipped on every side
+  for (const cv::Size size : {cv::Size(300, 200), cv::Size(17, 40)}) {
+    const cv::Mat board = MakeGradientBoard(size.height, size.width);
+    for (const int window : {31, 15}) {
+      const cv::Mat expected = NaiveSauvola(board, window, 0.2);
+      const cv::Mat binarized = mathboard::SauvolaBinarize(board, window, 0.2);
+      ASSERT_EQ(binarized.size(), board.size());
+      EXPECT_EQ(cv::countNonZero(binarized != expected), 0)
+          << size << " window " << window;
+    }
+  }
+
+  EXPECT_TRUE(mathboard::SauvolaBinarize(cv::Mat{}).empty());
+  EXPECT_TRUE(
+      mathboard::SauvolaBinarize(cv::Mat::zeros(8, 8, CV_8UC3)).empty());
+}
+
+TEST(BinarizeImage, ParsesMethodNames) {
+  EXPECT_EQ(mathboard::ParseBinarizationMethod("global"),
+            mathboard::BinarizationMethod::Global);
+  EXPECT_EQ(mathboard::ParseBinarizationMethod("otsu"),
+            mathboard::BinarizationMethod::Otsu);
+  EXPECT_EQ(mathboard::ParseBinarizationMethod("sauvola"),
+            mathboard::BinarizationMethod::Sauvola);
+  EXPECT_FALSE(mathboard::ParseBinarizationMethod("Otsu").has_value());
+}
@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include "../src/unix_socket_server/io_uring_server.hpp"
+#include "../src/unix_socket_server/unix_socket_server.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr const char *kSocketPath = "/tmp/mathboard_io_uring.sock";
+
+// io_uring server listening on kSocketPath, nullptr without io_uring
+std::unique_ptr<mathboard::UnixSocketServer> MakeServer() {
+  if (std::unique_ptr<mathboard::IoUringServer>(
+          mathboard::IoUringServer::Create()) == nullptr) {
+    return nullptr;
+  }
+  std::unique_ptr<mathboard::UnixSocketServer> server(
+      mathboard::UnixSocketServer::Instance(mathboard::Transport::IoUring));
+  // Available, so no fallback to poll()
+  EXPECT_NE(dynamic_cast<mathboard::IoUringServer *>(server.get()), nullptr);
+  EXPECT_TRUE(server->Init(kSocketPath));
+  server->Listen();
+  return server;
+}
+
+// Connect a client and accept it, returns the client's fd
+int Connect(mathboard::UnixSocketServer &server, int &server_side_fd) {
+  const int clientFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::string(kSocketPath).copy(address.sun_path,
+                                sizeof(address.sun_path) - 1);
+  EXPECT_EQ(connect(clientFd, reinterpret_cast<sockaddr *>(&address),
+                    sizeof(address)),
+            0);
+
+  void *clientAddr;
+  EXPECT_TRUE(server.Accept(server_side_fd, &clientAddr));
+  free(clientAddr);
+  return clientFd;
+}
+
+} // namespace
+
+TEST(IoUringServer, RoundTrip) {
+  const std::unique_ptr<mathboard::UnixSocketServer> server = MakeServer();
+  if (server == nullptr) {
+    GTEST_SKIP() << "io_uring isn't available";
+  }
+
+  const int clientFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::string(kSocketPath).copy(address.sun_path,
+                                sizeof(address.sun_path) - 1);
+  ASSERT_EQ(connect(clientFd, reinterpret_cast<sockaddr *>(&address),
+                    sizeof(address)),
+            0);
+
+  std::vector<std::int32_t> ready;
+  ASSERT_TRUE(server->Poll({server->GetServerSocketFd()}, ready));
+  EXPECT_EQ(ready, std::vector<std::int32_t>{server->GetServerSocketFd()});
+
+  int serverSideFd;
+  void *clientAddr;
+  ASSERT_TRUE(server->Accept(serverSideFd, &clientAddr));
+  free(clientAddr);
+
+  const std::string request = R"({"command": "stats"})";
+  ASSERT_EQ(write(clientFd, request.data(), request.size()),
+            static_cast<ssize_t>(request.size()));
+
+  ASSERT_TRUE(server->Poll({serverSideFd}, ready));
+  EXPECT_EQ(ready, std::vector<std::int32_t>{serverSideFd});
+
+  std::vector<unsigned char> buffer(1024);
+  ASSERT_TRUE(server->Read(serverSideFd, buffer));
+  EXPECT_EQ(std::string(buffer.begin(), buffer.end()), request);
+
+  ASSERT_TRUE(server->WriteString(serverSideFd, R"({"status": "ok"})"));
+  std::string reply(64, '\0');
+  const ssize_t received = read(clientFd, reply.data(), reply.size());
+  ASSERT_GT(received, 0);
+  reply.resize(static_cast<std::size_t>(received));
+  EXPECT_EQ(reply, R"({"status": "ok"})");
+
+  // Hanging up reads as an empty buffer
+  close(clientFd);
+  ASSERT_TRUE(server->Poll({serverSideFd}, ready));
+  buffer.resize(1024);
+  ASSERT_TRUE(server->Read(serverSideFd, buffer));
+  EXPECT_TRUE(buffer.empty());
+  server->Close(serverSideFd);
+}
+
+TEST(IoUringServer, ShortReadsKeepTheRest) {
+  const std::unique_ptr<mathboard::UnixSocketServer> server = MakeServer();
+  if (server == nullptr) {
+    GTEST_SKIP() << "io_uring isn't available";
+  }
+  int serverSideFd;
+  const int clientFd = Connect(*server, serverSideFd);
+
+  const std::string request(100, 'r');
+  ASSERT_EQ(write(clientFd, request.data(), request.size()),
+            static_cast<ssize_t>(request.size()));
+
+  std::string received;
+  std::vector<std::int32_t> ready;
+  std::vector<unsigned char> buffer;
+  while (received.size() < request.size()) {
+    ASSERT_TRUE(server->Poll({serverSideFd}, ready));
+    buffer.resize(40);
+    ASSERT_TRUE(server->Read(serverSideFd, buffer));
+    ASSERT_FALSE(buffer.empty());
+    EXPECT_LE(buffer.size(), 40u);
+    received.append(buffer.begin(), buffer.end());
+  }
+  EXPECT_EQ(received, request);
+
+  close(clientFd);
+  server->Close(serverSideFd);
+}
+
+TEST(IoUringServer, BoundsTheRepliesOfAClientNotReading) {
+  const std::unique_ptr<mathboard::UnixSocketServer> server = MakeServer();
+  if (server == nullptr) {
+    GTEST_SKIP() << "io_uring isn't available";
+  }
+  int serverSideFd;
+  const int clientFd = Connect(*server, serverSideFd);
+
+  // Whatever the socket buffer takes, the rest stays queued
+  const std::string reply(1024 * 1024, 'x');
+  bool refused = false;
+  for (std::size_t i = 0;
+       i <= mathboard::IoUringServer::kMaxQueuedBytes / reply.size() + 8 &&
+       !refused;
+       i++) {
+    refused = !server->WriteString(serverSideFd, reply);
+  }
+  EXPECT_TRUE(refused);
+
+  close(clientFd);
+  server->Close(serverSideFd);
+}
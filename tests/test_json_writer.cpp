@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include "../src/json_writer.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+TEST(JsonWriter, WritesNestedValues) {
+  mathboard::JsonWriter writer{};
+  writer.BeginObject()
+      .Key("status")
+      .String("ok")
+      .Key("id")
+      .UInt(std::numeric_limits<std::uint64_t>::max())
+      .Key("offset")
+      .Int(-3)
+      .Key("scale")
+      .Double(0.1)
+      .Key("points")
+      .BeginArray()
+      .BeginArray()
+      .Int(1)
+      .Int(2)
+      .EndArray()
+      .BeginArray()
+      .EndArray()
+      .EndArray()
+      .Key("done")
+      .Bool(true)
+      .Key("error")
+      .Null()
+      .Key("raw")
+      .Raw(R"({"a":[1]})")
+      .EndObject();
+
+  EXPECT_EQ(writer.View(),
+            R"({"status":"ok","id":18446744073709551615,"offset":-3,)"
+            R"("scale":0.1,"points":[[1,2],[]],"done":true,"error":null,)"
+            R"("raw":{"a":[1]}})");
+}
+
+TEST(JsonWriter, EscapesStrings) {
+  mathboard::JsonWriter writer{};
+  const std::string text = "a\"b\\c\nd\te\x01 f/";
+  writer.BeginArray()
+      .String(text)
+      .Double(std::numeric_limits<double>::infinity())
+      .EndArray();
+
+  const nlohmann::json parsed = nlohmann::json::parse(writer.View());
+  EXPECT_EQ(parsed[0], text);
+  EXPECT_TRUE(parsed[1].is_null());
+}
+
+TEST(JsonWriter, ClearStartsANewMessage) {
+  mathboard::JsonWriter writer{};
+  writer.BeginObject().Key("a").Int(1);
+  writer.Clear();
+  writer.BeginObject().Key("b").Int(2).EndObject();
+  EXPECT_EQ(writer.View(), R"({"b":2})");
+}
+
+TEST(JsonWriter, TakeMovesTheMessageOut) {
+  mathboard::JsonWriter writer{};
+  writer.BeginObject().Key("status").String("error").EndObject();
+  // Not copied, past the small string buffer
+  const char *data = writer.View().data();
+  const std::string message = writer.Take();
+  EXPECT_EQ(message, R"({"status":"error"})");
+  EXPECT_EQ(message.data(), data);
+
+  // Starts over like after Clear()
+  EXPECT_TRUE(writer.View().empty());
+  writer.BeginArray().EndArray();
+  EXPECT_EQ(writer.View(), "[]");
+}
+
+#ifndef NDEBUG
+TEST(JsonWriterDeathTest, EndWithoutBeginAsserts) {
+  mathboard::JsonWriter writer{};
+  EXPECT_DEATH(writer.EndObject(), "without BeginObject");
+  writer.BeginArray().EndArray();
+  EXPECT_DEATH(writer.EndArray(), "without BeginArray");
+}
+#endif
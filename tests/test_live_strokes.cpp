@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "../src/live_strokes.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+TEST(LiveStrokes, GrowsTheStrokeWithEveryBatch) {
+  mathboard::LiveStrokes strokes{};
+  const std::vector<cv::Point> first{{100, 50}, {110, 55}};
+  const mathboard::Stroke *stroke = strokes.Append(1, 7, first);
+  ASSERT_NE(stroke, nullptr);
+  EXPECT_EQ(stroke->GetPosition(), cv::Point2f(100, 50));
+  EXPECT_EQ(stroke->GetBoardBoundingBox(), cv::Rect(100, 50, 11, 6));
+
+  const std::vector<cv::Point> second{{90, 70}};
+  stroke = strokes.Append(1, 7, second);
+  ASSERT_NE(stroke, nullptr);
+  EXPECT_EQ(stroke->GetBoardBoundingBox(), cv::Rect(90, 50, 21, 21));
+  EXPECT_EQ(stroke->GetContours().front().size(), 3u);
+  EXPECT_EQ(strokes.Size(), 1u);
+
+  const std::optional<mathboard::Stroke> finished = strokes.Finish(1, 7);
+  ASSERT_TRUE(finished.has_value());
+  EXPECT_EQ(finished->GetIndex(), 7u);
+  EXPECT_EQ(strokes.Size(), 0u);
+  EXPECT_FALSE(strokes.Finish(1, 7).has_value());
+}
+
+TEST(LiveStrokes, NewPointsCancelTheSpeculation) {
+  mathboard::LiveStrokes strokes{};
+  const std::shared_ptr<mathboard::Speculation> first = strokes.Speculate(1);
+  const std::shared_ptr<mathboard::Speculation> other = strokes.Speculate(2);
+
+  // Replaced by the next one
+  const std::shared_ptr<mathboard::Speculation> second = strokes.Speculate(1);
+  EXPECT_TRUE(first->IsCancelled());
+  EXPECT_FALSE(second->IsCancelled());
+
+  const std::vector<cv::Point> points{{0, 0}};
+  strokes.Append(1, 8, points);
+  EXPECT_TRUE(second->IsCancelled());
+  EXPECT_FALSE(other->IsCancelled());
+}
+
+TEST(LiveStrokes, RefusesOverlongAndAbandonedStrokes) {
+  mathboard::LiveStrokes strokes{};
+  EXPECT_EQ(strokes.Append(1, 1, {}), nullptr);
+
+  const std::vector<cv::Point> points(mathboard::LiveStrokes::kMaxPoints);
+  EXPECT_NE(strokes.Append(1, 1, points), nullptr);
+  const std::vector<cv::Point> more{{0, 0}};
+  EXPECT_EQ(strokes.Append(1, 1, more), nullptr);
+
+  EXPECT_EQ(strokes.EvictIdle(std::chrono::steady_clock::now(),
+                              std::chrono::seconds(10)),
+            0u);
+  EXPECT_EQ(strokes.EvictIdle(std::chrono::steady_clock::now() +
+                                  std::chrono::seconds(11),
+                              std::chrono::seconds(10)),
+            1u);
+  EXPECT_EQ(strokes.Size(), 0u);
+}
+
+TEST(LiveStrokes, FinishedStrokeStartsAtItsBoundingBox) {
+  mathboard::LiveStrokes strokes{};
+  // Drawn up and to the left of its first point
+  const std::vector<cv::Point> points{{100, 100}, {95, 90}, {90, 80}};
+  ASSERT_NE(strokes.Append(1, 3, points), nullptr);
+
+  const std::optional<mathboard::Stroke> finished = strokes.Finish(1, 3);
+  ASSERT_TRUE(finished.has_value());
+  EXPECT_EQ(finished->GetPosition(), cv::Point2f(90, 80));
+  EXPECT_EQ(finished->GetBoundingBox(), cv::Rect(0, 0, 11, 21));
+  EXPECT_EQ(finished->GetBoardBoundingBox(), cv::Rect(90, 80, 11, 21));
+  // Same points on the board
+  EXPECT_EQ(finished->GetContours().front(),
+            (std::vector<cv::Point>{{10, 20}, {5, 10}, {0, 0}}));
+}
+
+TEST(LiveStrokes, RefusesPointsOverTheMemoryLimit) {
+  mathboard::LiveStrokes strokes(64 * 1024);
+  const std::vector<cv::Point> points(1024);
+  std::uint32_t started = 0;
+  while (strokes.Append(1, started, points) != nullptr) {
+    started++;
+  }
+  // 8 KiB of points each
+  EXPECT_GT(started, 0u);
+  EXPECT_LT(started, 8u);
+
+  // Finished strokes make room again
+  ASSERT_TRUE(strokes.Finish(1, 0).has_value());
+  EXPECT_NE(strokes.Append(1, started, points), nullptr);
+  EXPECT_EQ(strokes.Size(), static_cast<std::size_t>(started));
+}
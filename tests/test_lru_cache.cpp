@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include "../src/lru_cache.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(LruCache, GetPut) {
+  mathboard::LruCache<std::string, int> cache(4, 1);
+
+  EXPECT_FALSE(cache.Get("x").has_value());
+
+  cache.Put("x", 1);
+  cache.Put("y", 2);
+
+  EXPECT_EQ(cache.Get("x"), 1);
+  EXPECT_EQ(cache.Get("y"), 2);
+
+  cache.Put("x", 3);
+  EXPECT_EQ(cache.Get("x"), 3);
+  EXPECT_EQ(cache.Size(), 2);
+
+  const auto stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 3);
+  EXPECT_EQ(stats.misses, 1);
+}
+
+TEST(LruCache, EvictsLeastRecentlyUsed) {
+  mathboard::LruCache<int, int> cache(3, 1);
+
+  cache.Put(1, 1);
+  cache.Put(2, 2);
+  cache.Put(3, 3);
+
+  // 1 becomes the most recently used, 2 is evicted instead
+  EXPECT_TRUE(cache.Get(1).has_value());
+  cache.Put(4, 4);
+
+  EXPECT_TRUE(cache.Get(1).has_value());
+  EXPECT_FALSE(cache.Get(2).has_value());
+  EXPECT_TRUE(cache.Get(3).has_value());
+  EXPECT_TRUE(cache.Get(4).has_value());
+  EXPECT_EQ(cache.GetStats().evictions, 1);
+}
+
+TEST(LruCache, Erase) {
+  mathboard::LruCache<int, int> cache(8);
+
+  cache.Put(1, 1);
+
+  EXPECT_TRUE(cache.Erase(1));
+  EXPECT_FALSE(cache.Erase(1));
+  EXPECT_FALSE(cache.Get(1).has_value());
+}
+
+TEST(LruCache, Concurrent) {
+  mathboard::LruCache<int, int> cache(64);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&cache, t] {
+      for (int i = 0; i < 10000; i++) {
+        const int key = (i * 7 + t) % 128;
+        if (const auto value = cache.Get(key)) {
+          EXPECT_EQ(*value, key * 2);
+        } else {
+          cache.Put(key, key * 2);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_LE(cache.Size(), cache.Capacity());
+}
+
+TEST(LruCache, ShrinkingEvictsRightAway) {
+  mathboard::LruCache<int, int> cache(8, 1);
+  for (int i = 0; i < 8; i++) {
+    cache.Put(i, i);
+  }
+  // 0 becomes the most recently used
+  EXPECT_TRUE(cache.Get(0).has_value());
+
+  cache.SetCapacity(3);
+  EXPECT_EQ(cache.Capacity(), 3);
+  EXPECT_EQ(cache.Size(), 3);
+  EXPECT_EQ(cache.GetStats().evictions, 5);
+  EXPECT_TRUE(cache.Get(0).has_value());
+  EXPECT_TRUE(cache.Get(7).has_value());
+  EXPECT_FALSE(cache.Get(1).has_value());
+
+  // Stays at the new capacity
+  cache.Put(8, 8);
+  EXPECT_EQ(cache.Size(), 3);
+}
+
+TEST(LruCache, SetCapacityWhileInUse) {
+  mathboard::LruCache<int, int> cache(64, 4);
+
+  std::atomic<bool> done{false};
+  std::thread resizer([&cache, &done] {
+    for (std::size_t capacity = 4; !done; capacity = capacity % 64 + 4) {
+      cache.SetCapacity(capacity);
+    }
+  });
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&cache, t] {
+      for (int i = 0; i < 10000; i++) {
+        cache.Put((i * 5 + t) % 256, i);
+        cache.Get(i % 256);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  done = true;
+  resizer.join();
+
+  cache.SetCapacity(16);
+  EXPECT_LE(cache.Size(), cache.Capacity());
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include "../src/memory/allocation_stats.hpp"
+#include "../src/memory/pooled_mat_allocator.hpp"
+#include "../src/memory/request_arena.hpp"
+
+#include <opencv2/core/mat.hpp>
+
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+TEST(RequestArena, GrowsToFitThePreviousRequest) {
+  mathboard::RequestArena arena(1024);
+  const mathboard::AllocationStats before = mathboard::GetAllocationStats();
+
+  {
+    std::pmr::vector<char> data(arena.Resource());
+    data.resize(4096);
+  }
+  EXPECT_GT(arena.UpstreamBytes(), 0u);
+  EXPECT_GE((mathboard::GetAllocationStats() - before)
+                .arena_upstream_allocations,
+            1u);
+
+  // The next request of the same size fits into the arena's own buffer
+  arena.Reset();
+  EXPECT_GT(arena.Capacity(), 4096u);
+  EXPECT_EQ(arena.UpstreamBytes(), 0u);
+
+  const mathboard::AllocationStats reused = mathboard::GetAllocationStats();
+  {
+    std::pmr::vector<char> data(arena.Resource());
+    data.resize(4096);
+  }
+  EXPECT_EQ(arena.UpstreamBytes(), 0u);
+  EXPECT_EQ((mathboard::GetAllocationStats() - reused)
+                .arena_upstream_allocations,
+            0u);
+}
+
+TEST(RequestArena, ResetKeepsTheCapacity) {
+  mathboard::RequestArena arena(8 * 1024);
+  for (int request = 0; request < 3; request++) {
+    {
+      std::pmr::vector<int> data(arena.Resource());
+      data.resize(256);
+    }
+    arena.Reset();
+    EXPECT_EQ(arena.Capacity(), 8u * 1024u);
+  }
+}
+
+TEST(PooledMatAllocator, ReusesReleasedBuffers) {
+  mathboard::PooledMatAllocator *allocator =
+      mathboard::PooledMatAllocator::Instance();
+
+  const mathboard::AllocationStats before = mathboard::GetAllocationStats();
+  const uchar *buffer;
+  {
+    cv::Mat image{};
+    image.allocator = allocator;
+    image.create(64, 64, CV_8UC1);
+    buffer = image.data;
+  }
+
+  // Same size class, served from the pool
+  cv::Mat image{};
+  image.allocator = allocator;
+  image.create(60, 60, CV_8UC1);
+  EXPECT_EQ(image.data, buffer);
+
+  const mathboard::AllocationStats stats =
+      mathboard::GetAllocationStats() - before;
+  EXPECT_GE(stats.mat_pool_misses + stats.mat_pool_hits, 2u);
+  EXPECT_GE(stats.mat_pool_hits, 1u);
+
+  // User memory is wrapped, not pooled
+  std::vector<uchar> pixels(16 * 16);
+  const mathboard::AllocationStats wrapped = mathboard::GetAllocationStats();
+  {
+    cv::Mat user(16, 16, CV_8UC1, pixels.data());
+    EXPECT_EQ(user.data, pixels.data());
+  }
+  EXPECT_EQ((mathboard::GetAllocationStats() - wrapped).mat_pool_misses, 0u);
+}
+
+TEST(PooledMatAllocator, ReturnsBuffersFreedElsewhereToTheSharedPool) {
+  mathboard::PooledMatAllocator *allocator =
+      mathboard::PooledMatAllocator::Instance();
+
+  // Allocated here, freed on another thread
+  auto image = std::make_unique<cv::Mat>();
+  image->allocator = allocator;
+  image->create(512, 512, CV_8UC1);
+  const uchar *buffer = image->data;
+  std::thread([&image]() { image.reset(); }).join();
+
+  // Another thread's miss takes it from the shared pool
+  const uchar *reused = nullptr;
+  std::thread([allocator, &reused]() {
+    cv::Mat other{};
+    other.allocator = allocator;
+    other.create(500, 500, CV_8UC1);
+    reused = other.data;
+  }).join();
+  EXPECT_EQ(reused, buffer);
+}
+
+TEST(AllocationStats, SubtractsSnapshots) {
+  const mathboard::AllocationStats first{10, 8, 5, 2, 1};
+  const mathboard::AllocationStats second{15, 12, 9, 3, 1};
+  const mathboard::AllocationStats delta = second - first;
+  EXPECT_EQ(delta.heap_allocations, 5u);
+  EXPECT_EQ(delta.heap_deallocations, 4u);
+  EXPECT_EQ(delta.mat_pool_hits, 4u);
+  EXPECT_EQ(delta.mat_pool_misses, 1u);
+  EXPECT_EQ(delta.arena_upstream_allocations, 0u);
+}
+
+#ifdef MATHBOARD_COUNT_ALLOCATIONS
+TEST(AllocationStats, CountsHeapAllocations) {
+  const mathboard::AllocationStats before = mathboard::GetAllocationStats();
+  {
+    auto value = std::make_unique<int>(1);
+    EXPECT_EQ(*value, 1);
+  }
+  const mathboard::AllocationStats stats =
+      mathboard::GetAllocationStats() - before;
+  EXPECT_GE(stats.heap_allocations, 1u);
+  EXPECT_GE(stats.heap_deallocations, 1u);
+}
+#endif
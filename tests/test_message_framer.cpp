@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include "../src/unix_socket_server/message_framer.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> Drain(mathboard::MessageFramer &framer) {
+  std::vector<std::string> messages;
+  std::string_view message;
+  while (framer.Next(message)) {
+    messages.emplace_back(message);
+  }
+  return messages;
+}
+
+void Append(mathboard::MessageFramer &framer, std::string_view data) {
+  framer.Append(data.data(), data.size());
+}
+
+} // namespace
+
+TEST(MessageFramer, SplitsNewlineDelimitedAndConcatenatedJson) {
+  mathboard::MessageFramer framer{};
+  Append(framer, "{\"a\": 1}\n{\"b\": [1, {\"c\": 2}]}{\"d\": 3}  \n");
+
+  EXPECT_EQ(Drain(framer), (std::vector<std::string>{
+                               R"({"a": 1})", R"({"b": [1, {"c": 2}]})",
+                               R"({"d": 3})"}));
+  EXPECT_EQ(framer.Pending(), 0u);
+}
+
+TEST(MessageFramer, WaitsForTheRestOfAMessage) {
+  mathboard::MessageFramer framer{};
+  Append(framer, R"({"path": "a}b\"{", "x": )");
+  EXPECT_TRUE(Drain(framer).empty());
+  EXPECT_GT(framer.Pending(), 0u);
+
+  // Braces in strings and escaped quotes don't count
+  Append(framer, R"(5}{"y")");
+  EXPECT_EQ(Drain(framer),
+            (std::vector<std::string>{R"({"path": "a}b\"{", "x": 5})"}));
+
+  Append(framer, ": 6}");
+  EXPECT_EQ(Drain(framer), (std::vector<std::string>{R"({"y": 6})"}));
+}
+
+TEST(MessageFramer, EndsInvalidMessagesAtTheNewline) {
+  mathboard::MessageFramer framer{};
+  Append(framer, "not json\n{\"a\": 1}\n");
+
+  EXPECT_EQ(Drain(framer),
+            (std::vector<std::string>{"not json", R"({"a": 1})"}));
+}
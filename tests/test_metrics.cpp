@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include "../src/metrics/metrics.hpp"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+TEST(Metrics, MergesHistogramsOfEveryThread) {
+  const std::uint64_t before =
+      mathboard::Metrics::GetHistogram(mathboard::Stage::Simplify).count;
+
+  std::thread([] {
+    for (int i = 0; i < 100; i++) {
+      mathboard::Metrics::Observe(mathboard::Stage::Simplify,
+                                  std::chrono::microseconds(3));
+    }
+  }).join();
+  mathboard::Metrics::Observe(mathboard::Stage::Simplify,
+                              std::chrono::milliseconds(10));
+
+  const mathboard::Metrics::Histogram histogram =
+      mathboard::Metrics::GetHistogram(mathboard::Stage::Simplify);
+  EXPECT_EQ(histogram.count - before, 101u);
+  // 3us falls into the (2, 4] bucket, 10ms into (8192, 16384]
+  EXPECT_EQ(histogram.Quantile(0.5), 4.0);
+  EXPECT_EQ(histogram.Quantile(1.0), 16384.0);
+}
+
+TEST(Metrics, ExportsGaugesAndStages) {
+  mathboard::Metrics::RegisterGauge("test_gauge", []() { return 2.5; });
+  {
+    const mathboard::StageTimer stageTimer(mathboard::Stage::Request);
+  }
+
+  const nlohmann::json snapshot = mathboard::Metrics::Snapshot();
+  EXPECT_GE(snapshot["requestsTotal"].get<std::uint64_t>(), 1u);
+  EXPECT_EQ(snapshot["gauges"]["test_gauge"].get<double>(), 2.5);
+  EXPECT_TRUE(snapshot["stages"].contains("request"));
+
+  std::ostringstream output;
+  mathboard::Metrics::WritePrometheus(output);
+  const std::string text = output.str();
+  EXPECT_NE(text.find("mathboard_test_gauge 2.5"), std::string::npos);
+  EXPECT_NE(
+      text.find("mathboard_stage_latency_seconds_count{stage=\"request\"}"),
+      std::string::npos);
+}
+
+TEST(Metrics, RequestRateDoesNotDependOnOtherSnapshots) {
+  // Observed by a thread that exits, its requests still count
+  std::thread([] {
+    for (int i = 0; i < 50; i++) {
+      mathboard::Metrics::Observe(mathboard::Stage::Request,
+                                  std::chrono::microseconds(10));
+    }
+  }).join();
+  // Only complete seconds are counted
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+  // The window moves at most once between the snapshots
+  double rates[3];
+  for (double &rate : rates) {
+    rate = mathboard::Metrics::Snapshot()["requestsPerSecond"].get<double>();
+  }
+  EXPECT_GT(rates[0], 0.0);
+  EXPECT_TRUE(rates[0] == rates[1] || rates[1] == rates[2]);
+}
+
+TEST(Metrics, ScopedGaugesAreUnregistered) {
+  {
+    mathboard::ScopedGauges gauges{};
+    gauges.Register("test_scoped_gauge", []() { return 1.0; });
+    EXPECT_TRUE(
+        mathboard::Metrics::Snapshot()["gauges"].contains("test_scoped_gauge"));
+
+    // Moving the gauges doesn't unregister them
+    const mathboard::ScopedGauges moved = std::move(gauges);
+    EXPECT_TRUE(
+        mathboard::Metrics::Snapshot()["gauges"].contains("test_scoped_gauge"));
+  }
+  EXPECT_FALSE(
+      mathboard::Metrics::Snapshot()["gauges"].contains("test_scoped_gauge"));
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include "../src/opencv_helper.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int kFrameCount = 24;
+
+// Video whose dark frames get brighter one after another, each with a white
+// square
+std::filesystem::path WriteVideo(const std::string &name) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / name;
+  cv::VideoWriter writer(path.string(),
+                         cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 25.0,
+                         cv::Size(64, 48));
+  if (!writer.isOpened()) {
+    return {};
+  }
+  for (int i = 0; i < kFrameCount; i++) {
+    cv::Mat frame(48, 64, CV_8UC3, cv::Scalar::all(10 + 4 * i));
+    cv::rectangle(frame, cv::Rect(8, 8, 16, 16), cv::Scalar::all(255),
+                  cv::FILLED);
+    writer.write(frame);
+  }
+  return path;
+}
+
+} // namespace
+
+TEST(OpenCVHelper, RenderVideoDeliversFramesInOrder) {
+  const std::filesystem::path path = WriteVideo("mathboard_render_test.avi");
+  if (path.empty()) {
+    GTEST_SKIP() << "OpenCV can't write MJPG videos";
+  }
+
+  for (const std::uint32_t queueSize : {1U, 3U, 8U}) {
+    mathboard::OpenCVHelper helper(path);
+    ASSERT_TRUE(helper.IsVideo());
+    helper.SetSize(8);
+
+    std::vector<std::uint32_t> indices;
+    std::vector<double> brightness;
+    helper.RenderVideo(
+        [&](mathboard::FrameResult &&result) {
+          indices.push_back(result.index);
+          brightness.push_back(cv::mean(result.luminance)[0]);
+          EXPECT_EQ(result.strokes.size(), 1u);
+        },
+        4, queueSize);
+
+    ASSERT_EQ(indices.size(), static_cast<std::size_t>(kFrameCount))
+        << "queue size " << queueSize;
+    for (std::size_t i = 0; i < indices.size(); i++) {
+      EXPECT_EQ(indices[i], i);
+      if (i > 0) {
+        EXPECT_GT(brightness[i], brightness[i - 1]);
+      }
+    }
+
+    // The last frame stays available, even with a single slot
+    EXPECT_FALSE(helper.GetFrame().empty()) << "queue size " << queueSize;
+  }
+
+  std::filesystem::remove(path);
+}
+
+namespace {
+
+// Block averages the way ConvertFrame computed them before the summed-area
+// table
+cv::Mat NaiveConvertFrame(const cv::Mat &frame, std::uint32_t size) {
+  const float aspectRatio =
+      static_cast<float>(frame.rows) / static_cast<float>(frame.cols);
+  const std::uint32_t blocksPerRow =
+      std::max(1U, static_cast<std::uint32_t>(size / aspectRatio));
+  const std::uint32_t blockSizeX = std::max(1U, frame.cols / blocksPerRow);
+  const std::uint32_t blockSizeY =
+      std::max(1U, frame.rows / std::max(1U, size));
+  const std::uint32_t numBlocksX = frame.cols / blockSizeX;
+  const std::uint32_t numBlocksY = frame.rows / blockSizeY;
+
+  cv::Mat luminance(numBlocksY, numBlocksX, CV_8UC1);
+  for (std::uint32_t i = 0; i < numBlocksX; i++) {
+    for (std::uint32_t j = 0; j < numBlocksY; j++) {
+      std::uint32_t sum = 0;
+      for (std::uint32_t bi = 0; bi < blockSizeX; ++bi) {
+        for (std::uint32_t bj = 0; bj < blockSizeY; ++bj) {
+          const cv::Vec3b pixel =
+              frame.at<cv::Vec3b>(j * blockSizeY + bj, i * blockSizeX + bi);
+          sum += pixel[0] + pixel[1] + pixel[2];
+        }
+      }
+      luminance.at<uchar>(j, i) =
+          static_cast<uchar>(sum / (3 * blockSizeX * blockSizeY));
+    }
+  }
+  return luminance;
+}
+
+} // namespace
+
+TEST(OpenCVHelper, ConvertFrameMatchesNaiveBlockAverages) {
+  // Wider than a column strip, odd sizes, a tall frame and sizes asking for
+  // more blocks than there are pixels or for none
+  const std::vector<std::pair<cv::Size, std::uint32_t>> cases{
+      {cv::Size(640, 360), 36}, {cv::Size(333, 207), 17},
+      {cv::Size(600, 20), 5},   {cv::Size(20, 600), 10},
+      {cv::Size(64, 48), 1000}, {cv::Size(64, 48), 0},
+      {cv::Size(1, 1), 4}};
+
+  cv::Mat luminance;
+  for (const auto &[frameSize, size] : cases) {
+    cv::Mat frame(frameSize, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    mathboard::OpenCVHelper::ConvertFrame(frame, size, luminance);
+    const cv::Mat expected = NaiveConvertFrame(frame, size);
+    ASSERT_EQ(luminance.size(), expected.size())
+        << frameSize << " size " << size;
+    EXPECT_EQ(cv::countNonZero(luminance != expected), 0)
+        << frameSize << " size " << size;
+  }
+
+  // Not a BGR frame
+  mathboard::OpenCVHelper::ConvertFrame(cv::Mat::zeros(8, 8, CV_8UC1), 4,
+                                        luminance);
+  EXPECT_TRUE(luminance.empty());
+}
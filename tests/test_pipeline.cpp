@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include "../src/concurrency/pipeline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(Pipeline, RunsEveryStageOnEveryItem) {
+  std::mutex mutexResults;
+  std::vector<int> results;
+
+  {
+    mathboard::Pipeline<int> pipeline;
+    pipeline.AddStage("double", [](int &item) {
+      item *= 2;
+      return true;
+    }, {4, 4, 8});
+    // Odd inputs are dropped
+    pipeline.AddStage("filter", [](int &item) { return item % 4 == 0; },
+                      {2, 4, 8});
+    pipeline.AddStage("collect", [&](int &item) {
+      std::lock_guard<std::mutex> lockResults(mutexResults);
+      results.push_back(item);
+      return true;
+    });
+    pipeline.Start();
+
+    for (int i = 0; i < 1000; i++) {
+      EXPECT_TRUE(pipeline.Submit(i));
+    }
+    pipeline.Close();
+    pipeline.Wait();
+
+    EXPECT_FALSE(pipeline.Submit(0));
+    const auto stats = pipeline.GetStats();
+    ASSERT_EQ(stats.size(), 3u);
+    EXPECT_EQ(stats[0].processed, 1000u);
+    EXPECT_EQ(stats[1].dropped, 500u);
+    EXPECT_EQ(stats[2].processed, 500u);
+  }
+
+  std::sort(results.begin(), results.end());
+  ASSERT_EQ(results.size(), 500u);
+  for (int i = 0; i < 500; i++) {
+    EXPECT_EQ(results[i], i * 4);
+  }
+}
+
+TEST(Pipeline, SplitsBatchesLargerThanMaxBatch) {
+  std::vector<int> results;
+  {
+    mathboard::Pipeline<int> pipeline;
+    pipeline.AddStage("first", [](int &) { return true; }, {1, 4, 4});
+    pipeline.AddStage("collect", [&results](int &item) {
+      results.push_back(item);
+      return true;
+    }, {1, 4, 4});
+    pipeline.Start();
+
+    std::vector<int> batch(30);
+    for (int i = 0; i < 30; i++) {
+      batch[i] = i;
+    }
+    EXPECT_TRUE(pipeline.SubmitBatch(batch));
+    EXPECT_TRUE(pipeline.SubmitBatch({30, 31, 32}));
+    pipeline.Close();
+    pipeline.Wait();
+  }
+
+  // A single worker per stage keeps the order
+  ASSERT_EQ(results.size(), 33u);
+  for (int i = 0; i < 33; i++) {
+    EXPECT_EQ(results[i], i);
+  }
+}
+
+TEST(Pipeline, SlowStageBoundsItemsInFlight) {
+  std::atomic<int> started{0};
+  std::atomic<bool> release{false};
+
+  mathboard::Pipeline<int> pipeline;
+  pipeline.AddStage("fast", [&](int &) {
+    started++;
+    return true;
+  }, {1, 2, 1});
+  pipeline.AddStage("slow", [&](int &) {
+    while (!release) {
+      std::this_thread::yield();
+    }
+    return true;
+  }, {1, 2, 1});
+  pipeline.Start();
+
+  std::atomic<int> submitted{0};
+  std::thread producer([&]() {
+    for (int i = 0; i < 100; i++) {
+      pipeline.Submit(i);
+      submitted++;
+    }
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  // One item in the slow stage, its queue and the fast stage's queue are
+  // full, the producer waits
+  EXPECT_LT(submitted.load(), 10);
+  EXPECT_LT(started.load(), 10);
+
+  release = true;
+  producer.join();
+  pipeline.Close();
+  pipeline.Wait();
+  EXPECT_EQ(started.load(), 100);
+}
+
+TEST(Pipeline, DropsItemsThatThrow) {
+  std::atomic<int> collected{0};
+
+  mathboard::Pipeline<int> pipeline;
+  pipeline.AddStage("throw", [](int &item) {
+    if (item == 3) {
+      throw std::runtime_error("item 3");
+    }
+    return true;
+  });
+  pipeline.AddStage("collect", [&](int &) {
+    collected++;
+    return true;
+  });
+  pipeline.Start();
+  for (int i = 0; i < 10; i++) {
+    pipeline.Submit(i);
+  }
+  pipeline.Close();
+  pipeline.Wait();
+
+  EXPECT_EQ(collected.load(), 9);
+}
+
+TEST(Pipeline, HandsDroppedItemsToTheDropHandler) {
+  std::mutex mutexDropped;
+  std::vector<int> dropped;
+
+  {
+    mathboard::Pipeline<int> pipeline;
+    pipeline.AddStage("odd", [](int &item) { return item % 2 == 0; });
+    pipeline.SetDropHandler([&](int &item, const std::string &stage) {
+      EXPECT_EQ(stage, "odd");
+      std::lock_guard<std::mutex> lockDropped(mutexDropped);
+      dropped.push_back(item);
+    });
+    pipeline.Start();
+    for (int i = 0; i < 6; i++) {
+      pipeline.Submit(i);
+    }
+  }
+
+  EXPECT_EQ(dropped, (std::vector<int>{1, 3, 5}));
+}
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include "../src/polyline.hpp"
+
+TEST(Polyline, EncodeDecode) {
+  const std::vector<cv::Point> points = {
+      {10, 10}, {12, 11}, {15, 9}, {15, 20}, {3, 20}};
+
+  const mathboard::EncodedPolyline encoded = mathboard::EncodePolyline(points);
+
+  EXPECT_EQ(encoded.point_count, points.size());
+  EXPECT_EQ(encoded.origin, points.front());
+  EXPECT_EQ(encoded.deltas.size(), 2 * (points.size() - 1));
+  EXPECT_EQ(mathboard::DecodePolyline(encoded), points);
+}
+
+TEST(Polyline, EncodeEmpty) {
+  const mathboard::EncodedPolyline encoded = mathboard::EncodePolyline({});
+
+  EXPECT_EQ(encoded.point_count, 0);
+  EXPECT_TRUE(mathboard::DecodePolyline(encoded).empty());
+}
+
+TEST(Polyline, EncodeLongStep) {
+  const std::vector<cv::Point> points = {{0, 0}, {70000, -40000}};
+
+  const mathboard::EncodedPolyline encoded = mathboard::EncodePolyline(points);
+  const std::vector<cv::Point> decoded = mathboard::DecodePolyline(encoded);
+
+  // The step is split, but it still ends in the same place
+  EXPECT_GT(decoded.size(), points.size());
+  EXPECT_EQ(decoded.front(), points.front());
+  EXPECT_EQ(decoded.back(), points.back());
+}
+
+TEST(Polyline, SimplifyLine) {
+  std::vector<cv::Point> points;
+  for (int x = 0; x <= 100; x++) {
+    points.emplace_back(x, x % 2);
+  }
+
+  const std::vector<cv::Point> simplified =
+      mathboard::SimplifyPolyline(points, 2.0, false);
+
+  EXPECT_EQ(simplified.size(), 2);
+  EXPECT_EQ(simplified.front(), points.front());
+  EXPECT_EQ(simplified.back(), points.back());
+}
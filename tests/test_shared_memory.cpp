@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "../src/unix_socket_server/shared_memory_client.hpp"
+#include "../src/unix_socket_server/shared_memory_ring.hpp"
+#include "../src/unix_socket_server/unix_socket_server.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string ToString(const std::vector<unsigned char> &buffer) {
+  return std::string(buffer.begin(), buffer.end());
+}
+
+} // namespace
+
+TEST(SharedMemoryRing, WrapsAroundTheEnd) {
+  constexpr std::size_t kCapacity = 64;
+  std::vector<unsigned char> memory(
+      mathboard::SharedMemoryRing::RequiredSize(kCapacity) + 64);
+  // The header wants cache line alignment
+  void *aligned = memory.data() + (64 - reinterpret_cast<std::uintptr_t>(
+                                            memory.data()) % 64);
+  mathboard::SharedMemoryRing ring(aligned, kCapacity, true);
+
+  std::vector<unsigned char> buffer;
+  EXPECT_EQ(ring.TryPop(buffer), mathboard::SharedMemoryRing::PopResult::Empty);
+
+  // 24 bytes per message, the third one wraps around
+  for (int i = 0; i < 10; i++) {
+    const std::string message = "message number " + std::to_string(i) + "...";
+    ASSERT_TRUE(ring.TryPush(message.substr(0, 20)));
+    ASSERT_EQ(ring.TryPop(buffer),
+              mathboard::SharedMemoryRing::PopResult::Popped);
+    EXPECT_EQ(ToString(buffer), message.substr(0, 20));
+  }
+
+  EXPECT_TRUE(ring.TryPush(std::string(30, 'a')));
+  EXPECT_FALSE(ring.TryPush(std::string(30, 'b')));
+  EXPECT_FALSE(ring.Empty());
+}
+
+TEST(SharedMemoryRing, RejectsCorruptedPositionsAndSizes) {
+  constexpr std::size_t kCapacity = 64;
+  std::vector<unsigned char> memory(
+      mathboard::SharedMemoryRing::RequiredSize(kCapacity) + 64);
+  void *aligned = memory.data() + (64 - reinterpret_cast<std::uintptr_t>(
+                                            memory.data()) % 64);
+  mathboard::SharedMemoryRing ring(aligned, kCapacity, true);
+  auto *header = static_cast<mathboard::SharedMemoryRing::Header *>(aligned);
+  std::vector<unsigned char> buffer;
+
+  // More bytes written than the ring holds
+  header->head.store(kCapacity + 1);
+  EXPECT_EQ(ring.TryPop(buffer),
+            mathboard::SharedMemoryRing::PopResult::Corrupted);
+  // Not even a size prefix
+  header->head.store(2);
+  EXPECT_EQ(ring.TryPop(buffer),
+            mathboard::SharedMemoryRing::PopResult::Corrupted);
+
+  // A size prefix past the bytes written
+  header->head.store(0);
+  ASSERT_TRUE(ring.TryPush("abcd"));
+  header->head.store(header->head.load() - 1);
+  EXPECT_EQ(ring.TryPop(buffer),
+            mathboard::SharedMemoryRing::PopResult::Corrupted);
+  EXPECT_EQ(header->tail.load(), 0u);
+
+  header->head.store(header->head.load() + 1);
+  ASSERT_EQ(ring.TryPop(buffer),
+            mathboard::SharedMemoryRing::PopResult::Popped);
+  EXPECT_EQ(ToString(buffer), "abcd");
+}
+
+TEST(SharedMemoryServer, RoundTrip) {
+  std::unique_ptr<mathboard::UnixSocketServer> server(
+      mathboard::UnixSocketServer::Instance(
+          mathboard::Transport::SharedMemory));
+
+  ASSERT_TRUE(server->Init("/tmp/mathboard_shared_memory.sock"));
+  server->Listen();
+
+  mathboard::SharedMemoryClient client{};
+  std::thread connecting(
+      [&client]() { client.Connect("/tmp/mathboard_shared_memory.sock"); });
+
+  int clientFd;
+  void *clientAddr;
+  ASSERT_TRUE(server->Accept(clientFd, &clientAddr));
+  free(clientAddr);
+  connecting.join();
+  ASSERT_TRUE(client.IsConnected());
+
+  ASSERT_TRUE(client.Send(R"({"command": "stats"})"));
+
+  std::vector<std::int32_t> ready;
+  ASSERT_TRUE(server->Poll({clientFd}, ready));
+  EXPECT_EQ(ready, std::vector<std::int32_t>{clientFd});
+
+  std::vector<unsigned char> buffer(16);
+  ASSERT_TRUE(server->Read(clientFd, buffer));
+  EXPECT_EQ(ToString(buffer), R"({"command": "stats"})");
+
+  ASSERT_TRUE(server->WriteString(clientFd, R"({"status": "ok"})"));
+  ASSERT_TRUE(client.Receive(buffer, std::chrono::milliseconds(1000)));
+  EXPECT_EQ(ToString(buffer), R"({"status": "ok"})");
+
+  // Hanging up reads as an empty message, like with the socket transport
+  client.Close();
+  ASSERT_TRUE(server->Poll({clientFd}, ready));
+  EXPECT_EQ(ready, std::vector<std::int32_t>{clientFd});
+  ASSERT_TRUE(server->Read(clientFd, buffer));
+  EXPECT_TRUE(buffer.empty());
+  server->Close(clientFd);
+}
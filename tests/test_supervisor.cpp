@@ -0,0 +1,261 @@
+#include <gtest/gtest.h>
+
+#include "../src/request_board_id.hpp"
+#include "../src/supervisor/consistent_hash_ring.hpp"
+#include "../src/supervisor/supervisor.hpp"
+#include "../src/unix_socket_server/connection_registry.hpp"
+#include "../src/unix_socket_server/handoff_socket_server.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr const char *kSocketPath = "/tmp/mathboard_supervisor.sock";
+
+// Worker answering every message with its index, an "exit" command makes it
+// exit and a "large" one gets a 64 KiB reply
+void EchoWorker(std::size_t worker, std::int32_t channel_fd) {
+  mathboard::HandoffSocketServer server(channel_fd);
+  mathboard::ConnectionRegistry connections(server);
+
+  std::vector<std::int32_t> pollFds;
+  std::vector<std::int32_t> ready;
+  std::vector<unsigned char> buffer;
+  for (;;) {
+    pollFds = connections.GetFds();
+    pollFds.push_back(server.GetServerSocketFd());
+    server.Poll(pollFds, ready);
+    for (const std::int32_t socketFd : ready) {
+      if (socketFd == server.GetServerSocketFd()) {
+        int clientFd;
+        void *clientAddr;
+        if (!server.Accept(clientFd, &clientAddr)) {
+          return;
+        }
+        free(clientAddr);
+        connections.Add(clientFd);
+        continue;
+      }
+
+      buffer.resize(1024);
+      if (!server.Read(socketFd, buffer) || buffer.empty()) {
+        connections.Remove(socketFd);
+        continue;
+      }
+      if (std::string(buffer.begin(), buffer.end()).find("exit") !=
+          std::string::npos) {
+        _exit(1);
+      }
+      nlohmann::json reply{{"worker", worker}};
+      if (std::string(buffer.begin(), buffer.end()).find("large") !=
+          std::string::npos) {
+        reply["padding"] = std::string(64 * 1024, 'x');
+      }
+      server.WriteString(socketFd, reply.dump());
+    }
+  }
+}
+
+int Connect() {
+  const int socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::string(kSocketPath).copy(address.sun_path,
+                                sizeof(address.sun_path) - 1);
+  for (int attempt = 0; attempt < 100; attempt++) {
+    if (connect(socketFd, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) == 0) {
+      return socketFd;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  close(socketFd);
+  return -1;
+}
+
+// Send `message` and return the worker index in the reply, -1 on timeout
+int AskWorker(int socket_fd, const std::string &message) {
+  if (write(socket_fd, message.data(), message.size()) < 0) {
+    return -1;
+  }
+  pollfd pollFd{socket_fd, POLLIN, 0};
+  if (poll(&pollFd, 1, 5000) <= 0) {
+    return -1;
+  }
+  char reply[256];
+  const ssize_t size = read(socket_fd, reply, sizeof(reply));
+  if (size <= 0) {
+    return -1;
+  }
+  // Errors have no worker
+  return nlohmann::json::parse(std::string(reply, size)).value("worker", -1);
+}
+
+std::string BoardRequest(std::int64_t board_id) {
+  return nlohmann::json{{"board", {{"boardId", board_id}, {"path", "x.png"}}}}
+      .dump();
+}
+
+} // namespace
+
+TEST(ConsistentHashRing, SpreadsKeysEvenly) {
+  const mathboard::ConsistentHashRing ring(4);
+
+  std::vector<int> counts(4);
+  for (std::int64_t key = 0; key < 40000; key++) {
+    counts[ring.GetNode(key)]++;
+  }
+  for (const int count : counts) {
+    EXPECT_GT(count, 7000);
+    EXPECT_LT(count, 13000);
+  }
+}
+
+TEST(ConsistentHashRing, AddingANodeOnlyMovesKeysToIt) {
+  const mathboard::ConsistentHashRing four(4);
+  const mathboard::ConsistentHashRing five(5);
+
+  int moved = 0;
+  for (std::int64_t key = 0; key < 10000; key++) {
+    if (four.GetNode(key) != five.GetNode(key)) {
+      EXPECT_EQ(five.GetNode(key), 4u);
+      moved++;
+    }
+  }
+  // About a fifth of the keys
+  EXPECT_GT(moved, 1000);
+  EXPECT_LT(moved, 3000);
+}
+
+TEST(RequestBoardId, IgnoresIdsThatAreNotIntegers) {
+  using nlohmann::json;
+  EXPECT_EQ(mathboard::GetRequestBoardId(json::parse(R"({"boardId": 3})")), 3);
+  EXPECT_EQ(mathboard::GetRequestBoardId(
+                json::parse(R"({"board": {"boardId": 7}})")),
+            7);
+  EXPECT_EQ(mathboard::GetRequestBoardId(
+                json::parse(R"({"strokes": [{"boardId": 9}]})")),
+            9);
+
+  // Routed like a request without one instead of throwing
+  for (const char *request :
+       {R"({"boardId": "3"})", R"({"board": {"boardId": "7"}})",
+        R"({"board": {"boardId": null}})",
+        R"({"strokes": [{"boardId": [9]}]})", R"([1, 2])"}) {
+    EXPECT_EQ(mathboard::GetRequestBoardId(json::parse(request)), -1)
+        << request;
+  }
+}
+
+TEST(HandoffSocketServer, AcceptsHandedOverConnections) {
+  int channel[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+  mathboard::HandoffSocketServer server(channel[1]);
+  ASSERT_TRUE(server.Init("unused.sock"));
+
+  int pair[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+  ASSERT_TRUE(mathboard::HandoffSocketServer::SendConnection(channel[0],
+                                                             pair[1]));
+  close(pair[1]);
+
+  std::vector<std::int32_t> ready;
+  ASSERT_TRUE(server.Poll({server.GetServerSocketFd()}, ready));
+  EXPECT_EQ(ready, std::vector<std::int32_t>{server.GetServerSocketFd()});
+
+  int handedOver;
+  void *clientAddr;
+  ASSERT_TRUE(server.Accept(handedOver, &clientAddr));
+  free(clientAddr);
+
+  ASSERT_TRUE(server.WriteString(handedOver, "hello"));
+  char received[5];
+  ASSERT_EQ(read(pair[0], received, sizeof(received)), 5);
+  EXPECT_EQ(std::string(received, 5), "hello");
+
+  server.Close(handedOver);
+  close(pair[0]);
+  close(channel[0]);
+}
+
+TEST(Supervisor, RoutesBoardsAndRestartsWorkers) {
+  // RunSupervisor forks, keep it out of the test runner's process
+  const pid_t supervisor = fork();
+  ASSERT_GE(supervisor, 0);
+  if (supervisor == 0) {
+    mathboard::SupervisorOptions options{3, kSocketPath};
+    _exit(mathboard::RunSupervisor(options, EchoWorker) ? 0 : 1);
+  }
+
+  const int client = Connect();
+  ASSERT_GE(client, 0);
+
+  const mathboard::ConsistentHashRing ring(3);
+  for (std::int64_t board = 0; board < 20; board++) {
+    EXPECT_EQ(AskWorker(client, BoardRequest(board)),
+              static_cast<int>(ring.GetNode(board)));
+  }
+  EXPECT_EQ(AskWorker(client, R"({"command": "stats", "worker": 2})"), 2);
+
+  // The restarted worker gets the same boards
+  const std::size_t worker = ring.GetNode(7);
+  const std::string exit = nlohmann::json{{"command", "exit"},
+                                          {"worker", worker}}
+                               .dump();
+  ASSERT_GT(write(client, exit.data(), exit.size()), 0);
+  int answer = -1;
+  for (int attempt = 0; attempt < 10 && answer < 0; attempt++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    answer = AskWorker(client, BoardRequest(7));
+  }
+  EXPECT_EQ(answer, static_cast<int>(worker));
+
+  close(client);
+  kill(supervisor, SIGTERM);
+  int status = 0;
+  ASSERT_EQ(waitpid(supervisor, &status, 0), supervisor);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+TEST(Supervisor, ClientNotReadingDoesNotStallOthers) {
+  const pid_t supervisor = fork();
+  ASSERT_GE(supervisor, 0);
+  if (supervisor == 0) {
+    mathboard::SupervisorOptions options{2, kSocketPath};
+    _exit(mathboard::RunSupervisor(options, EchoWorker) ? 0 : 1);
+  }
+
+  // Far more replies than its socket holds, and it never reads them
+  const int slow = Connect();
+  ASSERT_GE(slow, 0);
+  const std::string large = R"({"command": "large", "worker": 0})";
+  for (int i = 0; i < 100; i++) {
+    ASSERT_GT(write(slow, large.data(), large.size()), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  const int client = Connect();
+  ASSERT_GE(client, 0);
+  EXPECT_EQ(AskWorker(client, R"({"command": "stats", "worker": 1})"), 1);
+
+  close(client);
+  close(slow);
+  kill(supervisor, SIGTERM);
+  int status = 0;
+  ASSERT_EQ(waitpid(supervisor, &status, 0), supervisor);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include "../src/system_solver.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+TEST(SystemSolver, SolvesUniqueLinearSystems) {
+  const auto solutions = mathboard::SolveSystems({"X+Y-(3)", "X-Y-(1)"});
+  ASSERT_EQ(solutions.size(), 1u);
+  const mathboard::SystemSolution &solution = solutions[0];
+  EXPECT_EQ(solution.kind, mathboard::SystemKind::Linear);
+  EXPECT_EQ(solution.symbols, (std::vector<std::string>{"X", "Y"}));
+  EXPECT_EQ(solution.rank, 2u);
+  EXPECT_TRUE(solution.unique);
+  ASSERT_EQ(solution.values.size(), 2u);
+  EXPECT_NEAR(solution.values[0], 2.0, 1e-12);
+  EXPECT_NEAR(solution.values[1], 1.0, 1e-12);
+
+  // Overdetermined but consistent
+  const auto overdetermined =
+      mathboard::SolveSystems({"X-(1)", "Y-(2)", "X+Y-(3)"});
+  ASSERT_EQ(overdetermined.size(), 1u);
+  EXPECT_EQ(overdetermined[0].rank, 2u);
+  EXPECT_TRUE(overdetermined[0].unique);
+  ASSERT_EQ(overdetermined[0].values.size(), 2u);
+  EXPECT_NEAR(overdetermined[0].values[0], 1.0, 1e-12);
+  EXPECT_NEAR(overdetermined[0].values[1], 2.0, 1e-12);
+}
+
+TEST(SystemSolver, SingularConsistentSystemsAreNotUnique) {
+  const auto solutions = mathboard::SolveSystems({"X+Y-(2)", "2*X+2*Y-(4)"});
+  ASSERT_EQ(solutions.size(), 1u);
+  const mathboard::SystemSolution &solution = solutions[0];
+  EXPECT_EQ(solution.rank, 1u);
+  EXPECT_FALSE(solution.unique);
+  // The solution of minimum norm
+  ASSERT_EQ(solution.values.size(), 2u);
+  EXPECT_NEAR(solution.values[0], 1.0, 1e-12);
+  EXPECT_NEAR(solution.values[1], 1.0, 1e-12);
+  EXPECT_LT(solution.residual, 1e-9);
+}
+
+TEST(SystemSolver, UnderdeterminedSystemsAreNotUnique) {
+  const auto solutions = mathboard::SolveSystems({"X+Y+Z-(3)", "X-Z-(0)"});
+  ASSERT_EQ(solutions.size(), 1u);
+  const mathboard::SystemSolution &solution = solutions[0];
+  EXPECT_EQ(solution.rank, 2u);
+  EXPECT_FALSE(solution.unique);
+  ASSERT_EQ(solution.values.size(), 3u);
+  EXPECT_NEAR(solution.values[0] + solution.values[1] + solution.values[2],
+              3.0, 1e-12);
+  EXPECT_NEAR(solution.values[0], solution.values[2], 1e-12);
+}
+
+TEST(SystemSolver, InconsistentSystemsHaveNoValues) {
+  const auto solutions = mathboard::SolveSystems({"X+Y-(1)", "X+Y-(2)"});
+  ASSERT_EQ(solutions.size(), 1u);
+  EXPECT_EQ(solutions[0].rank, 1u);
+  EXPECT_FALSE(solutions[0].unique);
+  EXPECT_TRUE(solutions[0].values.empty());
+  EXPECT_GT(solutions[0].residual, 0.1);
+
+  // Overdetermined without a common solution
+  const auto overdetermined =
+      mathboard::SolveSystems({"X-(1)", "Y-(2)", "X+Y-(4)"});
+  ASSERT_EQ(overdetermined.size(), 1u);
+  EXPECT_EQ(overdetermined[0].rank, 2u);
+  EXPECT_TRUE(overdetermined[0].values.empty());
+}
+
+TEST(SystemSolver, SolvesNonLinearSystems) {
+  const auto solutions =
+      mathboard::SolveSystems({"X**2+Y**2-(5)", "X-Y-(1)", "Z-(4)"});
+  ASSERT_EQ(solutions.size(), 2u);
+  const mathboard::SystemSolution &solution = solutions[0];
+  EXPECT_EQ(solution.kind, mathboard::SystemKind::NonLinear);
+  EXPECT_FALSE(solution.unique);
+  ASSERT_EQ(solution.values.size(), 2u);
+  const double x = solution.values[0];
+  const double y = solution.values[1];
+  EXPECT_NEAR(x * x + y * y, 5.0, 1e-9);
+  EXPECT_NEAR(x - y, 1.0, 1e-9);
+
+  // Separate system of its own symbol
+  EXPECT_EQ(solutions[1].symbols, std::vector<std::string>{"Z"});
+  ASSERT_EQ(solutions[1].values.size(), 1u);
+  EXPECT_NEAR(solutions[1].values[0], 4.0, 1e-12);
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include "../src/concurrency/thread_pool.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+TEST(ThreadPool, RunsTasksInOrder) {
+  std::vector<int> order;
+  {
+    mathboard::ThreadPool pool(1);
+    EXPECT_EQ(pool.GetThreadCount(), 1u);
+    for (int i = 0; i < 100; i++) {
+      pool.Submit([&order, i]() { order.push_back(i); });
+    }
+    // Queued tasks still run before the workers are joined
+  }
+
+  ASSERT_EQ(order.size(), 100u);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(ThreadPool, SurvivesThrowingTasks) {
+  std::atomic<int> ran{0};
+  {
+    mathboard::ThreadPool pool(2);
+    for (int i = 0; i < 10; i++) {
+      pool.Submit([&ran, i]() {
+        if (i % 2 == 0) {
+          throw std::runtime_error("task failed");
+        }
+        if (i == 5) {
+          throw 5;
+        }
+        ran++;
+      });
+    }
+  }
+  EXPECT_EQ(ran.load(), 4);
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "../src/concurrency/thread_registry.hpp"
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Counter {
+  int value{0};
+};
+
+mathboard::ThreadRegistry<Counter> &GetCounters() {
+  static mathboard::ThreadRegistry<Counter> counters(
+      [](const Counter &counter, Counter &retired) {
+        retired.value += counter.value;
+      });
+  return counters;
+}
+
+// Running threads' counts and the retired ones, read together
+std::pair<std::size_t, int> ReadCounters() {
+  return GetCounters().Read(
+      [](const std::vector<std::shared_ptr<Counter>> &counters,
+         const Counter &retired) {
+        int total = retired.value;
+        for (const auto &counter : counters) {
+          total += counter->value;
+        }
+        return std::make_pair(counters.size(), total);
+      });
+}
+
+} // namespace
+
+TEST(ThreadRegistry, RetiresObjectsOfExitedThreads) {
+  GetCounters().Local().value = 1;
+  const auto [runningBefore, totalBefore] = ReadCounters();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([]() { GetCounters().Local().value += 10; });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  const auto [running, total] = ReadCounters();
+  // The exited threads' counters are released, their counts kept
+  EXPECT_EQ(running, runningBefore);
+  EXPECT_EQ(total, totalBefore + 40);
+  EXPECT_EQ(GetCounters().GetObjects().size(), running);
+}
+
+TEST(ThreadRegistry, EachThreadHasItsOwnObject) {
+  Counter *main = &GetCounters().Local();
+  EXPECT_EQ(&GetCounters().Local(), main);
+
+  Counter *other = nullptr;
+  std::thread([&other]() {
+    other = &GetCounters().Local();
+    // Registered while the thread runs
+    EXPECT_EQ(GetCounters().GetObjects().size(), 2u);
+  }).join();
+  EXPECT_NE(other, main);
+}
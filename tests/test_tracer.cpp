@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "../src/tracing/tracer.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+
+TEST(Tracer, WritesSpansWithContext) {
+  {
+    const mathboard::TraceContextScope context(42, 7);
+    const mathboard::TraceSpan span("TracerTest::Span");
+  }
+
+  std::ostringstream output;
+  mathboard::Tracer::WriteChromeTrace(output);
+  const std::string trace = output.str();
+
+  EXPECT_NE(trace.find("\"name\":\"TracerTest::Span\""), std::string::npos);
+  EXPECT_NE(trace.find("\"requestId\":42,\"boardId\":7"), std::string::npos);
+  // Context is restored once the scope ends
+  EXPECT_EQ(mathboard::Tracer::CurrentContext().request_id, 0);
+}
+
+TEST(Tracer, KeepsOnlyTheNewestEventsPerThread) {
+  std::thread([] {
+    for (std::size_t i = 0; i < 2 * mathboard::Tracer::kThreadBufferSize;
+         i++) {
+      const mathboard::TraceSpan span("TracerTest::Ring");
+    }
+  }).join();
+
+  std::ostringstream output;
+  mathboard::Tracer::WriteChromeTrace(output);
+  const std::string trace = output.str();
+
+  std::size_t count = 0;
+  for (std::size_t pos = trace.find("TracerTest::Ring");
+       pos != std::string::npos;
+       pos = trace.find("TracerTest::Ring", pos + 1)) {
+    count++;
+  }
+  // The oldest slot may be mid-write while dumping, it's always skipped
+  EXPECT_EQ(count, mathboard::Tracer::kThreadBufferSize - 1);
+}
+
+TEST(Tracer, ExitedThreadsShareOneRing) {
+  // Each exited thread's ring is released, only the newest events of all of
+  // them stay
+  for (int thread = 0; thread < 3; thread++) {
+    std::thread([] {
+      for (std::size_t i = 0; i < mathboard::Tracer::kThreadBufferSize; i++) {
+        const mathboard::TraceSpan span("TracerTest::Exited");
+      }
+    }).join();
+  }
+
+  std::ostringstream output;
+  mathboard::Tracer::WriteChromeTrace(output);
+  const std::string trace = output.str();
+
+  std::size_t count = 0;
+  for (std::size_t pos = trace.find("TracerTest::Exited");
+       pos != std::string::npos;
+       pos = trace.find("TracerTest::Exited", pos + 1)) {
+    count++;
+  }
+  EXPECT_EQ(count, mathboard::Tracer::kThreadBufferSize);
+}
+
+TEST(Tracer, ContinuousDumpWritesOnStop) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "mathboard_tracer_test.json";
+  std::filesystem::remove(path);
+
+  mathboard::Tracer::StartContinuousDump(path, std::chrono::hours(1));
+  {
+    const mathboard::TraceSpan span("TracerTest::Continuous");
+  }
+  mathboard::Tracer::StopContinuousDump();
+
+  std::ifstream input(path);
+  const std::string trace((std::istreambuf_iterator<char>(input)),
+                          std::istreambuf_iterator<char>());
+  EXPECT_NE(trace.find("TracerTest::Continuous"), std::string::npos);
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,347 @@
+#include <gtest/gtest.h>
+
+#include "../src/traffic_recorder.hpp"
+#include "../src/unix_socket_server/connection_registry.hpp"
+#include "../src/unix_socket_server/linux_unix_socket_server.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Records what the registry writes and closes instead of using sockets
+class FakeServer : public mathboard::UnixSocketServer {
+public:
+  bool Init(const std::filesystem::path &) override { return true; }
+  void Listen() override {}
+  bool Accept(int &, void **) override { return false; }
+  bool Read(const std::int32_t, std::vector<unsigned char> &) override {
+    return false;
+  }
+  bool Write(const std::int32_t, const std::vector<unsigned char> &) override {
+    return true;
+  }
+  bool WriteString(const std::int32_t socket_fd,
+                   const std::string &msg) override {
+    written[socket_fd].push_back(msg);
+    return true;
+  }
+  bool Poll(const std::vector<std::int32_t> &,
+            std::vector<std::int32_t> &) override {
+    return true;
+  }
+  void Shutdown(const std::int32_t socket_fd) override {
+    std::lock_guard lock(shut_down_mutex);
+    shut_down.push_back(socket_fd);
+  }
+  void Close(const std::int32_t socket_fd) override {
+    closed.push_back(socket_fd);
+  }
+
+  std::map<std::int32_t, std::vector<std::string>> written{};
+  std::mutex shut_down_mutex{};
+  std::vector<std::int32_t> shut_down{};
+  std::vector<std::int32_t> closed{};
+};
+
+// Slow WriteV counting its calls and the messages in them
+class SlowServer : public FakeServer {
+public:
+  bool WriteV(const std::int32_t,
+              const std::vector<std::string_view> &messages) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    std::lock_guard lock(mutex);
+    calls++;
+    for (const std::string_view message : messages) {
+      lines.emplace_back(message);
+    }
+    return true;
+  }
+
+  std::mutex mutex{};
+  int calls{0};
+  std::vector<std::string> lines{};
+};
+
+// WriteV blocking like a socket whose client doesn't read, until the
+// connection is shut down
+class BlockedServer : public FakeServer {
+public:
+  bool WriteV(const std::int32_t,
+              const std::vector<std::string_view> &) override {
+    std::unique_lock lock(mutex);
+    blocked = true;
+    changed.notify_all();
+    changed.wait(lock, [this]() { return released; });
+    return false;
+  }
+  void Shutdown(const std::int32_t socket_fd) override {
+    FakeServer::Shutdown(socket_fd);
+    std::lock_guard lock(mutex);
+    released = true;
+    changed.notify_all();
+  }
+
+  void WaitUntilBlocked() {
+    std::unique_lock lock(mutex);
+    changed.wait(lock, [this]() { return blocked; });
+  }
+
+  std::mutex mutex{};
+  std::condition_variable changed{};
+  bool blocked{false};
+  bool released{false};
+};
+
+// Every WriteV queues another reply for the connection, like pipeline
+// threads finishing requests faster than the client reads
+class BusyServer : public FakeServer {
+public:
+  bool WriteV(const std::int32_t socket_fd,
+              const std::vector<std::string_view> &messages) override {
+    std::lock_guard lock(mutex);
+    writers.push_back(std::this_thread::get_id());
+    lines.insert(lines.end(), messages.begin(), messages.end());
+    if (queued < kReplies) {
+      queued++;
+      connections->Write(socket_fd, id, std::to_string(queued));
+    }
+    return true;
+  }
+
+  static constexpr int kReplies = 100;
+  mathboard::ConnectionRegistry *connections{nullptr};
+  std::uint64_t id{0};
+  std::mutex mutex{};
+  std::vector<std::thread::id> writers{};
+  int queued{0};
+  std::vector<std::string> lines{};
+};
+
+} // namespace
+
+TEST(TrafficRecorder, RecordsRawRequests) {
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "mathboard_test_capture.jsonl";
+
+  {
+    mathboard::TrafficRecorder recorder{};
+    ASSERT_TRUE(recorder.Open(path));
+    recorder.Record(1, R"({"command": "stats"})");
+    recorder.Record(2, "not json");
+  }
+
+  std::ifstream file(path);
+  std::vector<nlohmann::json> lines;
+  for (std::string line; std::getline(file, line);) {
+    lines.push_back(nlohmann::json::parse(line));
+  }
+
+  ASSERT_EQ(lines.size(), 2u);
+  EXPECT_EQ(lines[0]["connection"], 1);
+  EXPECT_EQ(lines[0]["request"], R"({"command": "stats"})");
+  EXPECT_EQ(lines[1]["request"], "not json");
+  EXPECT_LE(lines[0]["offsetUs"], lines[1]["offsetUs"]);
+
+  std::filesystem::remove(path);
+}
+
+TEST(ConnectionRegistry, DropsRepliesToClosedConnections) {
+  FakeServer server{};
+  mathboard::ConnectionRegistry connections(server);
+
+  const std::uint64_t first = connections.Add(5);
+  EXPECT_TRUE(connections.Write(5, first, "first"));
+
+  // The fd gets reused by the next client before the old reply is ready
+  connections.Remove(5);
+  const std::uint64_t second = connections.Add(5);
+  EXPECT_NE(first, second);
+  EXPECT_FALSE(connections.Write(5, first, "stale"));
+  EXPECT_TRUE(connections.Write(5, second, "second"));
+
+  // One line per reply
+  EXPECT_EQ(server.written[5],
+            (std::vector<std::string>{"first\n", "second\n"}));
+  EXPECT_EQ(server.closed, std::vector<std::int32_t>{5});
+  EXPECT_EQ(connections.Size(), 1u);
+}
+
+TEST(ConnectionRegistry, BatchesConcurrentReplies) {
+  SlowServer server{};
+  constexpr int kThreads = 8;
+  constexpr int kReplies = 50;
+  {
+    mathboard::ConnectionRegistry connections(server);
+    const std::uint64_t id = connections.Add(7);
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < kThreads; thread++) {
+      threads.emplace_back([&connections, id, thread]() {
+        for (int reply = 0; reply < kReplies; reply++) {
+          connections.Write(7, id,
+                            std::to_string(thread) + ":" +
+                                std::to_string(reply));
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    // Destroyed once the flusher wrote the rest
+  }
+
+  // Everything arrived, replies queued during a write went out together
+  EXPECT_EQ(server.lines.size(), static_cast<std::size_t>(kThreads * kReplies));
+  EXPECT_LT(server.calls, kThreads * kReplies);
+
+  // Every thread's replies stay in order
+  std::vector<int> next(kThreads, 0);
+  for (const std::string &line : server.lines) {
+    const std::size_t separator = line.find(':');
+    const int thread = std::stoi(line.substr(0, separator));
+    EXPECT_EQ(std::stoi(line.substr(separator + 1)), next[thread]++);
+  }
+}
+
+TEST(ConnectionRegistry, RemoveFailsABlockedWrite) {
+  BlockedServer server{};
+  mathboard::ConnectionRegistry connections(server);
+  const std::uint64_t id = connections.Add(3);
+
+  std::thread writer([&connections, id]() {
+    EXPECT_FALSE(connections.Write(3, id, "never read"));
+  });
+  server.WaitUntilBlocked();
+
+  // Doesn't wait for the client to read, the write fails instead
+  connections.Remove(3);
+  writer.join();
+  EXPECT_EQ(server.shut_down, std::vector<std::int32_t>{3});
+  EXPECT_EQ(server.closed, std::vector<std::int32_t>{3});
+}
+
+TEST(ConnectionRegistry, DisconnectsAClientNotReading) {
+  BlockedServer server{};
+  mathboard::ConnectionRegistry connections(server);
+  const std::uint64_t id = connections.Add(3);
+
+  std::thread writer([&connections, id]() { connections.Write(3, id, "x"); });
+  server.WaitUntilBlocked();
+
+  // Queued behind the blocked write until the bound
+  const std::string reply(1 << 20, 'x');
+  std::size_t accepted = 0;
+  while (connections.Write(3, id, reply)) {
+    accepted++;
+    ASSERT_LE(accepted * reply.size(),
+              mathboard::ConnectionRegistry::kMaxQueuedBytes);
+  }
+  EXPECT_GT(accepted, 0u);
+  writer.join();
+  EXPECT_EQ(server.shut_down, std::vector<std::int32_t>{3});
+  // Dropped until the daemon loop removes it
+  EXPECT_FALSE(connections.Write(3, id, "dropped"));
+  EXPECT_EQ(connections.Size(), 1u);
+}
+
+TEST(ConnectionRegistry, WriterDoesNotDrainABusyConnection) {
+  BusyServer server{};
+  {
+    mathboard::ConnectionRegistry connections(server);
+    server.connections = &connections;
+    server.id = connections.Add(4);
+
+    // Returns while replies keep coming, the flusher writes them
+    EXPECT_TRUE(connections.Write(4, server.id, "0"));
+  }
+
+  const auto calls = std::count(server.writers.begin(), server.writers.end(),
+                                std::this_thread::get_id());
+  EXPECT_EQ(calls, mathboard::ConnectionRegistry::kMaxWriteBatches);
+
+  ASSERT_EQ(server.lines.size(), BusyServer::kReplies + 1u);
+  for (int reply = 0; reply <= BusyServer::kReplies; reply++) {
+    EXPECT_EQ(server.lines[reply], std::to_string(reply));
+  }
+}
+
+TEST(ConnectionRegistry, NeverWaitsForAClient) {
+  mathboard::LinuxUnixSocketServer server{};
+  int stalled[2];
+  int reading[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, stalled), 0);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, reading), 0);
+  {
+    mathboard::ConnectionRegistry connections(server);
+    const std::uint64_t stalledId = connections.Add(stalled[0]);
+    const std::uint64_t readingId = connections.Add(reading[0]);
+
+    // Kept for the flusher past what the socket takes, until the bound
+    const std::string reply(1 << 20, 'x');
+    std::size_t accepted = 0;
+    while (connections.Write(stalled[0], stalledId, reply)) {
+      accepted++;
+    }
+    EXPECT_GT(accepted, 0u);
+
+    // Other clients still get their replies
+    EXPECT_TRUE(connections.Write(reading[0], readingId, "ok"));
+    char line[3];
+    ASSERT_EQ(read(reading[1], line, sizeof(line)), 3);
+    EXPECT_EQ(std::string(line, sizeof(line)), "ok\n");
+
+    // Doesn't wait for the flusher to write the rest either
+    connections.Remove(stalled[0]);
+  }
+  close(stalled[1]);
+  close(reading[1]);
+}
+
+TEST(ConnectionRegistry, FlushesWhatTheSocketDidNotTake) {
+  mathboard::LinuxUnixSocketServer server{};
+  int sockets[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+  constexpr int kReplies = 200;
+  std::string received;
+  {
+    mathboard::ConnectionRegistry connections(server);
+    const std::uint64_t id = connections.Add(sockets[0]);
+    // More than the socket buffer, read only once they're all written
+    for (int reply = 0; reply < kReplies; reply++) {
+      std::string message = std::to_string(reply);
+      message.resize(10000, ' ');
+      ASSERT_TRUE(connections.Write(sockets[0], id, std::move(message)));
+    }
+
+    std::vector<char> buffer(1 << 16);
+    while (received.size() < kReplies * 10001u) {
+      const ssize_t bytes = read(sockets[1], buffer.data(), buffer.size());
+      ASSERT_GT(bytes, 0);
+      received.append(buffer.data(), static_cast<std::size_t>(bytes));
+    }
+  }
+  close(sockets[1]);
+
+  ASSERT_EQ(received.size(), kReplies * 10001u);
+  for (int reply = 0; reply < kReplies; reply++) {
+    std::string expected = std::to_string(reply);
+    expected.resize(10000, ' ');
+    EXPECT_EQ(received.substr(reply * 10001u, 10001u), expected + "\n");
+  }
+}
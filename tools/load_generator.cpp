@@ -0,0 +1,887 @@
+// Drives the daemon's Unix socket with synthetic boards or a capture recorded
+// with `mathboard --record`, at a fixed open-loop rate over many connections.
+//
+// Latencies are measured from the time a request was scheduled, not from the
+// time it was sent, so a stalled daemon shows up in the percentiles instead
+// of just slowing the generator down (coordinated omission).
+
+// local
+#include "../src/concurrency/bounded_queue.hpp"
+#include "../src/unix_socket_server/message_framer.hpp"
+#include "../src/unix_socket_server/shared_memory_client.hpp"
+
+// libs
+// spdlog
+#include <spdlog/spdlog.h>
+// json
+#include <nlohmann/json.hpp>
+
+// std
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// posix
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::filesystem::path socket_path{"socket.sock"};
+  // Talk to a daemon started with --transport shared-memory
+  bool shared_memory{false};
+  // Requests per second, across all connections
+  double rate{100.0};
+  std::chrono::seconds duration{10};
+  std::size_t connections{8};
+  // Requests a connection sends before waiting for their replies, matched
+  // by requestId. Socket transport only.
+  std::size_t pipeline{1};
+  // Replay this capture instead of generating boards, every recorded
+  // connection over a connection of its own instead of `connections`
+  std::filesystem::path replay_path{};
+  // Replay faster (> 1) or slower than recorded
+  double replay_speed{1.0};
+  // Synthetic boards, reused round robin
+  std::size_t boards{16};
+  std::size_t strokes_per_board{8};
+  // Symbol height in pixels, every stroke is scaled by 0.75-1.25
+  double stroke_size{48.0};
+  // Symbols drawn uniformly, repeat one to make it more common
+  std::string symbols{"0123456789+-=x()"};
+  std::filesystem::path out_dir{"load_generator_boards"};
+  std::uint32_t seed{42};
+  // HdrHistogram-style percentile distribution, empty skips it
+  std::filesystem::path percentiles_path{};
+  std::chrono::milliseconds reply_timeout{10000};
+};
+
+// Log-linear latency histogram in microseconds. Values below 256 are exact,
+// larger ones land in one of 128 buckets per power of two, so every value is
+// within 1% of the recorded one.
+class LatencyHistogram {
+public:
+  void Record(std::uint64_t value_us) {
+    const std::size_t index = Index(value_us);
+    if (index >= m_Counts.size()) {
+      m_Counts.resize(index + 1, 0);
+    }
+    m_Counts[index]++;
+    m_Count++;
+    m_Sum += value_us;
+    m_Min = std::min(m_Min, value_us);
+    m_Max = std::max(m_Max, value_us);
+  }
+
+  void Merge(const LatencyHistogram &other) {
+    if (other.m_Counts.size() > m_Counts.size()) {
+      m_Counts.resize(other.m_Counts.size(), 0);
+    }
+    for (std::size_t i = 0; i < other.m_Counts.size(); i++) {
+      m_Counts[i] += other.m_Counts[i];
+    }
+    m_Count += other.m_Count;
+    m_Sum += other.m_Sum;
+    m_Min = std::min(m_Min, other.m_Min);
+    m_Max = std::max(m_Max, other.m_Max);
+  }
+
+  std::uint64_t Count() const { return m_Count; }
+  std::uint64_t Min() const { return m_Count == 0 ? 0 : m_Min; }
+  std::uint64_t Max() const { return m_Max; }
+  double Mean() const {
+    return m_Count == 0 ? 0.0
+                        : static_cast<double>(m_Sum) /
+                              static_cast<double>(m_Count);
+  }
+
+  // Highest value equivalent to the one at `percentile` (0-100)
+  std::uint64_t ValueAtPercentile(double percentile) const {
+    if (m_Count == 0) {
+      return 0;
+    }
+    const auto target = static_cast<std::uint64_t>(std::max(
+        1.0, std::ceil(percentile / 100.0 * static_cast<double>(m_Count))));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < m_Counts.size(); i++) {
+      seen += m_Counts[i];
+      if (seen >= target) {
+        return std::min(HighestEquivalent(i), m_Max);
+      }
+    }
+    return m_Max;
+  }
+
+  // Value, percentile, total count and 1/(1-percentile) of every bucket, the
+  // format HdrHistogram's plotter reads
+  void WritePercentiles(std::ostream &out) const {
+    out << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < m_Counts.size(); i++) {
+      if (m_Counts[i] == 0) {
+        continue;
+      }
+      seen += m_Counts[i];
+      const double fraction =
+          static_cast<double>(seen) / static_cast<double>(m_Count);
+      const double valueMs =
+          static_cast<double>(std::min(HighestEquivalent(i), m_Max)) / 1000.0;
+      if (seen == m_Count) {
+        out << fmt::format("{:12.3f} {:14.12f} {:10d}\n", valueMs, fraction,
+                           seen);
+      } else {
+        out << fmt::format("{:12.3f} {:14.12f} {:10d} {:14.2f}\n", valueMs,
+                           fraction, seen, 1.0 / (1.0 - fraction));
+      }
+    }
+    out << fmt::format("#[Mean    = {:12.3f}, Max = {:12.3f}]\n",
+                       Mean() / 1000.0, static_cast<double>(Max()) / 1000.0);
+    out << fmt::format("#[Total count    = {:12d}]\n", m_Count);
+  }
+
+private:
+  static constexpr std::uint32_t kSubBucketBits = 7;
+  static constexpr std::uint64_t kSubBuckets = 1 << kSubBucketBits;
+
+  static std::size_t Index(std::uint64_t value) {
+    const std::uint32_t magnitude = std::max<std::int32_t>(
+        0, std::bit_width(value) - static_cast<int>(kSubBucketBits) - 1);
+    if (magnitude == 0) {
+      return value;
+    }
+    const std::uint64_t subBucket = (value >> magnitude) - kSubBuckets;
+    return 2 * kSubBuckets + (magnitude - 1) * kSubBuckets + subBucket;
+  }
+
+  static std::uint64_t HighestEquivalent(std::size_t index) {
+    if (index < 2 * kSubBuckets) {
+      return index;
+    }
+    const std::uint64_t magnitude = (index - 2 * kSubBuckets) / kSubBuckets + 1;
+    const std::uint64_t subBucket =
+        (index - 2 * kSubBuckets) % kSubBuckets + kSubBuckets;
+    return ((subBucket + 1) << magnitude) - 1;
+  }
+
+private:
+  std::vector<std::uint64_t> m_Counts{};
+  std::uint64_t m_Count{0};
+  std::uint64_t m_Sum{0};
+  std::uint64_t m_Min{UINT64_MAX};
+  std::uint64_t m_Max{0};
+};
+
+// Request scheduled `offset` after the start
+struct Message {
+  Clock::duration offset{};
+  std::string request{};
+  // Recorded connection id, 0 for generated requests
+  std::uint64_t connection{0};
+};
+
+struct Job {
+  Clock::time_point intended{};
+  const std::string *request{nullptr};
+};
+
+struct WorkerStats {
+  LatencyHistogram latencies{};
+  std::uint64_t errors{0};
+  Clock::time_point last_reply{};
+};
+
+using Polyline = std::vector<std::pair<double, double>>;
+
+// Symbols drawn with straight segments in a unit box, y pointing down
+std::vector<Polyline> GetGlyph(char symbol) {
+  switch (symbol) {
+  case '0': {
+    Polyline ellipse;
+    for (int i = 0; i <= 16; i++) {
+      const double angle = 2.0 * std::numbers::pi * i / 16.0;
+      ellipse.emplace_back(0.5 + 0.4 * std::cos(angle),
+                           0.5 + 0.5 * std::sin(angle));
+    }
+    return {ellipse};
+  }
+  case '1':
+    return {{{0.3, 0.2}, {0.5, 0.0}, {0.5, 1.0}}};
+  case '2':
+    return {{{0.1, 0.25},
+             {0.3, 0.02},
+             {0.7, 0.02},
+             {0.9, 0.25},
+             {0.85, 0.45},
+             {0.1, 1.0},
+             {0.9, 1.0}}};
+  case '3':
+    return {{{0.1, 0.1},
+             {0.5, 0.0},
+             {0.85, 0.2},
+             {0.5, 0.48},
+             {0.9, 0.75},
+             {0.5, 1.0},
+             {0.1, 0.9}}};
+  case '4':
+    return {{{0.7, 1.0}, {0.7, 0.0}, {0.05, 0.7}, {0.95, 0.7}}};
+  case '5':
+    return {{{0.9, 0.0},
+             {0.15, 0.0},
+             {0.1, 0.45},
+             {0.6, 0.4},
+             {0.9, 0.7},
+             {0.6, 1.0},
+             {0.1, 0.92}}};
+  case '6':
+    return {{{0.8, 0.05},
+             {0.4, 0.1},
+             {0.12, 0.55},
+             {0.2, 0.9},
+             {0.5, 1.0},
+             {0.85, 0.8},
+             {0.8, 0.55},
+             {0.45, 0.45},
+             {0.15, 0.6}}};
+  case '7':
+    return {{{0.05, 0.0}, {0.95, 0.0}, {0.4, 1.0}}};
+  case '8':
+    return {{{0.5, 0.48},
+             {0.15, 0.25},
+             {0.5, 0.0},
+             {0.85, 0.25},
+             {0.5, 0.48},
+             {0.1, 0.75},
+             {0.5, 1.0},
+             {0.9, 0.75},
+             {0.5, 0.48}}};
+  case '9':
+    return {{{0.85, 0.4},
+             {0.55, 0.55},
+             {0.15, 0.4},
+             {0.2, 0.1},
+             {0.55, 0.0},
+             {0.85, 0.2},
+             {0.85, 0.4},
+             {0.7, 1.0}}};
+  case '+':
+    return {{{0.5, 0.15}, {0.5, 0.85}}, {{0.15, 0.5}, {0.85, 0.5}}};
+  case '-':
+    return {{{0.15, 0.5}, {0.85, 0.5}}};
+  case '=':
+    return {{{0.15, 0.35}, {0.85, 0.35}}, {{0.15, 0.65}, {0.85, 0.65}}};
+  case 'x':
+    return {{{0.15, 0.15}, {0.85, 0.85}}, {{0.85, 0.15}, {0.15, 0.85}}};
+  case '(':
+    return {{{0.65, 0.0}, {0.35, 0.3}, {0.35, 0.7}, {0.65, 1.0}}};
+  case ')':
+    return {{{0.35, 0.0}, {0.65, 0.3}, {0.65, 0.7}, {0.35, 1.0}}};
+  default:
+    return {};
+  }
+}
+
+// Write `symbol` as a black on white SVG of `size` pixels, every point
+// shifted a little so no two strokes are the same
+bool WriteSymbolSvg(const std::filesystem::path &path, char symbol,
+                    double size, std::mt19937 &random) {
+  std::uniform_real_distribution<double> jitter(-0.03, 0.03);
+  const double margin = size * 0.1;
+  const double width = size * 0.8 + 2.0 * margin;
+  const double height = size + 2.0 * margin;
+
+  std::ofstream file(path);
+  if (!file) {
+    spdlog::error("[load_generator]: Could not write {}.\n", path.string());
+    return false;
+  }
+
+  file << fmt::format("<svg xmlns=\"http://www.w3.org/2000/svg\" "
+                      "width=\"{:.0f}\" height=\"{:.0f}\">\n",
+                      width, height);
+  file << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+  for (const Polyline &polyline : GetGlyph(symbol)) {
+    file << "<polyline fill=\"none\" stroke=\"black\" stroke-linecap=\"round\""
+         << fmt::format(" stroke-width=\"{:.1f}\" points=\"",
+                        std::max(2.0, size / 12.0));
+    for (const auto &[x, y] : polyline) {
+      file << fmt::format("{:.1f},{:.1f} ",
+                          margin + (x + jitter(random)) * size * 0.8,
+                          margin + (y + jitter(random)) * size);
+    }
+    file << "\"/>\n";
+  }
+  file << "</svg>\n";
+  return true;
+}
+
+// Requests in the daemon's strokes format, one per board
+std::optional<std::vector<std::string>>
+GenerateBoards(const Options &options) {
+  std::vector<char> symbols;
+  for (const char symbol : options.symbols) {
+    if (GetGlyph(symbol).empty()) {
+      spdlog::error("[load_generator]: No glyph for symbol '{}'.\n", symbol);
+      return std::nullopt;
+    }
+    symbols.push_back(symbol);
+  }
+  if (symbols.empty()) {
+    spdlog::error("[load_generator]: The symbol mix is empty.\n");
+    return std::nullopt;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(options.out_dir, error);
+  if (error) {
+    spdlog::error("[load_generator]: Could not create {}.\n",
+                  options.out_dir.string());
+    return std::nullopt;
+  }
+
+  std::mt19937 random(options.seed);
+  std::uniform_int_distribution<std::size_t> pickSymbol(0, symbols.size() - 1);
+  std::uniform_real_distribution<double> scale(0.75, 1.25);
+
+  std::vector<std::string> requests;
+  requests.reserve(options.boards);
+  for (std::size_t board = 0; board < options.boards; board++) {
+    nlohmann::json strokes = nlohmann::json::array();
+    // Symbols are laid out in rows of ten, like a line of an equation
+    for (std::size_t stroke = 0; stroke < options.strokes_per_board;
+         stroke++) {
+      const double size = options.stroke_size * scale(random);
+      const std::filesystem::path path =
+          std::filesystem::absolute(options.out_dir) /
+          fmt::format("board_{}_stroke_{}.svg", board, stroke);
+      if (!WriteSymbolSvg(path, symbols[pickSymbol(random)], size, random)) {
+        return std::nullopt;
+      }
+      strokes.push_back(
+          {{"id", stroke},
+           {"boardId", board},
+           {"path", path.string()},
+           {"x", static_cast<int>((stroke % 10) * options.stroke_size * 1.3)},
+           {"y", static_cast<int>((stroke / 10) * options.stroke_size * 1.6)}});
+    }
+    requests.push_back(nlohmann::json{{"strokes", strokes}}.dump());
+  }
+
+  spdlog::info("[load_generator]: Generated {} boards of {} strokes in {}.\n",
+               options.boards, options.strokes_per_board,
+               options.out_dir.string());
+  return requests;
+}
+
+// Every request of the capture at its recorded offset
+std::optional<std::vector<Message>> LoadCapture(const Options &options) {
+  std::ifstream file(options.replay_path);
+  if (!file) {
+    spdlog::error("[load_generator]: Could not open {}.\n",
+                  options.replay_path.string());
+    return std::nullopt;
+  }
+
+  std::vector<Message> messages;
+  std::string line;
+  std::size_t lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    if (line.empty()) {
+      continue;
+    }
+    const nlohmann::json record = nlohmann::json::parse(line, nullptr, false);
+    if (record.is_discarded() || !record.contains("request")) {
+      spdlog::error("[load_generator]: Invalid record on line {}.\n",
+                    lineNumber);
+      return std::nullopt;
+    }
+    const auto offset = std::chrono::duration<double, std::micro>(
+        record.value("offsetUs", 0.0) / options.replay_speed);
+    messages.push_back({std::chrono::duration_cast<Clock::duration>(offset),
+                        record["request"].get<std::string>(),
+                        record.value("connection", std::uint64_t{0})});
+  }
+
+  spdlog::info("[load_generator]: Replaying {} requests from {}.\n",
+               messages.size(), options.replay_path.string());
+  return messages;
+}
+
+// Connection to the daemon over the socket or the shared memory rings
+class DaemonConnection {
+public:
+  explicit DaemonConnection(const Options &options) : m_Options(options) {}
+
+  ~DaemonConnection() { Close(); }
+
+  bool Open() {
+    if (m_Options.shared_memory) {
+      return m_SharedMemory.Connect(m_Options.socket_path);
+    }
+
+    m_SocketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_SocketFd < 0) {
+      return false;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const std::string path = m_Options.socket_path.string();
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    if (connect(m_SocketFd, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) < 0) {
+      Close();
+      return false;
+    }
+
+    // A lost reply becomes an error instead of a stuck connection
+    timeval timeout{};
+    timeout.tv_sec = m_Options.reply_timeout.count() / 1000;
+    setsockopt(m_SocketFd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+               sizeof(timeout));
+    return true;
+  }
+
+  bool IsOpen() const {
+    return m_SocketFd >= 0 || m_SharedMemory.IsConnected();
+  }
+
+  // One message per line, the shared memory ring frames them itself
+  bool Send(const std::string &request) {
+    if (m_Options.shared_memory) {
+      return m_SharedMemory.Send(request);
+    }
+
+    m_Outgoing.assign(request);
+    m_Outgoing.push_back('\n');
+    std::size_t sent = 0;
+    while (sent < m_Outgoing.size()) {
+      const ssize_t written = send(m_SocketFd, m_Outgoing.data() + sent,
+                                   m_Outgoing.size() - sent, MSG_NOSIGNAL);
+      if (written <= 0) {
+        return false;
+      }
+      sent += static_cast<std::size_t>(written);
+    }
+    return true;
+  }
+
+  // Wait for the next reply, false on timeout or once the connection closed
+  bool Receive(std::string &reply) {
+    if (m_Options.shared_memory) {
+      if (!m_SharedMemory.Receive(m_Buffer, m_Options.reply_timeout)) {
+        return false;
+      }
+      reply.assign(m_Buffer.begin(), m_Buffer.end());
+      return true;
+    }
+
+    std::string_view message;
+    while (!m_Framer.Next(message)) {
+      m_Buffer.resize(64 * 1024);
+      const ssize_t received =
+          recv(m_SocketFd, m_Buffer.data(), m_Buffer.size(), 0);
+      if (received <= 0) {
+        return false;
+      }
+      m_Framer.Append(m_Buffer.data(), static_cast<std::size_t>(received));
+    }
+    reply.assign(message);
+    return true;
+  }
+
+  // Send the request and wait for the daemon's reply
+  bool Exchange(const std::string &request) {
+    return Send(request) && Receive(m_Reply) &&
+           ParseReply(m_Reply).value("status", "") == "ok";
+  }
+
+  // Wake up a Receive() waiting in another thread, socket transport only
+  void Shutdown() {
+    if (m_SocketFd >= 0) {
+      shutdown(m_SocketFd, SHUT_RDWR);
+    }
+  }
+
+  void Close() {
+    m_SharedMemory.Close();
+    if (m_SocketFd >= 0) {
+      close(m_SocketFd);
+      m_SocketFd = -1;
+    }
+    m_Framer = mathboard::MessageFramer{};
+  }
+
+  // Reply parsed, discarded when it isn't JSON
+  static nlohmann::json ParseReply(const std::string &reply) {
+    return nlohmann::json::parse(reply, nullptr, false);
+  }
+
+private:
+  const Options &m_Options;
+  int m_SocketFd{-1};
+  mathboard::SharedMemoryClient m_SharedMemory{};
+  mathboard::MessageFramer m_Framer{};
+  std::vector<unsigned char> m_Buffer{};
+  std::string m_Outgoing{};
+  std::string m_Reply{};
+};
+
+// The request with a requestId the reply will echo, requests that aren't
+// JSON objects (only in a replay) are sent as they are
+std::string WithRequestId(const std::string &request, std::uint64_t id) {
+  if (request.empty() || request.front() != '{') {
+    return request;
+  }
+  const std::size_t body = request.find_first_not_of(" \t\r\n", 1);
+  const bool empty = body != std::string::npos && request[body] == '}';
+  return "{\"requestId\":" + std::to_string(id) + (empty ? "" : ",") +
+         request.substr(1);
+}
+
+// One client connection, takes the next due request whenever it's idle
+void Worker(const Options &options, mathboard::BoundedQueue<Job> &jobs,
+            WorkerStats &stats) {
+  DaemonConnection connection(options);
+  connection.Open();
+
+  Job job;
+  while (jobs.Pop(job)) {
+    if (!connection.IsOpen()) {
+      connection.Open();
+    }
+    const bool succeeded =
+        connection.IsOpen() && connection.Exchange(*job.request);
+    const Clock::time_point now = Clock::now();
+
+    stats.latencies.Record(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(now -
+                                                              job.intended)
+            .count()));
+    stats.last_reply = now;
+    if (!succeeded) {
+      stats.errors++;
+      // Replies could be out of step now, start over on a new connection
+      connection.Close();
+    }
+  }
+}
+
+// One client connection keeping up to `options.pipeline` requests in flight:
+// this thread sends the due requests, a second one reads the replies in the
+// order the daemon finishes them and matches them up by requestId
+void PipelinedWorker(const Options &options,
+                     mathboard::BoundedQueue<Job> &jobs, WorkerStats &stats) {
+  DaemonConnection connection(options);
+  std::counting_semaphore<> slots(
+      static_cast<std::ptrdiff_t>(options.pipeline));
+  std::mutex mutex;
+  std::condition_variable replied;
+  // Due time of every request in flight, by requestId
+  std::map<std::uint64_t, Clock::time_point> pending;
+  bool broken = false;
+  std::uint64_t nextId = 1;
+
+  // Called with `mutex` held
+  const auto record = [&stats](Clock::time_point intended, bool succeeded) {
+    const Clock::time_point now = Clock::now();
+    stats.latencies.Record(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - intended)
+            .count()));
+    stats.last_reply = now;
+    if (!succeeded) {
+      stats.errors++;
+    }
+  };
+
+  const auto receive = [&]() {
+    std::string reply;
+    while (connection.Receive(reply)) {
+      const nlohmann::json status = DaemonConnection::ParseReply(reply);
+      std::lock_guard lock(mutex);
+      auto request = pending.end();
+      if (!status.is_discarded() && status.contains("requestId") &&
+          status["requestId"].is_number_unsigned()) {
+        request = pending.find(status["requestId"].get<std::uint64_t>());
+      }
+      // A reply without our id answers a request that wasn't a JSON object,
+      // the daemon answers those right away
+      if (request == pending.end() && !pending.empty()) {
+        request = pending.begin();
+      }
+      if (request == pending.end()) {
+        continue;
+      }
+      record(request->second,
+             !status.is_discarded() && status.value("status", "") == "ok");
+      pending.erase(request);
+      slots.release();
+      replied.notify_all();
+    }
+
+    // Timed out or closed, whatever is in flight is lost
+    std::lock_guard lock(mutex);
+    for (const auto &[id, intended] : pending) {
+      record(intended, false);
+      slots.release();
+    }
+    pending.clear();
+    broken = true;
+    replied.notify_all();
+  };
+
+  std::thread receiver;
+  const auto reconnect = [&]() {
+    if (receiver.joinable()) {
+      connection.Shutdown();
+      receiver.join();
+    }
+    connection.Close();
+    broken = false;
+    if (connection.Open()) {
+      receiver = std::thread(receive);
+    }
+  };
+  reconnect();
+
+  Job job;
+  while (jobs.Pop(job)) {
+    slots.acquire();
+    bool reconnecting;
+    {
+      std::lock_guard lock(mutex);
+      reconnecting = broken || !connection.IsOpen();
+    }
+    if (reconnecting) {
+      reconnect();
+    }
+
+    const std::uint64_t id = nextId++;
+    {
+      std::lock_guard lock(mutex);
+      pending[id] = job.intended;
+    }
+    if (!connection.IsOpen() ||
+        !connection.Send(WithRequestId(*job.request, id))) {
+      std::lock_guard lock(mutex);
+      // Unless the receiver gave up on it already
+      if (pending.erase(id) != 0) {
+        record(job.intended, false);
+        slots.release();
+      }
+      broken = true;
+    }
+  }
+
+  {
+    std::unique_lock lock(mutex);
+    replied.wait(lock, [&]() { return pending.empty() || broken; });
+  }
+  if (receiver.joinable()) {
+    connection.Shutdown();
+    receiver.join();
+  }
+}
+
+void LogSummary(const LatencyHistogram &latencies, std::uint64_t errors,
+                std::chrono::duration<double> elapsed) {
+  const auto ms = [](std::uint64_t us) {
+    return static_cast<double>(us) / 1000.0;
+  };
+  spdlog::info("[load_generator]: {} requests in {:.2f}s, {:.1f} req/s, {} "
+               "errors.\n",
+               latencies.Count(), elapsed.count(),
+               static_cast<double>(latencies.Count()) / elapsed.count(),
+               errors);
+  spdlog::info("[load_generator]: Latency (ms) min {:.3f}, p50 {:.3f}, p90 "
+               "{:.3f}, p99 {:.3f}, p99.9 {:.3f}, max {:.3f}, mean {:.3f}.\n",
+               ms(latencies.Min()), ms(latencies.ValueAtPercentile(50.0)),
+               ms(latencies.ValueAtPercentile(90.0)),
+               ms(latencies.ValueAtPercentile(99.0)),
+               ms(latencies.ValueAtPercentile(99.9)), ms(latencies.Max()),
+               latencies.Mean() / 1000.0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options{};
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--socket" && i + 1 < argc) {
+      options.socket_path = argv[++i];
+    } else if (arg == "--transport" && i + 1 < argc) {
+      const std::string transport = argv[++i];
+      if (transport != "socket" && transport != "shared-memory") {
+        spdlog::error("[load_generator]: Unknown transport {}.\n", transport);
+        return 1;
+      }
+      options.shared_memory = transport == "shared-memory";
+    } else if (arg == "--rate" && i + 1 < argc) {
+      options.rate = std::stod(argv[++i]);
+    } else if (arg == "--duration" && i + 1 < argc) {
+      options.duration = std::chrono::seconds(std::stoi(argv[++i]));
+    } else if (arg == "--connections" && i + 1 < argc) {
+      options.connections = std::stoul(argv[++i]);
+    } else if (arg == "--pipeline" && i + 1 < argc) {
+      options.pipeline = std::stoul(argv[++i]);
+    } else if (arg == "--replay" && i + 1 < argc) {
+      options.replay_path = argv[++i];
+    } else if (arg == "--speed" && i + 1 < argc) {
+      options.replay_speed = std::stod(argv[++i]);
+    } else if (arg == "--boards" && i + 1 < argc) {
+      options.boards = std::stoul(argv[++i]);
+    } else if (arg == "--strokes" && i + 1 < argc) {
+      options.strokes_per_board = std::stoul(argv[++i]);
+    } else if (arg == "--stroke-size" && i + 1 < argc) {
+      options.stroke_size = std::stod(argv[++i]);
+    } else if (arg == "--symbols" && i + 1 < argc) {
+      options.symbols = argv[++i];
+    } else if (arg == "--out" && i + 1 < argc) {
+      options.out_dir = argv[++i];
+    } else if (arg == "--seed" && i + 1 < argc) {
+      options.seed = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+    } else if (arg == "--percentiles" && i + 1 < argc) {
+      options.percentiles_path = argv[++i];
+    } else {
+      spdlog::error("[load_generator]: Unknown argument {}.\n", arg);
+      return 1;
+    }
+  }
+
+  if (options.rate <= 0.0 || options.replay_speed <= 0.0 ||
+      options.connections == 0 || options.boards == 0 ||
+      options.pipeline == 0) {
+    spdlog::error("[load_generator]: --rate, --speed, --connections, "
+                  "--pipeline and --boards have to be positive.\n");
+    return 1;
+  }
+  if (options.pipeline > 1 && options.shared_memory) {
+    spdlog::error("[load_generator]: --pipeline needs the socket "
+                  "transport.\n");
+    return 1;
+  }
+
+  std::vector<Message> messages;
+  if (!options.replay_path.empty()) {
+    std::optional<std::vector<Message>> capture = LoadCapture(options);
+    if (!capture) {
+      return 1;
+    }
+    messages = std::move(*capture);
+  } else {
+    std::optional<std::vector<std::string>> boards = GenerateBoards(options);
+    if (!boards) {
+      return 1;
+    }
+    const auto count = static_cast<std::size_t>(
+        options.rate * static_cast<double>(options.duration.count()));
+    const std::chrono::duration<double> interval(1.0 / options.rate);
+    messages.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+      messages.push_back(
+          {std::chrono::duration_cast<Clock::duration>(interval * i),
+           (*boards)[i % boards->size()]});
+    }
+  }
+
+  // Requests of a recorded connection go over a client connection of their
+  // own, in the recorded order, so the daemon sees the same interleaving.
+  // Generated requests share one queue, an idle connection takes the next.
+  std::vector<std::size_t> queueOfMessage(messages.size(), 0);
+  std::vector<std::size_t> queueSizes;
+  if (options.replay_path.empty()) {
+    queueSizes.push_back(messages.size());
+  } else {
+    std::map<std::uint64_t, std::size_t> queueOfConnection;
+    for (std::size_t i = 0; i < messages.size(); i++) {
+      const auto [queue, inserted] = queueOfConnection.try_emplace(
+          messages[i].connection, queueSizes.size());
+      if (inserted) {
+        queueSizes.push_back(0);
+      }
+      queueOfMessage[i] = queue->second;
+      queueSizes[queue->second]++;
+    }
+    spdlog::info("[load_generator]: Replaying {} connections.\n",
+                 queueSizes.size());
+  }
+
+  std::vector<std::unique_ptr<mathboard::BoundedQueue<Job>>> queues;
+  for (const std::size_t size : queueSizes) {
+    queues.push_back(std::make_unique<mathboard::BoundedQueue<Job>>(
+        std::max<std::size_t>(size, 2)));
+  }
+  const std::size_t connections =
+      options.replay_path.empty() ? options.connections : queues.size();
+  std::vector<WorkerStats> stats(connections);
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < connections; i++) {
+    workers.emplace_back(options.pipeline > 1 ? PipelinedWorker : Worker,
+                         std::cref(options),
+                         std::ref(*queues[i % queues.size()]),
+                         std::ref(stats[i]));
+  }
+
+  // Open loop: requests are due on schedule whether or not earlier ones got
+  // their reply, a busy daemon queues them up here
+  const Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < messages.size(); i++) {
+    const Clock::time_point intended = start + messages[i].offset;
+    std::this_thread::sleep_until(intended);
+    queues[queueOfMessage[i]]->Push(Job{intended, &messages[i].request});
+  }
+  for (const auto &queue : queues) {
+    queue->Close();
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  LatencyHistogram latencies{};
+  std::uint64_t errors = 0;
+  Clock::time_point end = start;
+  for (const WorkerStats &workerStats : stats) {
+    latencies.Merge(workerStats.latencies);
+    errors += workerStats.errors;
+    end = std::max(end, workerStats.last_reply);
+  }
+  LogSummary(latencies, errors, end - start);
+
+  if (!options.percentiles_path.empty()) {
+    std::ofstream file(options.percentiles_path);
+    if (!file) {
+      spdlog::error("[load_generator]: Could not write {}.\n",
+                    options.percentiles_path.string());
+      return 1;
+    }
+    latencies.WritePercentiles(file);
+  }
+
+  return errors == 0 ? 0 : 1;
+}